@@ -0,0 +1,147 @@
+/*! \file
+ * Benchmark of vectorized loops over buffers from the allocator, with the
+ * buffers at three alignments:
+ *
+ *   - 4-byte:   4 bytes past a 16-byte boundary, where payloads used to start
+ *               when blocks had a bare 4-byte header
+ *   - 16-byte:  what myalloc() now returns by default
+ *   - 64-byte:  from myalloc_aligned(), so each buffer starts a cache line
+ *
+ * The kernels are compiled with -O3, so the compiler vectorizes them; with
+ * misaligned buffers some of the vector loads and stores span two cache
+ * lines.  Each kernel is timed over a working set that fits in the L1 cache,
+ * and one that fits in the L2 cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "myalloc.h"
+
+
+/* Size of the pool the buffers are allocated from. */
+#define BENCH_MEMORY_SIZE (4 * 1024 * 1024)
+
+/* Each kernel touches about this many elements in total per layout. */
+#define TOTAL_ELEMENTS (256 * 1024 * 1024)
+
+/* The working sets:  number of floats in each of the two buffers. */
+int buffer_floats[] = { 2 * 1024, 32 * 1024 };
+#define NUM_BUFFER_SIZES \
+    ((int) (sizeof(buffer_floats) / sizeof(buffer_floats[0])))
+
+
+/* The buffer layouts being compared. */
+typedef enum { ALIGN_4, ALIGN_16, ALIGN_64 } layout;
+#define NUM_LAYOUTS 3
+
+const char *layout_names[NUM_LAYOUTS] = { "4-byte", "16-byte", "64-byte" };
+
+
+/* Allocates a buffer of "size" bytes with the given layout. */
+float * alloc_buffer(layout l, int size) {
+    unsigned char *block;
+
+    switch (l) {
+    case ALIGN_4:
+        block = myalloc(size + 4);
+        return (block == NULL) ? NULL : (float *) (block + 4);
+    case ALIGN_16:
+        return (float *) myalloc(size);
+    default:
+        return (float *) myalloc_aligned(size, 64);
+    }
+}
+
+
+void free_buffer(layout l, float *buffer) {
+    myfree((unsigned char *) buffer - (l == ALIGN_4 ? 4 : 0));
+}
+
+
+/* The kernels.  They are kept out of line, so the compiler can't see the
+ * buffers' alignment and has to vectorize for any alignment.
+ */
+__attribute__((noinline))
+void saxpy(float * restrict y, const float * restrict x, float a, int n) {
+    int i;
+
+    for (i = 0; i < n; i++)
+        y[i] = a * x[i] + y[i];
+}
+
+
+__attribute__((noinline))
+void scale(float * restrict y, const float * restrict x, float a, int n) {
+    int i;
+
+    for (i = 0; i < n; i++)
+        y[i] = a * x[i];
+}
+
+
+double now_sec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main(int argc, char *argv[]) {
+    float *x[NUM_LAYOUTS], *y[NUM_LAYOUTS];
+    double start, saxpy_ns, scale_ns;
+    int s, l, n, i, reps;
+
+    MEMORY_SIZE = BENCH_MEMORY_SIZE;
+    init_myalloc();
+
+    printf("%9s  %8s  %7s  %14s  %14s\n", "floats", "layout", "offset",
+           "saxpy ns/elem", "scale ns/elem");
+
+    for (s = 0; s < NUM_BUFFER_SIZES; s++) {
+        n = buffer_floats[s];
+        reps = TOTAL_ELEMENTS / n;
+
+        for (l = 0; l < NUM_LAYOUTS; l++) {
+            x[l] = alloc_buffer(l, n * sizeof(float));
+            y[l] = alloc_buffer(l, n * sizeof(float));
+            if (x[l] == NULL || y[l] == NULL) {
+                fprintf(stderr, "alignbench: out of memory\n");
+                return 1;
+            }
+            for (i = 0; i < n; i++) {
+                x[l][i] = (float) i;
+                y[l][i] = 1.0f;
+            }
+        }
+
+        for (l = 0; l < NUM_LAYOUTS; l++) {
+            // Warm the caches and the branch predictors first
+            saxpy(y[l], x[l], 1e-6f, n);
+
+            start = now_sec();
+            for (i = 0; i < reps; i++)
+                saxpy(y[l], x[l], 1e-6f, n);
+            saxpy_ns = (now_sec() - start) * 1e9 / ((double) reps * n);
+
+            start = now_sec();
+            for (i = 0; i < reps; i++)
+                scale(y[l], x[l], 1.0f, n);
+            scale_ns = (now_sec() - start) * 1e9 / ((double) reps * n);
+
+            printf("%9d  %8s  %7d  %14.4f  %14.4f\n", n, layout_names[l],
+                   (int) ((uintptr_t) x[l] % 64), saxpy_ns, scale_ns);
+        }
+
+        for (l = 0; l < NUM_LAYOUTS; l++) {
+            free_buffer(l, x[l]);
+            free_buffer(l, y[l]);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*! \file
+ * Implementation of a thread-safe front end to the simple memory allocator.
+ *
+ * The shared pool is protected by a single mutex.  To keep threads from
+ * contending on it, each thread owns one cache of free blocks per small size
+ * class (8, 16, 32, ... MT_MAX_CACHED_SIZE bytes).  A cache that runs dry is
+ * refilled with MT_BATCH_SIZE blocks under one acquisition of the lock, and a
+ * cache that grows past MT_CACHE_LIMIT blocks spills MT_BATCH_SIZE of them
+ * back to the pool the same way.  Cached blocks stay marked as allocated in
+ * the pool's boundary tags, so the pool never coalesces them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "myalloc.h"
+#include "mtalloc.h"
+
+
+/* The smallest size class; it must be able to hold the cache link. */
+#define MT_MIN_CLASS_BITS 3
+#define MT_MAX_CLASS_BITS 8
+#define MT_NUM_CLASSES (MT_MAX_CLASS_BITS - MT_MIN_CLASS_BITS + 1)
+
+/* Number of blocks moved between a thread cache and the pool at once. */
+#define MT_BATCH_SIZE 32
+
+/* Number of blocks a single class cache may hold before spilling. */
+#define MT_CACHE_LIMIT (2 * MT_BATCH_SIZE)
+
+
+/* A free block sitting in a thread cache.  The link lives in the block's
+ * own payload, so caching costs no extra memory.
+ */
+typedef struct cached_block {
+    struct cached_block *next;
+} cached_block;
+
+
+/* The caches owned by a single thread, one per size class. */
+typedef struct {
+    cached_block *blocks[MT_NUM_CLASSES];
+    int count[MT_NUM_CLASSES];
+} thread_cache;
+
+
+/* Protects the shared pool, i.e. every call to myalloc() and myfree(). */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Used to flush a thread's caches back to the pool when the thread exits. */
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+/* The calling thread's caches; allocated on the thread's first request. */
+static __thread thread_cache *my_cache;
+
+
+static void release_thread_cache(void *cache);
+
+
+/* Returns the size class a request of "size" bytes is rounded up to. */
+static int class_for_request(int size) {
+    int c = 0;
+
+    while ((1 << (c + MT_MIN_CLASS_BITS)) < size)
+        c++;
+    return c;
+}
+
+
+/* Returns the largest size class that a block of "usable" bytes can serve,
+ * or -1 if the block is too big to be cached without wasting over half of it.
+ */
+static int class_for_block(int usable) {
+    int c = MT_NUM_CLASSES - 1;
+
+    if (usable >= 2 * MT_MAX_CACHED_SIZE)
+        return -1;
+
+    while (c >= 0 && (1 << (c + MT_MIN_CLASS_BITS)) > usable)
+        c--;
+    return c;
+}
+
+
+/* Returns the calling thread's caches, creating them if necessary. */
+static thread_cache * get_thread_cache() {
+    if (my_cache == NULL) {
+        my_cache = (thread_cache *) calloc(1, sizeof(thread_cache));
+        if (my_cache == NULL) {
+            fprintf(stderr, "mtalloc: could not allocate a thread cache\n");
+            abort();
+        }
+        pthread_setspecific(cache_key, my_cache);
+    }
+    return my_cache;
+}
+
+
+/* Moves up to MT_BATCH_SIZE blocks of size class c from the shared pool into
+ * the cache, holding the pool lock once for the whole batch.
+ */
+static void refill_cache(thread_cache *cache, int c) {
+    int i;
+    unsigned char *block;
+
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < MT_BATCH_SIZE; i++) {
+        block = myalloc(1 << (c + MT_MIN_CLASS_BITS));
+        if (block == NULL)
+            break;
+        ((cached_block *) block)->next = cache->blocks[c];
+        cache->blocks[c] = (cached_block *) block;
+        cache->count[c]++;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+
+/* Returns "num" blocks of size class c from the cache to the shared pool,
+ * holding the pool lock once for the whole batch.
+ */
+static void spill_cache(thread_cache *cache, int c, int num) {
+    cached_block *block;
+
+    pthread_mutex_lock(&pool_lock);
+    while (num > 0 && cache->blocks[c] != NULL) {
+        block = cache->blocks[c];
+        cache->blocks[c] = block->next;
+        cache->count[c]--;
+        myfree((unsigned char *) block);
+        num--;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+
+/* Creates the key whose destructor flushes an exiting thread's caches. */
+static void create_cache_key() {
+    if (pthread_key_create(&cache_key, release_thread_cache) != 0) {
+        fprintf(stderr, "init_mtalloc: could not create thread-cache key\n");
+        abort();
+    }
+}
+
+
+/* Initializes the shared pool, and the state used to synchronize access
+ * to it.
+ */
+void init_mtalloc() {
+    pthread_once(&cache_key_once, create_cache_key);
+
+    pthread_mutex_lock(&pool_lock);
+    init_myalloc();
+    pthread_mutex_unlock(&pool_lock);
+}
+
+
+/* Thread-safe version of myalloc().  Small requests are served from the
+ * calling thread's cache, which is refilled from the pool when empty.
+ */
+unsigned char * mt_myalloc(int size) {
+    thread_cache *cache;
+    cached_block *block;
+    unsigned char *result;
+    int c;
+
+    /* Like myalloc(), a negative size can't be served. */
+    if (size < 0)
+        return (unsigned char *) 0;
+
+    if (size > MT_MAX_CACHED_SIZE) {
+        pthread_mutex_lock(&pool_lock);
+        result = myalloc(size);
+        pthread_mutex_unlock(&pool_lock);
+        return result;
+    }
+
+    cache = get_thread_cache();
+    c = class_for_request(size);
+    if (cache->blocks[c] == NULL) {
+        refill_cache(cache, c);
+        if (cache->blocks[c] == NULL)
+            return (unsigned char *) 0;
+    }
+
+    block = cache->blocks[c];
+    cache->blocks[c] = block->next;
+    cache->count[c]--;
+    return (unsigned char *) block;
+}
+
+
+/* Thread-safe version of myfree().  Small blocks go to the calling thread's
+ * cache, which spills a batch back to the pool when it grows too large.
+ */
+void mt_myfree(unsigned char *oldptr) {
+    thread_cache *cache;
+    cached_block *block = (cached_block *) oldptr;
+    int c;
+
+    /* Like free(), freeing a null pointer does nothing. */
+    if (oldptr == NULL)
+        return;
+
+    /* The usable size is read from the block's header, which only changes
+     * while the block is free, so this doesn't need the pool lock.
+     */
+    c = class_for_block(myalloc_usable_size(oldptr));
+    if (c < 0) {
+        pthread_mutex_lock(&pool_lock);
+        myfree(oldptr);
+        pthread_mutex_unlock(&pool_lock);
+        return;
+    }
+
+    cache = get_thread_cache();
+    block->next = cache->blocks[c];
+    cache->blocks[c] = block;
+    cache->count[c]++;
+
+    if (cache->count[c] > MT_CACHE_LIMIT)
+        spill_cache(cache, c, MT_BATCH_SIZE);
+}
+
+
+/* Returns every block in the calling thread's caches to the shared pool. */
+void mt_flush_cache() {
+    int c;
+
+    if (my_cache == NULL)
+        return;
+
+    for (c = 0; c < MT_NUM_CLASSES; c++)
+        spill_cache(my_cache, c, my_cache->count[c]);
+}
+
+
+/* Thread-exit destructor registered with cache_key. */
+static void release_thread_cache(void *cache) {
+    my_cache = (thread_cache *) cache;
+    mt_flush_cache();
+    free(my_cache);
+    my_cache = NULL;
+}
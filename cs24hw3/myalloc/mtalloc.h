@@ -0,0 +1,35 @@
+/*! \file
+ * Declarations for a thread-safe front end to the simple memory allocator.
+ * All threads share the single boundary-tag pool managed by myalloc(), but
+ * each thread keeps a small cache of free blocks for every small size class,
+ * so that most small allocations and frees never touch the shared pool.
+ * Caches are refilled from, and spilled back to, the shared pool in batches.
+ */
+
+
+/* Requests up to this many bytes are served from the per-thread caches. */
+#define MT_MAX_CACHED_SIZE 256
+
+
+/* Initializes the shared pool (of MEMORY_SIZE bytes, using ALLOC_POLICY),
+ * and the state used to synchronize access to it.  Must be called before any
+ * thread calls mt_myalloc() or mt_myfree(), and may only be called again once
+ * every thread that used the previous pool has exited.
+ */
+void init_mtalloc();
+
+
+/* Thread-safe version of myalloc(). */
+unsigned char * mt_myalloc(int size);
+
+
+/* Thread-safe version of myfree().  A block may be freed by a different
+ * thread than the one that allocated it.
+ */
+void mt_myfree(unsigned char *oldptr);
+
+
+/* Returns every block in the calling thread's caches to the shared pool.
+ * This happens automatically when a thread exits.
+ */
+void mt_flush_cache();
@@ -0,0 +1,179 @@
+/*! \file
+ * Contention benchmark for the thread-safe allocator front end.  Each thread
+ * repeatedly allocates and frees small blocks against the shared pool, and
+ * the test is repeated for increasing thread counts.  Two front ends are
+ * compared:
+ *
+ *   - locked:  every myalloc()/myfree() call takes a single global mutex
+ *   - cached:  mt_myalloc()/mt_myfree(), with per-thread size-class caches
+ *
+ * For each run the total allocation rate, and the rate per core in use, are
+ * reported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "myalloc.h"
+#include "mtalloc.h"
+
+
+/* Size of the shared pool. */
+#define BENCH_MEMORY_SIZE (64 * 1024 * 1024)
+
+/* Most threads the benchmark will try to run. */
+#define MAX_THREADS 16
+
+/* Number of live-block slots each thread cycles through. */
+#define NUM_SLOTS 1024
+
+/* Number of operations (allocations plus frees) each thread performs. */
+#define OPS_PER_THREAD 2000000
+
+/* Allocations are between 1 and this many bytes. */
+#define MAX_BLOCK_SIZE 128
+
+
+/* The two front ends the benchmark compares. */
+typedef enum { LOCKED, CACHED } front_end;
+
+typedef struct {
+    front_end mode;
+    unsigned int seed;
+    long num_allocs;
+} thread_info;
+
+
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+unsigned char * bench_alloc(front_end mode, int size) {
+    unsigned char *result;
+
+    if (mode == CACHED)
+        return mt_myalloc(size);
+
+    pthread_mutex_lock(&bench_lock);
+    result = myalloc(size);
+    pthread_mutex_unlock(&bench_lock);
+    return result;
+}
+
+
+void bench_free(front_end mode, unsigned char *ptr) {
+    if (mode == CACHED) {
+        mt_myfree(ptr);
+        return;
+    }
+
+    pthread_mutex_lock(&bench_lock);
+    myfree(ptr);
+    pthread_mutex_unlock(&bench_lock);
+}
+
+
+/* Randomly either fills an empty slot with a new block, or frees the block
+ * held in an occupied slot.
+ */
+void * thread_func(void *arg) {
+    thread_info *info = (thread_info *) arg;
+    unsigned char *slots[NUM_SLOTS];
+    int i, slot, size;
+
+    memset(slots, 0, sizeof(slots));
+
+    for (i = 0; i < OPS_PER_THREAD; i++) {
+        slot = rand_r(&info->seed) % NUM_SLOTS;
+        if (slots[slot] != NULL) {
+            bench_free(info->mode, slots[slot]);
+            slots[slot] = NULL;
+        }
+        else {
+            size = 1 + rand_r(&info->seed) % MAX_BLOCK_SIZE;
+            slots[slot] = bench_alloc(info->mode, size);
+            if (slots[slot] == NULL) {
+                fprintf(stderr, "mtbench: allocation failed\n");
+                abort();
+            }
+            slots[slot][0] = (unsigned char) i;
+            info->num_allocs++;
+        }
+    }
+
+    for (slot = 0; slot < NUM_SLOTS; slot++) {
+        if (slots[slot] != NULL)
+            bench_free(info->mode, slots[slot]);
+    }
+
+    return NULL;
+}
+
+
+/* Runs the benchmark with the given front end and number of threads, and
+ * returns the total number of allocations per second.
+ */
+double run_bench(front_end mode, int num_threads) {
+    pthread_t threads[MAX_THREADS];
+    thread_info info[MAX_THREADS];
+    struct timespec t_start, t_end;
+    double elapsed;
+    long num_allocs = 0;
+    int i;
+
+    MEMORY_SIZE = BENCH_MEMORY_SIZE;
+    init_mtalloc();
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (i = 0; i < num_threads; i++) {
+        info[i].mode = mode;
+        info[i].seed = 12345 + i;
+        info[i].num_allocs = 0;
+        if (pthread_create(threads + i, NULL, thread_func, info + i) != 0) {
+            fprintf(stderr, "mtbench: could not create thread %d\n", i);
+            abort();
+        }
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+        num_allocs += info[i].num_allocs;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    elapsed = (t_end.tv_sec - t_start.tv_sec) +
+              (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+    return num_allocs / elapsed;
+}
+
+
+int main(int argc, char *argv[]) {
+    int num_cpus, max_threads, num_threads, cores;
+    double locked, cached;
+
+    ALLOC_POLICY = SEGREGATED_FIT;
+
+    num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus < 1)
+        num_cpus = 1;
+    max_threads = 2 * num_cpus;
+    if (max_threads > MAX_THREADS)
+        max_threads = MAX_THREADS;
+
+    printf("Running %d ops per thread on %d online CPUs, blocks of 1-%d "
+           "bytes.\n\n", OPS_PER_THREAD, num_cpus, MAX_BLOCK_SIZE);
+    printf("%7s  %14s %14s  %14s %14s\n", "threads", "locked a/s",
+           "locked a/s/cpu", "cached a/s", "cached a/s/cpu");
+
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        cores = (num_threads < num_cpus) ? num_threads : num_cpus;
+        locked = run_bench(LOCKED, num_threads);
+        cached = run_bench(CACHED, num_threads);
+        printf("%7d  %14.0f %14.0f  %14.0f %14.0f\n", num_threads,
+               locked, locked / cores, cached, cached / cores);
+    }
+
+    return 0;
+}
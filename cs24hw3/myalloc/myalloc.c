@@ -10,6 +10,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "myalloc.h"
 
@@ -23,9 +28,21 @@
 int MEMORY_SIZE;
 unsigned char *mem;
 
+/*! The placement policy selected for the allocator; see myalloc.h. */
+alloc_policy ALLOC_POLICY = FIRST_FIT;
 
-/* Blocks are represented with a signed int header indicating the block's 
- * size (positive if free, negative if allocated) and a footer, identical 
+/*! Whether the pool grows by mapping more arenas; see myalloc.h. */
+int ARENA_MODE = 0;
+
+/*! Whether every call validates the pool; see myalloc.h. */
+int DEBUG_HEAP = 0;
+
+/*! Whether myfree() defers coalescing small blocks; see myalloc.h. */
+int DEFER_COALESCE = 0;
+
+
+/* Blocks are represented with a signed int header indicating the block's
+ * size (positive if free, negative if allocated) and a footer, identical
  * to the header. We represent both here through a struct named "tag".
  */
 typedef struct {
@@ -33,18 +50,693 @@ typedef struct {
     // Positive size = free
     int size;
 } tag;
-tag *start; // start of the memory pool (points to header)
-tag *end; // end of the memory pool (points to footer)
 tag *point_to_foot(tag* head){
-    // Returns a pointer to the start of the footer tag of a block given a 
+    // Returns a pointer to the start of the footer tag of a block given a
     // pointer to the start of the block's header tag
     return (tag *) ((void *) head + sizeof(tag) + abs(head->size));
 }
 tag *point_to_head(tag* foot){
-    // Returns a pointer to the start of the head tag of a block given a 
+    // Returns a pointer to the start of the head tag of a block given a
     // pointer to the start of the block's foot tag
     return (tag *) ((void *) foot - abs(foot->size) - sizeof(tag));
-}  
+}
+
+
+/* Every payload starts at a multiple of MYALLOC_ALIGNMENT.  A payload is
+ * followed by its footer and the next block's header, so every block's size
+ * is TAGS_SIZE short of a multiple of MYALLOC_ALIGNMENT.  ALIGN_SIZE()
+ * rounds a size up to the next such size.
+ */
+#define TAGS_SIZE ((int) (2 * sizeof(tag)))
+#define ALIGN_SIZE(size) \
+    ((((size) + TAGS_SIZE + MYALLOC_ALIGNMENT - 1) & \
+      ~(MYALLOC_ALIGNMENT - 1)) - TAGS_SIZE)
+
+
+/* The pool is made of one or more arenas.  Each arena's blocks lie between
+ * two fence tags:
+ *
+ *     [fence tag][block][block]...[block][fence tag]
+ *
+ * The fence tags hold FENCE_SIZE, which is negative, so coalescing treats
+ * them like allocated neighbors and never runs off either end of an arena.
+ * A free block whose neighbors are both fences spans its whole arena.
+ *
+ * The front fence is placed so that the first payload is aligned, which
+ * may leave a few bytes unused at either end of the arena's region.
+ *
+ * Without ARENA_MODE there is a single arena, covering the whole pool that
+ * init_myalloc() malloc's, and described by fixed_arena.  With ARENA_MODE,
+ * every arena is mapped with mmap(), and its description is stored at the
+ * start of the mapping, ARENA_FENCE_OFFSET bytes before the front fence.
+ */
+typedef struct arena {
+    struct arena *prev; // previous arena in the directory
+    struct arena *next; // next arena in the directory
+    tag *fence; // the arena's front fence; its blocks follow it
+    int length; // bytes from the front fence to the end of the back fence
+    int region_length; // size of the arena's whole region, for releasing it
+    int is_mapped; // 1 if the region came from mmap(), 0 if from malloc()
+} arena;
+
+#define FENCE_SIZE INT_MIN
+#define FENCES_SIZE ((int) (2 * sizeof(tag)))
+#define ARENA_FENCE_OFFSET \
+    ((int) ((sizeof(arena) + FENCES_SIZE + MYALLOC_ALIGNMENT - 1) & \
+            ~(MYALLOC_ALIGNMENT - 1)) - FENCES_SIZE)
+
+arena fixed_arena; // the single arena used without ARENA_MODE
+arena *first_arena; // the arena directory, in the order arenas were added
+arena *last_arena;
+int num_arenas;
+long heap_length; // total length of all arenas
+
+tag *first_block(arena *a) {
+    // Returns the header of the first block in an arena, just past its
+    // front fence
+    return a->fence + 1;
+}
+
+arena *arena_of_spanning_block(tag *head) {
+    // Given the header of a block that spans its whole mapped arena, returns
+    // the arena description that precedes the front fence
+    return (arena *) ((unsigned char *) (head - 1) - ARENA_FENCE_OFFSET);
+}
+
+
+/* With the SEGREGATED_FIT policy, each free block's payload holds the links
+ * of a doubly-linked list threaded through all free blocks of the same size
+ * class.  Size class c holds free blocks whose size lies in [2^c, 2^(c+1)).
+ * A free block therefore needs a payload of at least MIN_FREE_PAYLOAD bytes,
+ * so smaller requests are rounded up to that size.  (MIN_FREE_PAYLOAD is
+ * itself rounded to a valid block size.)
+ */
+typedef struct {
+    tag *prev;
+    tag *next;
+} free_links;
+
+#define MIN_FREE_PAYLOAD ALIGN_SIZE((int) sizeof(free_links))
+#define NUM_SIZE_CLASSES 32
+
+/* Number of blocks examined in a request's own size class before falling
+ * back to a larger class, where every block is guaranteed to fit.  Bounding
+ * the scan keeps allocation constant-time.
+ */
+#define SEGREGATED_SCAN_LIMIT 8
+
+tag *size_classes[NUM_SIZE_CLASSES]; // head of each size class's free list
+unsigned int nonempty_classes; // bit c is set iff size_classes[c] != NULL
+
+free_links *links_of(tag *head) {
+    // Returns the free-list links stored in a free block's payload
+    return (free_links *) (head + 1);
+}
+
+int size_class(int size) {
+    // Returns floor(log2(size)); blocks of size 0 share class 0
+    return (size > 0) ? 31 - __builtin_clz((unsigned int) size) : 0;
+}
+
+
+/* With DEBUG_HEAP set, the pool is validated as each call enters and leaves
+ * the allocator.  "where" names the call, for the error message.
+ */
+void check_heap(const char *where);
+
+#define CHECK_HEAP(where) \
+    do { if (DEBUG_HEAP) check_heap(where); } while (0)
+
+
+/* With the BEST_FIT policy, the free blocks form a treap:  a binary search
+ * tree ordered by (size, address), that is also a heap ordered by a
+ * pseudo-random priority.  The priority is a hash of the block's address, so
+ * only the child links need to be stored, in the free block's payload just
+ * like the segregated list links.  The tree's expected depth is O(log n).
+ */
+typedef struct {
+    tag *left;
+    tag *right;
+} tree_links;
+
+tag *free_tree; // root of the treap of free blocks
+
+tree_links *tree_links_of(tag *head) {
+    // Returns the tree links stored in a free block's payload
+    return (tree_links *) (head + 1);
+}
+
+unsigned int tree_priority(tag *head) {
+    // Mixes the bits of the block's address into a pseudo-random priority
+    uintptr_t h = (uintptr_t) head;
+
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return (unsigned int) h;
+}
+
+int tree_less(tag *a, tag *b) {
+    // Orders free blocks by size, and blocks of equal size by address
+    return a->size < b->size || (a->size == b->size && a < b);
+}
+
+
+/* With the NEXT_FIT policy, each search resumes at the rover:  the block just
+ * past the last one allocated, in arena rover_arena.  A null rover means the
+ * next search starts at the beginning of the pool.
+ */
+tag *rover;
+arena *rover_arena;
+
+
+/* The payload bytes in [fresh_start, fresh_end) have not been handed out
+ * since their arena was mapped (or calloc'd), so they are still zero, apart
+ * from the tags and free index links of the free block they lie in.  This
+ * lets mycalloc() skip zeroing them.  Only the most recently added arena is
+ * tracked.
+ */
+unsigned char *fresh_start;
+unsigned char *fresh_end;
+
+void touch_fresh(unsigned char *start, unsigned char *end) {
+    // Marks [start, end) as possibly holding nonzero data
+    if (start < fresh_end && end > fresh_start)
+        fresh_start = (end < fresh_end) ? end : fresh_end;
+}
+
+
+/* With DEFER_COALESCE, myfree() parks blocks of up to QUICK_MAX_SIZE bytes on
+ * quick-lists, one per exact block size, instead of coalescing them.  Block
+ * sizes are 8 short of a multiple of MYALLOC_ALIGNMENT, so a block's size
+ * divided by MYALLOC_ALIGNMENT is its list.  Parked blocks stay marked
+ * allocated, so neighbors being freed don't coalesce with them either; the
+ * first word of the payload links each to the next block on its list.
+ * PARKED_MARK is added to a parked block's footer, which leaves it negative
+ * but no longer equal to the header, so myfree() can reject freeing the
+ * block again.
+ *
+ * Parked blocks fragment the pool, so they are all coalesced when an
+ * allocation can't be served otherwise, or once they hold more than
+ * 1 / QUICK_FLUSH_FRACTION of the pool.
+ */
+#define NUM_QUICK_LISTS 32
+#define QUICK_MAX_SIZE \
+    (NUM_QUICK_LISTS * MYALLOC_ALIGNMENT - TAGS_SIZE)
+#define QUICK_FLUSH_FRACTION 8
+#define PARKED_MARK 1
+
+tag *quick_lists[NUM_QUICK_LISTS];
+int num_parked; // number of blocks on the quick-lists
+long parked_bytes; // their total size
+
+tag **quick_next(tag *head) {
+    // Returns the quick-list link stored in a parked block's payload
+    return (tag **) (head + 1);
+}
+
+int is_parked(tag *head) {
+    // Returns nonzero if the allocated block "head" is parked
+    return point_to_foot(head)->size == head->size + PARKED_MARK;
+}
+
+void free_block(tag *head);
+
+
+/*!
+ * Parks the allocated block "head" on the quick-list for its size.
+ */
+void park_block(tag *head) {
+    int q = -head->size / MYALLOC_ALIGNMENT;
+
+    *quick_next(head) = quick_lists[q];
+    quick_lists[q] = head;
+    point_to_foot(head)->size = head->size + PARKED_MARK;
+    num_parked++;
+    parked_bytes -= head->size;
+}
+
+
+/*!
+ * Takes a block of exactly "size" bytes off its quick-list, and returns its
+ * header, or NULL if there is none.
+ */
+tag *unpark_block(int size) {
+    int q = size / MYALLOC_ALIGNMENT;
+    tag *head;
+
+    if (size < 0 || size > QUICK_MAX_SIZE || quick_lists[q] == NULL)
+        return NULL;
+
+    head = quick_lists[q];
+    quick_lists[q] = *quick_next(head);
+    point_to_foot(head)->size = head->size;
+    num_parked--;
+    parked_bytes -= size;
+    return head;
+}
+
+
+/*!
+ * Frees and coalesces every parked block.
+ */
+void flush_quick_lists() {
+    tag *head;
+    int q;
+
+    for (q = 0; q < NUM_QUICK_LISTS; q++) {
+        while (quick_lists[q] != NULL) {
+            head = quick_lists[q];
+            quick_lists[q] = *quick_next(head);
+            point_to_foot(head)->size = head->size;
+            free_block(head);
+        }
+    }
+    num_parked = 0;
+    parked_bytes = 0;
+}
+
+
+/*!
+ * Returns nonzero if the current placement policy threads an index through
+ * the payloads of free blocks, which then need at least MIN_FREE_PAYLOAD
+ * bytes.
+ */
+int policy_has_index() {
+    return ALLOC_POLICY == SEGREGATED_FIT || ALLOC_POLICY == BEST_FIT;
+}
+
+
+/*!
+ * Inserts the free block "node" into the treap rooted at "root", and returns
+ * the new root.  Rotations restore the heap order on the way back up.
+ */
+tag *tree_insert(tag *root, tag *node) {
+    tree_links *r, *c;
+    tag *child;
+
+    if (root == NULL) {
+        tree_links_of(node)->left = NULL;
+        tree_links_of(node)->right = NULL;
+        return node;
+    }
+
+    r = tree_links_of(root);
+    if (tree_less(node, root)) {
+        child = r->left = tree_insert(r->left, node);
+        if (tree_priority(child) > tree_priority(root)) {
+            // Rotate right
+            c = tree_links_of(child);
+            r->left = c->right;
+            c->right = root;
+            return child;
+        }
+    }
+    else {
+        child = r->right = tree_insert(r->right, node);
+        if (tree_priority(child) > tree_priority(root)) {
+            // Rotate left
+            c = tree_links_of(child);
+            r->right = c->left;
+            c->left = root;
+            return child;
+        }
+    }
+    return root;
+}
+
+
+/*!
+ * Joins two treaps, where every block in "left" orders before every block
+ * in "right", and returns the root of the result.
+ */
+tag *tree_join(tag *left, tag *right) {
+    if (left == NULL)
+        return right;
+    if (right == NULL)
+        return left;
+
+    if (tree_priority(left) > tree_priority(right)) {
+        tree_links_of(left)->right = tree_join(tree_links_of(left)->right,
+                                               right);
+        return left;
+    }
+    tree_links_of(right)->left = tree_join(left, tree_links_of(right)->left);
+    return right;
+}
+
+
+/*!
+ * Removes the free block "node" from the treap rooted at "root", and returns
+ * the new root.  The block's size must not have changed since it was
+ * inserted, since the search for it is ordered by size.
+ */
+tag *tree_remove(tag *root, tag *node) {
+    tree_links *r;
+
+    if (root == node)
+        return tree_join(tree_links_of(node)->left, tree_links_of(node)->right);
+
+    r = tree_links_of(root);
+    if (tree_less(node, root))
+        r->left = tree_remove(r->left, node);
+    else
+        r->right = tree_remove(r->right, node);
+    return root;
+}
+
+
+/*!
+ * Adds a free block to the free index of the current placement policy.  The
+ * FIRST_FIT and NEXT_FIT policies walk the tags directly, so they keep no
+ * index.
+ */
+void insert_free_block(tag *head) {
+    int c;
+
+    if (ALLOC_POLICY == BEST_FIT) {
+        free_tree = tree_insert(free_tree, head);
+        return;
+    }
+    if (ALLOC_POLICY != SEGREGATED_FIT)
+        return;
+
+    // Push onto the front of the block's size class list
+    c = size_class(head->size);
+    links_of(head)->prev = NULL;
+    links_of(head)->next = size_classes[c];
+    if (size_classes[c] != NULL)
+        links_of(size_classes[c])->prev = head;
+    size_classes[c] = head;
+    nonempty_classes |= 1u << c;
+}
+
+
+/*!
+ * Removes a free block from the free index of the current placement policy,
+ * e.g. because it is about to be allocated or coalesced.
+ */
+void remove_free_block(tag *head) {
+    int c;
+    free_links *links;
+
+    if (ALLOC_POLICY == BEST_FIT) {
+        free_tree = tree_remove(free_tree, head);
+        return;
+    }
+    if (ALLOC_POLICY != SEGREGATED_FIT)
+        return;
+
+    c = size_class(head->size);
+    links = links_of(head);
+    if (links->prev != NULL)
+        links_of(links->prev)->next = links->next;
+    else
+        size_classes[c] = links->next;
+    if (links->next != NULL)
+        links_of(links->next)->prev = links->prev;
+
+    if (size_classes[c] == NULL)
+        nonempty_classes &= ~(1u << c);
+}
+
+
+/*!
+ * Walks the blocks of one arena from "start" up to (not including) "stop",
+ * or up to the arena's back fence if "stop" is NULL, and returns the first
+ * free block that can hold "size" bytes, or NULL.  A block fits if it is
+ * exactly the right size, or large enough to be split into the allocated
+ * block and a (possibly empty) free block.
+ */
+tag *scan_blocks(tag *start, tag *stop, int size) {
+    tag *temp_ptr = start;
+
+    while (temp_ptr != stop && temp_ptr->size != FENCE_SIZE)
+    {
+        if (temp_ptr->size == size || temp_ptr->size > size + 7)
+            return temp_ptr;
+        temp_ptr = point_to_foot(temp_ptr) + 1;
+    }
+    return NULL;
+}
+
+
+/*!
+ * First-fit search:  walks every block of every arena from start to end and
+ * returns the first free block that can hold "size" bytes, or NULL.  This
+ * takes O(n).
+ */
+tag *find_first_fit(int size) {
+    arena *a;
+    tag *block;
+
+    for (a = first_arena; a != NULL; a = a->next)
+    {
+        block = scan_blocks(first_block(a), NULL, size);
+        if (block != NULL)
+            return block;
+    }
+    return NULL;
+}
+
+
+/*!
+ * Next-fit search:  like first-fit, but starts at the rover and wraps around
+ * the arenas, ending back at the rover.  Sets rover_arena to the arena of the
+ * block it returns.  This takes O(n) in the worst case, but skips the run of
+ * small, allocated blocks that first-fit builds up at the front of the pool.
+ */
+tag *find_next_fit(int size) {
+    arena *a;
+    tag *block;
+
+    if (rover == NULL) {
+        rover_arena = first_arena;
+        rover = first_block(first_arena);
+    }
+
+    // From the rover to the end of its arena
+    block = scan_blocks(rover, NULL, size);
+    if (block != NULL)
+        return block;
+
+    // Every other arena, wrapping around the directory
+    a = rover_arena;
+    for (;;) {
+        a = (a->next != NULL) ? a->next : first_arena;
+        if (a == rover_arena)
+            break;
+        block = scan_blocks(first_block(a), NULL, size);
+        if (block != NULL) {
+            rover_arena = a;
+            return block;
+        }
+    }
+
+    // The start of the rover's arena, up to the rover
+    return scan_blocks(first_block(rover_arena), rover, size);
+}
+
+
+/*!
+ * Segregated-fit search:  checks a bounded number of blocks in the request's
+ * own size class, then takes the first block of the smallest nonempty larger
+ * class, all of which are big enough.  This takes O(1).
+ */
+tag *find_segregated_fit(int size) {
+    int c = size_class(size);
+    int scanned = 0;
+    unsigned int larger;
+    tag *block;
+
+    for (block = size_classes[c]; block != NULL && scanned < SEGREGATED_SCAN_LIMIT;
+         block = links_of(block)->next, scanned++)
+    {
+        if (block->size >= size)
+            return block;
+    }
+
+    // Mask off class c and every class below it
+    larger = nonempty_classes & ~((2u << c) - 1);
+    if (larger == 0)
+        return NULL;
+    return size_classes[__builtin_ctz(larger)];
+}
+
+
+/*!
+ * Best-fit search:  descends the treap for the smallest free block that can
+ * hold "size" bytes, taking the lowest-addressed one among equals.  This
+ * takes O(log n).
+ */
+tag *find_best_fit(int size) {
+    tag *node = free_tree;
+    tag *best = NULL;
+
+    while (node != NULL) {
+        if (node->size >= size) {
+            // Fits; look for a smaller block that still does
+            best = node;
+            node = tree_links_of(node)->left;
+        }
+        else {
+            node = tree_links_of(node)->right;
+        }
+    }
+    return best;
+}
+
+
+/*!
+ * Marks the free block "block" as allocated for a request of "size" bytes,
+ * splitting off the remainder as a new free block if it is big enough to be
+ * worth keeping.  Returns the payload pointer.
+ */
+unsigned char *place_block(tag *block, int size) {
+    int min_split = policy_has_index() ? MIN_FREE_PAYLOAD : 0;
+    int remainder = block->size - size - (2 * sizeof(tag));
+    tag *rest;
+
+    remove_free_block(block);
+
+    if (remainder >= min_split) {
+        /* Perform block splitting */
+        block->size = -size;
+        point_to_foot(block)->size = -size;
+        // Add header and footer tags for the new free block
+        rest = point_to_foot(block) + 1;
+        rest->size = remainder;
+        point_to_foot(rest)->size = remainder;
+        insert_free_block(rest);
+    }
+    else {
+        // Allocate the entire block; the slack is too small to stand alone
+        block->size *= -1;
+        point_to_foot(block)->size = block->size;
+    }
+
+    // The caller may write anywhere in the payload
+    touch_fresh((unsigned char *) (block + 1),
+                (unsigned char *) point_to_foot(block));
+
+    // The next search resumes just past this block
+    if (ALLOC_POLICY == NEXT_FIT)
+        rover = point_to_foot(block) + 1;
+
+    return (unsigned char *) (block + 1);
+}
+
+
+/*!
+ * Lays out the bytes in [start, end) as an arena holding a single free block,
+ * appends the arena's description "a" to the arena directory, and adds the
+ * free block to the free index.  The front fence goes at the first place in
+ * the range where the block's payload is aligned, and the arena is trimmed
+ * so the block has a valid size.  Returns the free block's header.
+ */
+tag *add_arena(arena *a, unsigned char *start, unsigned char *end,
+               int region_length, int is_mapped) {
+    uintptr_t first_payload =
+        ((uintptr_t) start + FENCES_SIZE + MYALLOC_ALIGNMENT - 1) &
+        ~(uintptr_t) (MYALLOC_ALIGNMENT - 1);
+    tag *fence = (tag *) (first_payload - FENCES_SIZE);
+    tag *head = fence + 1;
+    int length = (int) (end - (unsigned char *) fence);
+
+    // The block is length - 2 * FENCES_SIZE bytes; that must be a valid size
+    length = ((length - FENCES_SIZE) & ~(MYALLOC_ALIGNMENT - 1)) + FENCES_SIZE;
+
+    a->fence = fence;
+    a->length = length;
+    a->region_length = region_length;
+    a->is_mapped = is_mapped;
+    a->prev = last_arena;
+    a->next = NULL;
+    if (last_arena != NULL)
+        last_arena->next = a;
+    else
+        first_arena = a;
+    last_arena = a;
+    num_arenas++;
+    heap_length += length;
+
+    // Nothing in the new arena has been handed out yet
+    fresh_start = (unsigned char *) (head + 1);
+    fresh_end = (unsigned char *) fence + length;
+
+    // Set the fences and the free block between them
+    fence->size = FENCE_SIZE;
+    head->size = length - FENCES_SIZE - (2 * sizeof(tag));
+    point_to_foot(head)->size = head->size;
+    (point_to_foot(head) + 1)->size = FENCE_SIZE;
+
+    // A pool too small to hold free-list links can't serve anything anyway
+    if (!policy_has_index() || head->size >= MIN_FREE_PAYLOAD)
+        insert_free_block(head);
+    return head;
+}
+
+
+/*!
+ * Unlinks an arena from the arena directory and returns its region to
+ * wherever it came from.  Any free block in the arena must already have been
+ * removed from the free index.
+ */
+void release_arena(arena *a) {
+    // Next-fit restarts from the beginning if its arena goes away
+    if (a == rover_arena)
+        rover = NULL;
+    if (fresh_start >= (unsigned char *) a->fence &&
+        fresh_start <= (unsigned char *) a->fence + a->length)
+        fresh_start = fresh_end = NULL;
+
+    if (a->prev != NULL)
+        a->prev->next = a->next;
+    else
+        first_arena = a->next;
+    if (a->next != NULL)
+        a->next->prev = a->prev;
+    else
+        last_arena = a->prev;
+    num_arenas--;
+    heap_length -= a->length;
+
+    if (a->is_mapped)
+        munmap(a, a->region_length);
+    else
+        free(mem);
+}
+
+
+/*!
+ * Maps a new arena, with room for a block of at least "size" bytes, from the
+ * OS.  The arena is at least MEMORY_SIZE bytes and a whole number of pages.
+ * Returns the new arena's free block, or NULL if the OS refuses.
+ */
+tag *map_arena(int size) {
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t length;
+    void *base;
+
+    // Leave room for the tags and a free remainder, so the block can split.
+    // This is done in 64 bits, since a long may be too small to hold it.
+    length = (uint64_t) size + ARENA_FENCE_OFFSET + MYALLOC_ALIGNMENT +
+             FENCES_SIZE + (4 * sizeof(tag)) + MIN_FREE_PAYLOAD;
+    if (length < (uint64_t) MEMORY_SIZE)
+        length = MEMORY_SIZE;
+    length = (length + page_size - 1) / page_size * page_size;
+    if (length > INT_MAX)
+        return NULL;
+
+    base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    return add_arena((arena *) base, (unsigned char *) ((arena *) base + 1),
+                     (unsigned char *) base + length, (int) length, 1);
+}
+
 
 /*!
  * This function initializes both the allocator state, and the memory pool.  It
@@ -54,17 +746,45 @@ tag *point_to_head(tag* foot){
  * can create different memory-pool sizes for testing.  Obviously, in a real
  * allocator, this memory pool would either be a fixed memory region, or the
  * allocator would request a memory region from the operating system (see the
- * C standard function sbrk(), for example).
+ * C standard function sbrk(), for example).  ARENA_MODE does the latter,
+ * mapping the pool with mmap() and growing it on demand.
  */
 void init_myalloc() {
-    tag * h;
-    tag * f;
+    int c;
+
+    /*
+     * Testers re-initialize the allocator many times, so release any arenas
+     * left over from a previous initialization, and reset the free index.
+     */
+    while (first_arena != NULL)
+        release_arena(first_arena);
+    for (c = 0; c < NUM_SIZE_CLASSES; c++)
+        size_classes[c] = NULL;
+    nonempty_classes = 0;
+    free_tree = NULL;
+    rover = NULL;
+    for (c = 0; c < NUM_QUICK_LISTS; c++)
+        quick_lists[c] = NULL;
+    num_parked = 0;
+    parked_bytes = 0;
+
+    if (ARENA_MODE) {
+        // The first arena is mapped just like the ones added later
+        if (map_arena(0) == NULL) {
+            fprintf(stderr, "init_myalloc: could not map %d bytes\n",
+                    MEMORY_SIZE);
+            abort();
+        }
+        mem = (unsigned char *) first_arena;
+        return;
+    }
 
     /*
      * Allocate the entire memory pool, from which our simple allocator will
-     * serve allocation requests.
+     * serve allocation requests.  The pool is zeroed up front, like mapped
+     * arenas are, so mycalloc() knows its contents.
      */
-    mem = (unsigned char *) malloc(MEMORY_SIZE);
+    mem = (unsigned char *) calloc(1, MEMORY_SIZE);
     if (mem == 0) {
         fprintf(stderr,
                 "init_myalloc: could not get %d bytes from the system\n",
@@ -72,181 +792,663 @@ void init_myalloc() {
         abort();
     }
 
-    /* You can initialize the initial state of your memory pool here. 
-     *
-     * Upon initializing, there is a single block of free memory with enough
-     * space for MEMORY_SIZE - 2 * 4 bytes (signed int header/footer).
+    /* Upon initializing, there is a single block of free memory, between the
+     * two fences, with enough space for MEMORY_SIZE - 4 * 4 bytes (signed int
+     * fences, and header/footer), less whatever alignment costs.
      */
-    tag init = {MEMORY_SIZE - (2 * sizeof(tag))};
-    // Set header
-    h = (tag *) mem;
-    *h = init;
-    // Set footer
-    f = point_to_foot(h);
-    *f = init;
-    // Set payload pointer
-    start = h;
-    end = f;
+    add_arena(&fixed_arena, mem, mem + MEMORY_SIZE, MEMORY_SIZE, 0);
+}
+
+
+/*!
+ * Returns the smallest block size that a request of "size" bytes can use
+ * under the current placement policy, or -1 if no block can be that big.
+ * Block sizes are never 0, since an allocated block of size 0 would be
+ * indistinguishable from a free one.
+ */
+int block_size_for(int size) {
+    if (size < 0 || size > INT_MAX - 2 * MYALLOC_ALIGNMENT)
+        return -1;
+    // The block must be able to hold its free index links once freed
+    if (policy_has_index() && size < MIN_FREE_PAYLOAD)
+        return MIN_FREE_PAYLOAD;
+    return ALIGN_SIZE(size);
+}
+
+
+/*!
+ * Searches the pool for a free block that can hold "size" bytes, using the
+ * current placement policy.  Returns NULL if there is none.
+ */
+tag *find_free_block(int size) {
+    tag * block;
+
+    switch (ALLOC_POLICY) {
+    case SEGREGATED_FIT:
+        block = find_segregated_fit(size);
+        break;
+    case NEXT_FIT:
+        block = find_next_fit(size);
+        break;
+    case BEST_FIT:
+        block = find_best_fit(size);
+        break;
+    default:
+        block = find_first_fit(size);
+        break;
+    }
+    return block;
+}
+
+
+/*!
+ * Finds a free block that can hold "size" bytes, coalescing any parked blocks
+ * and then growing the pool if needed and allowed.  Returns NULL if there is
+ * none.
+ */
+tag *find_fit(int size) {
+    tag * block;
+
+    if (size < 0)
+        return NULL;
+
+    block = find_free_block(size);
+
+    // Coalescing the parked blocks may make room
+    if (block == NULL && num_parked > 0) {
+        flush_quick_lists();
+        block = find_free_block(size);
+    }
+
+    // Grow the pool if no existing arena can serve the request
+    if (block == NULL && ARENA_MODE) {
+        block = map_arena(size);
+        rover_arena = last_arena;
+    }
+
+    // Never hand back a block too small for the request
+    if (block != NULL && block->size < size)
+        return NULL;
+
+    return block;
 }
 
 
 /*!
  * Attempt to allocate a chunk of memory of "size" bytes.  Return 0 if
  * allocation fails.
- * Due to first-fit placement strategy, this operation takes O(n)
+ * With first-fit or next-fit placement this operation takes O(n); with
+ * segregated-fit placement it takes O(1), and with best-fit, O(log n).
  */
 unsigned char *myalloc(int size) {
-    int free_block_size; // temporary variable
-    tag * temp_ptr;
-    tag * min; // pointer to smallest free block > size
-    tag temp_tag = {size * -1}; // temporary header/footer indicating size
-
-    /* Placement strategy: first-fit; Find the first free block > size */
-    min = start; // initial min points to start of memory pool
-    temp_ptr = point_to_foot(min); // temp pointer points to foot of 1st block
-    while (temp_ptr != end)
-    {
-        temp_ptr++;
-        if (temp_ptr->size == size || temp_ptr->size > size + 7)
-        {
-            min = temp_ptr;
-            break;
-        }
-        temp_ptr = point_to_foot(temp_ptr);
+    int block_size = block_size_for(size);
+    tag * block;
+    unsigned char *result = (unsigned char *) 0;
+
+    CHECK_HEAP("myalloc");
+
+    // A parked block of exactly the right size is already allocated
+    if (num_parked > 0 && (block = unpark_block(block_size)) != NULL) {
+        CHECK_HEAP("myalloc");
+        return (unsigned char *) (block + 1);
     }
-    
-    /* Failed attempt at best-fit; not sure why this doesn't work? Utilization
-     * ~0.10
-     */
-    //
-    // while (temp_ptr != end) // loop until temp pointer points to foot of pool
-    // {
-    //     temp_ptr++; // temp pointer now points to head of next block
-    //     if (temp_ptr->size == size) // optimal case
-    //     {
-    //         min = temp_ptr;
-    //         break;
-    //     }
-    //     else if (temp_ptr->size > size + 7 &&
-    //              min->size < 0)
-    //     {
-    //         min = temp_ptr;
-    //     }
-    //     else if (temp_ptr->size > size + 7 &&
-    //              min->size > size + 7)
-    //     {
-    //         if (temp_ptr->size < min->size)
-    //         {
-    //             min = temp_ptr;
-    //         }
-    //     }
-    //     temp_ptr = point_to_foot(temp_ptr);
-    //     // temp pointer points to foot of next block
-    // }
-    // min is either the head of last block or head of smallest free block
-    // greater than size
-
-    // Pre-emptively store pointer to payload
-    unsigned char *resultptr = (unsigned char *) (min + 1);
-
-    if (size == min->size) {
-        // special case in which we can allocate our entire block
-        min->size *= -1;
-        point_to_foot(min)->size *= 1;
-        return resultptr;
-    }
-    /* size + 8 bytes ensures header and footer of resulting blocks
-     * after split can be made, and the remaining free block contains
-     * at least 0 bytes free space. */
-    else if (size + 7 < min->size) {
-        /* Perform block splitting */
-        // Keep track of size of free block
-        free_block_size = min->size;
-        // Update free block header's tag to new size
-        *min = temp_tag;
-        // Add footer tag
-        *point_to_foot(min) = temp_tag;
-        // Add header tag for the new free block
-        min = point_to_foot(min) + 1;
-        temp_tag.size = free_block_size - size - (2 * sizeof(tag));
-        *min = temp_tag;
-        // update free block footer tag to new free size
-        *point_to_foot(min) = temp_tag;
-        return resultptr;
+
+    block = find_fit(block_size);
+    if (block == NULL)
+        fprintf(stderr, "myalloc: cannot service request of size %d\n", size);
+    else
+        result = place_block(block, block_size);
+
+    CHECK_HEAP("myalloc");
+    return result;
+}
+
+
+/*!
+ * Allocates a zeroed array of "num" elements of "size" bytes each.  Return 0
+ * if allocation fails.  Only the part of the block that may hold old data is
+ * zeroed; memory that has never been handed out is known to be zero already.
+ */
+unsigned char *mycalloc(int num, int size) {
+    long total = (long) num * size;
+    tag * block;
+    unsigned char *payload, *clean;
+
+    if (num < 0 || size < 0 || total > INT_MAX) {
+        fprintf(stderr, "mycalloc: cannot service request of %d x %d bytes\n",
+                num, size);
+        return (unsigned char *) 0;
     }
-    else {
-        fprintf(stderr, "myalloc: cannot service request of size %d with"
-                " %d bytes allocated\n", size, (min->size));
+
+    CHECK_HEAP("mycalloc");
+
+    block = find_fit(block_size_for((int) total));
+    if (block == NULL) {
+        fprintf(stderr, "mycalloc: cannot service request of %d x %d bytes\n",
+                num, size);
         return (unsigned char *) 0;
     }
+
+    /* Everything from "clean" on is zero already.  Within the fresh region,
+     * only the free index links at the start of the block are not.
+     */
+    payload = (unsigned char *) (block + 1);
+    clean = payload + total;
+    if (payload < fresh_end && payload + total > fresh_start) {
+        clean = payload + MIN_FREE_PAYLOAD;
+        if (clean < fresh_start)
+            clean = fresh_start;
+        if (clean > payload + total)
+            clean = payload + total;
+    }
+
+    place_block(block, block_size_for((int) total));
+    memset(payload, 0, clean - payload);
+
+    CHECK_HEAP("mycalloc");
+    return payload;
+}
+
+
+/*!
+ * Marks the allocated block "current_head" free, coalesces it with its free
+ * neighbors, and adds the result to the free index, or releases its arena.
+ * Coalescing only looks ahead and before the block, and so should take O(1)
+ */
+void free_block(tag *current_head) {
+    tag * next_head; // points to head of block after current block
+    tag * prev_foot; // points to tail of block before current block
+    tag * prev_head; // points to head of block before current block
+    int sum; // temporary storage value
+
+    /* Simply mark the block as free */
+    current_head->size *= -1;
+    point_to_foot(current_head)->size *= -1;
+
+    /* Forward coalescing */
+    next_head = point_to_foot(current_head) + 1;
+    // Check if block ahead is free; the fence at the end of the arena never is
+    if (next_head->size >= 0)
+    {
+        remove_free_block(next_head);
+        // The rover can't be left pointing into the middle of a block
+        if (rover == next_head)
+            rover = current_head;
+        // The next block's tags and links end up inside this block
+        touch_fresh((unsigned char *) next_head,
+                    (unsigned char *) (next_head + 1) + MIN_FREE_PAYLOAD);
+        sum = current_head->size + next_head->size + (2 * sizeof(tag));
+        current_head->size = sum;
+        // current_head's foot is now next_head's foot
+        point_to_foot(current_head)->size = sum;
+    }
+
+    /* Reverse coalescing */
+    // Check if block behind is free; the fence at the start of the arena
+    // never is
+    prev_foot = current_head - 1;
+    if (prev_foot->size >= 0)
+    {
+        prev_head = point_to_head(prev_foot);
+        remove_free_block(prev_head);
+        if (rover == current_head)
+            rover = prev_head;
+        sum = prev_head->size + current_head->size + (2 * sizeof(tag));
+        prev_head->size = sum;
+        // prev_head's foot is now current_head's foot
+        point_to_foot(prev_head)->size = sum;
+        current_head = prev_head;
+    }
+
+    /* Return an additional arena to the OS once it is entirely free */
+    if (ARENA_MODE && num_arenas > 1 &&
+        (current_head - 1)->size == FENCE_SIZE &&
+        (point_to_foot(current_head) + 1)->size == FENCE_SIZE)
+    {
+        release_arena(arena_of_spanning_block(current_head));
+        return;
+    }
+
+    insert_free_block(current_head);
 }
 
 
 /*!
  * Free a previously allocated pointer.  oldptr should be an address returned by
  * myalloc().
- * Coalescing only looks ahead and before the pointer, and so should take O(1)
+ * With DEFER_COALESCE, small blocks are parked in O(1) instead of being
+ * coalesced.
  */
 void myfree(unsigned char *oldptr) {
     tag * current_head; // points to head of block containing oldptr payload
-    tag * next_head; // points to head of block after oldptr block
-    tag * prev_foot; // points to tail of block before olptr block
-    int sum; // temporary storage value
-    int forward = 0; // flag for whether forward coalescing occurred
 
-    /* Simply mark the block as free */
+    // Like free(), freeing a null pointer does nothing
+    if (oldptr == NULL)
+        return;
+
+    CHECK_HEAP("myfree");
+
     // head of block containing oldptr paylod is oldptr - sizeof(tag)
     current_head = (tag *) (oldptr - sizeof(tag)); // start from head
     // First check if the block needs to be free
-    if (current_head->size < 0)
+    if (current_head->size >= 0 || is_parked(current_head))
     {
-        current_head->size *= -1;
-        point_to_foot(current_head)->size *= -1;
-    }
-    else
-    {
-        // Block is already free
+        // Block is already free or parked; it is already in the free index
+        // or on a quick-list too
         fprintf(stderr, "myalloc: cannot free an already free block\n");
+        return;
     }
 
-    /* Forward coalescing */
-    next_head = point_to_foot(current_head) + 1;
-    if (next_head != (end + 1)) // Check if not at the end of memory pool
-    {
-        if (next_head->size >= 0) // Check if block ahead is free
-        {
-            // Begin coalescing by updating current head
-            sum = current_head->size + next_head->size + (2 * sizeof(tag));
-            current_head->size = sum;
-            // Update next head's foot
-            point_to_foot(next_head)->size = sum;
-            // Update forward coalesce flag
-            forward = 1;
-        }
+    if (DEFER_COALESCE && -current_head->size <= QUICK_MAX_SIZE) {
+        park_block(current_head);
+        if (parked_bytes > heap_length / QUICK_FLUSH_FRACTION)
+            flush_quick_lists();
+    }
+    else {
+        free_block(current_head);
     }
 
-    /* Reverse coalescing */
-    // Check if current block is not the first block
-    if (current_head != start)
-    {
-        prev_foot = current_head - 1;
-        // Check if block behind is free
-        if ((current_head - 1)->size >= 0)
-        {
-            sum = prev_foot->size + current_head->size + (2 * sizeof(tag));
-            // Check forward coalesce flag
-            if (forward)
-            {
-                // Forward coalesced; foot is next_head's foot
-                point_to_foot(next_head)->size = sum;
+    CHECK_HEAP("myfree");
+}
+
+
+/*!
+ * Shrinks the allocated block "head" to "size" bytes, if the space left over
+ * can stand alone as a free block, and frees that space.
+ */
+void shrink_block(tag *head, int size) {
+    int min_split = policy_has_index() ? MIN_FREE_PAYLOAD : 0;
+    int remainder = -head->size - size - (2 * sizeof(tag));
+    tag *rest;
+
+    if (remainder < min_split)
+        return;
+
+    head->size = -size;
+    point_to_foot(head)->size = -size;
+    // The rest is made an allocated block, so myfree() coalesces it with
+    // whatever follows it
+    rest = point_to_foot(head) + 1;
+    rest->size = -remainder;
+    point_to_foot(rest)->size = -remainder;
+    myfree((unsigned char *) (rest + 1));
+}
+
+
+/*!
+ * Resizes a block returned by myalloc() to "size" bytes, and returns its new
+ * address, or 0 (leaving the old block alone) if that fails.  A block shrinks
+ * by splitting off its end, and grows in place into a free block that follows
+ * it; only when there is no such block are the contents copied to a new block.
+ * Like realloc(), a null pointer is allocated, and a size of 0 frees.
+ */
+unsigned char *myrealloc(unsigned char *oldptr, int size) {
+    tag *head, *next_head;
+    unsigned char *newptr;
+    int old_size, sum;
+
+    if (oldptr == NULL)
+        return myalloc(size);
+    if (size == 0) {
+        myfree(oldptr);
+        return (unsigned char *) 0;
+    }
+
+    CHECK_HEAP("myrealloc");
+
+    head = (tag *) (oldptr - sizeof(tag));
+    old_size = -head->size;
+    if (block_size_for(size) < 0) {
+        fprintf(stderr, "myrealloc: cannot service request of size %d\n",
+                size);
+        return (unsigned char *) 0;
+    }
+    size = block_size_for(size);
+
+    /* Shrinking, or growing into the slack of the block */
+    if (size <= old_size) {
+        shrink_block(head, size);
+        CHECK_HEAP("myrealloc");
+        return oldptr;
+    }
+
+    /* Growing into the following free block */
+    next_head = point_to_foot(head) + 1;
+    sum = old_size + next_head->size + (2 * sizeof(tag));
+    if (next_head->size >= 0 && sum >= size) {
+        remove_free_block(next_head);
+        if (rover == next_head)
+            rover = head;
+        head->size = -sum;
+        point_to_foot(head)->size = -sum;
+        touch_fresh(oldptr, (unsigned char *) point_to_foot(head));
+        shrink_block(head, size);
+        CHECK_HEAP("myrealloc");
+        return oldptr;
+    }
+
+    /* Moving the contents to a new block */
+    newptr = myalloc(size);
+    if (newptr == NULL)
+        return (unsigned char *) 0;
+    memcpy(newptr, oldptr, old_size);
+    myfree(oldptr);
+    return newptr;
+}
+
+
+/*!
+ * Allocates "size" bytes at an address that is a multiple of "align", which
+ * must be a power of 2.  Return 0 if allocation fails.  Alignments up to
+ * MYALLOC_ALIGNMENT are what myalloc() gives anyway.  For larger ones, a
+ * block with "align" bytes of slack at either end is allocated, and the
+ * slack in front of the aligned address is split off and freed, as is
+ * whatever is left over at the end.  The block is freed with myfree().
+ */
+unsigned char *myalloc_aligned(int size, int align) {
+    int block_size = block_size_for(size);
+    int min_gap, total;
+    unsigned char *ptr, *aligned;
+    tag *head;
+
+    if (align <= 0 || (align & (align - 1)) != 0) {
+        fprintf(stderr, "myalloc_aligned: alignment %d is not a power of 2\n",
+                align);
+        return (unsigned char *) 0;
+    }
+    if (align <= MYALLOC_ALIGNMENT)
+        return myalloc(size);
+    if (block_size < 0 || block_size > INT_MAX - 2 * align) {
+        fprintf(stderr, "myalloc_aligned: cannot service request of size "
+                "%d\n", size);
+        return (unsigned char *) 0;
+    }
+
+    ptr = myalloc(block_size + 2 * align);
+    if (ptr == NULL)
+        return (unsigned char *) 0;
+
+    // The slack in front has to be able to stand alone as a free block
+    min_gap = (policy_has_index() ? MIN_FREE_PAYLOAD : ALIGN_SIZE(0)) +
+              TAGS_SIZE;
+    aligned = (unsigned char *)
+        (((uintptr_t) ptr + align - 1) & ~(uintptr_t) (align - 1));
+    if (aligned != ptr && aligned - ptr < min_gap)
+        aligned += align;
+
+    head = (tag *) ptr - 1;
+    if (aligned != ptr) {
+        // Split the block in two at the aligned address, and free the front
+        total = -head->size;
+        head->size = -(int) (aligned - ptr - TAGS_SIZE);
+        point_to_foot(head)->size = head->size;
+        head = (tag *) aligned - 1;
+        head->size = -(total - (int) (aligned - ptr));
+        point_to_foot(head)->size = head->size;
+        myfree(ptr);
+    }
+
+    shrink_block(head, block_size);
+    return aligned;
+}
+
+
+/*!
+ * Returns the usable size of a block returned by myalloc().  Blocks are only
+ * split when the leftover space can stand alone as a free block, so this can
+ * be a little larger than the size that was requested.
+ */
+int myalloc_usable_size(unsigned char *ptr) {
+    tag *head = (tag *) (ptr - sizeof(tag));
+    return abs(head->size);
+}
+
+
+/*!
+ * Walks the tags of every block in every arena, and summarizes the state of
+ * the pool in *stats.  This takes O(n).
+ */
+void myalloc_stats(heap_stats *stats) {
+    arena *a;
+    tag *block;
+    int c;
+
+    stats->heap_size = 0;
+    stats->num_arenas = 0;
+    stats->num_allocated = 0;
+    stats->allocated_bytes = 0;
+    stats->num_free = 0;
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    for (c = 0; c < HEAP_HISTOGRAM_BUCKETS; c++)
+        stats->free_histogram[c] = 0;
+
+    for (a = first_arena; a != NULL; a = a->next) {
+        stats->num_arenas++;
+        stats->heap_size += a->region_length;
+
+        for (block = first_block(a); block->size != FENCE_SIZE;
+             block = point_to_foot(block) + 1) {
+            if (block->size >= 0) {
+                stats->num_free++;
+                stats->free_bytes += block->size;
+                stats->free_histogram[size_class(block->size)]++;
+                if (block->size > stats->largest_free)
+                    stats->largest_free = block->size;
             }
-            else
-            {
-                // No forward coalescing; foot is current_head's foot
-                point_to_foot(current_head)->size = sum;
+            else {
+                stats->num_allocated++;
+                stats->allocated_bytes -= block->size;
             }
-            // Update prev_head's value
-            point_to_head(prev_foot)->size = sum;
         }
     }
+
+    // Parked blocks look allocated, but aren't
+    stats->num_deferred = num_parked;
+    stats->deferred_bytes = parked_bytes;
+    stats->num_allocated -= num_parked;
+    stats->allocated_bytes -= parked_bytes;
+
+    stats->fragmentation = (stats->free_bytes == 0) ? 0.0 :
+        1.0 - (double) stats->largest_free / stats->free_bytes;
+}
+
+
+/* Describes a problem found by myalloc_check(), and returns -1. */
+int heap_error(const char *problem, tag *block) {
+    fprintf(stderr, "myalloc_check: %s, at block %p\n", problem,
+            (void *) block);
+    return -1;
+}
+
+
+/*!
+ * Checks the tags of every block in arena "a":  each block's header and
+ * footer must agree, the blocks must exactly fill the space between the
+ * fences, and no two free blocks may be adjacent, since they should have
+ * been coalesced.  Adds the number of free blocks the free index should hold
+ * to *num_indexed.  Returns 0, or -1 on the first problem found.
+ */
+int check_arena(arena *a, long *num_indexed) {
+    tag *back_fence = (tag *) ((unsigned char *) a->fence + a->length) - 1;
+    tag *block;
+    int prev_free = 0;
+
+    if (a->fence->size != FENCE_SIZE)
+        return heap_error("front fence overwritten", a->fence);
+
+    for (block = first_block(a); block != back_fence;
+         block = point_to_foot(block) + 1) {
+        if (block->size == FENCE_SIZE || block > back_fence ||
+            point_to_foot(block) >= back_fence)
+            return heap_error("block runs past the end of its arena", block);
+        if (point_to_foot(block)->size != block->size &&
+            !(block->size < 0 && is_parked(block)))
+            return heap_error("header and footer disagree", block);
+
+        if (block->size >= 0) {
+            if (prev_free)
+                return heap_error("free block was not coalesced", block);
+            if (!policy_has_index() || block->size >= MIN_FREE_PAYLOAD)
+                (*num_indexed)++;
+        }
+        prev_free = (block->size >= 0);
+    }
+
+    if (back_fence->size != FENCE_SIZE)
+        return heap_error("back fence overwritten", back_fence);
+    return 0;
+}
+
+
+/*!
+ * Checks the treap rooted at "node", whose blocks must all order strictly
+ * between "low" and "high" (either of which may be NULL, for no bound).
+ * Returns the number of blocks in it, or -1 on the first problem found.
+ */
+long check_tree(tag *node, tag *low, tag *high, long limit) {
+    tree_links *links;
+    long left, right;
+
+    if (node == NULL)
+        return 0;
+    if (limit <= 0)
+        return heap_error("free tree holds more blocks than the pool has",
+                          node);
+    if (node->size < 0)
+        return heap_error("allocated block in the free tree", node);
+    if ((low != NULL && !tree_less(low, node)) ||
+        (high != NULL && !tree_less(node, high)))
+        return heap_error("free tree out of order", node);
+
+    links = tree_links_of(node);
+    if ((links->left != NULL &&
+         tree_priority(links->left) > tree_priority(node)) ||
+        (links->right != NULL &&
+         tree_priority(links->right) > tree_priority(node)))
+        return heap_error("free tree out of heap order", node);
+
+    left = check_tree(links->left, low, node, limit - 1);
+    if (left < 0)
+        return -1;
+    right = check_tree(links->right, node, high, limit - 1 - left);
+    if (right < 0)
+        return -1;
+    return 1 + left + right;
+}
+
+
+/*!
+ * Checks the segregated free lists:  every block on a list must be free and
+ * in the list's size class, its back link must point to its predecessor, and
+ * the bitmap must say which lists are nonempty.  Returns the number of blocks
+ * on the lists, or -1 on the first problem found.
+ */
+long check_size_classes(long limit) {
+    tag *block, *prev;
+    long count = 0;
+    int c;
+
+    for (c = 0; c < NUM_SIZE_CLASSES; c++) {
+        if ((size_classes[c] != NULL) != ((nonempty_classes >> c) & 1))
+            return heap_error("nonempty class bitmap is wrong",
+                              size_classes[c]);
+
+        prev = NULL;
+        for (block = size_classes[c]; block != NULL;
+             block = links_of(block)->next) {
+            if (++count > limit)
+                return heap_error("free lists hold more blocks than the pool has",
+                                  block);
+            if (block->size < 0)
+                return heap_error("allocated block on a free list", block);
+            if (size_class(block->size) != c)
+                return heap_error("free block in the wrong size class", block);
+            if (links_of(block)->prev != prev)
+                return heap_error("free list back link is wrong", block);
+            prev = block;
+        }
+    }
+    return count;
+}
+
+
+/*!
+ * Checks the quick-lists:  every parked block must be marked allocated and
+ * parked, and be on the list for its size, and the lists must hold
+ * num_parked blocks of parked_bytes bytes in all.  Returns 0, or -1 on the first problem found.
+ */
+int check_quick_lists() {
+    tag *head;
+    long count = 0, bytes = 0;
+    int q;
+
+    for (q = 0; q < NUM_QUICK_LISTS; q++) {
+        for (head = quick_lists[q]; head != NULL; head = *quick_next(head)) {
+            if (++count > num_parked)
+                return heap_error("quick-lists hold more blocks than were "
+                                  "parked", head);
+            if (head->size >= 0)
+                return heap_error("free block on a quick-list", head);
+            if (!is_parked(head))
+                return heap_error("unmarked block on a quick-list", head);
+            if (-head->size / MYALLOC_ALIGNMENT != q)
+                return heap_error("block on the wrong quick-list", head);
+            bytes -= head->size;
+        }
+    }
+
+    if (count != num_parked || bytes != parked_bytes) {
+        fprintf(stderr, "myalloc_check: quick-lists hold %ld blocks of %ld "
+                "bytes, but %d blocks of %ld bytes were parked\n", count,
+                bytes, num_parked, parked_bytes);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*!
+ * Checks the consistency of every arena and of the free index.  This takes
+ * O(n).  See myalloc.h.
+ */
+int myalloc_check() {
+    arena *a;
+    long num_indexed = 0, count;
+
+    for (a = first_arena; a != NULL; a = a->next) {
+        if (check_arena(a, &num_indexed) < 0)
+            return -1;
+    }
+    if (check_quick_lists() < 0)
+        return -1;
+
+    switch (ALLOC_POLICY) {
+    case SEGREGATED_FIT:
+        count = check_size_classes(num_indexed);
+        break;
+    case BEST_FIT:
+        count = check_tree(free_tree, NULL, NULL, num_indexed);
+        break;
+    default:
+        // The tags are the only index
+        count = num_indexed;
+        break;
+    }
+    if (count < 0)
+        return -1;
+    if (count != num_indexed) {
+        fprintf(stderr, "myalloc_check: free index holds %ld blocks, but the "
+                "pool has %ld free blocks\n", count, num_indexed);
+        return -1;
+    }
+    return 0;
+}
+
+
+void check_heap(const char *where) {
+    if (myalloc_check() < 0) {
+        fprintf(stderr, "%s: heap is corrupt\n", where);
+        abort();
+    }
 }
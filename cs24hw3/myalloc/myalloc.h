@@ -13,6 +13,57 @@
 extern int MEMORY_SIZE;
 
 
+/*!
+ * Every block returned by myalloc(), mycalloc() and myrealloc() starts at a
+ * multiple of this many bytes, so it can hold any type, including SIMD
+ * vectors.  Use myalloc_aligned() for stricter alignments.
+ */
+#define MYALLOC_ALIGNMENT 16
+
+
+/*!
+ * The placement policies the allocator can use to pick a free block for an
+ * allocation request.
+ */
+typedef enum {
+    /* Scan every block in the pool, and take the first free one that fits. */
+    FIRST_FIT,
+
+    /* Keep free blocks on explicit lists, one per power-of-two size class,
+     * so that allocation and coalescing are constant-time.
+     */
+    SEGREGATED_FIT,
+
+    /* Like FIRST_FIT, but resume each scan where the previous allocation
+     * was made, instead of at the start of the pool.
+     */
+    NEXT_FIT,
+
+    /* Keep free blocks in a balanced search tree ordered by size, and take
+     * the smallest free block that fits, in O(log n) instead of a full scan.
+     */
+    BEST_FIT
+} alloc_policy;
+
+
+/*!
+ * Specifies the placement policy the allocator uses.  Like MEMORY_SIZE, this
+ * must be set before init_myalloc() is called.  Defaults to FIRST_FIT.
+ */
+extern alloc_policy ALLOC_POLICY;
+
+
+/*!
+ * If nonzero, the memory pool grows on demand.  init_myalloc() maps a first
+ * arena of MEMORY_SIZE bytes with mmap(), myalloc() maps another arena (of at
+ * least MEMORY_SIZE bytes) whenever no existing arena can serve a request,
+ * and myfree() unmaps any additional arena that becomes entirely free.  Like
+ * MEMORY_SIZE, this must be set before init_myalloc() is called.  Defaults to
+ * 0, i.e. a single fixed pool.
+ */
+extern int ARENA_MODE;
+
+
 /* Initializes allocator state, and memory pool state too. */
 void init_myalloc();
 
@@ -24,3 +75,101 @@ unsigned char * myalloc(int size);
 /* Free a previously allocated pointer. */
 void myfree(unsigned char *oldptr);
 
+
+/* Resize a previously allocated block to "size" bytes, in place if possible.
+ * Returns the block's (possibly new) address, or 0 if that fails.
+ */
+unsigned char * myrealloc(unsigned char *oldptr, int size);
+
+
+/* Attempt to allocate a zeroed array of "num" elements of "size" bytes. */
+unsigned char * mycalloc(int num, int size);
+
+
+/* Attempt to allocate "size" bytes at a multiple of "align" bytes, which must
+ * be a power of 2, e.g. 32 or 64 for a buffer that starts a cache line.
+ */
+unsigned char * myalloc_aligned(int size, int align);
+
+
+/* Returns the usable size of a block returned by myalloc(), which may be
+ * larger than the size originally requested.
+ */
+int myalloc_usable_size(unsigned char *ptr);
+
+
+/*!
+ * If nonzero, myfree() doesn't coalesce small blocks right away.  Instead it
+ * parks them on quick-lists, one per exact size, where myalloc() can reuse
+ * them for a request of the same size without searching or splitting.
+ * Parked blocks are coalesced all at once, when an allocation can't be
+ * served otherwise, or when they tie up too much of the pool.  Like
+ * MEMORY_SIZE, this must be set before init_myalloc() is called.  Defaults
+ * to 0, i.e. every free coalesces immediately.
+ */
+extern int DEFER_COALESCE;
+
+
+/*!
+ * If nonzero, every call to myalloc(), mycalloc(), myrealloc() and myfree()
+ * validates the whole pool with myalloc_check() on entry and on exit, and
+ * aborts if it is corrupt, so that corruption is caught at the call that
+ * caused it (or the first call after a caller overran a block).  This makes
+ * every call O(n).  Defaults to 0; it may be changed at any time.
+ */
+extern int DEBUG_HEAP;
+
+
+/*! Number of buckets in the histogram of free block sizes. */
+#define HEAP_HISTOGRAM_BUCKETS 32
+
+
+/*! A summary of the state of the pool, filled in by myalloc_stats(). */
+typedef struct {
+    /* Total bytes in all arenas, including tags and other overhead. */
+    long heap_size;
+
+    /* Number of arenas the pool is made of. */
+    int num_arenas;
+
+    /* Number of allocated blocks, and their total payload bytes. */
+    int num_allocated;
+    long allocated_bytes;
+
+    /* Number of freed blocks still waiting to be coalesced, with
+     * DEFER_COALESCE, and their total payload bytes.  These are counted
+     * neither as allocated nor as free.
+     */
+    int num_deferred;
+    long deferred_bytes;
+
+    /* Number of free blocks, and their total payload bytes. */
+    int num_free;
+    long free_bytes;
+
+    /* Payload bytes in the largest free block. */
+    int largest_free;
+
+    /* External fragmentation:  the fraction of the free bytes that lie
+     * outside the largest free block, i.e. 1 - largest_free / free_bytes.
+     * 0 means all free memory is in one block, or there is none.
+     */
+    double fragmentation;
+
+    /* Entry c counts the free blocks whose size lies in [2^c, 2^(c+1));
+     * blocks of size 0 are counted in entry 0.
+     */
+    int free_histogram[HEAP_HISTOGRAM_BUCKETS];
+} heap_stats;
+
+
+/* Walks every block in the pool, and summarizes what it finds in *stats. */
+void myalloc_stats(heap_stats *stats);
+
+
+/* Walks every block in the pool and the free index, and checks that they are
+ * consistent.  Returns 0 if they are; otherwise describes the first problem
+ * found on stderr, and returns -1.
+ */
+int myalloc_check();
+
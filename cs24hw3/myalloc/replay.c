@@ -0,0 +1,337 @@
+/*! \file
+ * Replays an allocation trace (see trace.h) against the allocator, and
+ * reports per-operation latency percentiles, peak heap size, utilization
+ * and fragmentation, so that placement strategies can be compared on
+ * allocation sequences recorded from real programs.
+ *
+ * Traces can be recorded from any dynamically-linked program with the
+ * libtracehook.so shim, or from testalloc with its -w option.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "myalloc.h"
+#include "slab.h"
+#include "trace.h"
+
+
+/* Pool statistics are sampled once per this many operations, outside of
+ * the timed region, since walking the pool takes O(n).  The pool is also
+ * sampled whenever the live bytes reach a new high.
+ */
+#define SAMPLE_INTERVAL 1024
+
+/* Default size of each arena the pool grows by. */
+#define DEFAULT_ARENA_SIZE 65536
+
+
+typedef struct {
+    const char *name;
+    alloc_policy policy;
+} policy_option;
+
+policy_option policy_options[] = {
+    { "first", FIRST_FIT },
+    { "segregated", SEGREGATED_FIT },
+    { "next", NEXT_FIT },
+    { "best", BEST_FIT }
+};
+#define NUM_POLICY_OPTIONS \
+    ((int) (sizeof(policy_options) / sizeof(policy_options[0])))
+
+
+/* When nonzero, requests go through the slab sub-allocator. */
+int use_slabs = 0;
+
+/* When nonzero, the free block histogram of the final pool is printed. */
+int verbose = 0;
+
+
+void usage(const char *progname) {
+    int i;
+
+    printf("usage: %s [-p policy] [-m arena-size] [-f] [-s] [-d] [-c] [-v] "
+           "trace-file\n\n", progname);
+    printf("\t-p policy      placement policy, one of:");
+    for (i = 0; i < NUM_POLICY_OPTIONS; i++)
+        printf(" %s", policy_options[i].name);
+    printf(" (default %s)\n", policy_options[0].name);
+    printf("\t-m arena-size  size of each arena the pool grows by, or of the\n"
+           "\t               whole pool with -f (default %d)\n",
+           DEFAULT_ARENA_SIZE);
+    printf("\t-f             use one fixed-size pool instead of growing\n");
+    printf("\t-s             serve small requests from slabs\n");
+    printf("\t-d             defer coalescing of small freed blocks\n");
+    printf("\t-c             check the heap's consistency on every call\n");
+    printf("\t-v             print a histogram of the final free blocks\n");
+}
+
+
+long now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+
+int compare_longs(const void *v1, const void *v2) {
+    long l1 = *(const long *) v1;
+    long l2 = *(const long *) v2;
+
+    return (l1 > l2) - (l1 < l2);
+}
+
+
+/* Returns the p-th percentile of a sorted array of latencies. */
+long percentile(long *sorted, int n, double p) {
+    int i = (int) (p / 100.0 * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+
+unsigned char * replay_alloc(int size) {
+    return use_slabs ? slab_alloc(size) : myalloc(size);
+}
+
+
+void replay_free(unsigned char *ptr) {
+    if (use_slabs)
+        slab_free(ptr);
+    else
+        myfree(ptr);
+}
+
+
+/* Resizes a block of "old_size" bytes to "size" bytes.  Slabs can't resize
+ * objects, so the contents are moved, as a caller without realloc would.
+ */
+unsigned char * replay_realloc(unsigned char *ptr, int old_size, int size) {
+    unsigned char *result;
+
+    if (!use_slabs)
+        return myrealloc(ptr, size);
+
+    result = slab_alloc(size);
+    if (result != NULL) {
+        memcpy(result, ptr, (size < old_size) ? size : old_size);
+        slab_free(ptr);
+    }
+    return result;
+}
+
+
+int main(int argc, char *argv[]) {
+    trace_op *ops;
+    int num_ops, opt, i, j;
+    uint32_t num_ids;
+    unsigned char **blocks;
+    uint32_t *sizes;
+    long *latencies;
+    long t_start, t_overhead, total_ns = 0;
+    long live_bytes = 0, peak_live = 0, sampled_live = 0, peak_heap = 0;
+    double frag_at_peak = 0.0;
+    int num_allocs = 0, num_frees = 0, num_reallocs = 0;
+    heap_stats stats;
+
+    MEMORY_SIZE = DEFAULT_ARENA_SIZE;
+    ARENA_MODE = 1;
+    ALLOC_POLICY = policy_options[0].policy;
+
+    while ((opt = getopt(argc, argv, "p:m:fsdcv")) != -1) {
+        switch (opt) {
+        case 'p':
+            for (i = 0; i < NUM_POLICY_OPTIONS; i++) {
+                if (strcmp(optarg, policy_options[i].name) == 0)
+                    break;
+            }
+            if (i == NUM_POLICY_OPTIONS) {
+                usage(argv[0]);
+                return 1;
+            }
+            ALLOC_POLICY = policy_options[i].policy;
+            break;
+
+        case 'm':
+            MEMORY_SIZE = atoi(optarg);
+            break;
+
+        case 'f':
+            ARENA_MODE = 0;
+            break;
+
+        case 's':
+            use_slabs = 1;
+            break;
+
+        case 'd':
+            DEFER_COALESCE = 1;
+            break;
+
+        case 'c':
+            DEBUG_HEAP = 1;
+            break;
+
+        case 'v':
+            verbose = 1;
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1 || MEMORY_SIZE <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ops = trace_load(argv[optind], &num_ops, &num_ids);
+    if (ops == NULL) {
+        fprintf(stderr, "%s: could not load trace %s\n", argv[0], argv[optind]);
+        return 1;
+    }
+
+    blocks = calloc(num_ids + 1, sizeof(unsigned char *));
+    sizes = calloc(num_ids + 1, sizeof(uint32_t));
+    latencies = malloc((num_ops + 1) * sizeof(long));
+    if (blocks == NULL || sizes == NULL || latencies == NULL) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+
+    init_myalloc();
+    if (use_slabs)
+        init_slab();
+
+    /* Estimate the cost of reading the clock, to subtract from each op. */
+    t_start = now_ns();
+    for (i = 0; i < 1000; i++)
+        now_ns();
+    t_overhead = (now_ns() - t_start) / 1001;
+
+    for (i = 0; i < num_ops; i++) {
+        trace_op *op = ops + i;
+        unsigned char *result = NULL;
+
+        t_start = now_ns();
+        switch (op->type) {
+        case TRACE_ALLOC:
+            result = blocks[op->id] = replay_alloc(op->size);
+            break;
+
+        case TRACE_FREE:
+            replay_free(blocks[op->id]);
+            break;
+
+        case TRACE_REALLOC:
+            result = blocks[op->new_id] =
+                replay_realloc(blocks[op->id], sizes[op->id], op->size);
+            break;
+        }
+        latencies[i] = now_ns() - t_start - t_overhead;
+        if (latencies[i] < 0)
+            latencies[i] = 0;
+        total_ns += latencies[i];
+
+        if (op->type != TRACE_FREE && result == NULL && op->size > 0) {
+            printf("Allocation of %u bytes failed at operation %d.\n",
+                   op->size, i);
+            num_ops = i;
+            break;
+        }
+
+        switch (op->type) {
+        case TRACE_ALLOC:
+            num_allocs++;
+            sizes[op->id] = op->size;
+            live_bytes += op->size;
+            break;
+
+        case TRACE_FREE:
+            num_frees++;
+            live_bytes -= sizes[op->id];
+            break;
+
+        case TRACE_REALLOC:
+            num_reallocs++;
+            sizes[op->new_id] = op->size;
+            live_bytes += (long) op->size - sizes[op->id];
+            break;
+        }
+
+        if (live_bytes > peak_live)
+            peak_live = live_bytes;
+
+        /* Sample the pool every SAMPLE_INTERVAL ops, and whenever the live
+         * bytes grow noticeably past the most ever sampled.
+         */
+        if (i % SAMPLE_INTERVAL == 0 ||
+            live_bytes > sampled_live + sampled_live / 64) {
+            myalloc_stats(&stats);
+            if (stats.heap_size > peak_heap)
+                peak_heap = stats.heap_size;
+            if (live_bytes >= sampled_live) {
+                sampled_live = live_bytes;
+                frag_at_peak = stats.fragmentation;
+            }
+        }
+    }
+    myalloc_stats(&stats);
+    if (stats.heap_size > peak_heap)
+        peak_heap = stats.heap_size;
+
+    if (num_ops == 0) {
+        printf("Trace is empty.\n");
+        return 0;
+    }
+
+    qsort(latencies, num_ops, sizeof(long), compare_longs);
+
+    for (j = 0; j < NUM_POLICY_OPTIONS; j++) {
+        if (policy_options[j].policy == ALLOC_POLICY)
+            break;
+    }
+    printf("Trace %s:  %d ops (%d allocs, %d frees, %d reallocs)\n",
+           argv[optind], num_ops, num_allocs, num_frees, num_reallocs);
+    printf("Allocator:  %s placement, %s of %d bytes%s%s\n",
+           policy_options[j].name, ARENA_MODE ? "arenas" : "fixed pool",
+           MEMORY_SIZE, use_slabs ? ", slabs" : "",
+           DEFER_COALESCE ? ", deferred coalescing" : "");
+    printf("Time:  %.3f ms total, %.1f ns/op mean\n", total_ns / 1e6,
+           (double) total_ns / num_ops);
+    printf("Latency (ns/op):  p50=%ld p90=%ld p99=%ld p99.9=%ld max=%ld\n",
+           percentile(latencies, num_ops, 50.0),
+           percentile(latencies, num_ops, 90.0),
+           percentile(latencies, num_ops, 99.0),
+           percentile(latencies, num_ops, 99.9),
+           latencies[num_ops - 1]);
+    printf("Peak live bytes:  %ld\n", peak_live);
+    printf("Peak heap bytes:  %ld (%d arenas at end)\n", peak_heap,
+           stats.num_arenas);
+    printf("Utilization:  %f\n",
+           (peak_heap == 0) ? 0.0 : (double) peak_live / peak_heap);
+    printf("Fragmentation at peak (1 - largest free / total free):  %f\n",
+           frag_at_peak);
+    printf("Blocks at end:  %d allocated (%ld bytes), %d free (%ld bytes)\n",
+           stats.num_allocated, stats.allocated_bytes, stats.num_free,
+           stats.free_bytes);
+    if (DEFER_COALESCE)
+        printf("Deferred at end:  %d blocks (%ld bytes)\n", stats.num_deferred,
+               stats.deferred_bytes);
+
+    if (verbose) {
+        printf("Free blocks at end, by size:\n");
+        for (j = 0; j < HEAP_HISTOGRAM_BUCKETS; j++) {
+            if (stats.free_histogram[j] != 0)
+                printf("  %10ld - %10ld  %d\n", (j == 0) ? 0L : 1L << j,
+                       (2L << j) - 1, stats.free_histogram[j]);
+        }
+    }
+
+    return 0;
+}
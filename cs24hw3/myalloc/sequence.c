@@ -28,6 +28,7 @@ SEQLIST *seq_add_front(int size, unsigned char *ref_block, SEQLIST *next) {
   result->myalloc_block = (unsigned char *) 0;
   result->tofree = (SEQLIST *) 0;
   result->next = next;
+  result->trace_id = 0;
   return result;
 }
 
@@ -48,6 +49,7 @@ SEQLIST *seq_set_next_allocate(int size, unsigned char *ref_block,
   result->myalloc_block = (unsigned char *) 0;
   result->tofree = (SEQLIST *) 0;
   result->next = (SEQLIST *) 0;
+  result->trace_id = 0;
   prev->next = result;
 
   return result;
@@ -70,6 +72,7 @@ SEQLIST *seq_set_next_free(SEQLIST *tofree, SEQLIST *prev) {
   result->myalloc_block = (unsigned char *) 0;
   result->tofree = tofree;
   result->next = (SEQLIST *) 0;
+  result->trace_id = 0;
   prev->next = result;
 
   return result;
@@ -91,6 +94,14 @@ void seq_set_myalloc_block(SEQLIST *seq, unsigned char *myalloc_block) {
   seq->myalloc_block = myalloc_block;
 }
 
+void seq_set_trace_id(SEQLIST *seq, unsigned int trace_id) {
+  seq->trace_id = trace_id;
+}
+
+unsigned int seq_trace_id(SEQLIST *seq) {
+  return seq->trace_id;
+}
+
 int seq_size(SEQLIST *seq) {
   return seq->size;
 }
@@ -18,6 +18,7 @@ typedef struct sequence_struct {
   struct sequence_struct *tofree; // for a free, the sequence_struct
                                   // whose allocation should be freed
   struct sequence_struct *next;  // next pointer
+  unsigned int trace_id; // id of the block in a recorded trace
 } SEQLIST;
 
 // add to front, always an allocate
@@ -35,8 +36,10 @@ SEQLIST  *seq_next(SEQLIST *seq);
 SEQLIST  *seq_tofree(SEQLIST *seq);
 // predicate
 int seq_null(SEQLIST *seq);
+unsigned int seq_trace_id(SEQLIST *seq);
 // mutators
 void seq_set_myalloc_block(SEQLIST *seq,unsigned char *myalloc_block);
+void seq_set_trace_id(SEQLIST *seq, unsigned int trace_id);
 void seq_free(SEQLIST *seq);
 // utilities
 SEQLIST *find_nth_allocated_block(SEQLIST *seq,int n);
@@ -29,6 +29,18 @@ unsigned char * allocate(int size, unsigned char fill) {
 }
 
 
+/* Returns nonzero if the first "size" bytes of the block are all "fill". */
+int contents_are(unsigned char *block, int size, unsigned char fill) {
+    int i;
+
+    for (i = 0; i < size; i++) {
+        if (block[i] != fill)
+            return 0;
+    }
+    return 1;
+}
+
+
 int main(int argc, char *argv[]) {
 
     /* Specify the memory pool size, then initialize the allocator. */
@@ -38,12 +50,38 @@ int main(int argc, char *argv[]) {
     /* Perform simple allocations and deallocations. */
     /* Change the below code as you see fit, to test various scenarios. */
 
+    /* The two blocks exactly fill the pool:  each block has a 4-byte header
+     * and footer, and the pool has a 4-byte fence tag at either end.  The
+     * pool from malloc() is 16-byte aligned, so its first 8 bytes are skipped
+     * to align the payloads.
+     */
     unsigned char *a = allocate(39000, 'A');
-    unsigned char *b = allocate(984, 'B');
+    unsigned char *b = allocate(968, 'B');
 
     myfree(a);
     myfree(b);
 
+    /* Grow a block into the free space after it, which shouldn't move it,
+     * then shrink it again.  The contents must survive both.
+     */
+    a = allocate(100, 'A');
+    b = myrealloc(a, 1000);
+    printf("Grew block to 1000 bytes %s.\n",
+           (b == a) ? "in place" : "by moving it");
+    b = myrealloc(b, 50);
+    printf("Shrank block to 50 bytes; contents %s.\n",
+           contents_are(b, 50, 'A') ? "intact" : "CORRUPTED");
+
+    /* A calloc'd block must be zeroed, even where a freed block left data. */
+    a = mycalloc(100, 4);
+    printf("Calloc'd block of 400 bytes is %s.\n",
+           contents_are(a, 400, 0) ? "zeroed" : "NOT ZEROED");
+
+    myfree(a);
+    myfree(b);
+
+    printf("Heap is %s.\n", (myalloc_check() == 0) ? "consistent" : "CORRUPT");
+
     return 0;
 }
 
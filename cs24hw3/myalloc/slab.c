@@ -0,0 +1,247 @@
+/*! \file
+ * Implementation of a slab sub-allocator that sits in front of myalloc().
+ *
+ * Each size class (8, 16, 24, ... SLAB_THRESHOLD bytes) has a list of the
+ * slabs that still have a free object, so allocation never has to look at a
+ * full slab.  Each slab is one SLAB_BYTES block from myalloc(), starting with
+ * a header that holds the occupancy bitmap, followed by the objects.  A slab
+ * directory, sorted by address, maps a freed pointer back to its slab, or
+ * tells us that the pointer came from myalloc() instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "myalloc.h"
+#include "slab.h"
+
+
+/* Size of the block each slab takes from myalloc(). */
+#define SLAB_BYTES 4096
+
+/* Objects are a multiple of this size, which is also the smallest object. */
+#define SLAB_GRANULE 8
+
+#define NUM_SLAB_CLASSES (SLAB_MAX_THRESHOLD / SLAB_GRANULE)
+
+/* Enough bitmap words to cover a slab full of the smallest objects. */
+#define SLAB_BITMAP_WORDS ((SLAB_BYTES / SLAB_GRANULE + 31) / 32)
+
+
+typedef struct slab {
+    /* Links in the size class's list of slabs with free objects. */
+    struct slab *prev;
+    struct slab *next;
+
+    /* Size of every object in the slab, and how many objects fit. */
+    int obj_size;
+    int num_objs;
+
+    /* Number of objects currently allocated. */
+    int num_used;
+
+    /* No bitmap word before this one has a free object. */
+    int first_free_word;
+
+    /* The first object in the slab. */
+    unsigned char *objs;
+
+    /* Bit i is set if object i is allocated, or doesn't exist. */
+    uint32_t used[SLAB_BITMAP_WORDS];
+} slab;
+
+
+int SLAB_THRESHOLD = 64;
+
+/* Per size class, the slabs that have at least one free object. */
+static slab *partial_slabs[NUM_SLAB_CLASSES];
+
+/* Every slab, sorted by address. */
+static slab **slab_dir;
+static int num_slabs;
+static int slab_dir_capacity;
+
+
+/* Returns the index in slab_dir of the last slab at or below "ptr", or -1
+ * if there is none.
+ */
+static int find_slab_index(unsigned char *ptr) {
+    int low = 0, high = num_slabs - 1, mid;
+
+    while (low <= high) {
+        mid = (low + high) / 2;
+        if ((unsigned char *) slab_dir[mid] <= ptr)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+    return high;
+}
+
+
+/* Adds a new slab to the directory, keeping it sorted by address. */
+static void add_to_dir(slab *s) {
+    int i;
+
+    if (num_slabs == slab_dir_capacity) {
+        slab_dir_capacity = (slab_dir_capacity == 0) ? 64 :
+                            2 * slab_dir_capacity;
+        slab_dir = realloc(slab_dir, slab_dir_capacity * sizeof(slab *));
+        if (slab_dir == NULL) {
+            fprintf(stderr, "slab: could not grow the slab directory\n");
+            abort();
+        }
+    }
+
+    i = find_slab_index((unsigned char *) s) + 1;
+    memmove(slab_dir + i + 1, slab_dir + i, (num_slabs - i) * sizeof(slab *));
+    slab_dir[i] = s;
+    num_slabs++;
+}
+
+
+static void remove_from_dir(slab *s) {
+    int i = find_slab_index((unsigned char *) s);
+
+    memmove(slab_dir + i, slab_dir + i + 1,
+            (num_slabs - i - 1) * sizeof(slab *));
+    num_slabs--;
+}
+
+
+static void push_partial(slab *s, int c) {
+    s->prev = NULL;
+    s->next = partial_slabs[c];
+    if (partial_slabs[c] != NULL)
+        partial_slabs[c]->prev = s;
+    partial_slabs[c] = s;
+}
+
+
+static void remove_partial(slab *s, int c) {
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        partial_slabs[c] = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+}
+
+
+/* Carves a new slab for size class c out of a block from myalloc(), and
+ * adds it to the class's list.  Returns NULL if the pool is exhausted.
+ */
+static slab * new_slab(int c) {
+    slab *s = (slab *) myalloc(SLAB_BYTES);
+    int i;
+
+    if (s == NULL)
+        return NULL;
+
+    s->obj_size = (c + 1) * SLAB_GRANULE;
+    // Objects whose size is a multiple of MYALLOC_ALIGNMENT stay aligned
+    s->objs = (unsigned char *) s +
+        (sizeof(slab) + MYALLOC_ALIGNMENT - 1) / MYALLOC_ALIGNMENT *
+        MYALLOC_ALIGNMENT;
+    s->num_objs = (SLAB_BYTES - (s->objs - (unsigned char *) s)) / s->obj_size;
+    s->num_used = 0;
+    s->first_free_word = 0;
+
+    // Mark the bits past the last object as used, so they're never handed out
+    memset(s->used, 0, sizeof(s->used));
+    for (i = s->num_objs; i < SLAB_BITMAP_WORDS * 32; i++)
+        s->used[i / 32] |= 1u << (i % 32);
+
+    add_to_dir(s);
+    push_partial(s, c);
+    return s;
+}
+
+
+/* Resets the slab allocator. */
+void init_slab() {
+    int c;
+
+    if (SLAB_THRESHOLD > SLAB_MAX_THRESHOLD)
+        SLAB_THRESHOLD = SLAB_MAX_THRESHOLD;
+
+    /* The slabs themselves went away with the old pool. */
+    for (c = 0; c < NUM_SLAB_CLASSES; c++)
+        partial_slabs[c] = NULL;
+    num_slabs = 0;
+}
+
+
+/* Allocates "size" bytes, from a slab if the request is small enough.  The
+ * first free object is found by scanning the bitmap a word at a time,
+ * starting from the first word that may have one.
+ */
+unsigned char * slab_alloc(int size) {
+    slab *s;
+    int c, w, bit;
+
+    if (size <= 0 || size > SLAB_THRESHOLD)
+        return myalloc(size);
+
+    c = (size - 1) / SLAB_GRANULE;
+    s = partial_slabs[c];
+    if (s == NULL) {
+        s = new_slab(c);
+        if (s == NULL)
+            return myalloc(size);
+    }
+
+    for (w = s->first_free_word; s->used[w] == ~0u; w++)
+        ;
+    s->first_free_word = w;
+    bit = __builtin_ctz(~s->used[w]);
+    s->used[w] |= 1u << bit;
+
+    // A full slab leaves the list until one of its objects is freed
+    s->num_used++;
+    if (s->num_used == s->num_objs)
+        remove_partial(s, c);
+
+    return s->objs + (w * 32 + bit) * s->obj_size;
+}
+
+
+/* Frees a pointer returned by slab_alloc().  A slab that becomes empty goes
+ * back to myalloc(), unless it is the only slab its class has room in.
+ */
+void slab_free(unsigned char *oldptr) {
+    slab *s;
+    int i, c;
+
+    if (oldptr == NULL)
+        return;
+
+    i = find_slab_index(oldptr);
+    if (i < 0 || oldptr >= (unsigned char *) slab_dir[i] + SLAB_BYTES) {
+        myfree(oldptr);
+        return;
+    }
+
+    s = slab_dir[i];
+    c = s->obj_size / SLAB_GRANULE - 1;
+    i = (oldptr - s->objs) / s->obj_size;
+    if (!(s->used[i / 32] & (1u << (i % 32)))) {
+        fprintf(stderr, "slab: cannot free an already free object\n");
+        return;
+    }
+    s->used[i / 32] &= ~(1u << (i % 32));
+    if (i / 32 < s->first_free_word)
+        s->first_free_word = i / 32;
+
+    if (s->num_used == s->num_objs)
+        push_partial(s, c);
+    s->num_used--;
+
+    if (s->num_used == 0 && (s->prev != NULL || s->next != NULL)) {
+        remove_partial(s, c);
+        remove_from_dir(s);
+        myfree((unsigned char *) s);
+    }
+}
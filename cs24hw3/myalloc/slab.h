@@ -0,0 +1,34 @@
+/*! \file
+ * Declarations for a slab sub-allocator that sits in front of myalloc().
+ * Small requests are rounded up to a multiple of 8 bytes and served from
+ * slabs:  blocks obtained from myalloc() and carved into equal-size objects,
+ * whose occupancy is tracked in a bitmap.  Objects carry no boundary tags of
+ * their own, and finding a free one takes no walk over the pool.  Larger
+ * requests fall through to myalloc().
+ */
+
+
+/*! The largest request the slabs can be configured to serve. */
+#define SLAB_MAX_THRESHOLD 256
+
+
+/*!
+ * Requests of up to this many bytes are served from slabs; larger requests
+ * go to myalloc().  Must be set before init_slab() is called, and is clamped
+ * to SLAB_MAX_THRESHOLD.  Defaults to 64.
+ */
+extern int SLAB_THRESHOLD;
+
+
+/* Resets the slab allocator.  Since slabs live in myalloc()'s pool, this must
+ * be called after every call to init_myalloc().
+ */
+void init_slab();
+
+
+/* Allocates "size" bytes, from a slab if the request is small enough. */
+unsigned char * slab_alloc(int size);
+
+
+/* Frees a pointer returned by slab_alloc(). */
+void slab_free(unsigned char *oldptr);
@@ -11,13 +11,58 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 #include "errno.h"
 #include "myalloc.h"
 #include "sequence.h"
+#include "slab.h"
+#include "trace.h"
 
 #define VERBOSE 0
 
+// parameters of the larger sequence used to time the placement policies;
+//  many small blocks stay live at once, so the pool gets fragmented
+#define BENCH_MAX_USED_MEMORY 200000
+#define BENCH_ALLOCATION_FACTOR 11
+#define BENCH_MAX_BLOCK_SIZE 200
+#define BENCH_REPETITIONS 3
+
+// parameters of the small, uniform objects sequence used to compare the
+//  slab sub-allocator against plain myalloc()
+#define SMALL_MAX_USED_MEMORY 20000
+#define SMALL_ALLOCATION_FACTOR 11
+#define SMALL_MAX_BLOCK_SIZE 32
+
+// initial pool size when testing growable arenas; most of the test sequence
+//  has to be served from arenas mapped on demand
+#define ARENA_TEST_MEMORY_SIZE 1024
+
+// when nonzero, sequences are replayed through the slab sub-allocator
+int use_slabs = 0;
+
+// the placement policies to compare
+alloc_policy test_policies[] = {
+  FIRST_FIT, NEXT_FIT, BEST_FIT, SEGREGATED_FIT
+};
+#define NUM_TEST_POLICIES \
+  ((int) (sizeof(test_policies) / sizeof(test_policies[0])))
+
+const char *policy_name(alloc_policy policy) {
+  switch (policy) {
+  case FIRST_FIT:
+    return "first-fit";
+  case SEGREGATED_FIT:
+    return "segregated-fit";
+  case NEXT_FIT:
+    return "next-fit";
+  case BEST_FIT:
+    return "best-fit";
+  }
+  return "unknown";
+}
+
 // some random numbers...
 
 int random_int(int max) {
@@ -32,11 +77,11 @@ int random_int(int max) {
 }
 
 
-int random_block_size(int max_value) {
+int random_block_size(int max_block_size) {
 
   // blah, almost certainly not a good model of
   //  typical allocations, but workable for a crude test
-  return random_int(max_value / 4);
+  return random_int(max_block_size);
 
 }
 
@@ -68,18 +113,37 @@ void fill_data(unsigned char *p1, unsigned char *p2, int len) {
 }
 
 
+// reset the allocator front end being tested
+void test_init(int mem_size) {
+  MEMORY_SIZE = mem_size;
+  init_myalloc();
+  if (use_slabs)
+    init_slab();
+}
+
+unsigned char *test_alloc(int size) {
+  return use_slabs ? slab_alloc(size) : myalloc(size);
+}
+
+void test_free(unsigned char *ptr) {
+  if (use_slabs)
+    slab_free(ptr);
+  else
+    myfree(ptr);
+}
+
+
 // try applying sequence
 int try_sequence(SEQLIST *test_sequence, int mem_size) {
   SEQLIST *sptr;
   unsigned char *mblock;
 
   // reset the memory allocator being tested
-  MEMORY_SIZE = mem_size;
-  init_myalloc();
+  test_init(mem_size);
 
   for (sptr = test_sequence; !seq_null(sptr); sptr = seq_next(sptr)) {
     if (seq_alloc(sptr)) {     // allocate a block
-      mblock = myalloc(seq_size(sptr));
+      mblock = test_alloc(seq_size(sptr));
       if (mblock == 0) {
         return 0; // failed -- return indication
       }
@@ -92,7 +156,7 @@ int try_sequence(SEQLIST *test_sequence, int mem_size) {
       }
     }
     else {    // dealloc
-      myfree(seq_myalloc_block(seq_tofree(sptr)));
+      test_free(seq_myalloc_block(seq_tofree(sptr)));
     }
   }
 
@@ -100,6 +164,43 @@ int try_sequence(SEQLIST *test_sequence, int mem_size) {
 }
 
 
+// replay sequence without touching the blocks' contents, so that only
+//  the allocator's own work is measured; returns nanoseconds per operation,
+//  or -1 if an allocation failed
+double time_sequence(SEQLIST *test_sequence, int mem_size, int repetitions) {
+  SEQLIST *sptr;
+  unsigned char *mblock;
+  struct timespec t_start, t_end;
+  double elapsed = 0.0;
+  long ops = 0;
+  int rep;
+
+  for (rep = 0; rep < repetitions; rep++) {
+    test_init(mem_size);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (sptr = test_sequence; !seq_null(sptr); sptr = seq_next(sptr)) {
+      if (seq_alloc(sptr)) {
+        mblock = test_alloc(seq_size(sptr));
+        if (mblock == 0)
+          return -1.0;
+        seq_set_myalloc_block(sptr, mblock);
+      }
+      else {
+        test_free(seq_myalloc_block(seq_tofree(sptr)));
+      }
+      ops++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    elapsed += (t_end.tv_sec - t_start.tv_sec) * 1e9 +
+               (t_end.tv_nsec - t_start.tv_nsec);
+  }
+
+  return elapsed / ops;
+}
+
+
 // search over memory sizes between low and high
 //  report smallest size that can accommodate the sequence
 int binary_search_required_memory(SEQLIST *test_sequence, int low, int high) {
@@ -216,7 +317,9 @@ int check_data(SEQLIST *test_sequence) {
 
 // create a test sequence which never uses more than max_used_memory
 //   and allocates a total of max_used_memory*allocation_factor
-SEQLIST *generate_sequence(int max_used_memory, int allocation_factor) {
+//   in blocks of at most max_block_size bytes
+SEQLIST *generate_sequence(int max_used_memory, int allocation_factor,
+                           int max_block_size) {
   int used_memory = 0;
   int total_allocated = 0;
   int next_block_size = 0;
@@ -229,7 +332,7 @@ SEQLIST *generate_sequence(int max_used_memory, int allocation_factor) {
   unsigned char *new_block_ref;
 
   while (total_allocated < allocation_factor * max_used_memory) {
-    next_block_size = random_block_size(max_used_memory);
+    next_block_size = random_block_size(max_block_size);
 
     // first see if we need to free anything in order to
     //  accommodate the new allocation
@@ -285,23 +388,38 @@ SEQLIST *generate_sequence(int max_used_memory, int allocation_factor) {
 
 
 
-int main(int argc, char *argv[]) {
-
-  int max_used_memory;
-  int allocation_factor;
-  int memory_required;
+// write a test sequence out as an allocation trace, so it can be replayed
+//  later by the replay driver
+void write_trace(SEQLIST *test_sequence, const char *path) {
+  SEQLIST *sptr;
+  trace_writer *tw;
+
+  // the writer holds a large buffer, so keep it off the stack
+  tw = (trace_writer *) malloc(sizeof(trace_writer));
+  if (tw == (trace_writer *) 0 || trace_open(tw, path) < 0) {
+    fprintf(stderr, "could not write trace to %s\n", path);
+    free(tw);
+    return;
+  }
 
-  SEQLIST *test_sequence;
+  for (sptr = test_sequence; !seq_null(sptr); sptr = seq_next(sptr)) {
+    if (seq_alloc(sptr))
+      seq_set_trace_id(sptr, trace_alloc(tw, seq_size(sptr)));
+    else
+      trace_free(tw, seq_trace_id(seq_tofree(sptr)));
+  }
 
-  max_used_memory = 2000;
-  allocation_factor = 11;
+  trace_close(tw);
+  free(tw);
+  printf("Wrote trace of the test sequence to %s\n", path);
+}
 
-  printf("running with MAX_USED_MEMORY=%d and ALLOCATION_FACTOR=%d\n",
-         max_used_memory, allocation_factor);
 
-  test_sequence = generate_sequence(max_used_memory, allocation_factor);
-  if (VERBOSE)
-    seq_print(test_sequence);
+// find the smallest pool that accommodates the sequence with the current
+//  placement policy, and report data integrity and memory utilization
+void test_utilization(SEQLIST *test_sequence, int max_used_memory,
+                      int allocation_factor) {
+  int memory_required;
 
   // check that allocation can actually do something.
   // This becomes upper bound on binary search.
@@ -334,7 +452,124 @@ int main(int argc, char *argv[]) {
   else {
     printf("Requires more memory than the no-free case.\n");
   }
-  return 1;
 }
 
 
+// replay sequence against a small, growable pool with the current
+//  placement policy, and report data integrity
+void test_arenas(SEQLIST *test_sequence) {
+  ARENA_MODE = 1;
+  if (try_sequence(test_sequence, ARENA_TEST_MEMORY_SIZE)) {
+    if (check_data(test_sequence)) {
+      printf("Growable arenas data integrity FAIL.\n");
+    }
+    else {
+      printf("Growable arenas data integrity PASS.\n");
+    }
+  }
+  else {
+    printf("Growable arenas could not accommodate the sequence.\n");
+  }
+  ARENA_MODE = 0;
+}
+
+
+int main(int argc, char *argv[]) {
+
+  int max_used_memory;
+  int allocation_factor;
+  int i;
+  double ns_per_op;
+
+  SEQLIST *test_sequence;
+  SEQLIST *bench_sequence;
+  SEQLIST *small_sequence;
+
+  max_used_memory = 2000;
+  allocation_factor = 11;
+
+  printf("running with MAX_USED_MEMORY=%d and ALLOCATION_FACTOR=%d\n",
+         max_used_memory, allocation_factor);
+
+  test_sequence = generate_sequence(max_used_memory, allocation_factor,
+                                    max_used_memory / 4);
+  if (VERBOSE)
+    seq_print(test_sequence);
+
+  // "-w file" records the test sequence as a trace
+  if (argc == 3 && strcmp(argv[1], "-w") == 0)
+    write_trace(test_sequence, argv[2]);
+
+  for (i = 0; i < NUM_TEST_POLICIES; i++) {
+    ALLOC_POLICY = test_policies[i];
+    printf("\n%s placement:\n", policy_name(ALLOC_POLICY));
+    test_utilization(test_sequence, max_used_memory, allocation_factor);
+    test_arenas(test_sequence);
+  }
+
+  // time each policy on a sequence that leaves thousands of blocks live
+  printf("\ntiming with MAX_USED_MEMORY=%d, ALLOCATION_FACTOR=%d and "
+         "blocks of at most %d bytes\n", BENCH_MAX_USED_MEMORY,
+         BENCH_ALLOCATION_FACTOR, BENCH_MAX_BLOCK_SIZE);
+  bench_sequence = generate_sequence(BENCH_MAX_USED_MEMORY,
+    BENCH_ALLOCATION_FACTOR, BENCH_MAX_BLOCK_SIZE);
+
+  for (i = 0; i < NUM_TEST_POLICIES; i++) {
+    ALLOC_POLICY = test_policies[i];
+    ns_per_op = time_sequence(bench_sequence, BENCH_MAX_USED_MEMORY * 2,
+                              BENCH_REPETITIONS);
+    if (ns_per_op < 0)
+      printf("%-16s allocation failed\n", policy_name(ALLOC_POLICY));
+    else
+      printf("%-16s %10.1f ns/op\n", policy_name(ALLOC_POLICY), ns_per_op);
+  }
+
+  // eager versus deferred coalescing, for the policies that keep a free
+  //  index, which coalescing has to update
+  for (i = 0; i < NUM_TEST_POLICIES; i++) {
+    ALLOC_POLICY = test_policies[i];
+    if (ALLOC_POLICY != BEST_FIT && ALLOC_POLICY != SEGREGATED_FIT)
+      continue;
+
+    for (DEFER_COALESCE = 0; DEFER_COALESCE <= 1; DEFER_COALESCE++) {
+      printf("\n%s placement, %s coalescing:\n", policy_name(ALLOC_POLICY),
+             DEFER_COALESCE ? "deferred" : "eager");
+      test_utilization(test_sequence, max_used_memory, allocation_factor);
+      ns_per_op = time_sequence(bench_sequence, BENCH_MAX_USED_MEMORY * 2,
+                                BENCH_REPETITIONS);
+      if (ns_per_op < 0)
+        printf("Throughput: allocation failed\n");
+      else
+        printf("Throughput: %.1f ns/op\n", ns_per_op);
+    }
+  }
+  DEFER_COALESCE = 0;
+
+  // small objects, served by myalloc() directly, then by the slabs
+  printf("\nsmall objects with MAX_USED_MEMORY=%d, ALLOCATION_FACTOR=%d and "
+         "blocks of at most %d bytes\n", SMALL_MAX_USED_MEMORY,
+         SMALL_ALLOCATION_FACTOR, SMALL_MAX_BLOCK_SIZE);
+  small_sequence = generate_sequence(SMALL_MAX_USED_MEMORY,
+    SMALL_ALLOCATION_FACTOR, SMALL_MAX_BLOCK_SIZE);
+
+  ALLOC_POLICY = SEGREGATED_FIT;
+  for (use_slabs = 0; use_slabs <= 1; use_slabs++) {
+    if (use_slabs)
+      printf("\nslabs (up to %d bytes) over %s placement:\n",
+             SLAB_THRESHOLD, policy_name(ALLOC_POLICY));
+    else
+      printf("\n%s placement:\n", policy_name(ALLOC_POLICY));
+
+    test_utilization(small_sequence, SMALL_MAX_USED_MEMORY,
+                     SMALL_ALLOCATION_FACTOR);
+    ns_per_op = time_sequence(small_sequence, SMALL_MAX_USED_MEMORY * 4,
+                              BENCH_REPETITIONS);
+    if (ns_per_op < 0)
+      printf("Throughput: allocation failed\n");
+    else
+      printf("Throughput: %.1f ns/op\n", ns_per_op);
+  }
+  use_slabs = 0;
+
+  return 1;
+}
@@ -0,0 +1,189 @@
+/*! \file
+ * Implementation of the compact binary allocation-trace format.  See trace.h
+ * for a description of the format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+
+static const unsigned char trace_magic[5] = { 'M', 'Y', 'T', 'R', 1 };
+
+
+/* Writes out everything in the buffer. */
+static void flush_buffer(trace_writer *tw) {
+    int written = 0, n;
+
+    while (written < tw->buffered) {
+        n = write(tw->fd, tw->buffer + written, tw->buffered - written);
+        if (n <= 0)
+            break;
+        written += n;
+    }
+    tw->buffered = 0;
+}
+
+
+/* Appends a byte to the buffer, flushing it first if it is full. */
+static void put_byte(trace_writer *tw, unsigned char b) {
+    if (tw->buffered == TRACE_BUFFER_SIZE)
+        flush_buffer(tw);
+    tw->buffer[tw->buffered++] = b;
+}
+
+
+/* Appends an unsigned LEB128 varint:  7 bits per byte, low bits first, with
+ * the high bit set on every byte but the last.
+ */
+static void put_varint(trace_writer *tw, uint32_t value) {
+    while (value >= 0x80) {
+        put_byte(tw, (value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    put_byte(tw, value);
+}
+
+
+int trace_open(trace_writer *tw, const char *path) {
+    int i;
+
+    tw->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (tw->fd < 0)
+        return -1;
+
+    tw->next_id = 0;
+    tw->buffered = 0;
+    for (i = 0; i < sizeof(trace_magic); i++)
+        put_byte(tw, trace_magic[i]);
+    return 0;
+}
+
+
+uint32_t trace_alloc(trace_writer *tw, uint32_t size) {
+    put_byte(tw, TRACE_ALLOC);
+    put_varint(tw, size);
+    return tw->next_id++;
+}
+
+
+void trace_free(trace_writer *tw, uint32_t id) {
+    put_byte(tw, TRACE_FREE);
+    put_varint(tw, id);
+}
+
+
+uint32_t trace_realloc(trace_writer *tw, uint32_t id, uint32_t size) {
+    put_byte(tw, TRACE_REALLOC);
+    put_varint(tw, id);
+    put_varint(tw, size);
+    return tw->next_id++;
+}
+
+
+void trace_close(trace_writer *tw) {
+    flush_buffer(tw);
+    close(tw->fd);
+    tw->fd = -1;
+}
+
+
+/* Decodes a varint starting at *pos, advancing *pos past it.  Returns -1 if
+ * the data ends in the middle of the varint, or it doesn't fit in 32 bits.
+ */
+static int get_varint(unsigned char *data, long length, long *pos,
+                      uint32_t *value) {
+    int shift = 0;
+
+    *value = 0;
+    while (*pos < length && shift < 32) {
+        *value |= (uint32_t) (data[*pos] & 0x7F) << shift;
+        if (!(data[(*pos)++] & 0x80))
+            return 0;
+        shift += 7;
+    }
+    return -1;
+}
+
+
+trace_op * trace_load(const char *path, int *num_ops, uint32_t *num_ids) {
+    FILE *f;
+    unsigned char *data;
+    long length, pos;
+    trace_op *ops;
+    int n = 0;
+    uint32_t next_id = 0;
+
+    f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = malloc(length > 0 ? length : 1);
+    if (data == NULL || fread(data, 1, length, f) != length ||
+        length < sizeof(trace_magic) ||
+        memcmp(data, trace_magic, sizeof(trace_magic)) != 0) {
+        fclose(f);
+        free(data);
+        return NULL;
+    }
+    fclose(f);
+
+    /* Every record takes at least two bytes, which bounds the op count. */
+    ops = malloc((length / 2 + 1) * sizeof(trace_op));
+    if (ops == NULL) {
+        free(data);
+        return NULL;
+    }
+
+    pos = sizeof(trace_magic);
+    while (pos < length) {
+        trace_op *op = ops + n;
+
+        op->type = data[pos++];
+        op->new_id = 0;
+        op->size = 0;
+        switch (op->type) {
+        case TRACE_ALLOC:
+            if (get_varint(data, length, &pos, &op->size) < 0)
+                goto malformed;
+            op->id = next_id++;
+            break;
+
+        case TRACE_FREE:
+            if (get_varint(data, length, &pos, &op->id) < 0 ||
+                op->id >= next_id)
+                goto malformed;
+            break;
+
+        case TRACE_REALLOC:
+            if (get_varint(data, length, &pos, &op->id) < 0 ||
+                get_varint(data, length, &pos, &op->size) < 0 ||
+                op->id >= next_id)
+                goto malformed;
+            op->new_id = next_id++;
+            break;
+
+        default:
+            goto malformed;
+        }
+        n++;
+    }
+
+    free(data);
+    *num_ops = n;
+    *num_ids = next_id;
+    return ops;
+
+malformed:
+    fprintf(stderr, "trace_load: %s is malformed at byte %ld\n", path, pos);
+    free(data);
+    free(ops);
+    return NULL;
+}
@@ -0,0 +1,76 @@
+/*! \file
+ * Declarations for a compact binary allocation-trace format, so that
+ * allocation sequences recorded from real programs (or from testalloc) can be
+ * replayed against the allocator.
+ *
+ * A trace file starts with the 4-byte magic "MYTR" and a version byte, and
+ * is followed by one record per operation.  Each record is an opcode byte
+ * followed by unsigned LEB128 varints:
+ *
+ *     TRACE_ALLOC    size          allocates block number <allocs so far>
+ *     TRACE_FREE     id            frees block "id"
+ *     TRACE_REALLOC  id size       resizes block "id"; the result is a new
+ *                                  block numbered like an allocation
+ *
+ * Blocks are numbered in the order they are created, so allocations never
+ * have to store their own ids, and most records take 2 or 3 bytes.
+ */
+
+#include <stdint.h>
+
+
+#define TRACE_ALLOC   1
+#define TRACE_FREE    2
+#define TRACE_REALLOC 3
+
+#define TRACE_BUFFER_SIZE 65536
+
+
+/* State for writing a trace.  The writer never calls malloc(), so that it can
+ * be used from inside a malloc() replacement; the caller provides the struct.
+ */
+typedef struct {
+    int fd;
+    uint32_t next_id;
+    int buffered;
+    unsigned char buffer[TRACE_BUFFER_SIZE];
+} trace_writer;
+
+
+/* A decoded trace operation. */
+typedef struct {
+    /* TRACE_ALLOC, TRACE_FREE or TRACE_REALLOC. */
+    int type;
+
+    /* The block freed or resized; for TRACE_ALLOC, the new block. */
+    uint32_t id;
+
+    /* For TRACE_REALLOC, the id of the resized block. */
+    uint32_t new_id;
+
+    /* For TRACE_ALLOC and TRACE_REALLOC, the requested size. */
+    uint32_t size;
+} trace_op;
+
+
+/* Creates (or truncates) a trace file.  Returns 0 on success, -1 on error. */
+int trace_open(trace_writer *tw, const char *path);
+
+/* Records an allocation, and returns the id of the new block. */
+uint32_t trace_alloc(trace_writer *tw, uint32_t size);
+
+/* Records that block "id" was freed. */
+void trace_free(trace_writer *tw, uint32_t id);
+
+/* Records that block "id" was resized, and returns the id of the result. */
+uint32_t trace_realloc(trace_writer *tw, uint32_t id, uint32_t size);
+
+/* Flushes buffered records and closes the trace file. */
+void trace_close(trace_writer *tw);
+
+
+/* Reads and decodes an entire trace file into a malloc'd array of operations,
+ * storing its length in *num_ops and the number of blocks the trace creates
+ * in *num_ids.  Returns NULL if the file can't be read or is malformed.
+ */
+trace_op * trace_load(const char *path, int *num_ops, uint32_t *num_ids);
@@ -0,0 +1,393 @@
+/*! \file
+ * An LD_PRELOAD shim that records the malloc()/calloc()/realloc()/free()
+ * calls of any dynamically-linked program into an allocation trace, along
+ * with those of the aligned allocators posix_memalign(), memalign() and
+ * aligned_alloc(), whose blocks are traced as plain allocations; the trace
+ * has no record of alignment.  (valloc() and pvalloc() aren't hooked, so
+ * their blocks aren't traced, and freeing one is skipped like any untracked
+ * block.)
+ *
+ *     MYALLOC_TRACE=out.trace LD_PRELOAD=./libtracehook.so some-program
+ *
+ * The calls are passed on to the C library's allocator unchanged.  Live
+ * blocks are mapped from their address to their trace id by an open-
+ * addressing hash table.  Since this code runs inside malloc(), neither it
+ * nor the trace writer may call malloc(); the table lives in mmap()'d memory.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "trace.h"
+
+
+static void * (*real_malloc)(size_t);
+static void * (*real_calloc)(size_t, size_t);
+static void * (*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void * (*real_memalign)(size_t, size_t);
+static void * (*real_aligned_alloc)(size_t, size_t);
+
+
+/* dlsym() may itself call calloc() before the real functions are known, so
+ * those early requests are served from this buffer, and never freed.  Other
+ * threads may be starting up too, so the buffer is carved up under a lock.
+ */
+static char bootstrap[8192] __attribute__((aligned(4096)));
+static size_t bootstrap_used;
+static pthread_mutex_t bootstrap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Whether a trace is being written, and the writer doing it. */
+static int tracing;
+static trace_writer writer;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Set while the current thread is inside the shim, so any allocation made
+ * on our behalf (e.g. by the C library) is passed through unrecorded.
+ */
+static __thread int in_hook;
+
+
+/* An entry in the address-to-id table; an empty slot has a null address. */
+typedef struct {
+    void *addr;
+    uint32_t id;
+} live_block;
+
+static live_block *table;
+static size_t table_capacity; // always a power of 2
+static size_t table_count;
+
+
+static size_t hash_addr(void *addr) {
+    uintptr_t a = (uintptr_t) addr;
+
+    a ^= a >> 16;
+    a *= 0x45d9f3b;
+    a ^= a >> 16;
+    return (size_t) a;
+}
+
+
+static live_block * new_table(size_t capacity) {
+    void *t = mmap(NULL, capacity * sizeof(live_block), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (t == MAP_FAILED) ? NULL : (live_block *) t;
+}
+
+
+static void table_put(void *addr, uint32_t id);
+
+
+/* Doubles the table, keeping the load factor at or below one half. */
+static int grow_table() {
+    live_block *old = table;
+    size_t old_capacity = table_capacity, i;
+
+    table_capacity = old_capacity ? 2 * old_capacity : 4096;
+    table = new_table(table_capacity);
+    if (table == NULL) {
+        table = old;
+        table_capacity = old_capacity;
+        return -1;
+    }
+
+    table_count = 0;
+    for (i = 0; i < old_capacity; i++) {
+        if (old[i].addr != NULL)
+            table_put(old[i].addr, old[i].id);
+    }
+    if (old != NULL)
+        munmap(old, old_capacity * sizeof(live_block));
+    return 0;
+}
+
+
+static void table_put(void *addr, uint32_t id) {
+    size_t i;
+
+    if (2 * (table_count + 1) > table_capacity && grow_table() < 0)
+        return;
+
+    i = hash_addr(addr) & (table_capacity - 1);
+    while (table[i].addr != NULL && table[i].addr != addr)
+        i = (i + 1) & (table_capacity - 1);
+    if (table[i].addr == NULL)
+        table_count++;
+    table[i].addr = addr;
+    table[i].id = id;
+}
+
+
+/* Removes addr from the table, storing its id in *id.  Returns 0 if addr
+ * wasn't there, e.g. because it was allocated before tracing started.
+ */
+static int table_take(void *addr, uint32_t *id) {
+    size_t i, j, home;
+
+    if (table_capacity == 0)
+        return 0;
+
+    i = hash_addr(addr) & (table_capacity - 1);
+    while (table[i].addr != addr) {
+        if (table[i].addr == NULL)
+            return 0;
+        i = (i + 1) & (table_capacity - 1);
+    }
+    *id = table[i].id;
+    table_count--;
+
+    /* Shift later entries of the probe run back, so lookups never stop
+     * early at the hole.
+     */
+    j = i;
+    for (;;) {
+        j = (j + 1) & (table_capacity - 1);
+        if (table[j].addr == NULL)
+            break;
+        home = hash_addr(table[j].addr) & (table_capacity - 1);
+        if ((j > i && (home <= i || home > j)) ||
+            (j < i && (home <= i && home > j))) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i].addr = NULL;
+    return 1;
+}
+
+
+static void resolve_real_functions() {
+    in_hook = 1;
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+    in_hook = 0;
+}
+
+
+__attribute__((constructor))
+static void start_tracing() {
+    const char *path;
+
+    if (real_malloc == NULL)
+        resolve_real_functions();
+
+    path = getenv("MYALLOC_TRACE");
+    if (path != NULL && trace_open(&writer, path) == 0)
+        tracing = 1;
+}
+
+
+__attribute__((destructor))
+static void stop_tracing() {
+    pthread_mutex_lock(&trace_lock);
+    if (tracing) {
+        tracing = 0;
+        trace_close(&writer);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+
+/* Records an allocation of "size" bytes that returned "result". */
+static void record_alloc(void *result, size_t size) {
+    if (!tracing || in_hook || result == NULL)
+        return;
+
+    in_hook = 1;
+    pthread_mutex_lock(&trace_lock);
+    if (tracing)
+        table_put(result, trace_alloc(&writer, (uint32_t) size));
+    pthread_mutex_unlock(&trace_lock);
+    in_hook = 0;
+}
+
+
+/* Carves a block of "size" bytes out of the bootstrap buffer, on a multiple
+ * of "alignment", a power of 2.  Returns NULL if the buffer is used up.
+ */
+static void * bootstrap_alloc(size_t size, size_t alignment) {
+    void *result = NULL;
+    size_t start;
+
+    if (alignment < 16)
+        alignment = 16;
+    size = (size + 15) & ~(size_t) 15;
+
+    pthread_mutex_lock(&bootstrap_lock);
+    start = (bootstrap_used + alignment - 1) & ~(alignment - 1);
+    if (start <= sizeof(bootstrap) && size <= sizeof(bootstrap) - start) {
+        result = bootstrap + start;
+        bootstrap_used = start + size;
+    }
+    pthread_mutex_unlock(&bootstrap_lock);
+    return result;
+}
+
+
+static int is_bootstrap(void *ptr) {
+    return (char *) ptr >= bootstrap && (char *) ptr < bootstrap + sizeof(bootstrap);
+}
+
+
+void * malloc(size_t size) {
+    void *result;
+
+    if (real_malloc == NULL) {
+        if (in_hook)
+            return bootstrap_alloc(size, 16);
+        resolve_real_functions();
+    }
+
+    result = real_malloc(size);
+    record_alloc(result, size);
+    return result;
+}
+
+
+void * calloc(size_t num, size_t size) {
+    void *result;
+
+    if (real_calloc == NULL) {
+        if (in_hook)
+            return bootstrap_alloc(num * size, 16); // static, so already zeroed
+        resolve_real_functions();
+    }
+
+    result = real_calloc(num, size);
+    record_alloc(result, num * size);
+    return result;
+}
+
+
+void * realloc(void *ptr, size_t size) {
+    void *result;
+    size_t old_size;
+    uint32_t id;
+
+    if (real_realloc == NULL)
+        resolve_real_functions();
+
+    if (is_bootstrap(ptr)) {
+        /* Can't resize in place; move it to the real heap.  Bootstrap blocks
+         * don't record their sizes, but none runs past what has been handed
+         * out, so copy no further than that.
+         */
+        pthread_mutex_lock(&bootstrap_lock);
+        old_size = bootstrap + bootstrap_used - (char *) ptr;
+        pthread_mutex_unlock(&bootstrap_lock);
+        result = malloc(size);
+        if (result != NULL)
+            memcpy(result, ptr, size < old_size ? size : old_size);
+        return result;
+    }
+
+    result = real_realloc(ptr, size);
+    if (!tracing || in_hook || (result == NULL && size != 0))
+        return result;
+
+    in_hook = 1;
+    pthread_mutex_lock(&trace_lock);
+    if (tracing) {
+        if (ptr == NULL) {
+            table_put(result, trace_alloc(&writer, (uint32_t) size));
+        }
+        else if (table_take(ptr, &id)) {
+            if (result == NULL)
+                trace_free(&writer, id);
+            else
+                table_put(result, trace_realloc(&writer, id, (uint32_t) size));
+        }
+        else if (result != NULL) {
+            /* An untracked block; it becomes tracked from here on. */
+            table_put(result, trace_alloc(&writer, (uint32_t) size));
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    in_hook = 0;
+
+    return result;
+}
+
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    int result;
+
+    if (real_posix_memalign == NULL) {
+        if (in_hook) {
+            *memptr = bootstrap_alloc(size, alignment);
+            return (*memptr == NULL) ? ENOMEM : 0;
+        }
+        resolve_real_functions();
+    }
+
+    result = real_posix_memalign(memptr, alignment, size);
+    if (result == 0)
+        record_alloc(*memptr, size);
+    return result;
+}
+
+
+void * memalign(size_t alignment, size_t size) {
+    void *result;
+
+    if (real_memalign == NULL) {
+        if (in_hook)
+            return bootstrap_alloc(size, alignment);
+        resolve_real_functions();
+    }
+
+    result = real_memalign(alignment, size);
+    record_alloc(result, size);
+    return result;
+}
+
+
+void * aligned_alloc(size_t alignment, size_t size) {
+    void *result;
+
+    if (real_aligned_alloc == NULL) {
+        if (in_hook)
+            return bootstrap_alloc(size, alignment);
+        resolve_real_functions();
+    }
+
+    result = real_aligned_alloc(alignment, size);
+    record_alloc(result, size);
+    return result;
+}
+
+
+void free(void *ptr) {
+    uint32_t id;
+
+    if (ptr == NULL || is_bootstrap(ptr))
+        return;
+
+    if (real_free == NULL)
+        resolve_real_functions();
+
+    if (tracing && !in_hook) {
+        in_hook = 1;
+        pthread_mutex_lock(&trace_lock);
+        if (tracing && table_take(ptr, &id))
+            trace_free(&writer, id);
+        pthread_mutex_unlock(&trace_lock);
+        in_hook = 0;
+    }
+
+    real_free(ptr);
+}
@@ -23,6 +23,13 @@
 int MEMORY_SIZE;
 unsigned char *mem;
 
+/*! The unacceptable allocator ignores the placement policy, arena mode and
+ * deferred coalescing.
+ */
+alloc_policy ALLOC_POLICY = FIRST_FIT;
+int ARENA_MODE = 0;
+int DEFER_COALESCE = 0;
+
 
 /* TODO:  The unacceptable allocator uses an external "free-pointer" to track
  *        where free memory starts.  If your allocator doesn't use this
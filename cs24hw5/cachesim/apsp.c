@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apsp.h"
+#include "profile.h"
+
+
+/* Local functions used by the shortest-path algorithms. */
+
+void clear_paths(shortest_path_info *info);
+void relax_tile(shortest_path_info *info, int i0, int i1, int j0, int j1,
+                int k0, int k1);
+void recursive_fw(shortest_path_info *info, int i0, int j0, int k0, int size,
+                  int base);
+
+void compute_shortest_paths(shortest_path_info *info, int param);
+void blocked_shortest_paths(shortest_path_info *info, int tile);
+void recursive_shortest_paths(shortest_path_info *info, int base);
+
+
+const apsp_algorithm_t apsp_algorithms[] = {
+    { "naive", "textbook Floyd-Warshall, a row at a time",
+      compute_shortest_paths },
+    { "blocked", "Floyd-Warshall in square tiles of -b nodes",
+      blocked_shortest_paths },
+    { "recursive", "cache-oblivious recursive Floyd-Warshall, down to "
+      "-b nodes", recursive_shortest_paths },
+    { NULL }
+};
+
+
+const apsp_algorithm_t * find_apsp_algorithm(const char *name) {
+    const apsp_algorithm_t *algorithm;
+
+    for (algorithm = apsp_algorithms; algorithm->name != NULL; algorithm++) {
+        if (strcmp(algorithm->name, name) == 0)
+            return algorithm;
+    }
+    return NULL;
+}
+
+
+/* Returns the bytes of memory needed for a graph of num_nodes nodes:  the
+ * weight matrix and the path-reconstruction matrix.
+ */
+uint32_t apsp_mem_size(int num_nodes) {
+    return 2 * num_nodes * num_nodes * sizeof(int);
+}
+
+
+int get_weight(shortest_path_info *info, int row, int col) {
+    return read_int(info->p_mem, row * info->num_nodes + col);
+}
+
+
+void set_weight(shortest_path_info *info, int row, int col, int weight) {
+    write_int(info->p_mem, row * info->num_nodes + col, weight);
+}
+
+
+int get_path(shortest_path_info *info, int row, int col) {
+    int nodes = info->num_nodes;
+    return read_int(info->p_mem, nodes * nodes + row * nodes + col);
+}
+
+
+void set_path(shortest_path_info *info, int row, int col, int node) {
+    int nodes = info->num_nodes;
+    write_int(info->p_mem, nodes * nodes + row * nodes + col, node);
+}
+
+
+/* Stores a random graph in the weight matrix, with pct percent of the
+ * edges present, using rand().  If "weights" isn't NULL, the weight matrix
+ * is also copied into it.
+ */
+void generate_graph(shortest_path_info *info, int pct, int *weights) {
+    int i, j, weight;
+
+    for (i = 0; i < info->num_nodes; i++) {
+        for (j = 0; j < info->num_nodes; j++) {
+            if (i != j) {
+                if (rand() % 100 < pct)
+                    weight = 1 + rand() % 10;
+                else
+                    weight = INFINITY;
+            }
+            else {
+                weight = 0;
+            }
+
+            set_weight(info, i, j, weight);
+            if (weights != NULL)
+                weights[i * info->num_nodes + j] = weight;
+        }
+    }
+}
+
+
+void host_shortest_paths(int *weights, int num_nodes) {
+    int i, j, k;
+
+    for (k = 0; k < num_nodes; k++) {
+        for (i = 0; i < num_nodes; i++) {
+            for (j = 0; j < num_nodes; j++) {
+                int weight_ikj = weights[i * num_nodes + k] +
+                                 weights[k * num_nodes + j];
+                if (weight_ikj < weights[i * num_nodes + j])
+                    weights[i * num_nodes + j] = weight_ikj;
+            }
+        }
+    }
+}
+
+
+/* Every algorithm starts by clearing the path-reconstruction state. */
+void clear_paths(shortest_path_info *info) {
+    int nodes = info->num_nodes;
+    int i, j;
+
+    if (info->verbose)
+        printf(" * Clearing the path-reconstruction state.\n");
+    set_access_site("clear path");
+    for (i = 0; i < nodes; i++)
+        for (j = 0; j < nodes; j++)
+            set_path(info, i, j, -1);
+}
+
+
+/* The textbook Floyd-Warshall:  for each intermediate node k, relax every
+ * path through it, sweeping the whole weight matrix each time.
+ */
+void compute_shortest_paths(shortest_path_info *info, int param) {
+    int nodes = info->num_nodes;
+    int k;
+
+    clear_paths(info);
+
+    if (info->verbose)
+        printf(" * Computing the all-points shortest path results.\n");
+    for (k = 0; k < nodes; k++) {
+        relax_tile(info, 0, nodes, 0, nodes, k, k + 1);
+        if (info->verbose) {
+            printf(".");
+            fflush(stdout);
+        }
+    }
+    if (info->verbose)
+        printf("\n");
+    set_access_site(NULL);
+}
+
+
+/* Relaxes the paths from nodes i0..i1-1 to nodes j0..j1-1 through the
+ * intermediate nodes k0..k1-1, in the order of the textbook algorithm.
+ */
+void relax_tile(shortest_path_info *info, int i0, int i1, int j0, int j1,
+                int k0, int k1) {
+    int i, j, k;
+
+    for (k = k0; k < k1; k++) {
+        for (i = i0; i < i1; i++) {
+            for (j = j0; j < j1; j++) {
+                int weight_ikj, weight_ij;
+
+                set_access_site("weight[i][k]");
+                weight_ikj = get_weight(info, i, k);
+                set_access_site("weight[k][j]");
+                weight_ikj += get_weight(info, k, j);
+                set_access_site("weight[i][j]");
+                weight_ij = get_weight(info, i, j);
+
+                if (weight_ikj < weight_ij) {
+                    set_access_site("update [i][j]");
+                    set_weight(info, i, j, weight_ikj);
+                    set_path(info, i, j, k);
+                }
+            }
+        }
+    }
+}
+
+
+/* Blocked Floyd-Warshall (Venkataraman, Sahni and Mukhopadhyaya):  the
+ * matrix is split into tiles, and for each band of intermediate nodes the
+ * tile on the diagonal is done first, then the other tiles of its row and
+ * column, which only depend on it, and then the rest, which only depend on
+ * those.  Each step works on at most three tiles, which fit in a cache
+ * when the tiles are small enough.
+ */
+void blocked_shortest_paths(shortest_path_info *info, int tile) {
+    int nodes = info->num_nodes;
+    int kb, k1, ib, i1, jb, j1;
+
+    clear_paths(info);
+
+    if (info->verbose) {
+        printf(" * Computing the all-points shortest path results in %dx%d "
+               "tiles.\n", tile, tile);
+    }
+    for (kb = 0; kb < nodes; kb += tile) {
+        k1 = (kb + tile < nodes) ? kb + tile : nodes;
+
+        relax_tile(info, kb, k1, kb, k1, kb, k1);
+
+        for (ib = 0; ib < nodes; ib += tile) {
+            if (ib == kb)
+                continue;
+            i1 = (ib + tile < nodes) ? ib + tile : nodes;
+            relax_tile(info, kb, k1, ib, i1, kb, k1);
+            relax_tile(info, ib, i1, kb, k1, kb, k1);
+        }
+
+        for (ib = 0; ib < nodes; ib += tile) {
+            if (ib == kb)
+                continue;
+            i1 = (ib + tile < nodes) ? ib + tile : nodes;
+            for (jb = 0; jb < nodes; jb += tile) {
+                if (jb == kb)
+                    continue;
+                j1 = (jb + tile < nodes) ? jb + tile : nodes;
+                relax_tile(info, ib, i1, jb, j1, kb, k1);
+            }
+        }
+
+        if (info->verbose) {
+            printf(".");
+            fflush(stdout);
+        }
+    }
+    if (info->verbose)
+        printf("\n");
+    set_access_site(NULL);
+}
+
+
+/* One step of the recursive Floyd-Warshall, relaxing the size x size
+ * submatrix at (i0, j0) through the intermediate nodes k0..k0+size-1.
+ * Nodes past the end of the graph are treated as unreachable, so their
+ * parts of the matrix are skipped.
+ */
+void recursive_fw(shortest_path_info *info, int i0, int j0, int k0, int size,
+                  int base) {
+    int nodes = info->num_nodes;
+    int h = size / 2;
+
+    if (i0 >= nodes || j0 >= nodes || k0 >= nodes)
+        return;
+
+    if (size <= base) {
+        relax_tile(info, i0, (i0 + size < nodes) ? i0 + size : nodes,
+                   j0, (j0 + size < nodes) ? j0 + size : nodes,
+                   k0, (k0 + size < nodes) ? k0 + size : nodes);
+        return;
+    }
+
+    /* The first half of the intermediate nodes, then the second half in
+     * the reverse order, so that each quadrant uses the newest values of
+     * the others.
+     */
+    recursive_fw(info, i0, j0, k0, h, base);
+    recursive_fw(info, i0, j0 + h, k0, h, base);
+    recursive_fw(info, i0 + h, j0, k0, h, base);
+    recursive_fw(info, i0 + h, j0 + h, k0, h, base);
+
+    recursive_fw(info, i0 + h, j0 + h, k0 + h, h, base);
+    recursive_fw(info, i0 + h, j0, k0 + h, h, base);
+    recursive_fw(info, i0, j0 + h, k0 + h, h, base);
+    recursive_fw(info, i0, j0, k0 + h, h, base);
+}
+
+
+/* Cache-oblivious Floyd-Warshall (Park, Penner and Prasanna):  the matrix
+ * is split into quadrants recursively, so that at some depth the
+ * submatrices fit in each level of the cache, whatever its size.  The graph
+ * is padded up to a power of 2 nodes.
+ */
+void recursive_shortest_paths(shortest_path_info *info, int base) {
+    int size = 1;
+
+    clear_paths(info);
+
+    while (size < info->num_nodes)
+        size *= 2;
+
+    if (info->verbose) {
+        printf(" * Computing the all-points shortest path results "
+               "recursively, down to %dx%d.\n", base, base);
+    }
+    recursive_fw(info, 0, 0, 0, size, base);
+    set_access_site(NULL);
+}
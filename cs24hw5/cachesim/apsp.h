@@ -0,0 +1,72 @@
+#ifndef __APSP_H__
+#define __APSP_H__
+
+
+#include "membase.h"
+
+
+/* This is the weight used to represent no edge between nodes. */
+#define INFINITY 1000000
+
+
+/* The state of an all-points-shortest-paths computation.  The weight
+ * matrix is stored at the start of the memory, and the path-reconstruction
+ * matrix after it, each in row-major order.
+ */
+typedef struct {
+    int num_nodes;
+
+    membase_t *p_mem;
+
+    /* Nonzero to print the progress of the computation. */
+    int verbose;
+} shortest_path_info;
+
+
+/* This struct describes an algorithm that computes the shortest paths.
+ * "param" is the tile size of a blocked algorithm, or the size of the base
+ * case of a recursive one, in nodes.
+ */
+typedef struct apsp_algorithm_t {
+    /* The name of the algorithm, as given with -a. */
+    const char *name;
+
+    const char *description;
+
+    void (*compute)(shortest_path_info *info, int param);
+} apsp_algorithm_t;
+
+
+/* The algorithms, ending with a NULL name.  The first is the textbook
+ * Floyd-Warshall.
+ */
+extern const apsp_algorithm_t apsp_algorithms[];
+
+/* The default tile or base-case size, in nodes. */
+#define DEFAULT_APSP_TILE 16
+
+
+const apsp_algorithm_t * find_apsp_algorithm(const char *name);
+
+/* Returns the bytes of memory needed for a graph of num_nodes nodes. */
+uint32_t apsp_mem_size(int num_nodes);
+
+int get_weight(shortest_path_info *info, int row, int col);
+void set_weight(shortest_path_info *info, int row, int col, int weight);
+int get_path(shortest_path_info *info, int row, int col);
+void set_path(shortest_path_info *info, int row, int col, int node);
+
+/* Stores a random graph in the weight matrix, with pct percent of the
+ * edges present, using rand().  If "weights" isn't NULL, the weight matrix
+ * is also copied into it.
+ */
+void generate_graph(shortest_path_info *info, int pct, int *weights);
+
+/* Computes the shortest paths with the textbook Floyd-Warshall algorithm
+ * directly in the host's memory, for checking the results.  "weights" holds
+ * the weight matrix on entry, and the shortest distances on exit.
+ */
+void host_shortest_paths(int *weights, int num_nodes);
+
+
+#endif /* __APSP_H__ */
@@ -1,10 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <time.h>
 
 #include "cmdline.h"
+#include "apsp.h"
 #include "memory.h"
 #include "cache.h"
+#include "profile.h"
 
 
 /* This is the number of nodes to have in the graph. */
@@ -15,119 +18,156 @@
  */
 #define CONNECTED_PCT 10
 
-/* This is the weight used to represent no edge between nodes. */
-#define INFINITY 1000000
-
-
 /* Set to time(NULL) to generate new random data each time, or a constant to
  * generate the same random data each time.
  */
 #define SEED 54321098
 
 
-typedef struct {
-    int num_nodes;
-
-    membase_t *p_mem;
-} shortest_path_info;
-
-
-int get_weight(shortest_path_info *info, int row, int col) {
-    return read_int(info->p_mem, row * info->num_nodes + col);
-}
-
-
-void set_weight(shortest_path_info *info, int row, int col, int weight) {
-    write_int(info->p_mem, row * info->num_nodes + col, weight);
-}
-
+void apsptest_usage(const char *progname) {
+    int i;
 
-int get_path(shortest_path_info *info, int row, int col) {
-    int nodes = info->num_nodes;
-    return read_int(info->p_mem, nodes * nodes + row * nodes + col);
+    printf("usage: %s [-a algorithm] [-b tile] [-n nodes] [-s stats-file]\n"
+           "\t[-M latency[:bandwidth]] [-T tlb-spec ...] [-P page-size] "
+           "[cache-spec ...]\n\n", progname);
+    printf("\t-a algorithm    the shortest-path algorithm (default %s):\n",
+           apsp_algorithms[0].name);
+    for (i = 0; apsp_algorithms[i].name != NULL; i++) {
+        printf("\t\t%-12s%s\n", apsp_algorithms[i].name,
+               apsp_algorithms[i].description);
+    }
+    printf("\t-b tile         the tile or base-case size, in nodes (default "
+           "%d)\n", DEFAULT_APSP_TILE);
+    printf("\t-n nodes        the number of nodes in the graph (default %d)\n",
+           NUM_NODES);
+    printf("\tCache specifications are described below.\n\n");
+    usage(progname);
 }
 
 
-void set_path(shortest_path_info *info, int row, int col, int node) {
-    int nodes = info->num_nodes;
-    write_int(info->p_mem, nodes * nodes + row * nodes + col, node);
-}
+int main(int argc, const char **argv) {
+    const apsp_algorithm_t *algorithm = apsp_algorithms;
+    int tile = DEFAULT_APSP_TILE, num_nodes = NUM_NODES;
+    membase_t *p_mem;
+    int *expected;
 
+    shortest_path_info info;
+    int i, j, opt, error;
+
+    while ((opt = getopt(argc, (char * const *) argv, "a:b:n:s:M:T:P:")) !=
+           -1) {
+        switch (opt) {
+        case 'a':
+            algorithm = find_apsp_algorithm(optarg);
+            if (algorithm == NULL) {
+                printf("ERROR:  unknown algorithm \"%s\".\n", optarg);
+                apsptest_usage(argv[0]);
+                return 1;
+            }
+            break;
 
-void compute_shortest_paths(shortest_path_info *info) {
-    int nodes = info->num_nodes;
-    int i, j, k;
+        case 'b':
+            tile = atoi(optarg);
+            break;
 
-    printf(" * Clearing the path-reconstruction state.\n");
-    for (i = 0; i < nodes; i++)
-        for (j = 0; j < nodes; j++)
-            set_path(info, i, j, -1);
+        case 'n':
+            num_nodes = atoi(optarg);
+            break;
 
-    printf(" * Computing the all-points shortest path results.\n");
-    for (k = 0; k < nodes; k++) {
-        for (i = 0; i < nodes; i++) {
-            for (j = 0; j < nodes; j++) {
-                int weight_ikj = get_weight(info, i, k) + get_weight(info, k, j);
-                int weight_ij = get_weight(info, i, j);
+        case 's':
+            set_stats_file(optarg);
+            break;
 
-                if (weight_ikj < weight_ij) {
-                    set_weight(info, i, j, weight_ikj);
-                    set_path(info, i, j, k);
-                }
+        case 'M':
+            if (parse_memory_timing(optarg) != 0) {
+                apsptest_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        case 'T':
+        case 'P':
+            if ((opt == 'T') ? parse_tlb_spec(optarg) != 0 :
+                               parse_page_size(optarg) != 0) {
+                apsptest_usage(argv[0]);
+                return 1;
             }
+            break;
+
+        default:
+            apsptest_usage(argv[0]);
+            return 1;
         }
-        printf(".");
-        fflush(stdout);
     }
-    printf("\n");
-}
-
-
-
-int main(int argc, const char **argv) {
-    membase_t *p_mem;
-
-    shortest_path_info info;
-    int i, j;
+    if (tile <= 0 || num_nodes <= 0) {
+        printf("ERROR:  the tile size and number of nodes must be "
+               "positive.\n");
+        apsptest_usage(argv[0]);
+        return 1;
+    }
 
-    /* Set up the simulated memory. */
-    p_mem = make_cached_memory(argc, argv,
-                               2 * NUM_NODES * NUM_NODES * sizeof(int));
+    /* Set up the simulated memory.  The remaining arguments are the cache
+     * specifications.
+     */
+    argv[optind - 1] = argv[0];
+    p_mem = make_cached_memory(argc - optind + 1, argv + optind - 1,
+                               apsp_mem_size(num_nodes));
 
     /* Generate a random graph. */
 
-    printf("Generating a random graph containing %d nodes.\n", NUM_NODES);
+    printf("Generating a random graph containing %d nodes.\n", num_nodes);
 
     srand(SEED);
 
-    info.num_nodes = NUM_NODES;
+    info.num_nodes = num_nodes;
     info.p_mem = p_mem;
+    info.verbose = 1;
 
-    for (i = 0; i < info.num_nodes; i++) {
-        for (j = 0; j < info.num_nodes; j++) {
-            if (i != j) {
-                if (rand() % 100 < CONNECTED_PCT)
-                    set_weight(&info, i, j, 1 + rand() % 10);
-                else
-                    set_weight(&info, i, j, INFINITY);
-            }
-            else {
-                set_weight(&info, i, j, 0);
+    /* Attribute the accesses to each matrix separately. */
+    add_profile_region("weight", 0, num_nodes * num_nodes * sizeof(int));
+    add_profile_region("path", num_nodes * num_nodes * sizeof(int),
+                       num_nodes * num_nodes * sizeof(int));
+
+    /* Keep a copy of the graph, to check the results against. */
+    expected = malloc(num_nodes * num_nodes * sizeof(int));
+    generate_graph(&info, CONNECTED_PCT, expected);
+
+    /* Compute the all-points shortest path of the graph. */
+
+    printf("Computing the all-points-shortest-paths of the graph with the "
+           "%s algorithm.\n", algorithm->name);
+    algorithm->compute(&info, tile);
+
+    printf("Checking the results.\n");
+    host_shortest_paths(expected, num_nodes);
+
+    set_access_site("check");
+    error = 0;
+    for (i = 0; i < num_nodes; i++) {
+        for (j = 0; j < num_nodes; j++) {
+            int weight = get_weight(&info, i, j);
+            if (weight != expected[i * num_nodes + j]) {
+                printf("ERROR:  shortest path from %d to %d is %d, expected "
+                       "%d\n", i, j, weight, expected[i * num_nodes + j]);
+                error = 1;
             }
         }
     }
+    set_access_site(NULL);
 
-    /* Compute the all-points shortest path of the graph. */
-
-    printf("Computing the all-points-shortest-paths of the graph.\n");
-    compute_shortest_paths(&info);
+    if (error) {
+        printf("Some paths were wrong, aborting.\n");
+        abort();
+    }
 
     /* Print out the results of the all-points-shortest-paths computation. */
 
     printf("\nMemory-Access Statistics:\n\n");
     p_mem->print_stats(p_mem);
     printf("\n");
+    print_timing_summary(p_mem);
+    printf("\n");
+    write_stats_file(p_mem);
 
     return 0;
 }
-
@@ -3,60 +3,106 @@
 #include <string.h>
 #include <assert.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "cache.h"
+#include "replace.h"
+#include "prefetch.h"
+#include "coherence.h"
+#include "profile.h"
 
 
 /* Set this to a nonzero value and rebuild to see debug output. */
 #define DEBUG_CACHE 0
 
 
-/* Set this to 0 to activate your custom replacement policy, which is
- * hopefully smarter and better than a random replacement policy!
- */
-#define RANDOM_REPLACEMENT_POLICY 0
-
-
 /* Local functions used by the cache implementation, roughly in order of
  * usage.
  */
 
 unsigned char cache_read_byte(membase_t *mb, addr_t address);
 void cache_write_byte(membase_t *mb, addr_t address, unsigned char value);
+uint32_t cache_read_word(membase_t *mb, addr_t address);
+void cache_write_word(membase_t *mb, addr_t address, uint32_t value);
+void cache_read_block(membase_t *mb, addr_t address, unsigned char *dest,
+                      uint32_t size);
+void cache_write_block(membase_t *mb, addr_t address,
+                       const unsigned char *src, uint32_t size);
 void cache_free(membase_t *mb);
 
 void cache_print_stats(membase_t *mb);
 void cache_reset_stats(membase_t *mb);
 
-cacheline_t *resolve_cache_access(cache_t *p_cache, addr_t address);
+cacheline_t *resolve_cache_access(cache_t *p_cache, addr_t address,
+                                  uint32_t size, int write);
+void read_cache_chunk(cache_t *p_cache, addr_t address, unsigned char *dest,
+                      uint32_t size);
+void write_cache_chunk(cache_t *p_cache, addr_t address,
+                       const unsigned char *src, uint32_t size);
+void send_write(cache_t *p_cache, addr_t address, const unsigned char *src,
+                uint32_t size);
+
+wcentry_t * find_wc_entry(cache_t *p_cache, addr_t block_start);
+void combine_write(cache_t *p_cache, addr_t address, const unsigned char *src,
+                   uint32_t size);
+void drain_wc_entry(cache_t *p_cache, wcentry_t *p_entry);
+void drain_wc_buffer(cache_t *p_cache);
 
 void decompose_address(cache_t *p_cache, addr_t address,
     addr_t *tag, addr_t *set, addr_t *offset);
 
 addr_t get_block_start_from_address(cache_t *p_cache, addr_t address);
 addr_t get_offset_in_block(cache_t *p_cache, addr_t address);
-addr_t get_block_start_from_line_info(cache_t *p_cache,
-                                      addr_t tag, addr_t set_no);
-
 cacheline_t * find_line_in_set(cacheset_t *p_set, addr_t tag);
 
-cacheline_t * choose_victim(cacheset_t *p_set);
+cacheline_t * choose_victim(cache_t *p_cache, cacheset_t *p_set);
 cacheline_t * evict_cache_line(cache_t *p_cache, cacheset_t *p_set);
+void displace_cache_line(cache_t *p_cache, cacheset_t *p_set,
+                         cacheline_t *victim);
+void invalidate_cache_line(cache_t *p_cache, cacheset_t *p_set,
+                           cacheline_t *victim);
+void clear_cache_line(cacheset_t *p_set, cacheline_t *victim);
+void fill_cache_line(cacheset_t *p_set, cacheline_t *p_line, addr_t tag);
+
+victim_entry_t * find_victim_entry(cache_t *p_cache, addr_t block_start);
+void save_victim(cache_t *p_cache, addr_t block_start,
+                 const unsigned char *data, int dirty);
+void retire_block(cache_t *p_cache, addr_t block_start, unsigned char *data,
+                  int dirty, int replaced);
+void purge_block(cache_t *p_cache, cache_t *p_upper, addr_t block_start,
+                 unsigned char *data, int *p_dirty);
+void insert_block(cache_t *p_cache, addr_t block_start,
+                  const unsigned char *data, int dirty);
+uint32_t pollution_slot(cache_t *p_cache, addr_t block);
+uint64_t * claim_mshr(cache_t *p_cache);
 
 void load_cache_line(cache_t *p_cache, cacheline_t *p_line, addr_t address,
                      addr_t tag);
 void write_back_cache_line(cache_t *p_cache, cacheline_t *p_line, 
                            addr_t set_no);
+void write_back_block(cache_t *p_cache, addr_t start_addr,
+                      const unsigned char *data);
 
 
 /* Initializes the members of the cache_t struct to be a cache with the
  * specified block size, number of cache-sets, and the number of cache lines
  * per set.  This requires a number of heap allocations, so the allocated
  * memory must be released when cleaning up the cache.
+ *
+ * The lines, tags, ages and blocks of all the sets are each allocated as one
+ * slab, set after set, so that neighboring sets and lines are adjacent in
+ * the host's memory too; the slabs start at set 0.
  */
 void init_cache(cache_t *p_cache, uint32_t block_size, uint32_t num_sets,
                 uint32_t lines_per_set, membase_t *next_mem) {
     addr_t set_no;
     unsigned int line_no;
+    cacheline_t *lines;
+    uint32_t *tags;
+    uint64_t *ages;
+    unsigned char *blocks;
 
     assert(p_cache != NULL);
     assert(next_mem != NULL);
@@ -72,10 +118,22 @@ void init_cache(cache_t *p_cache, uint32_t block_size, uint32_t num_sets,
     /* Set up the functions this cache exposes. */
     p_cache->read_byte = cache_read_byte;
     p_cache->write_byte = cache_write_byte;
+    p_cache->read_word = cache_read_word;
+    p_cache->write_word = cache_write_word;
+    p_cache->read_block = cache_read_block;
+    p_cache->write_block = cache_write_block;
     p_cache->print_stats = cache_print_stats;
     p_cache->reset_stats = cache_reset_stats;
     p_cache->free = cache_free;
 
+    /* Caches use LRU replacement unless set_replacement_policy() is used,
+     * and are write-back and write-allocate unless set_write_policy() is.
+     */
+    p_cache->policy = replacement_policies[0];
+    p_cache->write_allocate = 1;
+    p_cache->profile = alloc_cache_profile();
+    set_cache_timing(p_cache, DEFAULT_HIT_LATENCY, DEFAULT_MSHRS);
+
     /* These are various parameters for the cache. */
     
     p_cache->block_size = block_size;
@@ -88,6 +146,11 @@ void init_cache(cache_t *p_cache, uint32_t block_size, uint32_t num_sets,
     /* The remaining code initializes each cache set and the lines in
      * each set.
      */
+
+    lines = calloc(num_sets * lines_per_set, sizeof(cacheline_t));
+    tags = malloc(num_sets * lines_per_set * sizeof(uint32_t));
+    ages = calloc(num_sets * lines_per_set, sizeof(uint64_t));
+    blocks = malloc(num_sets * lines_per_set * block_size);
     
     for (set_no = 0; set_no < num_sets; set_no++) {
         /* Get a pointer to the specific cache set to initialize. */
@@ -95,14 +158,19 @@ void init_cache(cache_t *p_cache, uint32_t block_size, uint32_t num_sets,
 
         p_set->set_no = set_no;
         p_set->num_lines = lines_per_set;
-        p_set->cache_lines = malloc(lines_per_set * sizeof(cacheline_t));
+        p_set->num_valid = 0;
+        p_set->cache_lines = lines + set_no * lines_per_set;
+        p_set->tags = tags + set_no * lines_per_set;
+        p_set->ages = ages + set_no * lines_per_set;
+        p_set->policy_state = NULL;
 
         for (line_no = 0; line_no < lines_per_set; line_no++) {
             cacheline_t *p_line = p_set->cache_lines + line_no;
-            bzero(p_line, sizeof(cacheline_t));
 
             p_line->line_no = line_no;
-            p_line->block = malloc(block_size);
+            p_line->block = blocks + (set_no * lines_per_set + line_no) *
+                                     block_size;
+            p_set->tags[line_no] = INVALID_TAG;
         }
     }
 }
@@ -110,44 +178,118 @@ void init_cache(cache_t *p_cache, uint32_t block_size, uint32_t num_sets,
 
 /* This function implements reading bytes of memory through the cache. */
 unsigned char cache_read_byte(membase_t *mb, addr_t address) {
-    cache_t *p_cache = (cache_t *) mb;
-    cacheline_t *p_line;
-    addr_t block_offset;
+    unsigned char value;
     
 #if DEBUG_CACHE
     printf("Resolving cache read to address %u\n", address);
 #endif
     
-    p_line = resolve_cache_access(p_cache, address);
-    block_offset = get_offset_in_block(p_cache, address);
-    
-#if DEBUG_CACHE
-    printf(" * Block offset within cache line:  %u\n", block_offset);
-#endif
-    
     /* Return the byte read by the requester. */
-    p_cache->num_reads++;
-
-    // Update most recent access time
-    p_line->last_time = clock_tick();
-
-    return p_line->block[block_offset];
+    read_cache_chunk((cache_t *) mb, address, &value, 1);
+    return value;
 }
 
 
 /* This function implements writing bytes of memory through the cache. */
 void cache_write_byte(membase_t *mb, addr_t address, unsigned char value) {
+    /* Write the byte specified by the requester. */
+    write_cache_chunk((cache_t *) mb, address, &value, 1);
+}
+
+
+/* This function implements reading 4-byte words through the cache.  A word
+ * within a single cache line is one access, with one lookup; a word that
+ * straddles two lines is read as two accesses.
+ */
+uint32_t cache_read_word(membase_t *mb, addr_t address) {
     cache_t *p_cache = (cache_t *) mb;
-    cacheline_t *p_line = resolve_cache_access(p_cache, address);
     addr_t block_offset = get_offset_in_block(p_cache, address);
-    
-    /* Write the byte specified by the requester. */
-    p_cache->num_writes++;
-    p_line->block[block_offset] = value;
-    p_line->dirty = 1;
+    unsigned char bytes[4];
+
+    if (block_offset + 4 > p_cache->block_size)
+        cache_read_block(mb, address, bytes, 4);
+    else
+        read_cache_chunk(p_cache, address, bytes, 4);
+    return get_le_word(bytes);
+}
+
+
+/* This function implements writing 4-byte words through the cache.  As with
+ * reads, a word that straddles two lines is written as two accesses.
+ */
+void cache_write_word(membase_t *mb, addr_t address, uint32_t value) {
+    cache_t *p_cache = (cache_t *) mb;
+    addr_t block_offset = get_offset_in_block(p_cache, address);
+    unsigned char bytes[4];
 
-    // Update most recent access time
-    p_line->last_time = clock_tick();
+    put_le_word(bytes, value);
+    if (block_offset + 4 > p_cache->block_size)
+        cache_write_block(mb, address, bytes, 4);
+    else
+        write_cache_chunk(p_cache, address, bytes, 4);
+}
+
+
+/* This function implements reading a range of bytes through the cache.  The
+ * range is split at cache-line boundaries, and each piece counts as one
+ * access.
+ */
+void cache_read_block(membase_t *mb, addr_t address, unsigned char *dest,
+                      uint32_t size) {
+    cache_t *p_cache = (cache_t *) mb;
+    addr_t block_offset;
+    uint32_t chunk;
+    uint64_t start = p_cache->time, done = start;
+
+    while (size > 0) {
+        block_offset = get_offset_in_block(p_cache, address);
+        chunk = p_cache->block_size - block_offset;
+        if (chunk > size)
+            chunk = size;
+
+        /* The pieces are looked up together, and the read completes when
+         * the last of them does.
+         */
+        p_cache->time = start;
+        read_cache_chunk(p_cache, address, dest, chunk);
+        if (p_cache->time > done)
+            done = p_cache->time;
+
+        address += chunk;
+        dest += chunk;
+        size -= chunk;
+    }
+    p_cache->time = done;
+}
+
+
+/* This function implements writing a range of bytes through the cache.  The
+ * range is split at cache-line boundaries, and each piece counts as one
+ * access.
+ */
+void cache_write_block(membase_t *mb, addr_t address,
+                       const unsigned char *src, uint32_t size) {
+    cache_t *p_cache = (cache_t *) mb;
+    addr_t block_offset;
+    uint32_t chunk;
+    uint64_t start = p_cache->time, done = start;
+
+    while (size > 0) {
+        block_offset = get_offset_in_block(p_cache, address);
+        chunk = p_cache->block_size - block_offset;
+        if (chunk > size)
+            chunk = size;
+
+        p_cache->time = start;
+        write_cache_chunk(p_cache, address, src, chunk);
+        if (p_cache->time > done)
+            done = p_cache->time;
+
+        address += chunk;
+        src += chunk;
+        size -= chunk;
+    }
+    p_cache->time = done;
 }
 
 
@@ -156,7 +298,17 @@ void cache_write_byte(membase_t *mb, addr_t address, unsigned char value) {
  */
 void cache_print_stats(membase_t *mb) {
     cache_t *p_cache = (cache_t *) mb;
-    
+
+    print_cache_stats(p_cache);
+    p_cache->next_memory->print_stats(p_cache->next_memory);
+}
+
+
+/* This function prints the statistics for the cache itself, without the
+ * next level of the memory, e.g. for caches that share a next level.
+ */
+void print_cache_stats(cache_t *p_cache) {
+    uint64_t lookups = p_cache->num_hits + p_cache->num_misses;
     double miss_rate = (double) p_cache->num_misses;
     miss_rate /= (double) (p_cache->num_hits + p_cache->num_misses);
     miss_rate *= 100;
@@ -164,10 +316,67 @@ void cache_print_stats(membase_t *mb) {
     printf(" * Cache reads=%lld writes=%lld hits=%lld misses=%lld "
            "\n", p_cache->num_reads, p_cache->num_writes,
            p_cache->num_hits, p_cache->num_misses);
-    printf("   miss-rate=%.2f%% %s replacement policy\n", miss_rate,
-           (RANDOM_REPLACEMENT_POLICY ? "random" : "LRU"));
-    
-    p_cache->next_memory->print_stats(p_cache->next_memory);
+    printf("   miss-rate=%.2f%% %s replacement policy", miss_rate,
+           p_cache->policy->name);
+    if (p_cache->inclusion != INCLUSION_NINE) {
+        printf(", %s", (p_cache->inclusion == INCLUSION_INCLUSIVE) ?
+               "inclusive" : "exclusive");
+    }
+    printf("\n");
+
+    printf("   %s, %s", p_cache->write_through ? "write-through" : "write-back",
+           p_cache->write_allocate ? "write-allocate" : "no-write-allocate");
+    if (p_cache->wc_entries > 0)
+        printf(", %u-entry write-combining buffer", p_cache->wc_entries);
+    printf(":  next-level read-bytes=%lld write-bytes=%lld\n",
+           p_cache->next_read_bytes, p_cache->next_write_bytes);
+
+    if (p_cache->prefetcher != NULL) {
+        /* Accuracy is the fraction of prefetches that were used, and
+         * coverage the fraction of would-be misses that prefetches avoided.
+         */
+        uint64_t useful = p_cache->num_useful_prefetches;
+        double accuracy = 0, coverage = 0;
+
+        if (p_cache->num_prefetches > 0)
+            accuracy = 100.0 * useful / p_cache->num_prefetches;
+        if (useful + p_cache->num_misses > 0)
+            coverage = 100.0 * useful / (useful + p_cache->num_misses);
+
+        printf("   %s prefetcher, degree %u:  prefetches=%lld useful=%lld "
+               "pollution-misses=%lld\n", p_cache->prefetcher->name,
+               p_cache->prefetch_degree, p_cache->num_prefetches, useful,
+               p_cache->num_pollution_misses);
+        printf("   accuracy=%.2f%% coverage=%.2f%%\n", accuracy, coverage);
+    }
+
+    if (p_cache->vc_entries > 0) {
+        printf("   %u-entry victim cache:  hits=%lld (%.2f%% of misses)\n",
+               p_cache->vc_entries, p_cache->num_victim_hits,
+               (p_cache->num_misses > 0) ?
+               100.0 * p_cache->num_victim_hits / p_cache->num_misses : 0.0);
+    }
+    if (p_cache->inclusion == INCLUSION_INCLUSIVE) {
+        printf("   back-invalidations=%lld\n",
+               p_cache->num_back_invalidations);
+    }
+
+    /* The average access time counts from the start of each lookup to
+     * when its data is available.
+     */
+    printf("   hit-latency=%u cycles, ", p_cache->hit_latency);
+    if (p_cache->num_mshrs > 0)
+        printf("%u MSHRs", p_cache->num_mshrs);
+    else
+        printf("unlimited MSHRs");
+    printf(":  average-access-time=%.2f cycles\n",
+           (lookups > 0) ? (double) p_cache->total_latency / lookups : 0.0);
+    if (p_cache->num_mshrs > 0) {
+        printf("   mshr-stalls=%lld (%lld cycles)\n", p_cache->num_mshr_stalls,
+               p_cache->mshr_stall_cycles);
+    }
+
+    print_profile_stats(p_cache);
 }
 
 
@@ -181,27 +390,76 @@ void cache_reset_stats(membase_t *mb) {
     p_cache->num_writes = 0;
     p_cache->num_hits = 0;
     p_cache->num_misses = 0;
+    p_cache->num_prefetches = 0;
+    p_cache->num_useful_prefetches = 0;
+    p_cache->num_pollution_misses = 0;
+    p_cache->next_read_bytes = 0;
+    p_cache->next_write_bytes = 0;
+    p_cache->total_latency = 0;
+    p_cache->num_mshr_stalls = 0;
+    p_cache->mshr_stall_cycles = 0;
+    p_cache->num_victim_hits = 0;
+    p_cache->num_back_invalidations = 0;
+    reset_profile_counts(p_cache->profile);
     
     p_cache->next_memory->reset_stats(p_cache->next_memory);
 }
 
 
+/* This method adds another cache's statistics to this cache's, e.g. to
+ * total up copies of a cache that each simulated part of a trace.  The next
+ * levels of the memory are left alone.
+ */
+void add_cache_stats(cache_t *p_cache, const cache_t *p_other) {
+    p_cache->num_reads += p_other->num_reads;
+    p_cache->num_writes += p_other->num_writes;
+    p_cache->num_hits += p_other->num_hits;
+    p_cache->num_misses += p_other->num_misses;
+    p_cache->num_prefetches += p_other->num_prefetches;
+    p_cache->num_useful_prefetches += p_other->num_useful_prefetches;
+    p_cache->num_pollution_misses += p_other->num_pollution_misses;
+    p_cache->next_read_bytes += p_other->next_read_bytes;
+    p_cache->next_write_bytes += p_other->next_write_bytes;
+    p_cache->total_latency += p_other->total_latency;
+    p_cache->num_mshr_stalls += p_other->num_mshr_stalls;
+    p_cache->mshr_stall_cycles += p_other->mshr_stall_cycles;
+    p_cache->num_victim_hits += p_other->num_victim_hits;
+    p_cache->num_back_invalidations += p_other->num_back_invalidations;
+    add_profile_counts(p_cache->profile, p_other->profile);
+}
+
+
 /* This method frees all heap-allocated memory used by the simulated cache.
  * The method does *not* pass the call on to the next level of the memory.
  */
 void cache_free(membase_t *mb) {
     cache_t *p_cache = (cache_t *) mb;
-    int i_set, i_line;
+    int i_set;
     
-    for (i_set = 0; i_set < p_cache->num_sets; i_set++) {
-        cacheset_t *p_set = p_cache->cache_sets + i_set;
-        for (i_line = 0; i_line < p_set->num_lines; i_line++) {
-            cacheline_t *p_line = p_set->cache_lines + i_line;
-            free(p_line->block);
-        }
-        free(p_set->cache_lines);
-    }
+    for (i_set = 0; i_set < p_cache->num_sets; i_set++)
+        free(p_cache->cache_sets[i_set].policy_state);
+
+    /* The slabs of lines, tags, ages and blocks start at set 0. */
+    free(p_cache->cache_sets[0].cache_lines[0].block);
+    free(p_cache->cache_sets[0].cache_lines);
+    free(p_cache->cache_sets[0].tags);
+    free(p_cache->cache_sets[0].ages);
     free(p_cache->cache_sets);
+    free(p_cache->prefetch_state);
+    free(p_cache->pollution_filter);
+
+    for (i_set = 0; i_set < p_cache->wc_entries; i_set++) {
+        free(p_cache->wc_buffer[i_set].data);
+        free(p_cache->wc_buffer[i_set].written);
+    }
+    free(p_cache->wc_buffer);
+    free_cache_profile(p_cache->profile);
+    free(p_cache->mshrs);
+
+    for (i_set = 0; i_set < p_cache->vc_entries; i_set++)
+        free(p_cache->victim_cache[i_set].data);
+    free(p_cache->victim_cache);
+    free(p_cache->vc_scratch);
 }
 
 
@@ -219,15 +477,396 @@ int flush_cache(cache_t *p_cache) {
             cacheline_t *p_line = p_set->cache_lines + i_line;
             if (p_line->valid && p_line->dirty) {
                 write_back_cache_line(p_cache, p_line, i_set);
+                p_line->dirty = 0;
                 flushed++;
             }
         }
     }
+
+    for (i_line = 0; i_line < p_cache->vc_entries; i_line++) {
+        victim_entry_t *p_entry = p_cache->victim_cache + i_line;
+        if (p_entry->valid && p_entry->dirty) {
+            write_back_block(p_cache, p_entry->block_start, p_entry->data);
+            p_entry->dirty = 0;
+            flushed++;
+        }
+    }
+
+    drain_wc_buffer(p_cache);
     
     return flushed;
 }
 
 
+/* Initializes a cache with the same geometry, replacement policy, write
+ * policy, prefetcher, miss classification, timing, victim cache, inclusion
+ * policy and tag-only mode as another cache, but empty and in front of the
+ * memory next_mem.  The caches in front of it must be added with
+ * add_upper_cache().
+ */
+void init_cache_like(cache_t *p_cache, const cache_t *p_model,
+                     membase_t *next_mem) {
+    init_cache(p_cache, p_model->block_size, p_model->num_sets,
+               p_model->cache_sets[0].num_lines, next_mem);
+
+    set_replacement_policy(p_cache, p_model->policy);
+    set_write_policy(p_cache, p_model->write_through,
+                     p_model->write_allocate, p_model->wc_entries);
+    if (p_model->prefetcher != NULL) {
+        set_prefetcher(p_cache, p_model->prefetcher, p_model->prefetch_degree,
+                       p_model->prefetch_limit);
+    }
+    if (p_model->profile->classify)
+        set_miss_classification(p_cache, 1);
+    set_cache_timing(p_cache, p_model->hit_latency, p_model->num_mshrs);
+    set_victim_cache(p_cache, p_model->vc_entries);
+    set_inclusion_policy(p_cache, p_model->inclusion);
+    if (p_model->tag_only)
+        set_tag_only(p_cache);
+}
+
+
+/* This method changes the cache's replacement policy, resetting any state
+ * kept by the old policy.  It returns 0 on success, or -1 if the policy
+ * can't be used with this cache, in which case the old policy is kept.
+ */
+int set_replacement_policy(cache_t *p_cache, const replpolicy_t *policy) {
+    addr_t i_set, i_line;
+
+    assert(policy != NULL);
+
+    if (policy->needs_power_of_2_lines &&
+        !is_power_of_2(p_cache->cache_sets[0].num_lines))
+        return -1;
+
+    if (policy->needs_oracle && !have_next_use_oracle())
+        return -1;
+
+    p_cache->policy = policy;
+    for (i_set = 0; i_set < p_cache->num_sets; i_set++) {
+        cacheset_t *p_set = p_cache->cache_sets + i_set;
+
+        free(p_set->policy_state);
+        p_set->policy_state = NULL;
+        if (policy->init_set != NULL)
+            policy->init_set(p_cache, p_set);
+
+        for (i_line = 0; i_line < p_set->num_lines; i_line++)
+            p_set->cache_lines[i_line].repl_state = 0;
+    }
+
+    return 0;
+}
+
+
+/* This method gives the cache a prefetcher, or takes it away if prefetcher
+ * is NULL.  "degree" is the number of blocks to prefetch ahead, and "limit"
+ * is the size of the memory, which prefetches must not go past.
+ */
+void set_prefetcher(cache_t *p_cache, const prefetcher_t *prefetcher,
+                    uint32_t degree, addr_t limit) {
+    uint32_t lines = p_cache->num_sets * p_cache->cache_sets[0].num_lines;
+
+    free(p_cache->prefetch_state);
+    free(p_cache->pollution_filter);
+    p_cache->prefetch_state = NULL;
+    p_cache->pollution_filter = NULL;
+
+    p_cache->prefetcher = prefetcher;
+    p_cache->prefetch_degree = degree;
+    p_cache->prefetch_limit = limit;
+    if (prefetcher == NULL)
+        return;
+
+    /* Remember about as many evicted blocks as the cache holds. */
+    p_cache->pollution_filter_size = 1;
+    while (p_cache->pollution_filter_size < lines)
+        p_cache->pollution_filter_size *= 2;
+    p_cache->pollution_filter =
+        calloc(p_cache->pollution_filter_size, sizeof(addr_t));
+
+    if (prefetcher->init != NULL)
+        prefetcher->init(p_cache);
+}
+
+
+/* This method loads the block starting at the specified address into the
+ * cache ahead of demand, unless it is already there or past the end of the
+ * memory.  The line p_keep, which the current demand access is using, is
+ * never evicted; if it would be the victim, the prefetch is dropped.
+ */
+void issue_prefetch(cache_t *p_cache, addr_t address, cacheline_t *p_keep) {
+    addr_t tag, set_no, block_offset;
+    cacheset_t *p_set;
+    cacheline_t *victim;
+    addr_t victim_block;
+    mesi_state state = MESI_INVALID;
+    uint64_t start = p_cache->time, *p_mshr;
+
+    if (address >= p_cache->prefetch_limit ||
+        p_cache->prefetch_limit - address < p_cache->block_size)
+        return;
+
+    decompose_address(p_cache, address, &tag, &set_no, &block_offset);
+    p_set = p_cache->cache_sets + set_no;
+    if (find_line_in_set(p_set, tag) != NULL)
+        return;
+    if (p_cache->vc_entries > 0 &&
+        find_victim_entry(p_cache, address - block_offset) != NULL)
+        return;
+
+    victim = choose_victim(p_cache, p_set);
+    if (victim == p_keep)
+        return;
+
+    if (victim->valid) {
+        /* Remember the evicted block, to see if it is missed later. */
+        victim_block = get_block_start_from_line_info(p_cache, victim->tag,
+                           set_no) >> p_cache->block_offset_bits;
+        p_cache->pollution_filter[pollution_slot(p_cache, victim_block)] =
+            victim_block + 1;
+    }
+
+    /* The prefetch waits for an MSHR rather than being dropped, so that
+     * timing doesn't change which blocks are prefetched.  It is issued in
+     * the background:  only the line's ready time shows when it completes.
+     */
+    p_mshr = claim_mshr(p_cache);
+
+    if (p_cache->bus != NULL)
+        state = coherent_miss(p_cache, address, 0, 0, 1);
+
+    displace_cache_line(p_cache, p_set, victim);
+    victim->coherence_state = state;
+    load_cache_line(p_cache, victim, address, tag);
+    victim->prefetched = 1;
+    p_cache->policy->insert(p_cache, p_set, victim);
+    p_cache->num_prefetches++;
+
+    if (p_mshr != NULL)
+        *p_mshr = victim->ready_time;
+    p_cache->time = start;
+}
+
+
+/* This method sets how the cache handles writes:  write-through or
+ * write-back, write-allocate or not, and the number of entries in its
+ * write-combining buffer (0 for none).  Any dirty lines and combined writes
+ * are flushed to the next level first.
+ */
+void set_write_policy(cache_t *p_cache, int write_through, int write_allocate,
+                      uint32_t wc_entries) {
+    uint32_t i;
+
+    flush_cache(p_cache);
+    for (i = 0; i < p_cache->wc_entries; i++) {
+        free(p_cache->wc_buffer[i].data);
+        free(p_cache->wc_buffer[i].written);
+    }
+    free(p_cache->wc_buffer);
+
+    p_cache->write_through = write_through;
+    p_cache->write_allocate = write_allocate;
+    p_cache->wc_entries = wc_entries;
+    p_cache->wc_buffer = NULL;
+    p_cache->wc_next = 0;
+    if (wc_entries == 0)
+        return;
+
+    p_cache->wc_buffer = calloc(wc_entries, sizeof(wcentry_t));
+    for (i = 0; i < wc_entries; i++) {
+        p_cache->wc_buffer[i].data = malloc(p_cache->block_size);
+        p_cache->wc_buffer[i].written = malloc(p_cache->block_size);
+    }
+}
+
+
+/* This method sets the cycles a lookup in the cache takes, and the number of
+ * MSHRs, which bound the misses outstanding at once (0 for no bound).
+ */
+void set_cache_timing(cache_t *p_cache, uint32_t hit_latency,
+                      uint32_t num_mshrs) {
+    free(p_cache->mshrs);
+
+    p_cache->hit_latency = hit_latency;
+    p_cache->num_mshrs = num_mshrs;
+    p_cache->mshrs = NULL;
+    if (num_mshrs > 0)
+        p_cache->mshrs = calloc(num_mshrs, sizeof(uint64_t));
+}
+
+
+/* This method gives the cache a victim cache with the specified number of
+ * entries, or takes it away if entries is 0.  Blocks in the old victim
+ * cache leave the cache first.
+ */
+void set_victim_cache(cache_t *p_cache, uint32_t entries) {
+    victim_entry_t *p_entry;
+    uint32_t i;
+
+    for (i = 0; i < p_cache->vc_entries; i++) {
+        p_entry = p_cache->victim_cache + i;
+        if (p_entry->valid) {
+            retire_block(p_cache, p_entry->block_start, p_entry->data,
+                         p_entry->dirty, 1);
+        }
+        free(p_entry->data);
+    }
+    free(p_cache->victim_cache);
+    free(p_cache->vc_scratch);
+
+    p_cache->vc_entries = entries;
+    p_cache->victim_cache = NULL;
+    p_cache->vc_scratch = NULL;
+    if (entries == 0)
+        return;
+
+    p_cache->victim_cache = calloc(entries, sizeof(victim_entry_t));
+    for (i = 0; i < entries; i++)
+        p_cache->victim_cache[i].data = malloc(p_cache->block_size);
+    p_cache->vc_scratch = malloc(p_cache->block_size);
+}
+
+
+/* This method sets how the cache relates to the caches in front of it,
+ * which must have the same block size if the cache is inclusive or
+ * exclusive.  It must be set before the cache is used.
+ */
+void set_inclusion_policy(cache_t *p_cache, inclusion_policy inclusion) {
+    p_cache->inclusion = inclusion;
+}
+
+
+/* This method makes the cache keep only the tags of its blocks, for when
+ * the values of the data don't matter, e.g. when simulating a trace:  all
+ * of its lines share one block of storage, so a large cache takes little of
+ * the host's memory.  Blocks still move between the levels as before, so
+ * the accesses and their timing are the same, but the values read through
+ * the cache are garbage.  It must be set before the cache is used.
+ */
+void set_tag_only(cache_t *p_cache) {
+    unsigned char *block;
+    addr_t i_set, i_line;
+
+    if (p_cache->tag_only)
+        return;
+
+    /* The slab of blocks starts at set 0, and is replaced by one block. */
+    free(p_cache->cache_sets[0].cache_lines[0].block);
+    block = malloc(p_cache->block_size);
+
+    for (i_set = 0; i_set < p_cache->num_sets; i_set++) {
+        cacheset_t *p_set = p_cache->cache_sets + i_set;
+
+        for (i_line = 0; i_line < p_set->num_lines; i_line++)
+            p_set->cache_lines[i_line].block = block;
+    }
+
+    p_cache->tag_only = 1;
+}
+
+
+/* This method records that p_upper is in front of p_cache, i.e. that
+ * p_cache is p_upper's next level, so that an inclusive or exclusive cache
+ * can find the blocks held above it.  Returns 0 on success, or -1 if
+ * p_cache is inclusive or exclusive and the block sizes differ.
+ */
+int add_upper_cache(cache_t *p_cache, cache_t *p_upper) {
+    if (p_cache->inclusion != INCLUSION_NINE &&
+        p_upper->block_size != p_cache->block_size)
+        return -1;
+
+    p_upper->next_peer = p_cache->first_upper;
+    p_upper->lower_cache = p_cache;
+    p_cache->first_upper = p_upper;
+    return 0;
+}
+
+
+/* This method returns the line holding the block that contains the
+ * specified address, or NULL if the cache doesn't hold it.  It isn't an
+ * access, so no statistics are updated.
+ */
+cacheline_t * find_cache_line(cache_t *p_cache, addr_t address) {
+    addr_t tag, set_no, block_offset;
+
+    decompose_address(p_cache, address, &tag, &set_no, &block_offset);
+    return find_line_in_set(p_cache->cache_sets + set_no, tag);
+}
+
+
+/* This method makes sure the next level of the memory has the cache's
+ * latest data for the block that contains the specified address:  combined
+ * writes to the block are drained, and its line is written back if dirty.
+ * It returns nonzero if anything was written.
+ */
+int clean_cache_block(cache_t *p_cache, addr_t address) {
+    addr_t tag, set_no, block_offset;
+    cacheline_t *p_line;
+    wcentry_t *p_entry;
+    victim_entry_t *p_victim;
+    int cleaned = 0;
+
+    if (p_cache->wc_entries > 0) {
+        p_entry = find_wc_entry(p_cache,
+                                get_block_start_from_address(p_cache, address));
+        if (p_entry != NULL) {
+            drain_wc_entry(p_cache, p_entry);
+            cleaned = 1;
+        }
+    }
+
+    decompose_address(p_cache, address, &tag, &set_no, &block_offset);
+    p_line = find_line_in_set(p_cache->cache_sets + set_no, tag);
+    if (p_line != NULL && p_line->dirty) {
+        write_back_cache_line(p_cache, p_line, set_no);
+        p_line->dirty = 0;
+        cleaned = 1;
+    }
+
+    if (p_cache->vc_entries > 0) {
+        p_victim = find_victim_entry(p_cache, address - block_offset);
+        if (p_victim != NULL && p_victim->dirty) {
+            write_back_block(p_cache, p_victim->block_start, p_victim->data);
+            p_victim->dirty = 0;
+            cleaned = 1;
+        }
+    }
+
+    return cleaned;
+}
+
+
+/* This method cleans the block that contains the specified address, as
+ * clean_cache_block() does, and then removes it from the cache.  It returns
+ * nonzero if anything was written.
+ */
+int invalidate_cache_block(cache_t *p_cache, addr_t address) {
+    addr_t tag, set_no, block_offset;
+    cacheline_t *p_line;
+    victim_entry_t *p_victim;
+    int cleaned;
+
+    cleaned = clean_cache_block(p_cache, address);
+
+    decompose_address(p_cache, address, &tag, &set_no, &block_offset);
+    p_line = find_line_in_set(p_cache->cache_sets + set_no, tag);
+    if (p_line != NULL)
+        invalidate_cache_line(p_cache, p_cache->cache_sets + set_no, p_line);
+
+    if (p_cache->vc_entries > 0) {
+        p_victim = find_victim_entry(p_cache, address - block_offset);
+        if (p_victim != NULL) {
+            retire_block(p_cache, p_victim->block_start, p_victim->data,
+                         p_victim->dirty, 0);
+            p_victim->valid = 0;
+        }
+    }
+
+    return cleaned;
+}
+
+
 /*---------------------------------------------------------------------------
  * CACHE HELPER FUNCTIONS
  */
@@ -239,12 +878,21 @@ int flush_cache(cache_t *p_cache) {
  * the cache doesn't contain a line for the specified address, the
  * corresponding block will be loaded from the next level of the memory.  An
  * eviction will also occur if the cache doesn't currently have room for the
- * new line.
+ * new line.  "size" is the number of bytes being accessed, within the line,
+ * and "write" is nonzero for writes.  A write miss in a no-write-allocate
+ * cache loads nothing, and the function returns NULL.
  */
-cacheline_t *resolve_cache_access(cache_t *p_cache, addr_t address) {
-    addr_t tag, set_no, block_offset;
+cacheline_t *resolve_cache_access(cache_t *p_cache, addr_t address,
+                                  uint32_t size, int write) {
+    addr_t tag, set_no, block_offset, block;
     cacheset_t *p_set;
     cacheline_t *p_line;
+    access_outcome outcome;
+    mesi_state state = MESI_INVALID;
+    victim_entry_t *p_victim = NULL;
+    int allocate, dirty;
+    uint32_t slot;
+    uint64_t start = p_cache->time, done, *p_mshr = NULL;
     
     /* Map the address to a cache set, and pull out the tag and block
      * offset too.
@@ -267,19 +915,312 @@ cacheline_t *resolve_cache_access(cache_t *p_cache, addr_t address) {
         printf(" * Cache miss.\n");
 #endif
         
-        /* Resolve the cache miss. */
-        p_line = evict_cache_line(p_cache, p_set);
-        load_cache_line(p_cache, p_line, address, tag);
+        /* Resolve the cache miss.  In a coherent cache, the bus is
+         * consulted first, so other cores' writes reach the next level
+         * before the block is read from it.
+         */
+        allocate = (!write || p_cache->write_allocate) &&
+                   p_cache->inclusion != INCLUSION_EXCLUSIVE;
+
+        /* A block in the victim cache always comes back into the cache, so
+         * there is only ever one copy of it.
+         */
+        if (p_cache->vc_entries > 0)
+            p_victim = find_victim_entry(p_cache, address - block_offset);
+
+        /* The miss goes to the next level once the lookup is done, and a
+         * free MSHR is found to track it.
+         */
+        p_cache->time = start + p_cache->hit_latency;
+        if (allocate && p_victim == NULL) {
+            p_mshr = claim_mshr(p_cache);
+            if (p_cache->time > start + p_cache->hit_latency) {
+                p_cache->num_mshr_stalls++;
+                p_cache->mshr_stall_cycles +=
+                    p_cache->time - (start + p_cache->hit_latency);
+
+                /* A posted write isn't taken until the MSHR is free. */
+                if (write && p_cache->time - p_cache->hit_latency >
+                             p_cache->accept_time) {
+                    p_cache->accept_time =
+                        p_cache->time - p_cache->hit_latency;
+                }
+            }
+        }
+
+        if (p_cache->bus != NULL)
+            state = coherent_miss(p_cache, address, size, write, allocate);
+
+        done = p_cache->time;
+        if (p_victim != NULL) {
+            /* Swap the block with the line it replaces.  The victim cache
+             * has a free entry for that line once the block is taken out.
+             */
+            p_cache->num_victim_hits++;
+            memcpy(p_cache->vc_scratch, p_victim->data, p_cache->block_size);
+            dirty = p_victim->dirty;
+            p_victim->valid = 0;
+
+            p_line = evict_cache_line(p_cache, p_set);
+            fill_cache_line(p_set, p_line, tag);
+            memcpy(p_line->block, p_cache->vc_scratch, p_cache->block_size);
+            p_line->dirty = dirty;
+            p_line->ready_time = done;
+            p_cache->policy->insert(p_cache, p_set, p_line);
+        }
+        else if (allocate) {
+            p_line = evict_cache_line(p_cache, p_set);
+            p_line->coherence_state = state;
+            load_cache_line(p_cache, p_line, address, tag);
+            p_cache->policy->insert(p_cache, p_set, p_line);
+
+            done = p_line->ready_time;
+            if (p_mshr != NULL)
+                *p_mshr = done;
+        }
+        outcome = ACCESS_MISS;
+
+        if (p_cache->prefetcher != NULL) {
+            /* Was the block pushed out by a prefetch? */
+            block = address >> p_cache->block_offset_bits;
+            slot = pollution_slot(p_cache, block);
+            if (p_cache->pollution_filter[slot] == block + 1) {
+                p_cache->num_pollution_misses++;
+                p_cache->pollution_filter[slot] = 0;
+            }
+        }
     }
     else {
         /* CACHE HIT!  :-) */
         p_cache->num_hits++;
+        p_cache->policy->touch(p_cache, p_set, p_line);
+        outcome = ACCESS_HIT;
+
+        /* A line still being loaded isn't ready until its data arrives. */
+        done = start + p_cache->hit_latency;
+        if (p_line->ready_time > done)
+            done = p_line->ready_time;
+
+        if (write && p_cache->bus != NULL)
+            coherent_write_hit(p_cache, p_line, address, size);
+
+        if (p_line->prefetched) {
+            p_line->prefetched = 0;
+            p_cache->num_useful_prefetches++;
+            outcome = ACCESS_PREFETCHED_HIT;
+        }
+    }
+
+    if (p_cache->profile->classify || profiling_active)
+        profile_access(p_cache, address, outcome != ACCESS_MISS);
+
+    /* Prefetches are issued once the lookup is done. */
+    if (p_cache->prefetcher != NULL) {
+        p_cache->time = start + p_cache->hit_latency;
+        p_cache->prefetcher->on_access(p_cache, address, outcome, p_line);
     }
+
+    p_cache->time = done;
+    p_cache->total_latency += done - start;
     
     return p_line;
 }
 
 
+/* This function performs a read of a piece of a single cache line.  The
+ * data comes from the line, or straight from the next level if the cache
+ * doesn't allocate the block, i.e. if it is exclusive.  A block found in an
+ * exclusive cache moves up to the cache reading it, which takes over any
+ * write-back it needs.
+ */
+void read_cache_chunk(cache_t *p_cache, addr_t address, unsigned char *dest,
+                      uint32_t size) {
+    membase_t *next_mem = p_cache->next_memory;
+    cacheline_t *p_line;
+    wcentry_t *p_entry;
+    addr_t tag, set_no, block_offset;
+    uint64_t start;
+
+    p_line = resolve_cache_access(p_cache, address, size, 0);
+    p_cache->num_reads++;
+
+    if (p_line == NULL) {
+        /* Any combined writes to the block must reach the next level
+         * first, as when loading a line.
+         */
+        if (p_cache->wc_entries > 0) {
+            p_entry = find_wc_entry(p_cache,
+                get_block_start_from_address(p_cache, address));
+            if (p_entry != NULL)
+                drain_wc_entry(p_cache, p_entry);
+        }
+
+        start = p_cache->time;
+        next_mem->time = start;
+        read_block(next_mem, address, dest, size);
+        p_cache->next_read_bytes += size;
+        p_cache->time = next_mem->time;
+        p_cache->total_latency += p_cache->time - start;
+
+        /* A dirty block that moved up from an exclusive cache below passes
+         * on through this one, so the write-back goes with it.
+         */
+        if (p_cache->lower_cache != NULL) {
+            p_cache->handed_up_dirty = p_cache->lower_cache->handed_up_dirty;
+            p_cache->lower_cache->handed_up_dirty = 0;
+        }
+        return;
+    }
+
+    decompose_address(p_cache, address, &tag, &set_no, &block_offset);
+    memcpy(dest, p_line->block + block_offset, size);
+
+    if (p_cache->inclusion == INCLUSION_EXCLUSIVE) {
+        p_cache->handed_up_dirty = p_line->dirty;
+        clear_cache_line(p_cache->cache_sets + set_no, p_line);
+    }
+}
+
+
+/* This function performs a write to a piece of a single cache line.  The
+ * line is updated if the cache has it (or loads it, when write-allocate),
+ * and the write is also sent to the next level if the cache is
+ * write-through, or doesn't have the line.
+ */
+void write_cache_chunk(cache_t *p_cache, addr_t address,
+                       const unsigned char *src, uint32_t size) {
+    cacheline_t *p_line;
+
+    p_line = resolve_cache_access(p_cache, address, size, 1);
+    p_cache->num_writes++;
+
+    if (p_line != NULL) {
+        memcpy(p_line->block + get_offset_in_block(p_cache, address), src,
+               size);
+        if (!p_cache->write_through)
+            p_line->dirty = 1;
+    }
+
+    if (p_line == NULL || p_cache->write_through)
+        send_write(p_cache, address, src, size);
+}
+
+
+/* This function sends a write on to the next level of the memory, through
+ * the write-combining buffer if the cache has one.
+ */
+void send_write(cache_t *p_cache, addr_t address, const unsigned char *src,
+                uint32_t size) {
+    if (p_cache->wc_entries > 0) {
+        combine_write(p_cache, address, src, size);
+    }
+    else {
+        p_cache->next_memory->time = p_cache->time;
+        write_block(p_cache->next_memory, address, src, size);
+        p_cache->next_write_bytes += size;
+
+        /* The write isn't taken until the next level takes it. */
+        if (p_cache->next_memory->accept_time > p_cache->accept_time)
+            p_cache->accept_time = p_cache->next_memory->accept_time;
+    }
+}
+
+
+/* This function returns the write-combining buffer entry holding writes for
+ * the block starting at the specified address, or NULL if there is none.
+ */
+wcentry_t * find_wc_entry(cache_t *p_cache, addr_t block_start) {
+    uint32_t i;
+
+    for (i = 0; i < p_cache->wc_entries; i++) {
+        if (p_cache->wc_buffer[i].valid &&
+            p_cache->wc_buffer[i].block_start == block_start)
+            return p_cache->wc_buffer + i;
+    }
+    return NULL;
+}
+
+
+/* This function adds a write, which must be within a single block, to the
+ * write-combining buffer.  It is merged into the block's entry if there is
+ * one; otherwise a free entry is used, or the oldest entry is drained.
+ */
+void combine_write(cache_t *p_cache, addr_t address, const unsigned char *src,
+                   uint32_t size) {
+    addr_t block_start = get_block_start_from_address(p_cache, address);
+    addr_t block_offset = get_offset_in_block(p_cache, address);
+    wcentry_t *p_entry = find_wc_entry(p_cache, block_start);
+    uint32_t i;
+
+    if (p_entry == NULL) {
+        for (i = 0; i < p_cache->wc_entries; i++) {
+            if (!p_cache->wc_buffer[i].valid) {
+                p_entry = p_cache->wc_buffer + i;
+                break;
+            }
+        }
+
+        if (p_entry == NULL) {
+            p_entry = p_cache->wc_buffer + p_cache->wc_next;
+            p_cache->wc_next = (p_cache->wc_next + 1) % p_cache->wc_entries;
+            drain_wc_entry(p_cache, p_entry);
+        }
+
+        p_entry->valid = 1;
+        p_entry->block_start = block_start;
+        memset(p_entry->written, 0, p_cache->block_size);
+    }
+
+    memcpy(p_entry->data + block_offset, src, size);
+    memset(p_entry->written + block_offset, 1, size);
+}
+
+
+/* This function sends the writes held in a write-combining buffer entry to
+ * the next level of the memory, one write per run of written bytes, and
+ * frees the entry.
+ */
+void drain_wc_entry(cache_t *p_cache, wcentry_t *p_entry) {
+    uint32_t start, end;
+
+    if (!p_entry->valid)
+        return;
+
+    start = 0;
+    while (start < p_cache->block_size) {
+        if (!p_entry->written[start]) {
+            start++;
+            continue;
+        }
+
+        end = start + 1;
+        while (end < p_cache->block_size && p_entry->written[end])
+            end++;
+
+        p_cache->next_memory->time = p_cache->time;
+        write_block(p_cache->next_memory, p_entry->block_start + start,
+                    p_entry->data + start, end - start);
+        p_cache->next_write_bytes += end - start;
+
+        /* The write isn't taken until the next level takes it. */
+        if (p_cache->next_memory->accept_time > p_cache->accept_time)
+            p_cache->accept_time = p_cache->next_memory->accept_time;
+        start = end;
+    }
+
+    p_entry->valid = 0;
+}
+
+
+/* This function drains every entry of the write-combining buffer. */
+void drain_wc_buffer(cache_t *p_cache) {
+    uint32_t i;
+
+    for (i = 0; i < p_cache->wc_entries; i++)
+        drain_wc_entry(p_cache, p_cache->wc_buffer + i);
+}
+
+
 /* This function takes a cache and an address being accessed through the
  * cache, and it breaks the address down into the values needed by the cache:
  *  - The tag that identifies the block.
@@ -305,17 +1246,15 @@ void decompose_address(cache_t *p_cache, addr_t address,
     *offset = address & mask;
 
     // Calculating the cache-set
-    // Mask the middle s bits of the address
-    // Works b/c C fills left shifts with 0 bits!
-    mask = ((1 << log_2(p_cache->num_sets)) - 1)
-           << log_2(p_cache->block_size);
-    // Shift the results right by # of bits in block_size to get our set #
-    *set = (address & mask) >> log_2(p_cache->block_size);
+    // Mask the middle s bits of the address, after shifting off the offset.
+    // The bit counts are computed once, in init_cache().
+    mask = p_cache->num_sets - 1;
+    *set = (address >> p_cache->block_offset_bits) & mask;
 
     // Calculating the tag (the remaining bits)
     // Typecast into unsigned to ensure >> performs a logical shift
-    *tag = ((unsigned int) address) >> (log_2(p_cache->num_sets) + 
-                                        log_2(p_cache->block_size));
+    *tag = ((unsigned int) address) >> (p_cache->sets_addr_bits +
+                                        p_cache->block_offset_bits);
 }
 
 
@@ -329,8 +1268,8 @@ addr_t get_block_start_from_address(cache_t *p_cache, addr_t address) {
 
     // Start of block is when the block_offset bits are 0
     // We can simply shift right then left by log(block_offset)
-    result = (address >> log_2(p_cache->block_size))
-             << log_2(p_cache->block_size);
+    result = (address >> p_cache->block_offset_bits)
+             << p_cache->block_offset_bits;
     return result;
 }
 
@@ -362,10 +1301,10 @@ addr_t get_block_start_from_line_info(cache_t *p_cache,
     addr_t set_no_shifted;
 
     // Shift the tag so it's at the most significant digits
-    tag_shifted = tag << (log_2(p_cache->num_sets) +
-                          log_2(p_cache->block_size));
+    tag_shifted = tag << (p_cache->sets_addr_bits +
+                          p_cache->block_offset_bits);
     // Shift the set_no so it's at its respective block of the bits
-    set_no_shifted = set_no << (log_2(p_cache->block_size));
+    set_no_shifted = set_no << p_cache->block_offset_bits;
     // Since we look for the start of the block, offset = 0; just combine
     // the shifted pieces
     result = tag_shifted | set_no_shifted;
@@ -378,23 +1317,36 @@ addr_t get_block_start_from_line_info(cache_t *p_cache,
  * returns NULL.
  */
 cacheline_t * find_line_in_set(cacheset_t *p_set, addr_t tag) {
-    int i;
-    cacheline_t *found_line = NULL;
+    int i = 0;
 
 #if DEBUG_CACHE
     printf(" * Finding line with tag %u in cache set:\n", tag);
 #endif
-    // cycle through all lines in set
-    for (i = 0; i < p_set->num_lines; i++)
-    {
-        if ((p_set->cache_lines[i]).valid == 1 &&
-            (p_set->cache_lines[i]).tag == tag)
-        {
-            // update found_line if tag found
-            found_line = &(p_set->cache_lines[i]);
+
+#if defined(__SSE2__)
+    /* Compare the tags four ways at a time. */
+    __m128i key = _mm_set1_epi32((int) tag), tags;
+    int matches;
+
+    for (; i + 4 <= p_set->num_lines; i += 4) {
+        tags = _mm_loadu_si128((const __m128i *) (p_set->tags + i));
+        matches = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(tags,
+                                                                   key)));
+        while (matches != 0) {
+            int way = i + __builtin_ctz(matches);
+            if (p_set->cache_lines[way].valid)
+                return p_set->cache_lines + way;
+            matches &= matches - 1;
         }
     }
-    return found_line;
+#endif
+
+    // cycle through the remaining lines in the set
+    for (; i < p_set->num_lines; i++) {
+        if (p_set->tags[i] == tag && p_set->cache_lines[i].valid)
+            return p_set->cache_lines + i;
+    }
+    return NULL;
 }
 
 
@@ -402,39 +1354,24 @@ cacheline_t * find_line_in_set(cacheset_t *p_set, addr_t tag) {
  * must be loaded into the cache.  Note that this function is slightly mis-
  * named; if it selects a cache line that is currently invalid, nothing will
  * actually be evicted; the line will simply be used to store the new block
- * of data.
+ * of data.  Invalid lines are always used first; otherwise the cache's
+ * replacement policy chooses the victim.
  */
-cacheline_t * choose_victim(cacheset_t *p_set) {
+cacheline_t * choose_victim(cache_t *p_cache, cacheset_t *p_set) {
     cacheline_t *victim = NULL;
-    // int i_victim;
-    unsigned long long int current_least;
     int i;
-    
-#if RANDOM_REPLACEMENT_POLICY
-    /* Randomly choose a victim line to evict. */
-    i_victim = rand() % p_set->num_lines;
-    victim = p_set->cache_lines + i_victim;
-#else
-    // Establish a current_least that is greater than any current time
-    current_least = clock_tick();
-    // We can do this b/c it won't mess with the ordering of lines
-    // e.g. this with lower time will still be lower than any future time.
-    // search through all lines in cacheset
-    for (i = 0; i < p_set->num_lines; i++)
-    {
-        if ((p_set->cache_lines[i]).valid == 0)
-        {
-            victim = &(p_set->cache_lines[i]);
+
+    for (i = 0; p_set->num_valid < p_set->num_lines &&
+                i < p_set->num_lines; i++) {
+        if (p_set->cache_lines[i].valid == 0) {
+            victim = p_set->cache_lines + i;
             break;
         }
-        else if ((p_set->cache_lines[i]).last_time < current_least)
-        {
-            victim = &(p_set->cache_lines[i]);
-            current_least = victim->last_time;
-        }
     }
-#endif
-    
+
+    if (victim == NULL)
+        victim = p_cache->policy->choose_victim(p_cache, p_set);
+
 #if DEBUG_CACHE
     if (victim->valid) {
         printf(" * Chose victim line to evict:  tag %u, set %u\n",
@@ -454,26 +1391,238 @@ cacheline_t * choose_victim(cacheset_t *p_set) {
  * to load a new block from the next level of memory.
  */
 cacheline_t * evict_cache_line(cache_t *p_cache, cacheset_t *p_set) {
-    /* Randomly choose a victim line to evict. */
-    cacheline_t *victim = choose_victim(p_set);
+    /* Choose a victim line to evict. */
+    cacheline_t *victim = choose_victim(p_cache, p_set);
 
-    if (victim->valid && victim->dirty) {
-        /* The line being evicted is dirty, so we need to
-         * write it back to the next level.
-         */
+    displace_cache_line(p_cache, p_set, victim);
+    return victim;
+}
 
-#if DEBUG_CACHE
-        printf(" * Victim cache line is dirty; writing back.\n");
-#endif
 
-        write_back_cache_line(p_cache, victim, p_set->set_no);
+/* This function empties a line chosen for replacement.  Its block moves
+ * into the victim cache if there is one, and otherwise leaves the cache
+ * (see retire_block()).
+ */
+void displace_cache_line(cache_t *p_cache, cacheset_t *p_set,
+                         cacheline_t *victim) {
+    addr_t block_start;
+
+    if (!victim->valid)
+        return;
+
+    block_start = get_block_start_from_line_info(p_cache, victim->tag,
+                                                 p_set->set_no);
+    if (p_cache->vc_entries > 0)
+        save_victim(p_cache, block_start, victim->block, victim->dirty);
+    else
+        retire_block(p_cache, block_start, victim->block, victim->dirty, 1);
+
+    clear_cache_line(p_set, victim);
+}
+
+
+/* This function empties a line whose block must leave the cache, e.g. for
+ * coherence, writing it back to the next level of the memory first if it
+ * is dirty.
+ */
+void invalidate_cache_line(cache_t *p_cache, cacheset_t *p_set,
+                           cacheline_t *victim) {
+    if (victim->valid) {
+        retire_block(p_cache,
+            get_block_start_from_line_info(p_cache, victim->tag,
+                                           p_set->set_no),
+            victim->block, victim->dirty, 0);
     }
 
+    clear_cache_line(p_set, victim);
+}
+
+
+/* This function marks a line as invalid, without writing anything back. */
+void clear_cache_line(cacheset_t *p_set, cacheline_t *victim) {
+    if (victim->valid)
+        p_set->num_valid--;
     victim->valid = 0;
     victim->dirty = 0;
     victim->tag = 0;
+    victim->coherence_state = MESI_INVALID;
+    p_set->tags[victim - p_set->cache_lines] = INVALID_TAG;
+}
 
-    return victim;
+
+/* This function marks a line as holding the block with the specified tag,
+ * clean and not prefetched.  The caller fills in the data.
+ */
+void fill_cache_line(cacheset_t *p_set, cacheline_t *p_line, addr_t tag) {
+    if (!p_line->valid)
+        p_set->num_valid++;
+    p_line->valid = 1;
+    p_line->dirty = 0;
+    p_line->tag = tag;
+    p_line->prefetched = 0;
+    p_set->tags[p_line - p_set->cache_lines] = tag;
+}
+
+
+/* This function returns the victim cache entry holding the block starting
+ * at the specified address, or NULL if there is none.
+ */
+victim_entry_t * find_victim_entry(cache_t *p_cache, addr_t block_start) {
+    uint32_t i;
+
+    for (i = 0; i < p_cache->vc_entries; i++) {
+        if (p_cache->victim_cache[i].valid &&
+            p_cache->victim_cache[i].block_start == block_start)
+            return p_cache->victim_cache + i;
+    }
+    return NULL;
+}
+
+
+/* This function moves a block replaced in the cache into its victim cache.
+ * If the victim cache is full, its oldest block leaves the cache to make
+ * room.
+ */
+void save_victim(cache_t *p_cache, addr_t block_start,
+                 const unsigned char *data, int dirty) {
+    victim_entry_t *p_entry = NULL, *p_oldest = p_cache->victim_cache;
+    uint32_t i;
+
+    for (i = 0; i < p_cache->vc_entries; i++) {
+        if (!p_cache->victim_cache[i].valid) {
+            p_entry = p_cache->victim_cache + i;
+            break;
+        }
+        if (p_cache->victim_cache[i].age < p_oldest->age)
+            p_oldest = p_cache->victim_cache + i;
+    }
+
+    if (p_entry == NULL) {
+        p_entry = p_oldest;
+        retire_block(p_cache, p_entry->block_start, p_entry->data,
+                     p_entry->dirty, 1);
+    }
+
+    p_entry->valid = 1;
+    p_entry->dirty = dirty;
+    p_entry->block_start = block_start;
+    p_entry->age = clock_tick();
+    memcpy(p_entry->data, data, p_cache->block_size);
+}
+
+
+/* This function sends a block that is leaving the cache on to the next
+ * level.  An inclusive cache first takes the block away from the caches in
+ * front of it, along with any newer data they hold.  Dirty data is written
+ * back, and a block being replaced moves into an exclusive next level even
+ * if it is clean, since that cache doesn't have it.
+ */
+void retire_block(cache_t *p_cache, addr_t block_start, unsigned char *data,
+                  int dirty, int replaced) {
+    cache_t *p_upper, *p_lower = p_cache->lower_cache;
+
+    if (p_cache->inclusion == INCLUSION_INCLUSIVE) {
+        for (p_upper = p_cache->first_upper; p_upper != NULL;
+             p_upper = p_upper->next_peer)
+            purge_block(p_cache, p_upper, block_start, data, &dirty);
+    }
+
+    if (replaced && p_lower != NULL &&
+        p_lower->inclusion == INCLUSION_EXCLUSIVE) {
+        p_lower->time = p_cache->time;
+        insert_block(p_lower, block_start, data, dirty);
+        p_cache->next_write_bytes += p_cache->block_size;
+    }
+    else if (dirty) {
+#if DEBUG_CACHE
+        printf(" * Victim cache line is dirty; writing back.\n");
+#endif
+        write_back_block(p_cache, block_start, data);
+    }
+}
+
+
+/* This function removes a block from p_upper, a cache in front of the
+ * inclusive cache p_cache, and from the caches in front of that, copying
+ * any data they hold that is newer than p_cache's into "data".  Each cache
+ * is newer than the one below it, so its data is copied after theirs.
+ */
+void purge_block(cache_t *p_cache, cache_t *p_upper, addr_t block_start,
+                 unsigned char *data, int *p_dirty) {
+    addr_t tag, set_no, block_offset;
+    cacheline_t *p_line;
+    victim_entry_t *p_victim;
+    wcentry_t *p_entry;
+    cache_t *p_above;
+    uint32_t i;
+
+    if (p_upper->vc_entries > 0 &&
+        (p_victim = find_victim_entry(p_upper, block_start)) != NULL) {
+        if (p_victim->dirty) {
+            memcpy(data, p_victim->data, p_cache->block_size);
+            p_upper->next_write_bytes += p_cache->block_size;
+            *p_dirty = 1;
+        }
+        p_victim->valid = 0;
+        p_cache->num_back_invalidations++;
+    }
+
+    decompose_address(p_upper, block_start, &tag, &set_no, &block_offset);
+    p_line = find_line_in_set(p_upper->cache_sets + set_no, tag);
+    if (p_line != NULL) {
+        if (p_line->dirty) {
+            memcpy(data, p_line->block, p_cache->block_size);
+            p_upper->next_write_bytes += p_cache->block_size;
+            *p_dirty = 1;
+        }
+        clear_cache_line(p_upper->cache_sets + set_no, p_line);
+        p_cache->num_back_invalidations++;
+    }
+
+    /* Combined writes held for the block are newer than the line. */
+    if (p_upper->wc_entries > 0 &&
+        (p_entry = find_wc_entry(p_upper, block_start)) != NULL) {
+        for (i = 0; i < p_cache->block_size; i++) {
+            if (p_entry->written[i]) {
+                data[i] = p_entry->data[i];
+                p_upper->next_write_bytes++;
+            }
+        }
+        p_entry->valid = 0;
+        *p_dirty = 1;
+    }
+
+    for (p_above = p_upper->first_upper; p_above != NULL;
+         p_above = p_above->next_peer)
+        purge_block(p_cache, p_above, block_start, data, p_dirty);
+}
+
+
+/* This function moves a block replaced in the cache in front of an
+ * exclusive cache into the exclusive cache.
+ */
+void insert_block(cache_t *p_cache, addr_t block_start,
+                  const unsigned char *data, int dirty) {
+    addr_t tag, set_no, block_offset;
+    cacheset_t *p_set;
+    cacheline_t *p_line;
+
+    decompose_address(p_cache, block_start, &tag, &set_no, &block_offset);
+    p_set = p_cache->cache_sets + set_no;
+    p_cache->num_writes++;
+
+    /* Another core's copy of the block may have moved here already. */
+    p_line = find_line_in_set(p_set, tag);
+    if (p_line == NULL) {
+        p_line = evict_cache_line(p_cache, p_set);
+        fill_cache_line(p_set, p_line, tag);
+        p_line->ready_time = p_cache->time;
+        p_cache->policy->insert(p_cache, p_set, p_line);
+    }
+
+    memcpy(p_line->block, data, p_cache->block_size);
+    if (dirty)
+        p_line->dirty = 1;
 }
 
 
@@ -485,19 +1634,75 @@ cacheline_t * evict_cache_line(cache_t *p_cache, cacheset_t *p_set) {
 void load_cache_line(cache_t *p_cache, cacheline_t *p_line, addr_t address,
                      addr_t tag) {
     membase_t *next_mem = p_cache->next_memory;
-    addr_t start_addr;
-    int offset;
+    addr_t start_addr, set_no, block_offset;
+    cacheset_t *p_set;
 
-    /* Determine the start of the block that holds the specified address. */
+    /* Determine the start of the block that holds the specified address,
+     * and the set the line is in.
+     */
     start_addr = get_block_start_from_address(p_cache, address);
+    decompose_address(p_cache, address, &tag, &set_no, &block_offset);
+    p_set = p_cache->cache_sets + set_no;
 
-    /* Read each byte of the new line from the next level. */
-    for (offset = 0; offset < p_cache->block_size; offset++)
-        p_line->block[offset] = read_byte(next_mem, start_addr + offset);
+    /* Any combined writes to the block must reach the next level first. */
+    if (p_cache->wc_entries > 0) {
+        wcentry_t *p_entry = find_wc_entry(p_cache, start_addr);
+        if (p_entry != NULL)
+            drain_wc_entry(p_cache, p_entry);
+    }
 
-    p_line->valid = 1;
-    p_line->dirty = 0;
-    p_line->tag = tag;
+    /* The line is filled in before the block is read, so that a coherent
+     * next level can see that the core already holds the block.
+     */
+    fill_cache_line(p_set, p_line, tag);
+
+    /* Read the new line from the next level, as a single access.  The read
+     * starts at the cache's current time, and the line is ready when the
+     * next level is done.
+     */
+    next_mem->time = p_cache->time;
+    read_block(next_mem, start_addr, p_line->block, p_cache->block_size);
+    p_cache->next_read_bytes += p_cache->block_size;
+    p_line->ready_time = next_mem->time;
+
+    /* A dirty block that moved up from an exclusive cache is now this
+     * cache's to write back.
+     */
+    if (p_cache->lower_cache != NULL &&
+        p_cache->lower_cache->handed_up_dirty) {
+        p_line->dirty = 1;
+        p_cache->lower_cache->handed_up_dirty = 0;
+    }
+}
+
+
+/* This function finds the MSHR that becomes free first, for a miss starting
+ * at the cache's current time, and advances the time to when it is free.
+ * The caller sets the MSHR's busy time once the miss is issued.  NULL is
+ * returned if the cache doesn't bound its outstanding misses.
+ */
+uint64_t * claim_mshr(cache_t *p_cache) {
+    uint64_t *p_mshr;
+    uint32_t i;
+
+    if (p_cache->num_mshrs == 0)
+        return NULL;
+
+    p_mshr = p_cache->mshrs;
+    for (i = 1; i < p_cache->num_mshrs; i++) {
+        if (p_cache->mshrs[i] < *p_mshr)
+            p_mshr = p_cache->mshrs + i;
+    }
+
+    if (*p_mshr > p_cache->time)
+        p_cache->time = *p_mshr;
+    return p_mshr;
+}
+
+
+/* This function returns the pollution filter slot for a block number. */
+uint32_t pollution_slot(cache_t *p_cache, addr_t block) {
+    return (block * 2654435761U) & (p_cache->pollution_filter_size - 1);
 }
 
 
@@ -511,9 +1716,7 @@ void write_back_cache_line(cache_t *p_cache, cacheline_t *p_line,
     /* The line being evicted is dirty, so we need to
      * write it back to the next level.
      */
-    membase_t *next_mem = p_cache->next_memory;
     addr_t start_addr;
-    int offset;
 
     assert(p_line->valid);
     assert(p_line->dirty);
@@ -532,8 +1735,20 @@ void write_back_cache_line(cache_t *p_cache, cacheline_t *p_line,
            start_addr);
 #endif
 
-    /* Write each byte of the victim line out to the next level. */
-    for (offset = 0; offset < p_cache->block_size; offset++)
-        write_byte(next_mem, start_addr + offset, p_line->block[offset]);
+    write_back_block(p_cache, start_addr, p_line->block);
+}
+
+
+/* This function writes a dirty block back to the next level of the memory,
+ * as a single access.
+ */
+void write_back_block(cache_t *p_cache, addr_t start_addr,
+                      const unsigned char *data) {
+    membase_t *next_mem = p_cache->next_memory;
+
+    next_mem->time = p_cache->time;
+    write_block(next_mem, start_addr, (unsigned char *) data,
+                p_cache->block_size);
+    p_cache->next_write_bytes += p_cache->block_size;
 }
 
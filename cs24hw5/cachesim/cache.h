@@ -19,17 +19,111 @@ typedef struct cacheline_t {
     /* This value will be 0 if the line is clean, 1 if it is dirty. */
     char dirty;
 
-    /* This is the tag for the cache line, taken from the address. */
+    /* This is the tag for the cache line, taken from the address.  It is
+     * also kept in the set's tag array, for lookups.
+     */
     uint32_t tag;
     
-    /* This is the start of the block of data itself. */
+    /* This is the start of the block of data itself, within the cache's
+     * block slab, or the cache's one shared block if it only keeps tags.
+     */
     unsigned char *block;
 
-    /* This value stores the most recent time that the line was accessed*/
-    unsigned long long int last_time;
+    /* State kept by the replacement policy, e.g. an access count for LFU. */
+    uint32_t repl_state;
+
+    /* This value will be 1 if the line was loaded by a prefetch and hasn't
+     * been accessed since, 0 otherwise.
+     */
+    char prefetched;
+
+    /* The MESI state of the line, in a cache kept coherent by a bus (see
+     * coherence.h).  Unused in other caches.
+     */
+    char coherence_state;
+
+    /* The time at which the line's data arrives from the next level.  Hits
+     * before then wait for it, as they would on an outstanding miss.
+     */
+    uint64_t ready_time;
 } cacheline_t;
 
 
+/* The tag kept in a set's tag array for an invalid line.  A valid line can
+ * have this tag too, if the cache has a single set of 1-byte blocks, so a
+ * matching line's valid flag is still checked.
+ */
+#define INVALID_TAG 0xFFFFFFFFU
+
+
+/* The number of write-combining buffer entries when no number is given. */
+#define DEFAULT_WC_ENTRIES 4
+
+/* The timing used unless set_cache_timing() is called:  the cycles a lookup
+ * takes, and the number of MSHRs.
+ */
+#define DEFAULT_HIT_LATENCY 4
+#define DEFAULT_MSHRS 8
+
+
+/* This struct represents an entry of a cache's write-combining buffer,
+ * which gathers writes headed for the next level of the memory, so that
+ * several writes to one block are sent as one.
+ */
+typedef struct wcentry_t {
+    /* This value will be 0 if the entry is free, 1 if it holds writes. */
+    char valid;
+
+    /* The start address of the block the writes are for. */
+    addr_t block_start;
+
+    /* The written bytes, and for each byte of the block, whether it has
+     * been written.
+     */
+    unsigned char *data;
+    unsigned char *written;
+} wcentry_t;
+
+
+/* The number of victim cache entries when no number is given. */
+#define DEFAULT_VICTIM_ENTRIES 8
+
+
+/* This struct represents an entry of a cache's victim cache, a small fully
+ * associative buffer of the blocks most recently evicted from the cache.
+ */
+typedef struct victim_entry_t {
+    /* This value will be 0 if the entry is free, 1 if it holds a block. */
+    char valid;
+
+    /* This value will be 1 if the block must be written back, 0 if not. */
+    char dirty;
+
+    /* The start address of the block. */
+    addr_t block_start;
+
+    /* When the entry was filled; the oldest entry is replaced first. */
+    uint64_t age;
+
+    unsigned char *data;
+} victim_entry_t;
+
+
+/* How a cache relates to the caches in front of it.  A non-inclusive
+ * non-exclusive (NINE) cache just caches what the levels above it miss on.
+ * An inclusive cache holds every block the levels above it hold, so when
+ * it evicts a block, it invalidates the block above it too
+ * (back-invalidation).  An exclusive cache holds only blocks the level
+ * above it doesn't:  it fills with the blocks evicted from above, and a
+ * block found in it moves up instead of being copied.
+ */
+typedef enum inclusion_policy {
+    INCLUSION_NINE,
+    INCLUSION_INCLUSIVE,
+    INCLUSION_EXCLUSIVE
+} inclusion_policy;
+
+
 /* This struct represents a cache set within the cache. */
 typedef struct cacheset_t {
     /* The number of the cache set.  This allows us to construct addresses
@@ -44,8 +138,28 @@ typedef struct cacheset_t {
      */
     int32_t num_lines;
 
+    /* The number of valid lines in the set, so that a full set needn't be
+     * searched for an invalid line.
+     */
+    int32_t num_valid;
+
     /* The cache lines in this cache set. */
     cacheline_t *cache_lines;
+
+    /* The tags of the lines, with INVALID_TAG for invalid lines, packed
+     * together so that a lookup compares them without touching the lines.
+     */
+    uint32_t *tags;
+
+    /* The most recent time that each line was accessed (or loaded, for
+     * FIFO), packed together so that replacement policies can scan them.
+     */
+    uint64_t *ages;
+
+    /* Any per-set state of the replacement policy, or NULL.  It is freed
+     * along with the set.
+     */
+    void *policy_state;
 } cacheset_t;
 
 
@@ -61,11 +175,36 @@ typedef struct cache_t {
     /* The number of writes that occurred at this level of the memory. */
     uint64_t num_writes;
 
+    /* The simulated time, in cycles.  An access to this level starts at
+     * this time, and the level advances it to the time the access completes
+     * (see the timing model in membase.c).
+     */
+    uint64_t time;
+
+    /* When this level took the last posted write, which may be after the
+     * write was issued if the level had to wait for room to track it.
+     */
+    uint64_t accept_time;
+
     /* The function to read a byte from the cache. */
     unsigned char (*read_byte)(membase_t *mb, addr_t address);
     
     /* The function to write a byte to the cache. */
     void (*write_byte)(membase_t *mb, addr_t address, unsigned char value);
+
+    /* The function to read a 4-byte word from the cache. */
+    uint32_t (*read_word)(membase_t *mb, addr_t address);
+
+    /* The function to write a 4-byte word to the cache. */
+    void (*write_word)(membase_t *mb, addr_t address, uint32_t value);
+
+    /* The function to read a range of bytes from the cache. */
+    void (*read_block)(membase_t *mb, addr_t address, unsigned char *dest,
+                       uint32_t size);
+
+    /* The function to write a range of bytes to the cache. */
+    void (*write_block)(membase_t *mb, addr_t address,
+                        const unsigned char *src, uint32_t size);
  
     /* The function to print the cache's access statistics. */
     void (*print_stats)(struct membase_t *mb);
@@ -84,6 +223,11 @@ typedef struct cache_t {
      */
     uint32_t block_size;
 
+    /* Nonzero if the cache only keeps the tags of its blocks, and not their
+     * data (see set_tag_only()).
+     */
+    int tag_only;
+
 
     /* This is the number of address bits devoted to identifying the
      * cache set based on the address.
@@ -106,20 +250,174 @@ typedef struct cache_t {
     /* The memory that this is a cache of. */
     membase_t *next_memory;
 
+    /* The replacement policy used to choose victims; see replace.h. */
+    const struct replpolicy_t *policy;
+
     /* The number of cache hits. */
     uint64_t num_hits;
 
     /* The number of cache misses. */
     uint64_t num_misses;
 
+
+    /* Nonzero if every write is also sent to the next level (write-through);
+     * zero if lines are marked dirty and written back when evicted.
+     */
+    int write_through;
+
+    /* Nonzero if a write miss loads the block into the cache; zero if the
+     * write is just sent on to the next level.
+     */
+    int write_allocate;
+
+    /* The write-combining buffer, if wc_entries is nonzero.  Writes sent to
+     * the next level go through it; when it is full, the entry at wc_next
+     * is drained to make room.
+     */
+    uint32_t wc_entries;
+    wcentry_t *wc_buffer;
+    uint32_t wc_next;
+
+    /* The number of bytes read from and written to the next level. */
+    uint64_t next_read_bytes;
+    uint64_t next_write_bytes;
+
+
+    /* The prefetcher model, or NULL if the cache only fetches on demand;
+     * see prefetch.h.
+     */
+    const struct prefetcher_t *prefetcher;
+
+    /* The number of blocks the prefetcher fetches ahead. */
+    uint32_t prefetch_degree;
+
+    /* Prefetches are only issued for blocks below this address, so they
+     * never run off the end of the memory.
+     */
+    addr_t prefetch_limit;
+
+    /* Any state kept by the prefetcher, or NULL. */
+    void *prefetch_state;
+
+    /* The number of prefetches that loaded a block. */
+    uint64_t num_prefetches;
+
+    /* The number of prefetched blocks that were accessed before eviction. */
+    uint64_t num_useful_prefetches;
+
+    /* The number of misses on blocks that a prefetch had evicted. */
+    uint64_t num_pollution_misses;
+
+    /* The blocks most recently evicted by prefetches, for counting the
+     * misses they cause.  Each entry holds a block number plus 1, or 0 if
+     * empty, and is indexed by a hash of the block number; colliding blocks
+     * simply replace each other.
+     */
+    addr_t *pollution_filter;
+    uint32_t pollution_filter_size;
+
+
+    /* The bus keeping this cache coherent with the private caches of other
+     * cores, or NULL if the cache isn't shared with anything; see
+     * coherence.h.  "core" is the core the cache belongs to.
+     */
+    struct bus_t *bus;
+    uint32_t core;
+
+
+    /* The miss classification and per-region and per-site counts of the
+     * cache; see profile.h.
+     */
+    struct cache_profile_t *profile;
+
+
+    /* The timing of the cache:  the cycles a lookup takes, and the number
+     * of MSHRs (miss status holding registers), which bound the number of
+     * misses that can be outstanding at once; 0 means no bound.  mshrs
+     * holds the time until which each MSHR is busy.
+     */
+    uint32_t hit_latency;
+    uint32_t num_mshrs;
+    uint64_t *mshrs;
+
+    /* The total cycles taken by the cache's lookups, and the number of
+     * misses that waited for a free MSHR, and the cycles they waited.
+     */
+    uint64_t total_latency;
+    uint64_t num_mshr_stalls;
+    uint64_t mshr_stall_cycles;
+
+
+    /* The victim cache, if vc_entries is nonzero.  Lines replaced in the
+     * cache move into it, and a miss that finds its block there swaps the
+     * block back in, without going to the next level.  vc_scratch holds a
+     * block during the swap.
+     */
+    uint32_t vc_entries;
+    victim_entry_t *victim_cache;
+    unsigned char *vc_scratch;
+
+    /* The number of misses that found their block in the victim cache. */
+    uint64_t num_victim_hits;
+
+
+    /* How the cache relates to the caches in front of it, and those caches:
+     * first_upper is the first of them, and each links to the next through
+     * next_peer.  lower_cache is the cache this one is in front of, if the
+     * next level is a cache.
+     */
+    inclusion_policy inclusion;
+    struct cache_t *first_upper;
+    struct cache_t *next_peer;
+    struct cache_t *lower_cache;
+
+    /* Set by an exclusive cache when a block that moved up from it was
+     * dirty, so the cache above takes on the write-back.
+     */
+    int handed_up_dirty;
+
+    /* The number of blocks an inclusive cache invalidated above it. */
+    uint64_t num_back_invalidations;
+
 } cache_t;
 
 
 void init_cache(cache_t *p_cache, uint32_t block_size, uint32_t num_sets,
     uint32_t lines_per_set, membase_t *next_mem);
+void init_cache_like(cache_t *p_cache, const cache_t *p_model,
+                     membase_t *next_mem);
 
 int flush_cache(cache_t *p_cache);
 
+int set_replacement_policy(cache_t *p_cache,
+                           const struct replpolicy_t *policy);
+
+void set_prefetcher(cache_t *p_cache, const struct prefetcher_t *prefetcher,
+                    uint32_t degree, addr_t limit);
+
+void issue_prefetch(cache_t *p_cache, addr_t address, cacheline_t *p_keep);
+
+void set_write_policy(cache_t *p_cache, int write_through, int write_allocate,
+                      uint32_t wc_entries);
+
+void set_cache_timing(cache_t *p_cache, uint32_t hit_latency,
+                      uint32_t num_mshrs);
+
+void set_victim_cache(cache_t *p_cache, uint32_t entries);
+void set_inclusion_policy(cache_t *p_cache, inclusion_policy inclusion);
+void set_tag_only(cache_t *p_cache);
+int add_upper_cache(cache_t *p_cache, cache_t *p_upper);
+
+addr_t get_block_start_from_line_info(cache_t *p_cache,
+                                      addr_t tag, addr_t set_no);
+
+void print_cache_stats(cache_t *p_cache);
+void add_cache_stats(cache_t *p_cache, const cache_t *p_other);
+
+cacheline_t * find_cache_line(cache_t *p_cache, addr_t address);
+int clean_cache_block(cache_t *p_cache, addr_t address);
+int invalidate_cache_block(cache_t *p_cache, addr_t address);
+
 
 #endif /* CACHE_H */
 
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "cmdline.h"
+#include "memory.h"
+#include "cache.h"
+
+
+/* Measures how fast the simulator itself runs:  it drives a synthetic
+ * stream of word accesses through a simulated memory hierarchy, and reports
+ * the simulated accesses per second of real time, e.g.:
+ *
+ *     ./cachebench -p random -f 4194304 64:64:8 64:1024:16
+ *
+ * Compare the rate across versions of the simulator, or across cache
+ * configurations, to see what the simulation of each costs.
+ */
+
+
+/* The default number of accesses to simulate. */
+#define DEFAULT_ACCESSES 20000000
+
+/* The default footprint of the accesses, which is also the size of the
+ * simulated memory.  It must be a power of 2.
+ */
+#define DEFAULT_FOOTPRINT (1024 * 1024)
+
+/* Every WRITE_PERIOD'th access is a write. */
+#define WRITE_PERIOD 4
+
+
+/* This struct describes a pattern of accesses the benchmark can make. */
+typedef struct pattern_t {
+    /* The name of the pattern, as given with -p. */
+    const char *name;
+
+    const char *description;
+
+    /* Returns the address of the next access, given the previous one, the
+     * mask of the footprint, and the state of a random-number generator.
+     */
+    addr_t (*next)(addr_t address, addr_t mask, uint32_t *p_seed);
+} pattern_t;
+
+
+/* A xorshift generator, much cheaper than rand() so that the benchmark
+ * measures the simulator rather than the generator.
+ */
+uint32_t next_random(uint32_t *p_seed) {
+    uint32_t x = *p_seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *p_seed = x;
+    return x;
+}
+
+
+addr_t sequential_next(addr_t address, addr_t mask, uint32_t *p_seed) {
+    return (address + 4) & mask;
+}
+
+
+addr_t strided_next(addr_t address, addr_t mask, uint32_t *p_seed) {
+    return (address + 4100) & mask & ~3;
+}
+
+
+addr_t random_next(addr_t address, addr_t mask, uint32_t *p_seed) {
+    return next_random(p_seed) & mask & ~3;
+}
+
+
+/* Mostly small steps, with an occasional jump, like a program walking
+ * through a few data structures.
+ */
+addr_t mixed_next(addr_t address, addr_t mask, uint32_t *p_seed) {
+    uint32_t r = next_random(p_seed);
+
+    if ((r & 15) == 0)
+        return (r >> 4) & mask & ~3;
+    return (address + ((r >> 4) & 28)) & mask;
+}
+
+
+static const pattern_t patterns[] = {
+    { "sequential", "walk through the footprint a word at a time",
+      sequential_next },
+    { "strided", "step 4100 bytes at a time, touching a new block each time",
+      strided_next },
+    { "random", "uniformly random words across the footprint", random_next },
+    { "mixed", "short forward steps with occasional random jumps",
+      mixed_next },
+    { NULL }
+};
+
+
+void cachebench_usage(const char *progname) {
+    int i;
+
+    printf("usage: %s [-n accesses] [-f footprint] [-p pattern] "
+           "[-T tlb-spec ...]\n\t[-P page-size] [cache-spec ...]\n\n",
+           progname);
+    printf("\t-n accesses     number of accesses to simulate (default %d)\n",
+           DEFAULT_ACCESSES);
+    printf("\t-f footprint    bytes the accesses range over; must be a power "
+           "of 2\n\t                (default %d)\n", DEFAULT_FOOTPRINT);
+    printf("\t-p pattern      the pattern of accesses (default %s):\n",
+           patterns[0].name);
+    for (i = 0; patterns[i].name != NULL; i++)
+        printf("\t\t%-12s%s\n", patterns[i].name, patterns[i].description);
+    printf("\n");
+    printf("\tEvery %dth access is a write.\n", WRITE_PERIOD);
+    printf("\tCache specifications are described below.\n\n");
+    usage(progname);
+}
+
+
+double now_sec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main(int argc, const char **argv) {
+    uint32_t num_accesses = DEFAULT_ACCESSES, footprint = DEFAULT_FOOTPRINT;
+    uint32_t seed = 2463534242U, i;
+    const pattern_t *pattern = patterns;
+    membase_t *p_mem;
+    addr_t address = 0, mask;
+    double start, elapsed;
+    int opt;
+
+    while ((opt = getopt(argc, (char * const *) argv, "n:f:p:T:P:")) != -1) {
+        switch (opt) {
+        case 'n':
+            num_accesses = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'f':
+            footprint = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'p':
+            for (pattern = patterns; pattern->name != NULL; pattern++) {
+                if (strcmp(pattern->name, optarg) == 0)
+                    break;
+            }
+            if (pattern->name == NULL) {
+                printf("ERROR:  unknown pattern \"%s\".\n", optarg);
+                cachebench_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        case 'T':
+        case 'P':
+            if ((opt == 'T') ? parse_tlb_spec(optarg) != 0 :
+                               parse_page_size(optarg) != 0) {
+                cachebench_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        default:
+            cachebench_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (footprint < 4 || !is_power_of_2(footprint) ||
+        footprint > (1U << 31)) {
+        printf("ERROR:  footprint must be a power of 2, from 4 to 2^31.\n");
+        cachebench_usage(argv[0]);
+        return 1;
+    }
+    mask = footprint - 1;
+
+    /* The remaining arguments are the cache specifications. */
+    argv[optind - 1] = argv[0];
+    p_mem = make_cached_memory(argc - optind + 1, argv + optind - 1,
+                               footprint);
+
+    printf("Simulating %u %s accesses over %u bytes.\n", num_accesses,
+           pattern->name, footprint);
+
+    start = now_sec();
+    for (i = 0; i < num_accesses; i++) {
+        address = pattern->next(address, mask, &seed);
+        if (i % WRITE_PERIOD == WRITE_PERIOD - 1)
+            write_word(p_mem, address, i);
+        else
+            read_word(p_mem, address);
+    }
+    elapsed = now_sec() - start;
+
+    printf("Simulation time:  %.3f sec, %.2f million accesses/sec\n", elapsed,
+           (elapsed > 0) ? num_accesses / elapsed / 1e6 : 0.0);
+
+    printf("\nMemory-Access Statistics:\n\n");
+    p_mem->print_stats(p_mem);
+    printf("\n");
+
+    return 0;
+}
@@ -1,25 +1,468 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 #include "cmdline.h"
 #include "memory.h"
 #include "cache.h"
+#include "replace.h"
+#include "prefetch.h"
+#include "profile.h"
+#include "tlb.h"
 
 
-/* Prints the program usage. */
-void usage(const char *progname) {
-    printf("usage: %s [cache-spec ...]\n\n", progname);
+/* The options that may follow B:S:E in a cache specification. */
+typedef struct cache_options {
+    const replpolicy_t *policy;
+    const prefetcher_t *prefetcher;
+    uint32_t prefetch_degree;
+    int write_through;
+    int write_allocate;
+    uint32_t wc_entries;
+    int classify;
+    uint32_t hit_latency;
+    uint32_t num_mshrs;
+    uint32_t vc_entries;
+    inclusion_policy inclusion;
+    int tag_only;
+} cache_options;
+
+
+/* The file to write statistics to, or NULL, and the number of caches built
+ * by make_cached_memory().
+ */
+static const char *stats_path = NULL;
+static int num_caches = 0;
+
+/* The memory timing given with -M. */
+static uint32_t mem_latency = DEFAULT_MEM_LATENCY;
+static uint32_t mem_bandwidth = DEFAULT_MEM_BANDWIDTH;
+
+/* The levels of TLB given with -T, and the page size given with -P, and the
+ * TLB built from them by make_cached_memory(), or NULL.
+ */
+static uint32_t num_tlb_levels = 0;
+static uint32_t tlb_entries[MAX_TLB_LEVELS];
+static uint32_t tlb_ways[MAX_TLB_LEVELS];
+static uint32_t tlb_latency[MAX_TLB_LEVELS];
+static uint32_t page_bits = PAGE_BITS_4K;
+static tlb_t *p_built_tlb = NULL;
+
+/* Nonzero if every cache only keeps tags, as set by set_tag_only_caches(). */
+static int tag_only_caches = 0;
+
+
+/* Prints the description of cache specifications, for programs that take
+ * them without the other options.
+ */
+void cache_spec_usage() {
+    int i;
+
     printf("\tAll arguments are cache specifications in the form B:S:E, where\n");
     printf("\tB, S and E are all positive integers with the following meanings:\n");
     printf("\t\tB = block size for the cache, in bytes (must be a power of 2)\n");
     printf("\t\tS = the number of cache-sets in the cache (must be a power of 2)\n");
     printf("\t\tE = the number of cache-lines in each cache-set (may be 1 or more)\n");
     printf("\n");
+    printf("\tOptions may be appended as B:S:E:option:option..., from:\n");
+    printf("\t\tA replacement policy, one of:  ");
+    for (i = 0; replacement_policies[i] != NULL; i++)
+        printf("%s ", replacement_policies[i]->name);
+    printf("\n\t\t(default %s).  plru needs a power-of-2 E, and opt (Belady's\n",
+           replacement_policies[0]->name);
+    printf("\t\toptimal policy) needs the lookahead of a trace-driven simulation.\n");
+    printf("\t\tA prefetcher, one of:  ");
+    for (i = 0; prefetchers[i] != NULL; i++)
+        printf("%s ", prefetchers[i]->name);
+    printf("\n\t\toptionally with a degree, e.g. stream=4 (default %d).\n",
+           DEFAULT_PREFETCH_DEGREE);
+    printf("\t\tA write policy:  wb (write-back, the default) or wt "
+           "(write-through),\n");
+    printf("\t\tand wa (write-allocate, the default) or nwa "
+           "(no-write-allocate).\n");
+    printf("\t\twc=N, for an N-entry write-combining buffer in front of the "
+           "next\n\t\tlevel (default %d entries).\n", DEFAULT_WC_ENTRIES);
+    printf("\t\t3c, to classify misses as compulsory, capacity or conflict.\n");
+    printf("\t\tlat=N, for a hit latency of N cycles (default %d), and "
+           "mshr=N, for N\n\t\tMSHRs, i.e. outstanding misses (default %d, "
+           "0 for no limit).\n", DEFAULT_HIT_LATENCY, DEFAULT_MSHRS);
+    printf("\t\tvc=N, for an N-entry fully-associative victim cache "
+           "(default %d\n\t\tentries).\n", DEFAULT_VICTIM_ENTRIES);
+    printf("\t\tincl, excl or nine, for a cache that is inclusive of, "
+           "exclusive of,\n\t\tor neither (the default) the cache in front "
+           "of it, which must\n\t\thave the same block size.\n");
+    printf("\t\ttags, for a cache that only keeps the tags of its blocks, "
+           "for when the\n\t\tvalues of the data don't matter.\n");
+    printf("\n");
+}
+
+
+/* Prints the program usage. */
+void usage(const char *progname) {
+    printf("usage: %s [-s stats-file] [-M latency[:bandwidth]] "
+           "[-T tlb-spec ...]\n\t[-P page-size] [cache-spec ...]\n\n",
+           progname);
+    cache_spec_usage();
+    printf("\tWith -s, the statistics are also written to stats-file, as JSON "
+           "if its name\n\tends in .json, or CSV otherwise.\n");
+    printf("\tWith -M, the memory has the given latency in cycles (default "
+           "%d), and\n\tbandwidth in bytes per cycle (default %d, 0 for no "
+           "limit).\n", DEFAULT_MEM_LATENCY, DEFAULT_MEM_BANDWIDTH);
+    printf("\tWith -T entries:ways[:lat=N], accesses go through a TLB with "
+           "the given number\n\tof entries, in sets of \"ways\" entries.  "
+           "Up to %d levels of TLB may be given,\n\tfrom the one looked up "
+           "first; a hit in the first adds %d cycles, and in the\n\tothers "
+           "%d, unless lat=N is given.  Misses walk the page table through "
+           "the\n\tcaches.  -P gives the page size, 4K (the default) or "
+           "2M.\n", MAX_TLB_LEVELS, DEFAULT_L1_TLB_LATENCY,
+           DEFAULT_TLB_LATENCY);
+    printf("\n");
     printf("\tThe actual memory size will be fixed by the program itself, as it\n");
     printf("\tdepends on the specific tests being run against the cache simulator.\n");
 }
 
 
+/* Parses the options following B:S:E in a cache specification, which are
+ * separated by colons.  Returns 0 on success, or -1 after printing an error
+ * if an option isn't recognized.
+ */
+int parse_cache_options(const char *spec, int arg_no, cache_options *opts) {
+    char buffer[256], *option, *value;
+    int number;
+
+    opts->policy = replacement_policies[0];
+    opts->prefetcher = NULL;
+    opts->prefetch_degree = DEFAULT_PREFETCH_DEGREE;
+    opts->write_through = 0;
+    opts->write_allocate = 1;
+    opts->wc_entries = 0;
+    opts->classify = 0;
+    opts->hit_latency = DEFAULT_HIT_LATENCY;
+    opts->num_mshrs = DEFAULT_MSHRS;
+    opts->vc_entries = 0;
+    opts->inclusion = INCLUSION_NINE;
+    opts->tag_only = tag_only_caches;
+
+    strncpy(buffer, spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    for (option = strtok(buffer, ":"); option != NULL;
+         option = strtok(NULL, ":")) {
+        if (find_replacement_policy(option) != NULL) {
+            opts->policy = find_replacement_policy(option);
+            continue;
+        }
+
+        if (strcmp(option, "wb") == 0 || strcmp(option, "wt") == 0) {
+            opts->write_through = (option[1] == 't');
+            continue;
+        }
+        if (strcmp(option, "wa") == 0 || strcmp(option, "nwa") == 0) {
+            opts->write_allocate = (option[0] == 'w');
+            continue;
+        }
+        if (strcmp(option, "3c") == 0) {
+            opts->classify = 1;
+            continue;
+        }
+        if (strcmp(option, "incl") == 0) {
+            opts->inclusion = INCLUSION_INCLUSIVE;
+            continue;
+        }
+        if (strcmp(option, "excl") == 0) {
+            opts->inclusion = INCLUSION_EXCLUSIVE;
+            continue;
+        }
+        if (strcmp(option, "nine") == 0) {
+            opts->inclusion = INCLUSION_NINE;
+            continue;
+        }
+        if (strcmp(option, "tags") == 0) {
+            opts->tag_only = 1;
+            continue;
+        }
+
+        value = strchr(option, '=');
+        if (value != NULL)
+            *value++ = '\0';
+
+        if (strcmp(option, "wc") == 0) {
+            number = (value != NULL) ? atoi(value) : DEFAULT_WC_ENTRIES;
+            if (number <= 0) {
+                printf("ERROR:  argument %d:  write-combining buffer size "
+                       "must be a positive integer.\n", arg_no);
+                return -1;
+            }
+            opts->wc_entries = number;
+            continue;
+        }
+
+        if (strcmp(option, "vc") == 0) {
+            number = (value != NULL) ? atoi(value) : DEFAULT_VICTIM_ENTRIES;
+            if (number <= 0) {
+                printf("ERROR:  argument %d:  victim cache size must be a "
+                       "positive integer.\n", arg_no);
+                return -1;
+            }
+            opts->vc_entries = number;
+            continue;
+        }
+
+        if (strcmp(option, "lat") == 0 || strcmp(option, "mshr") == 0) {
+            if (value == NULL || *value < '0' || *value > '9') {
+                printf("ERROR:  argument %d:  %s needs a number of %s.\n",
+                       arg_no, option, (option[0] == 'l') ? "cycles" : "MSHRs");
+                return -1;
+            }
+            if (option[0] == 'l')
+                opts->hit_latency = strtoul(value, NULL, 0);
+            else
+                opts->num_mshrs = strtoul(value, NULL, 0);
+            continue;
+        }
+
+        if (find_prefetcher(option) != NULL) {
+            opts->prefetcher = find_prefetcher(option);
+            if (value != NULL) {
+                number = atoi(value);
+                if (number <= 0) {
+                    printf("ERROR:  argument %d:  prefetch degree must be "
+                           "a positive integer.\n", arg_no);
+                    return -1;
+                }
+                opts->prefetch_degree = number;
+            }
+            continue;
+        }
+
+        printf("ERROR:  argument %d:  unknown cache option \"%s\".\n",
+               arg_no, option);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Builds a cache in front of next_mem from a cache specification, which is
+ * argument arg_no of the program.  If the specification is invalid, prints
+ * an error and the program usage, and exits.  mem_size is the size of the
+ * memory, which prefetches must not go past.
+ */
+cache_t * make_cache(const char *progname, const char *spec, int arg_no,
+                     membase_t *next_mem, uint32_t mem_size) {
+    int block_size, num_sets, lines_per_set, spec_length = 0;
+    cache_options opts;
+    cache_t *p_cache;
+    int ct = sscanf(spec, "%d:%d:%d%n",
+                    &block_size, &num_sets, &lines_per_set, &spec_length);
+
+    if (ct != 3 || (spec[spec_length] != '\0' && spec[spec_length] != ':')) {
+        printf("ERROR:  argument %d isn't correctly formatted.\n", arg_no);
+        usage(progname);
+        exit(1);
+    }
+
+    if (block_size <= 0 || !is_power_of_2(block_size)) {
+        printf("ERROR:  argument %d:  block size must be a positive "
+               "power of 2, got %d.\n", arg_no, block_size);
+        usage(progname);
+        exit(1);
+    }
+
+    if (num_sets <= 0 || !is_power_of_2(num_sets)) {
+        printf("ERROR:  argument %d:  number of cache-sets must be a "
+               "positive power of 2, got %d.\n", arg_no, num_sets);
+        usage(progname);
+        exit(1);
+    }
+
+    if (lines_per_set <= 0) {
+        printf("ERROR:  argument %d:  number of cache-lines per set "
+               "must be a positive integer, got %d.\n", arg_no,
+               lines_per_set);
+        usage(progname);
+        exit(1);
+    }
+
+    if (parse_cache_options(spec + spec_length, arg_no, &opts) != 0) {
+        usage(progname);
+        exit(1);
+    }
+
+    printf(" * Building cache with a block-size of %d bytes, %d cache-sets,\n"
+           "   and %d cache-lines per set.  Total cache size is %d bytes.\n",
+           block_size, num_sets, lines_per_set,
+           block_size * num_sets * lines_per_set);
+
+    p_cache = malloc(sizeof(cache_t));
+    init_cache(p_cache, block_size, num_sets, lines_per_set, next_mem);
+
+    if (set_replacement_policy(p_cache, opts.policy) != 0) {
+        printf("ERROR:  argument %d:  the %s replacement policy can't be "
+               "used with this cache.\n", arg_no, opts.policy->name);
+        usage(progname);
+        exit(1);
+    }
+    printf("   Replacement policy is %s.\n", opts.policy->name);
+
+    if (opts.write_through || !opts.write_allocate || opts.wc_entries) {
+        set_write_policy(p_cache, opts.write_through, opts.write_allocate,
+                         opts.wc_entries);
+        printf("   Write policy is %s, %s",
+               opts.write_through ? "write-through" : "write-back",
+               opts.write_allocate ? "write-allocate" : "no-write-allocate");
+        if (opts.wc_entries > 0)
+            printf(", with a %u-entry write-combining buffer",
+                   opts.wc_entries);
+        printf(".\n");
+    }
+
+    if (opts.prefetcher != NULL) {
+        set_prefetcher(p_cache, opts.prefetcher, opts.prefetch_degree,
+                       mem_size);
+        printf("   Prefetcher is %s, with a degree of %u.\n",
+               opts.prefetcher->name, opts.prefetch_degree);
+    }
+
+    if (opts.classify) {
+        set_miss_classification(p_cache, 1);
+        printf("   Misses are classified as compulsory, capacity or "
+               "conflict.\n");
+    }
+
+    set_cache_timing(p_cache, opts.hit_latency, opts.num_mshrs);
+    if (opts.hit_latency != DEFAULT_HIT_LATENCY ||
+        opts.num_mshrs != DEFAULT_MSHRS) {
+        printf("   Hit latency is %u cycles, with ", opts.hit_latency);
+        if (opts.num_mshrs > 0)
+            printf("%u MSHRs.\n", opts.num_mshrs);
+        else
+            printf("no limit on outstanding misses.\n");
+    }
+
+    if (opts.vc_entries > 0) {
+        set_victim_cache(p_cache, opts.vc_entries);
+        printf("   Victim cache has %u entries.\n", opts.vc_entries);
+    }
+
+    if (opts.inclusion != INCLUSION_NINE) {
+        set_inclusion_policy(p_cache, opts.inclusion);
+        printf("   Cache is %s of the cache in front of it.\n",
+               (opts.inclusion == INCLUSION_INCLUSIVE) ?
+               "inclusive" : "exclusive");
+    }
+
+    if (opts.tag_only) {
+        set_tag_only(p_cache);
+        if (!tag_only_caches)
+            printf("   Cache keeps only the tags of its blocks.\n");
+    }
+
+    return p_cache;
+}
+
+
+/* Parses a memory timing given with -M, as latency[:bandwidth], for
+ * make_memory() to use.  Returns 0 on success, or -1 after printing an
+ * error.
+ */
+int parse_memory_timing(const char *spec) {
+    unsigned int latency, bandwidth = mem_bandwidth;
+    int ct, length = 0;
+
+    ct = sscanf(spec, "%u%n:%u%n", &latency, &length, &bandwidth, &length);
+    if (ct < 1 || spec[length] != '\0') {
+        printf("ERROR:  -M needs a latency in cycles, optionally followed "
+               "by :bandwidth.\n");
+        return -1;
+    }
+
+    mem_latency = latency;
+    mem_bandwidth = bandwidth;
+    return 0;
+}
+
+
+/* Parses a level of TLB given with -T, as entries:ways[:lat=N], for
+ * make_cached_memory() to put in front of the caches.  Returns 0 on
+ * success, or -1 after printing an error.
+ */
+int parse_tlb_spec(const char *spec) {
+    unsigned int entries, ways, latency;
+    int ct, length = 0;
+
+    if (num_tlb_levels == MAX_TLB_LEVELS) {
+        printf("ERROR:  -T may only be given %d times.\n", MAX_TLB_LEVELS);
+        return -1;
+    }
+
+    latency = (num_tlb_levels == 0) ? DEFAULT_L1_TLB_LATENCY :
+                                      DEFAULT_TLB_LATENCY;
+    ct = sscanf(spec, "%u:%u%n:lat=%u%n", &entries, &ways, &length, &latency,
+                &length);
+    if (ct < 2 || spec[length] != '\0') {
+        printf("ERROR:  -T needs entries:ways, optionally followed by "
+               ":lat=N.\n");
+        return -1;
+    }
+    if (ways == 0 || entries == 0 || entries % ways != 0 ||
+        !is_power_of_2(entries / ways)) {
+        printf("ERROR:  -T %s:  entries / ways must be a power of 2.\n",
+               spec);
+        return -1;
+    }
+
+    tlb_entries[num_tlb_levels] = entries;
+    tlb_ways[num_tlb_levels] = ways;
+    tlb_latency[num_tlb_levels] = latency;
+    num_tlb_levels++;
+    return 0;
+}
+
+
+/* Parses a page size given with -P, 4K or 2M.  Returns 0 on success, or -1
+ * after printing an error.
+ */
+int parse_page_size(const char *spec) {
+    if (strcasecmp(spec, "4K") == 0) {
+        page_bits = PAGE_BITS_4K;
+    }
+    else if (strcasecmp(spec, "2M") == 0) {
+        page_bits = PAGE_BITS_2M;
+    }
+    else {
+        printf("ERROR:  -P needs a page size of 4K or 2M.\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+/* Returns the TLB built by make_cached_memory(), or NULL if -T wasn't
+ * given.
+ */
+tlb_t * get_tlb() {
+    return p_built_tlb;
+}
+
+
+/* Builds the memory at the bottom of a simulated memory hierarchy, with the
+ * timing given with -M.
+ */
+memory_t * make_memory(uint32_t mem_size) {
+    memory_t *p_memory;
+
+    printf(" * Building memory of size %u bytes\n", mem_size);
+    p_memory = malloc(sizeof(memory_t));
+    init_memory(p_memory, mem_size);
+    set_memory_timing(p_memory, mem_latency, mem_bandwidth);
+
+    return p_memory;
+}
+
+
 /* Initializes a set of caches and a memory, using the cache configuration
  * specified from command-line arguments.
  *
@@ -29,69 +472,211 @@ void usage(const char *progname) {
  */
 membase_t * make_cached_memory(int argc, const char **argv,
                                uint32_t mem_size) {
-    int i;
+    int i, level, *arg_nos;
     const char *progname;
     membase_t **p_mems;
     memory_t *p_memory;
-    cache_t *p_cache;
+    addr_t table_base = 0;
+    uint32_t total_size = mem_size;
     
     progname = argv[0];
-    argc--;
-    argv++;
+
+    /* Pick out an optional "-s stats-file", "-M timing", "-T tlb-spec" and
+     * "-P page-size"; the other arguments are cache specifications.
+     * Remember where each one was, for error messages.
+     */
+    arg_nos = malloc(argc * sizeof(int));
+    num_caches = 0;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0) {
+            if (i + 1 == argc) {
+                printf("ERROR:  -s needs a file name.\n");
+                usage(progname);
+                exit(1);
+            }
+            set_stats_file(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-M") == 0) {
+            if (i + 1 == argc) {
+                printf("ERROR:  -M needs a memory timing.\n");
+                usage(progname);
+                exit(1);
+            }
+            if (parse_memory_timing(argv[++i]) != 0) {
+                usage(progname);
+                exit(1);
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "-T") == 0 || strcmp(argv[i], "-P") == 0) {
+            if (i + 1 == argc) {
+                printf("ERROR:  %s needs an argument.\n", argv[i]);
+                usage(progname);
+                exit(1);
+            }
+            if (argv[i][1] == 'T' ? parse_tlb_spec(argv[i + 1]) != 0 :
+                                    parse_page_size(argv[i + 1]) != 0) {
+                usage(progname);
+                exit(1);
+            }
+            i++;
+            continue;
+        }
+        arg_nos[num_caches++] = i;
+    }
+
+    /* The page table goes past the memory the program uses, on a page
+     * boundary.
+     */
+    if (num_tlb_levels > 0) {
+        table_base = (mem_size + (1 << PAGE_BITS_4K) - 1) &
+                     ~((1 << PAGE_BITS_4K) - 1);
+        total_size = table_base + page_table_size(mem_size, page_bits);
+    }
     
-    p_mems = malloc((argc + 1) * sizeof(membase_t *));
+    p_mems = malloc((num_caches + 1) * sizeof(membase_t *));
 
     printf("Constructing memory for simulation (in reverse order):\n");
     
-    printf(" * Building memory of size %u bytes\n", mem_size);
-    p_memory = malloc(sizeof(memory_t));
-    init_memory(p_memory, mem_size);
-    p_mems[argc] = (membase_t *) p_memory;
+    p_memory = make_memory(total_size);
+    p_mems[num_caches] = (membase_t *) p_memory;
     
-    for (i = argc - 1; i >= 0; i--) {
-        int block_size, num_sets, lines_per_set;
-        int ct = sscanf(argv[i], "%d:%d:%d",
-                        &block_size, &num_sets, &lines_per_set);
-        if (ct != 3) {
-            printf("ERROR:  argument %d isn't correctly formatted.\n", i + 1);
-            usage(progname);
-            exit(1);
-        }
-        
-        if (block_size <= 0 || !is_power_of_2(block_size)) {
-            printf("ERROR:  argument %d:  block size must be a positive "
-                   "power of 2, got %d.\n", i + 1, block_size);
-            usage(progname);
-            exit(1);
-        }
-
-        if (num_sets <= 0 || !is_power_of_2(num_sets)) {
-            printf("ERROR:  argument %d:  number of cache-sets must be a "
-                   "positive power of 2, got %d.\n", i + 1, num_sets);
-            usage(progname);
-            exit(1);
-        }
+    for (level = num_caches - 1; level >= 0; level--) {
+        p_mems[level] = (membase_t *) make_cache(progname,
+            argv[arg_nos[level]], arg_nos[level], p_mems[level + 1],
+            total_size);
+        if (level + 1 == num_caches)
+            continue;
 
-        if (lines_per_set <= 0) {
-            printf("ERROR:  argument %d:  number of cache-lines per set "
-                   "must be a positive integer, got %d.\n", i + 1,
-                   lines_per_set);
+        if (add_upper_cache((cache_t *) p_mems[level + 1],
+                            (cache_t *) p_mems[level]) != 0) {
+            printf("ERROR:  argument %d:  a cache in front of an inclusive or "
+                   "exclusive\n        cache must have the same block size.\n",
+                   arg_nos[level]);
             usage(progname);
             exit(1);
         }
+    }
+    printf("\n");
 
-        printf(" * Building cache with a block-size of %d bytes, %d cache-sets,\n"
-               "   and %d cache-lines per set.  Total cache size is %d bytes.\n",
-               block_size, num_sets, lines_per_set,
-               block_size * num_sets * lines_per_set);
+    if (num_caches > 0 &&
+        ((cache_t *) p_mems[0])->inclusion != INCLUSION_NINE) {
+        printf("ERROR:  argument %d:  the first cache has no cache in front of "
+               "it to be\n        inclusive or exclusive of.\n", arg_nos[0]);
+        usage(progname);
+        exit(1);
+    }
 
-        p_cache = malloc(sizeof(cache_t));
-        init_cache(p_cache, block_size, num_sets, lines_per_set, p_mems[i + 1]);
+    if (num_tlb_levels > 0) {
+        printf(" * Building %u-level TLB with %s pages, and a page table at "
+               "%u.\n", num_tlb_levels,
+               (page_bits == PAGE_BITS_4K) ? "4KB" : "2MB", table_base);
+        p_built_tlb = malloc(sizeof(tlb_t));
+        init_tlb(p_built_tlb, page_bits, table_base, mem_size, p_mems[0]);
+        for (i = 0; i < num_tlb_levels; i++) {
+            add_tlb_level(p_built_tlb, tlb_entries[i], tlb_ways[i],
+                          tlb_latency[i]);
+            printf("   L%d TLB has %u entries, %u-way, with a hit latency of "
+                   "%u cycles.\n", i + 1, tlb_entries[i], tlb_ways[i],
+                   tlb_latency[i]);
+        }
+        printf("\n");
 
-        p_mems[i] = (membase_t *) p_cache;
+        /* Attribute the page walks' accesses to the page table. */
+        add_profile_region("page table", table_base, total_size - table_base);
+        p_mems[0] = (membase_t *) p_built_tlb;
     }
-    printf("\n");
     
+    free(arg_nos);
     return p_mems[0];
 }
 
+
+/* Makes every cache built from a cache specification keep only the tags of
+ * its blocks, for programs that never look at the data, such as tracesim.
+ */
+void set_tag_only_caches() {
+    tag_only_caches = 1;
+}
+
+
+/* Sets the file that write_stats_file() writes statistics to. */
+void set_stats_file(const char *path) {
+    stats_path = path;
+}
+
+
+/* Writes the statistics of the memory built by make_cached_memory() to the
+ * file given with -s, if there was one:  as JSON if the file name ends in
+ * ".json", or else as CSV.
+ */
+void write_stats_file(membase_t *p_mem) {
+    FILE *file;
+    size_t length;
+
+    if (stats_path == NULL)
+        return;
+
+    file = fopen(stats_path, "w");
+    if (file == NULL) {
+        printf("ERROR:  couldn't write statistics to %s.\n", stats_path);
+        return;
+    }
+
+    /* The statistics cover the caches and memory below any TLB. */
+    if (p_built_tlb != NULL && p_mem == (membase_t *) p_built_tlb)
+        p_mem = p_built_tlb->next_memory;
+
+    length = strlen(stats_path);
+    if (length >= 5 && strcmp(stats_path + length - 5, ".json") == 0)
+        write_stats_json(file, p_mem, num_caches);
+    else
+        write_stats_csv(file, p_mem, num_caches);
+
+    fclose(file);
+    printf("Wrote statistics to %s.\n", stats_path);
+}
+
+
+/* Prints a summary of the time taken by the accesses to the memory built by
+ * make_cached_memory():  the cycles the simulated core took, the average
+ * memory access time (AMAT), and the cycles the core spent stalled, beyond
+ * what it would have taken if every read hit the first level.  With a TLB,
+ * the access time and stalls include translation.
+ */
+void print_timing_summary(membase_t *p_mem) {
+    uint64_t accesses, total_latency, ideal, stalls = 0;
+    uint32_t hit_latency = 0;
+    membase_t *p_first = p_mem;
+
+    if (p_built_tlb != NULL && p_mem == (membase_t *) p_built_tlb)
+        p_first = p_built_tlb->next_memory;
+
+    if (p_first != p_mem) {
+        accesses = p_mem->num_reads + p_mem->num_writes;
+        total_latency = p_built_tlb->total_latency;
+        if (num_caches > 0)
+            hit_latency = ((cache_t *) p_first)->hit_latency;
+    }
+    else if (num_caches > 0) {
+        cache_t *p_cache = (cache_t *) p_mem;
+
+        accesses = p_cache->num_hits + p_cache->num_misses;
+        total_latency = p_cache->total_latency;
+        hit_latency = p_cache->hit_latency;
+    }
+    else {
+        accesses = p_mem->num_reads + p_mem->num_writes;
+        total_latency = ((memory_t *) p_mem)->total_latency;
+    }
+
+    ideal = p_mem->num_reads * hit_latency + p_mem->num_writes;
+    if (p_mem->time > ideal)
+        stalls = p_mem->time - ideal;
+
+    printf("Timing:  %lld cycles, average memory access time %.2f cycles,\n"
+           "         %lld stall cycles (%.2f%%)\n", p_mem->time,
+           (accesses > 0) ? (double) total_latency / accesses : 0.0, stalls,
+           (p_mem->time > 0) ? 100.0 * stalls / p_mem->time : 0.0);
+}
@@ -1,5 +1,20 @@
 #include "membase.h"
+#include "memory.h"
+#include "cache.h"
+#include "tlb.h"
 
 void usage(const char *progname);
+void cache_spec_usage();
 membase_t * make_cached_memory(int argc, const char **argv, uint32_t mem_size);
+cache_t * make_cache(const char *progname, const char *spec, int arg_no,
+                     membase_t *next_mem, uint32_t mem_size);
+int parse_memory_timing(const char *spec);
+memory_t * make_memory(uint32_t mem_size);
+int parse_tlb_spec(const char *spec);
+int parse_page_size(const char *spec);
+tlb_t * get_tlb();
+void set_tag_only_caches();
 
+void set_stats_file(const char *path);
+void write_stats_file(membase_t *p_mem);
+void print_timing_summary(membase_t *p_mem);
@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "coherence.h"
+
+
+/* Set this to a nonzero value and rebuild to see debug output. */
+#define DEBUG_COHERENCE 0
+
+
+/* Local functions used by the coherence implementation. */
+
+cache_t * core_cache(bus_t *p_bus, uint32_t core, uint32_t level);
+mesi_state core_state(bus_t *p_bus, uint32_t core, addr_t address);
+void set_core_state(bus_t *p_bus, uint32_t core, addr_t address,
+                    mesi_state state);
+
+void acquire_block(bus_t *p_bus, cache_t *p_cache, addr_t address,
+                   uint32_t size, mesi_state state);
+int snoop_read(bus_t *p_bus, uint32_t core, addr_t address);
+void snoop_invalidate(bus_t *p_bus, uint32_t core, addr_t address,
+                      uint32_t size);
+
+sharing_entry_t * sharing_slot(bus_t *p_bus, uint32_t core, addr_t block);
+uint64_t word_mask(bus_t *p_bus, addr_t address, uint32_t size);
+void note_write(bus_t *p_bus, uint32_t core, addr_t address, uint32_t size);
+void classify_miss(bus_t *p_bus, uint32_t core, addr_t address,
+                   uint32_t size);
+
+
+/* Initializes a bus connecting the private caches of num_cores cores, with
+ * num_levels caches per core.  "caches" lists each core's caches in turn,
+ * from the level the core accesses down to the one in front of the shared
+ * memory.  Returns 0 on success, or -1 if the caches don't all have the same
+ * block size, or one is no-write-allocate, has a write-combining buffer or
+ * victim cache, or is inclusive or exclusive.
+ */
+int init_bus(bus_t *p_bus, uint32_t num_cores, uint32_t num_levels,
+             cache_t **caches) {
+    uint32_t i, num_caches = num_cores * num_levels;
+
+    assert(num_cores > 0);
+    assert(num_levels > 0);
+
+    for (i = 0; i < num_caches; i++) {
+        if (caches[i]->block_size != caches[0]->block_size ||
+            !caches[i]->write_allocate || caches[i]->wc_entries > 0 ||
+            caches[i]->vc_entries > 0 ||
+            caches[i]->inclusion != INCLUSION_NINE)
+            return -1;
+    }
+
+    bzero(p_bus, sizeof(bus_t));
+    p_bus->num_cores = num_cores;
+    p_bus->num_levels = num_levels;
+    p_bus->block_size = caches[0]->block_size;
+
+    p_bus->caches = malloc(num_caches * sizeof(cache_t *));
+    memcpy(p_bus->caches, caches, num_caches * sizeof(cache_t *));
+    for (i = 0; i < num_caches; i++) {
+        caches[i]->bus = p_bus;
+        caches[i]->core = i / num_levels;
+    }
+
+    /* Use 4-byte words, or 64 words per block for larger blocks. */
+    p_bus->word_bits = caches[0]->block_offset_bits;
+    p_bus->word_bits = (p_bus->word_bits > 8) ? p_bus->word_bits - 6 : 2;
+
+    p_bus->filters = calloc(num_cores * SHARING_FILTER_SIZE,
+                            sizeof(sharing_entry_t));
+    return 0;
+}
+
+
+/* Prints the bus's coherence statistics. */
+void print_bus_stats(bus_t *p_bus) {
+    printf(" * MESI bus, %u cores:  bus-reads=%lld read-exclusives=%lld "
+           "upgrades=%lld\n", p_bus->num_cores, p_bus->num_bus_reads,
+           p_bus->num_bus_read_exclusives, p_bus->num_bus_upgrades);
+    printf("   invalidations=%lld interventions=%lld\n",
+           p_bus->num_invalidations, p_bus->num_interventions);
+    printf("   coherence misses:  true-sharing=%lld false-sharing=%lld\n",
+           p_bus->num_true_sharing_misses, p_bus->num_false_sharing_misses);
+}
+
+
+void reset_bus_stats(bus_t *p_bus) {
+    p_bus->num_bus_reads = 0;
+    p_bus->num_bus_read_exclusives = 0;
+    p_bus->num_bus_upgrades = 0;
+    p_bus->num_invalidations = 0;
+    p_bus->num_interventions = 0;
+    p_bus->num_true_sharing_misses = 0;
+    p_bus->num_false_sharing_misses = 0;
+}
+
+
+/* Releases the bus's own memory.  The caches are not freed. */
+void free_bus(bus_t *p_bus) {
+    free(p_bus->caches);
+    free(p_bus->filters);
+}
+
+
+/* This function is called when an access to a coherent cache misses, before
+ * the block is loaded.  If the core already holds the block in another of
+ * its caches, the new line takes on the core's state without involving the
+ * bus.  Otherwise a read goes on the bus, and the line is exclusive unless
+ * another core holds the block too.  Writes make the core the block's
+ * owner.  "allocate" is zero for a write that won't be loaded into the
+ * cache; it is sent on to the next level, so unless this is the last
+ * private level, the next level takes care of the bus.
+ */
+mesi_state coherent_miss(cache_t *p_cache, addr_t address, uint32_t size,
+                         int write, int allocate) {
+    bus_t *p_bus = p_cache->bus;
+    uint32_t core = p_cache->core;
+    mesi_state state;
+
+    if (!allocate &&
+        p_cache != core_cache(p_bus, core, p_bus->num_levels - 1)) {
+        if (p_cache == core_cache(p_bus, core, 0))
+            note_write(p_bus, core, address, size);
+        return MESI_INVALID;
+    }
+
+    state = core_state(p_bus, core, address);
+    if (state == MESI_INVALID)
+        classify_miss(p_bus, core, address, size);
+
+    if (write) {
+        acquire_block(p_bus, p_cache, address, size, state);
+        return allocate ? MESI_MODIFIED : MESI_INVALID;
+    }
+
+    if (state == MESI_SHARED)
+        return MESI_SHARED;
+    if (state != MESI_INVALID)
+        return MESI_EXCLUSIVE;
+
+#if DEBUG_COHERENCE
+    printf(" * Core %u:  bus read of address %u\n", core, address);
+#endif
+
+    p_bus->num_bus_reads++;
+    return snoop_read(p_bus, core, address) ? MESI_SHARED : MESI_EXCLUSIVE;
+}
+
+
+/* This function is called when a write hits in a coherent cache.  A shared
+ * line must be upgraded first, invalidating the other cores' copies; an
+ * exclusive line just becomes modified.
+ */
+void coherent_write_hit(cache_t *p_cache, cacheline_t *p_line,
+                        addr_t address, uint32_t size) {
+    acquire_block(p_cache->bus, p_cache, address, size,
+                  p_line->coherence_state);
+    p_line->coherence_state = MESI_MODIFIED;
+}
+
+
+/*---------------------------------------------------------------------------
+ * COHERENCE HELPER FUNCTIONS
+ */
+
+
+/* Returns one of a core's private caches; level 0 is the one the core
+ * accesses.
+ */
+cache_t * core_cache(bus_t *p_bus, uint32_t core, uint32_t level) {
+    return p_bus->caches[core * p_bus->num_levels + level];
+}
+
+
+/* Returns the state of a block in a core:  the strongest state of the
+ * core's copies of it, or MESI_INVALID if it has none.
+ */
+mesi_state core_state(bus_t *p_bus, uint32_t core, addr_t address) {
+    mesi_state state = MESI_INVALID;
+    cacheline_t *p_line;
+    uint32_t level;
+
+    for (level = 0; level < p_bus->num_levels; level++) {
+        p_line = find_cache_line(core_cache(p_bus, core, level), address);
+        if (p_line != NULL && p_line->coherence_state > state)
+            state = p_line->coherence_state;
+    }
+    return state;
+}
+
+
+/* Sets the state of all of a core's copies of a block. */
+void set_core_state(bus_t *p_bus, uint32_t core, addr_t address,
+                    mesi_state state) {
+    cacheline_t *p_line;
+    uint32_t level;
+
+    for (level = 0; level < p_bus->num_levels; level++) {
+        p_line = find_cache_line(core_cache(p_bus, core, level), address);
+        if (p_line != NULL)
+            p_line->coherence_state = state;
+    }
+}
+
+
+/* Makes the core of p_cache the owner of a block, for a write to
+ * [address, address + size).  "state" is the core's current state for the
+ * block.  Unless the core already owns it, the other cores' copies are
+ * invalidated, with an upgrade if the core has a shared copy, or a read for
+ * ownership if it has none, and the core's copies become exclusive.
+ */
+void acquire_block(bus_t *p_bus, cache_t *p_cache, addr_t address,
+                   uint32_t size, mesi_state state) {
+    uint32_t core = p_cache->core;
+
+    if (state != MESI_EXCLUSIVE && state != MESI_MODIFIED) {
+#if DEBUG_COHERENCE
+        printf(" * Core %u:  bus %s of address %u\n", core,
+               state == MESI_SHARED ? "upgrade" : "read-exclusive", address);
+#endif
+
+        if (state == MESI_SHARED)
+            p_bus->num_bus_upgrades++;
+        else
+            p_bus->num_bus_read_exclusives++;
+
+        snoop_invalidate(p_bus, core, address, size);
+        set_core_state(p_bus, core, address, MESI_EXCLUSIVE);
+    }
+
+    /* Only writes by the core itself count for the sharing filters, not
+     * write-backs from one private level to the next.
+     */
+    if (p_cache == core_cache(p_bus, core, 0))
+        note_write(p_bus, core, address, size);
+}
+
+
+/* Snoops a bus read by a core:  every other core flushes any writes it has
+ * made to the block out to the shared memory, and its copies become shared.
+ * Returns nonzero if any other core holds the block.
+ */
+int snoop_read(bus_t *p_bus, uint32_t core, addr_t address) {
+    uint32_t other, level;
+    int shared = 0, flushed;
+
+    for (other = 0; other < p_bus->num_cores; other++) {
+        if (other == core)
+            continue;
+
+        /* Clean the core's copies from the top level down, so that its
+         * writes reach the shared memory.
+         */
+        flushed = 0;
+        for (level = 0; level < p_bus->num_levels; level++)
+            flushed |= clean_cache_block(core_cache(p_bus, other, level),
+                                         address);
+        if (flushed)
+            p_bus->num_interventions++;
+
+        if (core_state(p_bus, other, address) != MESI_INVALID) {
+            set_core_state(p_bus, other, address, MESI_SHARED);
+            shared = 1;
+        }
+    }
+
+    return shared;
+}
+
+
+/* Snoops a write to [address, address + size) by a core:  every other core
+ * flushes any writes it has made to the block, and invalidates its copies.
+ * The cores that lose the block remember it in their sharing filters.
+ */
+void snoop_invalidate(bus_t *p_bus, uint32_t core, addr_t address,
+                      uint32_t size) {
+    addr_t block = address >> p_bus->caches[0]->block_offset_bits;
+    sharing_entry_t *p_entry;
+    uint32_t other, level;
+    mesi_state state;
+    int flushed;
+
+    for (other = 0; other < p_bus->num_cores; other++) {
+        if (other == core)
+            continue;
+
+        state = core_state(p_bus, other, address);
+        flushed = 0;
+        for (level = 0; level < p_bus->num_levels; level++)
+            flushed |= invalidate_cache_block(core_cache(p_bus, other, level),
+                                              address);
+        if (flushed)
+            p_bus->num_interventions++;
+
+        if (state == MESI_INVALID)
+            continue;
+
+        p_bus->num_invalidations++;
+        p_entry = sharing_slot(p_bus, other, block);
+        p_entry->block = block + 1;
+        p_entry->written = word_mask(p_bus, address, size);
+    }
+}
+
+
+/* Returns the entry of a core's sharing filter for a block number.
+ * Colliding blocks simply replace each other.
+ */
+sharing_entry_t * sharing_slot(bus_t *p_bus, uint32_t core, addr_t block) {
+    return p_bus->filters + core * SHARING_FILTER_SIZE +
+           ((block * 2654435761U) & (SHARING_FILTER_SIZE - 1));
+}
+
+
+/* Returns a mask with a bit set for each word of its block that
+ * [address, address + size) touches.
+ */
+uint64_t word_mask(bus_t *p_bus, addr_t address, uint32_t size) {
+    addr_t offset = address & (p_bus->block_size - 1);
+    uint32_t first, last;
+
+    if (size == 0)
+        return 0;
+
+    if (size > p_bus->block_size - offset)
+        size = p_bus->block_size - offset;
+
+    first = offset >> p_bus->word_bits;
+    last = (offset + size - 1) >> p_bus->word_bits;
+    if (last - first == 63)
+        return ~(uint64_t) 0;
+    return (((uint64_t) 1 << (last - first + 1)) - 1) << first;
+}
+
+
+/* Records a write by a core in the other cores' sharing filters, for the
+ * cores that have lost the block.
+ */
+void note_write(bus_t *p_bus, uint32_t core, addr_t address, uint32_t size) {
+    addr_t block = address >> p_bus->caches[0]->block_offset_bits;
+    sharing_entry_t *p_entry;
+    uint32_t other;
+
+    for (other = 0; other < p_bus->num_cores; other++) {
+        if (other == core)
+            continue;
+
+        p_entry = sharing_slot(p_bus, other, block);
+        if (p_entry->block == block + 1)
+            p_entry->written |= word_mask(p_bus, address, size);
+    }
+}
+
+
+/* Classifies a miss on a block the core doesn't hold.  If the core lost the
+ * block to another core's write, it is a coherence miss:  true sharing if
+ * another core has since written one of the words being accessed, or false
+ * sharing if they only wrote other words of the block.  Prefetches (a size
+ * of 0) aren't counted, but still use up the filter entry.
+ */
+void classify_miss(bus_t *p_bus, uint32_t core, addr_t address,
+                   uint32_t size) {
+    addr_t block = address >> p_bus->caches[0]->block_offset_bits;
+    sharing_entry_t *p_entry = sharing_slot(p_bus, core, block);
+
+    if (p_entry->block != block + 1)
+        return;
+
+    if (size > 0) {
+        if (p_entry->written & word_mask(p_bus, address, size))
+            p_bus->num_true_sharing_misses++;
+        else
+            p_bus->num_false_sharing_misses++;
+    }
+    p_entry->block = 0;
+}
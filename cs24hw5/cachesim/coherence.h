@@ -0,0 +1,114 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+
+#include "cache.h"
+
+
+/* The MESI states of a line in a coherent cache. */
+typedef enum mesi_state {
+    MESI_INVALID,    /* the line holds nothing */
+    MESI_SHARED,     /* clean, and other cores may hold the block too */
+    MESI_EXCLUSIVE,  /* clean, and no other core holds the block */
+    MESI_MODIFIED    /* written, and no other core holds the block */
+} mesi_state;
+
+
+/* The number of blocks per core remembered after being invalidated by
+ * another core's write, for classifying the misses that follow.
+ */
+#define SHARING_FILTER_SIZE 1024
+
+
+/* An entry of a core's sharing filter:  a block the core lost to another
+ * core's write, and which of its words other cores have written since.
+ * Blocks are divided into up to 64 words for this.
+ */
+typedef struct sharing_entry_t {
+    /* The block number plus 1, or 0 if the entry is empty. */
+    addr_t block;
+
+    uint64_t written;
+} sharing_entry_t;
+
+
+/* This struct represents a snooping bus that keeps the private caches of
+ * several cores coherent with the MESI protocol.  Each core has the same
+ * number of private cache levels, chained through their next_memory
+ * members, and the last level of every core sits in front of the same
+ * shared memory, which is usually a shared last-level cache.  The private
+ * caches must be write-allocate, without write-combining buffers, so that a
+ * core only ever writes blocks it holds.
+ *
+ * Coherence is tracked per core:  all the private copies of a block held by
+ * a core are either shared, or else owned by the core (exclusive or
+ * modified), and the bus only gets involved when a core needs a block it
+ * doesn't hold, or to write a block it doesn't own.  Another core's dirty
+ * copies are flushed to the shared memory before a block is read or taken
+ * from it.
+ */
+typedef struct bus_t {
+    uint32_t num_cores;
+
+    /* The number of private cache levels per core. */
+    uint32_t num_levels;
+
+    /* The private caches, num_levels per core, from the level the core
+     * accesses down to the one in front of the shared memory.
+     */
+    cache_t **caches;
+
+    /* The block size of all the private caches; coherence is kept a block
+     * at a time.
+     */
+    uint32_t block_size;
+
+    /* Words are 2^word_bits bytes for the sharing filters. */
+    uint32_t word_bits;
+
+    /* The sharing filters, SHARING_FILTER_SIZE entries per core. */
+    sharing_entry_t *filters;
+
+    /* The number of bus transactions of each kind:  reads of blocks the
+     * core doesn't hold (BusRd), reads for ownership (BusRdX), and upgrades
+     * of shared blocks to owned ones (BusUpgr).
+     */
+    uint64_t num_bus_reads;
+    uint64_t num_bus_read_exclusives;
+    uint64_t num_bus_upgrades;
+
+    /* The number of times a core's copies of a block were invalidated, and
+     * the number of times a core had to flush writes to a block so another
+     * core could have it.
+     */
+    uint64_t num_invalidations;
+    uint64_t num_interventions;
+
+    /* The misses on blocks lost to another core's write, split by whether
+     * the word being accessed was written by another core (true sharing)
+     * or only other words of the block were (false sharing).
+     */
+    uint64_t num_true_sharing_misses;
+    uint64_t num_false_sharing_misses;
+} bus_t;
+
+
+int init_bus(bus_t *p_bus, uint32_t num_cores, uint32_t num_levels,
+             cache_t **caches);
+
+void print_bus_stats(bus_t *p_bus);
+void reset_bus_stats(bus_t *p_bus);
+void free_bus(bus_t *p_bus);
+
+/* These functions are called by a coherent cache.  coherent_miss() is
+ * called when an access misses, before the block is loaded, and returns the
+ * state to give the new line.  coherent_write_hit() is called when a write
+ * hits, and updates the line's state.  A size of 0 marks a prefetch.
+ */
+mesi_state coherent_miss(cache_t *p_cache, addr_t address, uint32_t size,
+                         int write, int allocate);
+void coherent_write_hit(cache_t *p_cache, cacheline_t *p_line,
+                        addr_t address, uint32_t size);
+
+
+#endif /* COHERENCE_H */
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "heap.h"
+#include "profile.h"
 
 
 /*
@@ -47,6 +48,8 @@ float get_first_value(float_heap *p_heap) {
     /* There needs to be at least one value left in the heap! */
     assert(p_heap->num_values > 0);
 
+    set_access_site("get_first_value");
+
     /* Smallest value is at the root - index 0. */
     result = read_float(p_heap->memory, 0);
 
@@ -82,6 +85,7 @@ void add_value(float_heap *p_heap, float newval) {
 
     /* Add the new value to the end of the heap, then sift up. */
 
+    set_access_site("add_value");
     index = p_heap->num_values;
     write_float(p_heap->memory, index, newval);
     p_heap->num_values++;
@@ -119,7 +123,10 @@ void sift_down(float_heap *p_heap, int index) {
 
     int left_child = LEFT_CHILD(index);
     int right_child = RIGHT_CHILD(index);
-    float index_val = read_float(p_heap->memory, index);
+    float index_val;
+
+    set_access_site("sift_down");
+    index_val = read_float(p_heap->memory, index);
 
     if (left_child >= p_heap->num_values) {
         /* If the left child's index is past the end of the heap
@@ -190,6 +197,7 @@ void sift_up(float_heap *p_heap, int index) {
     /* If the specified value is smaller than its parent value then
      * we have to swap the value and its parent.
      */
+    set_access_site("sift_up");
     if (read_float(p_heap->memory, index) <
         read_float(p_heap->memory, parent_index)) {
         /* Swap the value with its parent value. */
@@ -214,6 +222,7 @@ void swap_values(float_heap *p_heap, int i, int j) {
     assert(j >= 0 && j < p_heap->num_values);
     assert(i != j);
 
+    set_access_site("swap_values");
     i_val = read_float(p_heap->memory, i);
     j_val = read_float(p_heap->memory, j);
 
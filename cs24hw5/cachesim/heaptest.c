@@ -6,6 +6,7 @@
 #include "heap.h"
 #include "memory.h"
 #include "cache.h"
+#include "profile.h"
 
 
 #define NUM_ELEMS 1000000
@@ -59,6 +60,7 @@ int main(int argc, const char **argv) {
     printf("Sorting numbers using the heap.\n");
 
     init_heap(&heap, p_mem, NUM_ELEMS);
+    add_profile_region("heap", 0, NUM_ELEMS * sizeof(float));
     for (i = 0; i < NUM_ELEMS; i++)
         add_value(&heap, inputs[i]);
 
@@ -88,6 +90,9 @@ int main(int argc, const char **argv) {
     printf("\nMemory-Access Statistics:\n\n");
     p_mem->print_stats(p_mem);
     printf("\n");
+    print_timing_summary(p_mem);
+    printf("\n");
+    write_stats_file(p_mem);
 
     return 0;
 }
@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "lookahead.h"
+
+
+/* A slot of the hash table:  a granule, and the first and last entries of
+ * its queue of upcoming accesses.
+ */
+typedef struct granule_queue_t {
+    addr_t granule;
+    int32_t head;
+    int32_t tail;
+} granule_queue_t;
+
+
+/* Local functions used by the lookahead implementation. */
+
+uint32_t hash_granule(addr_t granule);
+granule_queue_t * find_queue(lookahead_t *p_la, addr_t granule);
+int grow_table(lookahead_t *p_la);
+void remove_queue(lookahead_t *p_la, granule_queue_t *p_queue);
+int push_ref(lookahead_t *p_la, addr_t granule, uint64_t seq);
+void pop_ref(lookahead_t *p_la, addr_t granule, uint64_t seq);
+int fill_window(lookahead_t *p_la);
+int update_refs(lookahead_t *p_la, const memaccess_t *access, uint64_t seq,
+                int push);
+
+
+int init_lookahead(lookahead_t *p_la, memtrace_reader_t *reader,
+                   pagemap_t *map, uint32_t granule_size, uint32_t window) {
+    assert(is_power_of_2(granule_size));
+    assert(granule_size <= (1U << map->frame_bits));
+    assert(window > 0);
+
+    bzero(p_la, sizeof(lookahead_t));
+    p_la->reader = reader;
+    p_la->map = map;
+    p_la->granule_bits = log_2(granule_size);
+    p_la->window = window;
+    p_la->free_ref = -1;
+
+    p_la->accesses = malloc(window * sizeof(memaccess_t));
+    if (p_la->accesses == NULL || grow_table(p_la) != 0)
+        return -1;
+
+    return fill_window(p_la);
+}
+
+
+int lookahead_next(lookahead_t *p_la, memaccess_t *access) {
+    if (p_la->next_seq == p_la->read_seq)
+        return p_la->at_end < 0 ? -1 : 0;
+
+    *access = p_la->accesses[p_la->next_seq % p_la->window];
+
+    /* This access is now the current one, so it no longer counts as a next
+     * use of the granules it touches.
+     */
+    update_refs(p_la, access, p_la->next_seq, 0);
+
+    p_la->next_seq++;
+    if (fill_window(p_la) != 0)
+        return -1;
+    return 1;
+}
+
+
+uint64_t lookahead_next_use(void *context, addr_t address, uint32_t size) {
+    lookahead_t *p_la = (lookahead_t *) context;
+    granule_queue_t *p_queue;
+    addr_t granule, last;
+    uint64_t result = UINT64_MAX;
+
+    granule = address >> p_la->granule_bits;
+    last = (address + size - 1) >> p_la->granule_bits;
+    for (; granule <= last; granule++) {
+        p_queue = find_queue(p_la, granule);
+        if (p_queue->head >= 0 && p_la->ref_seq[p_queue->head] < result)
+            result = p_la->ref_seq[p_queue->head];
+    }
+    return result;
+}
+
+
+void free_lookahead(lookahead_t *p_la) {
+    free(p_la->accesses);
+    free(p_la->ref_seq);
+    free(p_la->ref_next);
+    free(p_la->table);
+}
+
+
+/*---------------------------------------------------------------------------
+ * LOOKAHEAD HELPER FUNCTIONS
+ */
+
+
+uint32_t hash_granule(addr_t granule) {
+    granule ^= granule >> 16;
+    granule *= 0x45d9f3b;
+    granule ^= granule >> 16;
+    return granule;
+}
+
+
+/* Returns the slot holding the granule's queue, or the empty slot where it
+ * would go.
+ */
+granule_queue_t * find_queue(lookahead_t *p_la, addr_t granule) {
+    uint32_t i = hash_granule(granule) & (p_la->table_capacity - 1);
+
+    while (p_la->table[i].head >= 0 && p_la->table[i].granule != granule)
+        i = (i + 1) & (p_la->table_capacity - 1);
+    return p_la->table + i;
+}
+
+
+/* Doubles the hash table, keeping the load factor at or below one half. */
+int grow_table(lookahead_t *p_la) {
+    granule_queue_t *old = p_la->table, *p_queue;
+    uint32_t old_capacity = p_la->table_capacity, i;
+
+    p_la->table_capacity = old_capacity ? 2 * old_capacity : 4096;
+    p_la->table = malloc(p_la->table_capacity * sizeof(granule_queue_t));
+    if (p_la->table == NULL) {
+        p_la->table = old;
+        p_la->table_capacity = old_capacity;
+        return -1;
+    }
+    for (i = 0; i < p_la->table_capacity; i++)
+        p_la->table[i].head = -1;
+
+    for (i = 0; i < old_capacity; i++) {
+        if (old[i].head >= 0) {
+            p_queue = find_queue(p_la, old[i].granule);
+            *p_queue = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+
+/* Empties a slot of the hash table, shifting later entries of the probe run
+ * back, so lookups never stop early at the hole.
+ */
+void remove_queue(lookahead_t *p_la, granule_queue_t *p_queue) {
+    uint32_t mask = p_la->table_capacity - 1, i, j, home;
+
+    i = p_queue - p_la->table;
+    j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (p_la->table[j].head < 0)
+            break;
+        home = hash_granule(p_la->table[j].granule) & mask;
+        if ((j > i && (home <= i || home > j)) ||
+            (j < i && (home <= i && home > j))) {
+            p_la->table[i] = p_la->table[j];
+            i = j;
+        }
+    }
+    p_la->table[i].head = -1;
+    p_la->table_count--;
+}
+
+
+/* Appends an access's sequence number to the granule's queue.  Returns 0 on
+ * success, or -1 if out of memory.
+ */
+int push_ref(lookahead_t *p_la, addr_t granule, uint64_t seq) {
+    granule_queue_t *p_queue;
+    int32_t ref;
+
+    if (p_la->free_ref < 0) {
+        /* Double the pool, and chain the new entries onto the free list. */
+        int32_t old_refs = p_la->num_refs, new_refs, i;
+        uint64_t *ref_seq;
+        int32_t *ref_next;
+
+        new_refs = old_refs ? 2 * old_refs : 4096;
+        ref_seq = realloc(p_la->ref_seq, new_refs * sizeof(uint64_t));
+        if (ref_seq == NULL)
+            return -1;
+        p_la->ref_seq = ref_seq;
+        ref_next = realloc(p_la->ref_next, new_refs * sizeof(int32_t));
+        if (ref_next == NULL)
+            return -1;
+        p_la->ref_next = ref_next;
+
+        for (i = old_refs; i < new_refs - 1; i++)
+            p_la->ref_next[i] = i + 1;
+        p_la->ref_next[new_refs - 1] = -1;
+        p_la->free_ref = old_refs;
+        p_la->num_refs = new_refs;
+    }
+
+    ref = p_la->free_ref;
+    p_la->free_ref = p_la->ref_next[ref];
+    p_la->ref_seq[ref] = seq;
+    p_la->ref_next[ref] = -1;
+
+    p_queue = find_queue(p_la, granule);
+    if (p_queue->head >= 0) {
+        p_la->ref_next[p_queue->tail] = ref;
+        p_queue->tail = ref;
+        return 0;
+    }
+
+    if (2 * (p_la->table_count + 1) > p_la->table_capacity) {
+        if (grow_table(p_la) != 0)
+            return -1;
+        p_queue = find_queue(p_la, granule);
+    }
+    p_queue->granule = granule;
+    p_queue->head = p_queue->tail = ref;
+    p_la->table_count++;
+    return 0;
+}
+
+
+/* Removes the access with sequence number "seq" from the front of the
+ * granule's queue.
+ */
+void pop_ref(lookahead_t *p_la, addr_t granule, uint64_t seq) {
+    granule_queue_t *p_queue = find_queue(p_la, granule);
+    int32_t ref = p_queue->head;
+
+    assert(ref >= 0 && p_la->ref_seq[ref] == seq);
+
+    p_queue->head = p_la->ref_next[ref];
+    p_la->ref_next[ref] = p_la->free_ref;
+    p_la->free_ref = ref;
+
+    if (p_queue->head < 0)
+        remove_queue(p_la, p_queue);
+}
+
+
+/* Reads accesses from the trace until the window is full or the trace ends.
+ * Returns 0 on success, or -1 if out of memory.
+ */
+int fill_window(lookahead_t *p_la) {
+    memaccess_t *access;
+    int result;
+
+    while (!p_la->at_end && p_la->read_seq - p_la->next_seq < p_la->window) {
+        access = p_la->accesses + p_la->read_seq % p_la->window;
+        result = memtrace_read(p_la->reader, access);
+        if (result <= 0) {
+            p_la->at_end = (result < 0) ? -1 : 1;
+            break;
+        }
+
+        if (update_refs(p_la, access, p_la->read_seq, 1) != 0)
+            return -1;
+
+        p_la->read_seq++;
+    }
+    return 0;
+}
+
+
+/* Adds the access with sequence number "seq" to the queues of the granules
+ * it touches if "push" is nonzero, or else removes it from them.  The access
+ * is mapped a frame at a time, since neighboring trace frames needn't be
+ * neighbors in the simulated memory.  Returns 0 on success, or -1 if out of
+ * memory.
+ */
+int update_refs(lookahead_t *p_la, const memaccess_t *access, uint64_t seq,
+                int push) {
+    uint64_t address = access->address, end = address + access->size;
+    uint64_t frame_mask = ((uint64_t) 1 << p_la->map->frame_bits) - 1;
+    uint64_t chunk_end;
+    addr_t mapped, granule, last;
+
+    while (address < end) {
+        chunk_end = (address | frame_mask) + 1;
+        if (chunk_end > end || chunk_end == 0)
+            chunk_end = end;
+
+        mapped = map_trace_address(p_la->map, address);
+        granule = mapped >> p_la->granule_bits;
+        last = (mapped + (addr_t) (chunk_end - address) - 1) >>
+               p_la->granule_bits;
+        for (; granule <= last; granule++) {
+            if (!push)
+                pop_ref(p_la, granule, seq);
+            else if (push_ref(p_la, granule, seq) != 0)
+                return -1;
+        }
+
+        address = chunk_end;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+
+#include "membase.h"
+#include "memtrace.h"
+#include "pagemap.h"
+
+
+/* This struct holds a window of upcoming trace accesses, so that Belady's
+ * optimal replacement policy can ask when a block will next be used.  The
+ * accesses are read from a trace reader ahead of the simulation, and each
+ * granule (an aligned block of 2^granule_bits bytes) touched in the window
+ * has a queue of the sequence numbers of the accesses that touch it.
+ *
+ * Addresses are mapped into the simulated memory through tracesim's page
+ * map as they are read, so the granules match the addresses the caches see;
+ * the accesses themselves are returned with their trace addresses.
+ */
+typedef struct lookahead_t {
+    memtrace_reader_t *reader;
+    pagemap_t *map;
+    uint32_t granule_bits;
+
+    /* Ring buffer of the accesses in the window, indexed by sequence number
+     * modulo the window size.
+     */
+    memaccess_t *accesses;
+    uint32_t window;
+
+    /* The sequence numbers of the next access to return, and of the next
+     * access to read from the trace.
+     */
+    uint64_t next_seq;
+    uint64_t read_seq;
+
+    /* Nonzero once the trace has ended; negative if it was malformed. */
+    int at_end;
+
+    /* Pool of queue entries:  ref_seq[i] is a sequence number, and
+     * ref_next[i] the next entry in the same queue, or -1.  Unused entries
+     * are chained from free_ref.
+     */
+    uint64_t *ref_seq;
+    int32_t *ref_next;
+    int32_t num_refs;
+    int32_t free_ref;
+
+    /* Open-addressing hash table from granules to their queues.  An empty
+     * slot has a head of -1.
+     */
+    struct granule_queue_t *table;
+    uint32_t table_capacity;
+    uint32_t table_count;
+} lookahead_t;
+
+
+/* Initializes the lookahead over a trace reader, reading ahead up to
+ * "window" accesses.  The granule size must not be larger than the page
+ * map's frames.  Returns 0 on success, or -1 if out of memory.
+ */
+int init_lookahead(lookahead_t *p_la, memtrace_reader_t *reader,
+                   pagemap_t *map, uint32_t granule_size, uint32_t window);
+
+/* Returns the next access through *access, and makes it the current one.
+ * Returns 1 if there was an access, 0 at the end of the trace, or -1 if the
+ * trace is malformed.
+ */
+int lookahead_next(lookahead_t *p_la, memaccess_t *access);
+
+/* Returns the sequence number of the next access after the current one that
+ * touches [address, address + size), or UINT64_MAX if none is in the
+ * window.  The signature matches next_use_fn in replace.h.
+ */
+uint64_t lookahead_next_use(void *context, addr_t address, uint32_t size);
+
+void free_lookahead(lookahead_t *p_la);
+
+
+#endif /* LOOKAHEAD_H */
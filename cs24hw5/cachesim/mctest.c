@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cmdline.h"
+#include "coherence.h"
+#include "memory.h"
+#include "cache.h"
+
+
+/* Simulates several cores running a multithreaded kernel.  Each core has
+ * its own private caches, which are kept coherent by a MESI bus in front of
+ * a shared last-level cache (or the memory itself, if there isn't one).
+ * The cores are interleaved one memory operation at a time, in a random
+ * order, so that their accesses contend the way concurrent threads' do, e.g.:
+ *
+ *     ./mctest -c 4 -k packed -l 64:1024:8 64:64:4 64:256:8
+ */
+
+
+/* The default number of cores, as in cs24fin/cas/testaccum.c. */
+#define DEFAULT_CORES 4
+
+#define MAX_CORES 64
+
+/* The default number of iterations of the kernel run by each core. */
+#define DEFAULT_ITERATIONS 100000
+
+/* The size of the simulated memory. */
+#define MEM_SIZE (64 * 1024)
+
+/* The address of the shared accumulator, and of the per-core counters. */
+#define ACCUM_ADDR 0
+#define COUNTERS_ADDR 4096
+
+
+/* Set to time(NULL) to get a new interleaving each time, or a constant to
+ * get the same interleaving each time.
+ */
+#define SEED 54321098
+
+
+/* The state of the kernel running on one core. */
+typedef struct core_t {
+    /* The number of iterations the core has finished. */
+    uint32_t done;
+
+    /* The next step of the current iteration. */
+    int step;
+
+    /* The address of the core's own counter, for the counter kernels. */
+    addr_t counter;
+
+    /* The value read by the first step of an iteration. */
+    uint32_t old;
+
+    /* The total the core has added to the accumulator. */
+    uint32_t total;
+
+    /* The number of failed compare-and-swaps. */
+    uint64_t retries;
+} core_t;
+
+
+/* This struct describes a kernel that the cores can run. */
+typedef struct kernel_t {
+    /* The name of the kernel, as given with -k. */
+    const char *name;
+
+    const char *description;
+
+    /* Sets up a core's state before the kernel runs.  May be NULL. */
+    void (*init)(core_t *p_core, uint32_t core, uint32_t block_size);
+
+    /* Performs the next memory operation of a core's kernel, through its
+     * private caches.
+     */
+    void (*step)(membase_t *p_mem, core_t *p_core);
+
+    /* Checks the results, returning nonzero if they are right. */
+    int (*check)(membase_t *p_mem, core_t *cores, uint32_t num_cores,
+                 uint32_t iterations);
+} kernel_t;
+
+
+/*---------------------------------------------------------------------------
+ * The accumulator from cs24fin/cas:  add_to_accum() reads the accumulator,
+ * then uses compare-and-swap to store the new total, retrying if another
+ * core changed it in between, and then reads the total back.  A locked
+ * cmpxchg always writes its destination, storing the old value back when
+ * the comparison fails, so a failed compare-and-swap is a write too.
+ */
+
+
+void accum_step(membase_t *p_mem, core_t *p_core) {
+    uint32_t value = p_core->done % 1000 + 1, current;
+
+    switch (p_core->step) {
+    case 0:
+        p_core->old = read_word(p_mem, ACCUM_ADDR);
+        p_core->step = 1;
+        break;
+
+    case 1:
+        current = read_word(p_mem, ACCUM_ADDR);
+        if (current == p_core->old) {
+            write_word(p_mem, ACCUM_ADDR, p_core->old + value);
+            p_core->total += value;
+            p_core->step = 2;
+        }
+        else {
+            write_word(p_mem, ACCUM_ADDR, current);
+            p_core->retries++;
+            p_core->step = 0;
+        }
+        break;
+
+    case 2:
+        read_word(p_mem, ACCUM_ADDR);
+        p_core->done++;
+        p_core->step = 0;
+        break;
+    }
+}
+
+
+int accum_check(membase_t *p_mem, core_t *cores, uint32_t num_cores,
+                uint32_t iterations) {
+    uint32_t expected = 0, accum, i;
+    uint64_t retries = 0;
+
+    for (i = 0; i < num_cores; i++) {
+        expected += cores[i].total;
+        retries += cores[i].retries;
+    }
+    printf("Compare-and-swap retries:  %lld\n", retries);
+
+    accum = read_word(p_mem, ACCUM_ADDR);
+    if (accum != expected) {
+        printf("ERROR:  accumulator is %u, expected %u\n", accum, expected);
+        return 0;
+    }
+    return 1;
+}
+
+
+/*---------------------------------------------------------------------------
+ * Per-core counters:  each core increments its own counter.  The counters
+ * are either packed into adjacent words, so they share blocks and every
+ * increment takes the block from the other cores (false sharing), or padded
+ * out to a block each.
+ */
+
+
+void packed_init(core_t *p_core, uint32_t core, uint32_t block_size) {
+    p_core->counter = COUNTERS_ADDR + core * sizeof(uint32_t);
+}
+
+
+void padded_init(core_t *p_core, uint32_t core, uint32_t block_size) {
+    p_core->counter = COUNTERS_ADDR + core * block_size;
+}
+
+
+void counter_step(membase_t *p_mem, core_t *p_core) {
+    if (p_core->step == 0) {
+        p_core->old = read_word(p_mem, p_core->counter);
+        p_core->step = 1;
+    }
+    else {
+        write_word(p_mem, p_core->counter, p_core->old + 1);
+        p_core->done++;
+        p_core->step = 0;
+    }
+}
+
+
+int counter_check(membase_t *p_mem, core_t *cores, uint32_t num_cores,
+                  uint32_t iterations) {
+    uint32_t i, count;
+    int ok = 1;
+
+    for (i = 0; i < num_cores; i++) {
+        count = read_word(p_mem, cores[i].counter);
+        if (count != iterations) {
+            printf("ERROR:  core %u's counter is %u, expected %u\n", i,
+                   count, iterations);
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+
+static const kernel_t kernels[] = {
+    { "accum", "add to a shared accumulator with compare-and-swap",
+      NULL, accum_step, accum_check },
+    { "packed", "increment per-core counters in adjacent words",
+      packed_init, counter_step, counter_check },
+    { "padded", "increment per-core counters a block apart",
+      padded_init, counter_step, counter_check },
+    { NULL }
+};
+
+
+void mctest_usage(const char *progname) {
+    int i;
+
+    printf("usage: %s [-c cores] [-k kernel] [-n iterations] "
+           "[-l shared-cache-spec]\n\t[-M latency[:bandwidth]] "
+           "cache-spec ...\n\n", progname);
+    printf("\t-c cores        number of simulated cores, up to %d "
+           "(default %d)\n", MAX_CORES, DEFAULT_CORES);
+    printf("\t-k kernel       the kernel each core runs (default %s):\n",
+           kernels[0].name);
+    for (i = 0; kernels[i].name != NULL; i++)
+        printf("\t\t%-8s%s\n", kernels[i].name, kernels[i].description);
+    printf("\t-n iterations   iterations of the kernel per core (default %d)\n",
+           DEFAULT_ITERATIONS);
+    printf("\t-l cache-spec   the last-level cache shared by all cores\n");
+    printf("\t-M latency[:bandwidth]\n\t                the memory's latency "
+           "in cycles, and bytes per cycle\n");
+    printf("\n");
+    printf("\tThe other cache specifications give each core's private "
+           "caches, from the\n\tone the core accesses down.  They must all "
+           "have the same block size, and\n\tbe write-allocate and "
+           "non-inclusive without write-combining buffers or\n\tvictim "
+           "caches.  The shared cache may be inclusive, but not "
+           "exclusive.\n");
+    printf("\tCache specifications are described below.\n\n");
+    usage(progname);
+}
+
+
+int main(int argc, const char **argv) {
+    uint32_t num_cores = DEFAULT_CORES, iterations = DEFAULT_ITERATIONS;
+    uint32_t num_levels, num_active, core, level, i;
+    const kernel_t *kernel = kernels;
+    const char *shared_spec = NULL;
+    int shared_arg = 0;
+    memory_t *p_memory;
+    membase_t *p_shared, *p_next;
+    cache_t **caches;
+    bus_t bus;
+    core_t cores[MAX_CORES];
+    uint32_t active[MAX_CORES];
+    int opt, ok;
+
+    while ((opt = getopt(argc, (char * const *) argv, "c:k:n:l:M:")) != -1) {
+        switch (opt) {
+        case 'c':
+            num_cores = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'k':
+            for (kernel = kernels; kernel->name != NULL; kernel++) {
+                if (strcmp(kernel->name, optarg) == 0)
+                    break;
+            }
+            if (kernel->name == NULL) {
+                printf("ERROR:  unknown kernel \"%s\".\n", optarg);
+                mctest_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        case 'n':
+            iterations = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'l':
+            shared_spec = optarg;
+            shared_arg = optind - 1;
+            break;
+
+        case 'M':
+            if (parse_memory_timing(optarg) != 0) {
+                mctest_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        default:
+            mctest_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (num_cores == 0 || num_cores > MAX_CORES) {
+        printf("ERROR:  the number of cores must be from 1 to %d.\n",
+               MAX_CORES);
+        mctest_usage(argv[0]);
+        return 1;
+    }
+    if (optind == argc) {
+        printf("ERROR:  each core needs at least one private cache.\n");
+        mctest_usage(argv[0]);
+        return 1;
+    }
+    num_levels = argc - optind;
+
+    /* Set up the simulated memory:  the memory and shared cache, then each
+     * core's private caches in front of them.
+     */
+
+    printf("Constructing memory for simulation (in reverse order):\n");
+
+    p_memory = make_memory(MEM_SIZE);
+    p_shared = (membase_t *) p_memory;
+
+    if (shared_spec != NULL) {
+        printf("Shared cache:\n");
+        p_shared = (membase_t *) make_cache(argv[0], shared_spec, shared_arg,
+                                            p_shared, MEM_SIZE);
+    }
+
+    caches = malloc(num_cores * num_levels * sizeof(cache_t *));
+    for (core = 0; core < num_cores; core++) {
+        printf("Core %u:\n", core);
+        p_next = p_shared;
+        for (level = num_levels; level-- > 0; ) {
+            caches[core * num_levels + level] =
+                make_cache(argv[0], argv[optind + level], optind + level,
+                           p_next, MEM_SIZE);
+            p_next = (membase_t *) caches[core * num_levels + level];
+        }
+    }
+    printf("\n");
+
+    if (init_bus(&bus, num_cores, num_levels, caches) != 0) {
+        printf("ERROR:  the private caches must all have the same block "
+               "size, and be\n        write-allocate and non-inclusive "
+               "without write-combining buffers\n        or victim "
+               "caches.\n");
+        mctest_usage(argv[0]);
+        return 1;
+    }
+
+    /* An inclusive shared cache must find the blocks in every core's last
+     * private cache.  An exclusive one would hand blocks to one core behind
+     * the bus's back, so it isn't supported.
+     */
+    if (shared_spec != NULL) {
+        ok = ((cache_t *) p_shared)->inclusion != INCLUSION_EXCLUSIVE;
+        for (core = 0; ok && core < num_cores; core++) {
+            ok = add_upper_cache((cache_t *) p_shared,
+                                 caches[core * num_levels + num_levels - 1]) == 0;
+        }
+        if (!ok) {
+            printf("ERROR:  the shared cache may only be inclusive if it has "
+                   "the private\n        caches' block size, and can't be "
+                   "exclusive.\n");
+            mctest_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* Run the kernel on each core, choosing a random core to perform the
+     * next memory operation until they have all finished.
+     */
+
+    printf("Running the %s kernel on %u cores, %u iterations each.\n",
+           kernel->name, num_cores, iterations);
+
+    srand(SEED);
+
+    memset(cores, 0, sizeof(cores));
+    for (core = 0; core < num_cores; core++) {
+        if (kernel->init != NULL)
+            kernel->init(cores + core, core, bus.block_size);
+        active[core] = core;
+    }
+
+    num_active = (iterations > 0) ? num_cores : 0;
+    while (num_active > 0) {
+        i = rand() % num_active;
+        core = active[i];
+
+        kernel->step((membase_t *) caches[core * num_levels], cores + core);
+        if (cores[core].done == iterations)
+            active[i] = active[--num_active];
+    }
+
+    /* Check the results through core 0, which sees every core's writes. */
+
+    printf("Checking the results.\n");
+    ok = kernel->check((membase_t *) caches[0], cores, num_cores, iterations);
+    if (!ok) {
+        printf("Some results were wrong, aborting.\n");
+        abort();
+    }
+
+    /* Print out the statistics of each core's caches, with the cycles the
+     * core took, then of the shared levels of the memory and the bus.
+     */
+
+    printf("\nMemory-Access Statistics:\n\n");
+    for (core = 0; core < num_cores; core++) {
+        printf("Core %u:  %lld cycles\n", core,
+               caches[core * num_levels]->time);
+        for (level = 0; level < num_levels; level++)
+            print_cache_stats(caches[core * num_levels + level]);
+    }
+    printf("Shared:\n");
+    p_shared->print_stats(p_shared);
+    print_bus_stats(&bus);
+    printf("\n");
+
+    return 0;
+}
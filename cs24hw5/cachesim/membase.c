@@ -25,6 +25,25 @@ uint32_t log_2(uint32_t n) {
 }
 
 
+/*
+ * TIMING MODEL
+ *
+ * Each level of the memory keeps a simulated time, in its "time" member.
+ * An access starts at the level's time, and the level advances the time to
+ * when the access completes.  A cache sets its next level's time before
+ * accessing it, so the levels below see when each miss or write-back
+ * starts.  For the level the program accesses, the time is the clock of a
+ * simple in-order core:  reads stall the core until their data arrives,
+ * while writes are posted to a store buffer and only take a cycle.  The
+ * functions below do the same for writes from one level to the next, so
+ * write-backs use bandwidth below without delaying the access that caused
+ * them.  A posted write still has to be taken by the level, though, which
+ * sets its accept_time to when it did:  a write that misses in a cache
+ * with all of its MSHRs busy holds up the writer until one is free, so
+ * that the misses in flight stay bounded.
+ */
+
+
 /* Reads a byte from a specific memory address in the simulated memory. */
 unsigned char read_byte(membase_t *mb, addr_t address) {
     return mb->read_byte(mb, address);
@@ -33,7 +52,59 @@ unsigned char read_byte(membase_t *mb, addr_t address) {
 
 /* Writes a byte to a specific memory address in the simulated memory. */
 void write_byte(membase_t *mb, addr_t address, unsigned char value) {
+    uint64_t start = mb->time;
+
+    mb->accept_time = start;
     mb->write_byte(mb, address, value);
+    mb->time = start + 1;
+    if (mb->accept_time > mb->time)
+        mb->time = mb->accept_time;
+}
+
+
+/* Reads a 4-byte little-endian word from a specific memory address in the
+ * simulated memory, as a single access.
+ */
+uint32_t read_word(membase_t *mb, addr_t address) {
+    return mb->read_word(mb, address);
+}
+
+
+/* Writes a 4-byte little-endian word to a specific memory address in the
+ * simulated memory, as a single access.
+ */
+void write_word(membase_t *mb, addr_t address, uint32_t value) {
+    uint64_t start = mb->time;
+
+    mb->accept_time = start;
+    mb->write_word(mb, address, value);
+    mb->time = start + 1;
+    if (mb->accept_time > mb->time)
+        mb->time = mb->accept_time;
+}
+
+
+/* Reads a range of bytes starting at a specific memory address in the
+ * simulated memory.
+ */
+void read_block(membase_t *mb, addr_t address, unsigned char *dest,
+                uint32_t size) {
+    mb->read_block(mb, address, dest, size);
+}
+
+
+/* Writes a range of bytes starting at a specific memory address in the
+ * simulated memory.
+ */
+void write_block(membase_t *mb, addr_t address, const unsigned char *src,
+                 uint32_t size) {
+    uint64_t start = mb->time;
+
+    mb->accept_time = start;
+    mb->write_block(mb, address, src, size);
+    mb->time = start + 1;
+    if (mb->accept_time > mb->time)
+        mb->time = mb->accept_time;
 }
 
 
@@ -51,11 +122,7 @@ typedef union {
  * is stored in little-endian format, as IA32 normally does.
  */
 int32_t read_int(membase_t *mb, uint32_t index) {
-    addr_t addr = index * 4;
-    return read_byte(mb, addr) |
-           read_byte(mb, addr + 1) <<  8 |
-           read_byte(mb, addr + 2) << 16 |
-           read_byte(mb, addr + 3) << 24;
+    return read_word(mb, index * 4);
 }
 
 
@@ -64,11 +131,7 @@ int32_t read_int(membase_t *mb, uint32_t index) {
  * is stored in little-endian format, as IA32 normally does.
  */
 void write_int(membase_t *mb, uint32_t index, int32_t value) {
-    addr_t addr = index * 4;
-    write_byte(mb, addr, value & 0xFF);
-    write_byte(mb, addr + 1, (value >>  8) & 0xFF);
-    write_byte(mb, addr + 2, (value >> 16) & 0xFF);
-    write_byte(mb, addr + 3, (value >> 24) & 0xFF);
+    write_word(mb, index * 4, value);
 }
 
 
@@ -94,13 +157,30 @@ void write_float(membase_t *mb, uint32_t index, float value) {
 }
 
 
+/* Unpacks a 4-byte little-endian word from an array of bytes. */
+uint32_t get_le_word(const unsigned char *bytes) {
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 |
+           (uint32_t) bytes[3] << 24;
+}
+
+
+/* Packs a 4-byte little-endian word into an array of bytes. */
+void put_le_word(unsigned char *bytes, uint32_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >>  8) & 0xFF;
+    bytes[2] = (value >> 16) & 0xFF;
+    bytes[3] = (value >> 24) & 0xFF;
+}
+
+
 /* This function can be used to emulate a hardware clock e.g. for tagging cache
  * lines in order to implement an LRU replacement policy when evicting cache
  * lines.  Every call to the function advances the clock by one tick, and then
- * returns the new value of the clock.
+ * returns the new value of the clock.  Each thread has its own clock, so
+ * caches simulated on different threads don't race on it.
  */
 uint64_t clock_tick() {
-    static uint64_t clock = 0;
+    static __thread uint64_t clock = 0;
 
     return ++clock;
 }
@@ -24,12 +24,37 @@ typedef struct membase_t {
     /* The number of writes that occurred at this level of the memory. */
     uint64_t num_writes;
 
+    /* The simulated time, in cycles.  An access to this level starts at
+     * this time, and the level advances it to the time the access completes
+     * (see the timing model in membase.c).
+     */
+    uint64_t time;
+
+    /* When this level took the last posted write, which may be after the
+     * write was issued if the level had to wait for room to track it.
+     */
+    uint64_t accept_time;
+
     /* The function to read a byte from the memory. */
     unsigned char (*read_byte)(struct membase_t *mb, addr_t address);
 
     /* The function to write a byte to the memory. */
     void (*write_byte)(struct membase_t *mb, addr_t address, unsigned char value);
 
+    /* The function to read a 4-byte little-endian word from the memory. */
+    uint32_t (*read_word)(struct membase_t *mb, addr_t address);
+
+    /* The function to write a 4-byte little-endian word to the memory. */
+    void (*write_word)(struct membase_t *mb, addr_t address, uint32_t value);
+
+    /* The function to read "size" bytes starting at "address" into "dest". */
+    void (*read_block)(struct membase_t *mb, addr_t address,
+                       unsigned char *dest, uint32_t size);
+
+    /* The function to write "size" bytes from "src" starting at "address". */
+    void (*write_block)(struct membase_t *mb, addr_t address,
+                        const unsigned char *src, uint32_t size);
+
     /* The function to print the memory's access statistics. */
     void (*print_stats)(struct membase_t *mb);
 
@@ -56,6 +81,14 @@ uint32_t log_2(uint32_t n);
 unsigned char read_byte(membase_t *mb, addr_t address);
 void write_byte(membase_t *mb, addr_t address, unsigned char value);
 
+uint32_t read_word(membase_t *mb, addr_t address);
+void write_word(membase_t *mb, addr_t address, uint32_t value);
+
+void read_block(membase_t *mb, addr_t address, unsigned char *dest,
+                uint32_t size);
+void write_block(membase_t *mb, addr_t address, const unsigned char *src,
+                 uint32_t size);
+
 
 /*
  * These functions expose the memory as an array of signed integers or floats,
@@ -71,6 +104,13 @@ float read_float(membase_t *mb, uint32_t index);
 void write_float(membase_t *mb, uint32_t index, float value);
 
 
+/* These functions pack and unpack a 4-byte little-endian word in an array
+ * of bytes, for memory implementations of read_word and write_word.
+ */
+uint32_t get_le_word(const unsigned char *bytes);
+void put_le_word(unsigned char *bytes, uint32_t value);
+
+
 /* This function can be used to emulate a hardware clock e.g. for tagging cache
  * lines in order to implement an LRU replacement policy when evicting cache
  * lines.
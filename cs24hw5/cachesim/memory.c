@@ -14,29 +14,60 @@
 
 unsigned char memory_read_byte(membase_t *mb, addr_t address);
 void memory_write_byte(membase_t *mb, addr_t address, unsigned char value);
+uint32_t memory_read_word(membase_t *mb, addr_t address);
+void memory_write_word(membase_t *mb, addr_t address, uint32_t value);
+void memory_read_block(membase_t *mb, addr_t address, unsigned char *dest,
+                       uint32_t size);
+void memory_write_block(membase_t *mb, addr_t address,
+                        const unsigned char *src, uint32_t size);
 void memory_print_stats(membase_t *mb);
 void memory_reset_stats(membase_t *mb);
 void memory_free(membase_t *mb);
 
+void time_memory_access(memory_t *p_memory, uint32_t size);
+void copy_to_memory(memory_t *p_memory, addr_t address,
+                    const unsigned char *src, uint32_t size);
+int is_all_zero(const unsigned char *data, uint32_t size);
+
 
 /* Initializes the members of the memory_t struct to be a memory of the
- * specified number of bytes.  This requires a heap allocation, so the
+ * specified number of bytes.  This requires heap allocations, so the
  * allocated memory must be released when cleaning up the memory.
  */
-void init_memory(memory_t *p_memory, int32_t mem_size) {
+void init_memory(memory_t *p_memory, uint32_t mem_size) {
     bzero(p_memory, sizeof(memory_t));
 
-    /* Allocate the memory, and clear its contents to 0. */
+    /* Only the table of pages is allocated up front; the pages themselves
+     * are allocated as they are written.
+     */
     p_memory->mem_size = mem_size;
-    p_memory->mem = malloc(mem_size);
-    bzero(p_memory->mem, mem_size);
+    p_memory->num_pages = (mem_size > 0) ?
+                          ((mem_size - 1) >> MEM_PAGE_BITS) + 1 : 0;
+    p_memory->pages = calloc(p_memory->num_pages, sizeof(unsigned char *));
 
     /* Set up the pointers for interacting with the memory. */
     p_memory->read_byte = memory_read_byte;
     p_memory->write_byte = memory_write_byte;
+    p_memory->read_word = memory_read_word;
+    p_memory->write_word = memory_write_word;
+    p_memory->read_block = memory_read_block;
+    p_memory->write_block = memory_write_block;
     p_memory->print_stats = memory_print_stats;
     p_memory->reset_stats = memory_reset_stats;
     p_memory->free = memory_free;
+
+    p_memory->latency = DEFAULT_MEM_LATENCY;
+    p_memory->bytes_per_cycle = DEFAULT_MEM_BANDWIDTH;
+}
+
+
+/* Sets the latency of the memory, in cycles, and its bandwidth, in bytes
+ * per cycle (0 for unlimited bandwidth).
+ */
+void set_memory_timing(memory_t *p_memory, uint32_t latency,
+                       uint32_t bytes_per_cycle) {
+    p_memory->latency = latency;
+    p_memory->bytes_per_cycle = bytes_per_cycle;
 }
 
 
@@ -46,6 +77,7 @@ void init_memory(memory_t *p_memory, int32_t mem_size) {
  */
 unsigned char memory_read_byte(membase_t *mb, addr_t address) {
     memory_t *p_memory = (memory_t *) mb;
+    unsigned char value;
 
     assert(address >= 0 && address < p_memory->mem_size);
 
@@ -54,7 +86,9 @@ unsigned char memory_read_byte(membase_t *mb, addr_t address) {
 #endif
 
     p_memory->num_reads++;
-    return p_memory->mem[address];
+    time_memory_access(p_memory, 1);
+    copy_from_memory(p_memory, address, &value, 1);
+    return value;
 }
 
 
@@ -72,7 +106,88 @@ void memory_write_byte(membase_t *mb, addr_t address, unsigned char value) {
 #endif
 
     p_memory->num_writes++;
-    p_memory->mem[address] = value;
+    time_memory_access(p_memory, 1);
+    copy_to_memory(p_memory, address, &value, 1);
+}
+
+
+/* This function implements word reads against the memory.  The word counts
+ * as a single read.
+ */
+uint32_t memory_read_word(membase_t *mb, addr_t address) {
+    memory_t *p_memory = (memory_t *) mb;
+    unsigned char bytes[4];
+
+    assert(address < p_memory->mem_size - 3);
+
+#if DEBUG_MEMORY
+    printf("Reading word memory[%u]\n", address);
+#endif
+
+    p_memory->num_reads++;
+    time_memory_access(p_memory, 4);
+    copy_from_memory(p_memory, address, bytes, 4);
+    return get_le_word(bytes);
+}
+
+
+/* This function implements word writes against the memory.  The word counts
+ * as a single write.
+ */
+void memory_write_word(membase_t *mb, addr_t address, uint32_t value) {
+    memory_t *p_memory = (memory_t *) mb;
+    unsigned char bytes[4];
+
+    assert(address < p_memory->mem_size - 3);
+
+#if DEBUG_MEMORY
+    printf("Writing word memory[%u] = %u\n", address, value);
+#endif
+
+    p_memory->num_writes++;
+    time_memory_access(p_memory, 4);
+    put_le_word(bytes, value);
+    copy_to_memory(p_memory, address, bytes, 4);
+}
+
+
+/* This function implements reads of a range of bytes against the memory,
+ * e.g. to fill a cache line.  The whole range counts as a single read.
+ */
+void memory_read_block(membase_t *mb, addr_t address, unsigned char *dest,
+                       uint32_t size) {
+    memory_t *p_memory = (memory_t *) mb;
+
+    assert(size <= p_memory->mem_size &&
+           address <= p_memory->mem_size - size);
+
+#if DEBUG_MEMORY
+    printf("Reading memory[%u..%u]\n", address, address + size - 1);
+#endif
+
+    p_memory->num_reads++;
+    time_memory_access(p_memory, size);
+    copy_from_memory(p_memory, address, dest, size);
+}
+
+
+/* This function implements writes of a range of bytes against the memory,
+ * e.g. to write back a cache line.  The whole range counts as a single write.
+ */
+void memory_write_block(membase_t *mb, addr_t address,
+                        const unsigned char *src, uint32_t size) {
+    memory_t *p_memory = (memory_t *) mb;
+
+    assert(size <= p_memory->mem_size &&
+           address <= p_memory->mem_size - size);
+
+#if DEBUG_MEMORY
+    printf("Writing memory[%u..%u]\n", address, address + size - 1);
+#endif
+
+    p_memory->num_writes++;
+    time_memory_access(p_memory, size);
+    copy_to_memory(p_memory, address, src, size);
 }
 
 
@@ -80,8 +195,20 @@ void memory_write_byte(membase_t *mb, addr_t address, unsigned char value) {
 void memory_print_stats(membase_t *mb) {
     memory_t *p_memory = (memory_t *) mb;
 
+    uint64_t accesses = p_memory->num_reads + p_memory->num_writes;
+
     printf(" * Memory reads=%lld writes=%lld\n",
         p_memory->num_reads, p_memory->num_writes);
+    printf("   latency=%u cycles, bandwidth=", p_memory->latency);
+    if (p_memory->bytes_per_cycle > 0)
+        printf("%u bytes/cycle", p_memory->bytes_per_cycle);
+    else
+        printf("unlimited");
+    printf(":  average-access-time=%.2f cycles\n",
+           (accesses > 0) ? (double) p_memory->total_latency / accesses : 0.0);
+    printf("   pages-allocated=%u of %u (%u KB of host memory)\n",
+           p_memory->num_allocated, p_memory->num_pages,
+           p_memory->num_allocated * (MEM_PAGE_SIZE / 1024));
 }
 
 
@@ -91,12 +218,112 @@ void memory_reset_stats(membase_t *mb) {
 
     p_memory->num_reads = 0;
     p_memory->num_writes = 0;
+    p_memory->total_latency = 0;
+}
+
+
+/* This function advances the memory's time past an access of "size" bytes.
+ * The access waits for the channel to be free, then the transfer holds the
+ * channel, and the data arrives after the memory's latency.
+ */
+void time_memory_access(memory_t *p_memory, uint32_t size) {
+    uint64_t start = p_memory->time, transfer = 0;
+
+    if (p_memory->bytes_per_cycle > 0) {
+        transfer = (size + p_memory->bytes_per_cycle - 1) /
+                   p_memory->bytes_per_cycle;
+        if (p_memory->time < p_memory->channel_free)
+            p_memory->time = p_memory->channel_free;
+        p_memory->channel_free = p_memory->time + transfer;
+    }
+
+    p_memory->time += p_memory->latency + transfer;
+    p_memory->total_latency += p_memory->time - start;
+}
+
+
+/* This function copies "size" bytes of the memory starting at "address"
+ * into dest, without counting an access.  Pages that haven't been allocated
+ * read as zeros.
+ */
+void copy_from_memory(memory_t *p_memory, addr_t address, unsigned char *dest,
+                      uint32_t size) {
+    unsigned char *page;
+    uint32_t offset, chunk;
+
+    while (size > 0) {
+        offset = address & (MEM_PAGE_SIZE - 1);
+        chunk = MEM_PAGE_SIZE - offset;
+        if (chunk > size)
+            chunk = size;
+
+        page = p_memory->pages[address >> MEM_PAGE_BITS];
+        if (page != NULL)
+            memcpy(dest, page + offset, chunk);
+        else
+            bzero(dest, chunk);
+
+        address += chunk;
+        dest += chunk;
+        size -= chunk;
+    }
+}
+
+
+/* This function copies "size" bytes from src into the memory starting at
+ * "address", allocating the pages written to.  Zeros written to a page that
+ * hasn't been allocated are already there, so they don't allocate it.
+ */
+void copy_to_memory(memory_t *p_memory, addr_t address,
+                    const unsigned char *src, uint32_t size) {
+    unsigned char **p_page;
+    uint32_t offset, chunk;
+
+    while (size > 0) {
+        offset = address & (MEM_PAGE_SIZE - 1);
+        chunk = MEM_PAGE_SIZE - offset;
+        if (chunk > size)
+            chunk = size;
+
+        p_page = p_memory->pages + (address >> MEM_PAGE_BITS);
+        if (*p_page == NULL && !is_all_zero(src, chunk)) {
+            *p_page = calloc(MEM_PAGE_SIZE, 1);
+            if (*p_page == NULL) {
+                printf("ERROR:  out of host memory for the simulated "
+                       "memory.\n");
+                exit(1);
+            }
+            p_memory->num_allocated++;
+        }
+        if (*p_page != NULL)
+            memcpy(*p_page + offset, src, chunk);
+
+        address += chunk;
+        src += chunk;
+        size -= chunk;
+    }
+}
+
+
+/* Returns nonzero if the "size" bytes at data are all zero. */
+int is_all_zero(const unsigned char *data, uint32_t size) {
+    uint32_t i;
+
+    for (i = 0; i < size; i++) {
+        if (data[i] != 0)
+            return 0;
+    }
+    return 1;
 }
 
 
 /* This function releases the, uh, memory used by the, uh, memory. */
 void memory_free(membase_t *mb) {
     memory_t *p_memory = (memory_t *) mb;
-    free(p_memory->mem);
+    uint32_t i;
+
+    for (i = 0; i < p_memory->num_pages; i++)
+        free(p_memory->pages[i]);
+    free(p_memory->pages);
 }
 
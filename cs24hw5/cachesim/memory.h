@@ -5,12 +5,24 @@
 #include "membase.h"
 
 
+/* The memory is allocated in pages of 2^MEM_PAGE_BITS bytes, as they are
+ * first written.
+ */
+#define MEM_PAGE_BITS 16
+#define MEM_PAGE_SIZE (1 << MEM_PAGE_BITS)
+
+
 /* This struct holds the state for a simple memory that is an addressable
  * array of bytes.  Thus, the read_byte and write_byte implementations are
- * very simple; they just access or modify values in the array of memory
- * pointed to by mem.  Access statistics and other operations are also
+ * very simple; they just access or modify values in the pages of memory
+ * pointed to by pages.  Access statistics and other operations are also
  * provided via the function-pointers held in the struct, which are
  * initialized to point to the memory_t implementations of these functions.
+ *
+ * The memory starts out all zeros, and a page is only allocated when a
+ * nonzero byte is written to it, so a large memory that is only partly
+ * used, or only ever holds zeros, as when simulating a trace, takes little
+ * of the host's memory.
  */
 typedef struct memory_t {
     /* The number of reads that occurred at this level of the memory. */
@@ -19,12 +31,37 @@ typedef struct memory_t {
     /* The number of writes that occurred at this level of the memory. */
     uint64_t num_writes;
 
+    /* The simulated time, in cycles.  An access to this level starts at
+     * this time, and the level advances it to the time the access completes
+     * (see the timing model in membase.c).
+     */
+    uint64_t time;
+
+    /* When this level took the last posted write, which may be after the
+     * write was issued if the level had to wait for room to track it.
+     */
+    uint64_t accept_time;
+
     /* The function to read a byte from the memory. */
     unsigned char (*read_byte)(membase_t *mb, addr_t address);
 
     /* The function to write a byte to the memory. */
     void (*write_byte)(membase_t *mb, addr_t address, unsigned char value);
 
+    /* The function to read a 4-byte word from the memory. */
+    uint32_t (*read_word)(membase_t *mb, addr_t address);
+
+    /* The function to write a 4-byte word to the memory. */
+    void (*write_word)(membase_t *mb, addr_t address, uint32_t value);
+
+    /* The function to read a range of bytes from the memory. */
+    void (*read_block)(membase_t *mb, addr_t address, unsigned char *dest,
+                       uint32_t size);
+
+    /* The function to write a range of bytes to the memory. */
+    void (*write_block)(membase_t *mb, addr_t address,
+                        const unsigned char *src, uint32_t size);
+
     /* The function to print the memory's access statistics. */
     void (*print_stats)(struct membase_t *mb);
 
@@ -37,19 +74,50 @@ typedef struct memory_t {
     void (*free)(membase_t *mb);
 
     /* The size of the memory. */
-    int32_t mem_size;
+    uint32_t mem_size;
 
-    /* The malloc'd region of memory. */
-    unsigned char *mem;
+    /* The pages of the memory, NULL where a page hasn't been allocated, and
+     * the number of pages allocated.
+     */
+    unsigned char **pages;
+    uint32_t num_pages;
+    uint32_t num_allocated;
+
+    /* The timing of the memory:  the cycles from the start of an access to
+     * its first byte, and the number of bytes transferred per cycle (0 for
+     * no limit).  Transfers take turns on one channel, which is busy until
+     * channel_free.
+     */
+    uint32_t latency;
+    uint32_t bytes_per_cycle;
+    uint64_t channel_free;
+
+    /* The total cycles taken by the memory's accesses. */
+    uint64_t total_latency;
 
 } memory_t;
 
 
 /* Initializes the members of the memory_t struct to be a memory of the
- * specified number of bytes.  This requires a heap allocation, so the
+ * specified number of bytes.  This requires heap allocations, so the
  * allocated memory must be released as well.
  */
-void init_memory(memory_t *p_memory, int mem_size);
+void init_memory(memory_t *p_memory, uint32_t mem_size);
+
+/* The memory timing used unless set_memory_timing() is called:  a DRAM-like
+ * latency, and a channel transferring 8 bytes per cycle.
+ */
+#define DEFAULT_MEM_LATENCY 100
+#define DEFAULT_MEM_BANDWIDTH 8
+
+void set_memory_timing(memory_t *p_memory, uint32_t latency,
+                       uint32_t bytes_per_cycle);
+
+/* Copies the contents of the memory starting at "address" into dest, without
+ * counting an access.
+ */
+void copy_from_memory(memory_t *p_memory, addr_t address, unsigned char *dest,
+                      uint32_t size);
 
 
 #endif /* MEMORY_H */
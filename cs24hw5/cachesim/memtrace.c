@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "memtrace.h"
+
+
+/* Implementation of the compact binary memory-access trace format.  See
+ * memtrace.h for a description of the format.
+ */
+
+
+static const unsigned char memtrace_magic[5] = { 'M', 'E', 'M', 'T', 1 };
+
+
+/*---------------------------------------------------------------------------
+ * WRITING TRACES
+ */
+
+
+/* Writes out everything in the buffer. */
+static void flush_buffer(memtrace_writer_t *tw) {
+    fwrite(tw->buffer, 1, tw->buffered, tw->file);
+    tw->buffered = 0;
+}
+
+
+/* Appends an unsigned LEB128 varint:  7 bits per byte, low bits first, with
+ * the high bit set on every byte but the last.  A 64-bit value takes at most
+ * 10 bytes.
+ */
+static void put_varint(memtrace_writer_t *tw, uint64_t value) {
+    if (tw->buffered > MEMTRACE_BUFFER_SIZE - 10)
+        flush_buffer(tw);
+
+    while (value >= 0x80) {
+        tw->buffer[tw->buffered++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    tw->buffer[tw->buffered++] = value;
+}
+
+
+int memtrace_open_writer(memtrace_writer_t *tw, FILE *file) {
+    tw->file = file;
+    tw->last_address = 0;
+    tw->last_size = 0;
+    tw->buffered = 0;
+
+    if (fwrite(memtrace_magic, 1, sizeof(memtrace_magic), file) !=
+        sizeof(memtrace_magic))
+        return -1;
+    return 0;
+}
+
+
+void memtrace_write(memtrace_writer_t *tw, uint64_t address, uint32_t size,
+                    int is_write) {
+    int64_t delta = (int64_t) (address - tw->last_address);
+
+    /* Zigzag-encode the delta, so small negative deltas stay small.  The top
+     * bits of the delta are lost to the flags, which only matters for jumps
+     * of 2^60 bytes or more.
+     */
+    uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+    int size_changed = (size != tw->last_size);
+
+    put_varint(tw, (zigzag << 2) | (size_changed << 1) | (is_write != 0));
+    if (size_changed)
+        put_varint(tw, size);
+
+    tw->last_address = address;
+    tw->last_size = size;
+}
+
+
+void memtrace_close_writer(memtrace_writer_t *tw) {
+    flush_buffer(tw);
+    fflush(tw->file);
+}
+
+
+/*---------------------------------------------------------------------------
+ * READING TRACES
+ */
+
+
+/* Refills the buffer from the stream.  Returns the number of bytes read,
+ * which is 0 at the end of the stream.
+ */
+static int fill_buffer(memtrace_reader_t *tr) {
+    tr->offset += tr->length;
+    tr->length = fread(tr->buffer, 1, MEMTRACE_BUFFER_SIZE, tr->file);
+    tr->pos = 0;
+    return tr->length;
+}
+
+
+/* Decodes a varint, refilling the buffer as necessary.  Returns 1 on success,
+ * 0 if the stream ended before the varint started, or -1 if it ended in the
+ * middle of the varint or the varint doesn't fit in 64 bits.
+ */
+static int get_varint(memtrace_reader_t *tr, uint64_t *value) {
+    unsigned char b;
+    int shift = 0;
+
+    *value = 0;
+    do {
+        if (tr->pos == tr->length && fill_buffer(tr) == 0)
+            return (shift == 0) ? 0 : -1;
+        if (shift > 63)
+            return -1;
+
+        b = tr->buffer[tr->pos++];
+        *value |= (uint64_t) (b & 0x7F) << shift;
+        shift += 7;
+    }
+    while (b & 0x80);
+
+    return 1;
+}
+
+
+int memtrace_open_reader(memtrace_reader_t *tr, FILE *file) {
+    tr->file = file;
+    tr->last_address = 0;
+    tr->last_size = 0;
+    tr->length = 0;
+    tr->pos = 0;
+    tr->offset = 0;
+
+    fill_buffer(tr);
+    if (tr->length < sizeof(memtrace_magic) ||
+        memcmp(tr->buffer, memtrace_magic, sizeof(memtrace_magic)) != 0)
+        return -1;
+
+    tr->pos = sizeof(memtrace_magic);
+    return 0;
+}
+
+
+int memtrace_read(memtrace_reader_t *tr, memaccess_t *access) {
+    uint64_t value, zigzag, size;
+    int result;
+
+    result = get_varint(tr, &value);
+    if (result <= 0)
+        goto done;
+
+    if (value & 2) {
+        result = get_varint(tr, &size);
+        if (result <= 0 || size == 0 || size > UINT32_MAX) {
+            result = -1;
+            goto done;
+        }
+        tr->last_size = size;
+    }
+    else if (tr->last_size == 0) {
+        /* The first record must give its size. */
+        result = -1;
+        goto done;
+    }
+
+    zigzag = value >> 2;
+    tr->last_address += (zigzag >> 1) ^ -(zigzag & 1);
+
+    access->address = tr->last_address;
+    access->size = tr->last_size;
+    access->is_write = value & 1;
+    return 1;
+
+done:
+    if (result < 0) {
+        fprintf(stderr, "memtrace_read:  trace is malformed at byte %llu\n",
+                (unsigned long long) (tr->offset + tr->pos));
+    }
+    return result;
+}
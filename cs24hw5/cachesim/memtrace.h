@@ -0,0 +1,96 @@
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+
+#include <stdio.h>
+#include <stdint.h>
+
+
+/* Declarations for a compact binary memory-access trace format, so that
+ * address streams recorded from real programs can be run through the
+ * simulated memory hierarchy.
+ *
+ * A trace starts with the 4-byte magic "MEMT" and a version byte, and is
+ * followed by one record per access.  Each record is an unsigned LEB128
+ * varint holding
+ *
+ *     (zigzag(address - previous address) << 2) | (size changed << 1) | write
+ *
+ * and, if the size changed bit is set, a second varint with the new access
+ * size in bytes.  The first record's delta is from address 0, and its size is
+ * always given.  Since most accesses are near the one before, and the same
+ * size, a typical record takes a single byte.
+ */
+
+
+#define MEMTRACE_BUFFER_SIZE 65536
+
+
+/* A single memory access from a trace. */
+typedef struct memaccess_t {
+    /* The accessed address.  Traces may hold 64-bit addresses; it is up to
+     * the consumer to map them into the simulated address space.
+     */
+    uint64_t address;
+
+    /* The number of bytes accessed. */
+    uint32_t size;
+
+    /* This value will be 0 for a read, 1 for a write. */
+    int is_write;
+} memaccess_t;
+
+
+/* State for writing a trace to a stream. */
+typedef struct memtrace_writer_t {
+    FILE *file;
+    uint64_t last_address;
+    uint32_t last_size;
+    int buffered;
+    unsigned char buffer[MEMTRACE_BUFFER_SIZE];
+} memtrace_writer_t;
+
+
+/* State for reading a trace from a stream.  The trace is decoded as it is
+ * read, so traces far larger than the host's memory can be streamed from a
+ * file or a pipe.
+ */
+typedef struct memtrace_reader_t {
+    FILE *file;
+    uint64_t last_address;
+    uint32_t last_size;
+    int length;
+    int pos;
+
+    /* Number of bytes consumed before the current buffer, for errors. */
+    uint64_t offset;
+
+    unsigned char buffer[MEMTRACE_BUFFER_SIZE];
+} memtrace_reader_t;
+
+
+/* Starts writing a trace to an already opened stream.  Returns 0 on success,
+ * -1 on error.
+ */
+int memtrace_open_writer(memtrace_writer_t *tw, FILE *file);
+
+/* Appends one access to the trace. */
+void memtrace_write(memtrace_writer_t *tw, uint64_t address, uint32_t size,
+                    int is_write);
+
+/* Flushes buffered records.  The stream is not closed. */
+void memtrace_close_writer(memtrace_writer_t *tw);
+
+
+/* Starts reading a trace from an already opened stream, checking its header.
+ * Returns 0 on success, -1 if the stream doesn't hold a trace.
+ */
+int memtrace_open_reader(memtrace_reader_t *tr, FILE *file);
+
+/* Decodes the next access of the trace into *access.  Returns 1 if an access
+ * was read, 0 at the end of the trace, or -1 if the trace is malformed.
+ */
+int memtrace_read(memtrace_reader_t *tr, memaccess_t *access);
+
+
+#endif /* MEMTRACE_H */
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memtrace.h"
+
+
+/* Converts a text memory trace, in the format printed by Valgrind's Lackey
+ * tool (valgrind --tool=lackey --trace-mem=yes), into the binary format read
+ * by tracesim.  Each line of the input is one of:
+ *
+ *     I  address,size      an instruction fetch (skipped unless -i is given)
+ *      L address,size      a data load
+ *      S address,size      a data store
+ *      M address,size      a data modify, i.e. a load then a store
+ *
+ * with the address in hexadecimal.  Any other line, such as Valgrind's own
+ * "==pid==" messages, is ignored.
+ */
+
+
+void usage(const char *progname) {
+    printf("usage: %s [-i] text-trace binary-trace\n\n", progname);
+    printf("\tEither file may be - for standard input or output.\n");
+    printf("\t-i  include instruction fetches as reads\n");
+}
+
+
+int main(int argc, char **argv) {
+    FILE *in, *out;
+    memtrace_writer_t *writer;
+    char line[256];
+    char op;
+    unsigned long long address;
+    unsigned int size;
+    uint64_t num_accesses = 0;
+    int include_fetches = 0, opt;
+
+    while ((opt = getopt(argc, argv, "i")) != -1) {
+        switch (opt) {
+        case 'i':
+            include_fetches = 1;
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[optind], "-") == 0)
+        in = stdin;
+    else
+        in = fopen(argv[optind], "r");
+
+    if (strcmp(argv[optind + 1], "-") == 0)
+        out = stdout;
+    else
+        out = fopen(argv[optind + 1], "wb");
+
+    writer = malloc(sizeof(memtrace_writer_t));
+    if (in == NULL || out == NULL || writer == NULL ||
+        memtrace_open_writer(writer, out) != 0) {
+        fprintf(stderr, "%s: couldn't open the input or output\n", argv[0]);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (sscanf(line, " %c %llx,%u", &op, &address, &size) != 3 ||
+            size == 0)
+            continue;
+
+        switch (op) {
+        case 'I':
+            if (!include_fetches)
+                break;
+            /* Fall through. */
+
+        case 'L':
+            memtrace_write(writer, address, size, 0);
+            num_accesses++;
+            break;
+
+        case 'S':
+            memtrace_write(writer, address, size, 1);
+            num_accesses++;
+            break;
+
+        case 'M':
+            memtrace_write(writer, address, size, 0);
+            memtrace_write(writer, address, size, 1);
+            num_accesses += 2;
+            break;
+        }
+    }
+
+    memtrace_close_writer(writer);
+    fprintf(stderr, "%s: wrote %llu accesses\n", argv[0], num_accesses);
+
+    if (in != stdin)
+        fclose(in);
+    if (out != stdout)
+        fclose(out);
+    free(writer);
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "membase.h"
+#include "memtrace.h"
+#include "stackdist.h"
+
+
+/* Computes the miss ratios of every LRU cache configuration with a given
+ * block size, up to a maximum number of sets and lines per set, in a single
+ * pass over a binary memory-access trace (see memtrace.h).  This replaces
+ * rerunning a simulation once per B:S:E specification when sizing caches.
+ */
+
+
+#define DEFAULT_BLOCK_SIZE 64
+#define DEFAULT_MAX_SETS 4096
+#define DEFAULT_MAX_LINES 16
+
+/* Limits on the configurations, to bound the engine's memory use. */
+#define LIMIT_SET_BITS 20
+#define LIMIT_LINES 1024
+
+
+void usage(const char *progname) {
+    printf("usage: %s [-t trace-file] [-b block-size] [-s max-sets] "
+           "[-e max-lines] [-n max-accesses] [-a]\n\n", progname);
+    printf("\t-t trace-file   binary trace to simulate, or - for standard "
+           "input (default -)\n");
+    printf("\t-b block-size   block size of all the caches; a power of 2 "
+           "(default %d)\n", DEFAULT_BLOCK_SIZE);
+    printf("\t-s max-sets     most cache-sets to simulate; a power of 2, up "
+           "to 2^%d (default %d)\n", LIMIT_SET_BITS, DEFAULT_MAX_SETS);
+    printf("\t-e max-lines    most cache-lines per set to simulate, up to %d "
+           "(default %d)\n", LIMIT_LINES, DEFAULT_MAX_LINES);
+    printf("\t-n max-accesses stop after this many accesses\n");
+    printf("\t-a              report every number of lines per set, not just "
+           "powers of 2\n");
+}
+
+
+double now_sec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Returns nonzero if the miss ratio for "lines" lines per set should be
+ * reported.
+ */
+int report_lines(uint32_t lines, uint32_t max_lines, int all_lines) {
+    return all_lines || is_power_of_2(lines) || lines == max_lines;
+}
+
+
+int main(int argc, char **argv) {
+    const char *trace_path = "-";
+    uint32_t block_size = DEFAULT_BLOCK_SIZE, max_sets = DEFAULT_MAX_SETS;
+    uint32_t max_lines = DEFAULT_MAX_LINES, s, e;
+    uint64_t max_accesses = 0, num_accesses = 0;
+    int all_lines = 0, opt, result;
+    FILE *file;
+    memtrace_reader_t *reader;
+    memaccess_t access;
+    stackdist_t sd;
+    double start, elapsed;
+
+    while ((opt = getopt(argc, argv, "t:b:s:e:n:a")) != -1) {
+        switch (opt) {
+        case 't':
+            trace_path = optarg;
+            break;
+
+        case 'b':
+            block_size = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            max_sets = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'e':
+            max_lines = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'n':
+            max_accesses = strtoull(optarg, NULL, 0);
+            break;
+
+        case 'a':
+            all_lines = 1;
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc || block_size == 0 || !is_power_of_2(block_size) ||
+        max_sets == 0 || !is_power_of_2(max_sets) ||
+        log_2(max_sets) > LIMIT_SET_BITS ||
+        max_lines == 0 || max_lines > LIMIT_LINES) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (strcmp(trace_path, "-") == 0)
+        file = stdin;
+    else
+        file = fopen(trace_path, "rb");
+
+    reader = malloc(sizeof(memtrace_reader_t));
+    if (file == NULL || reader == NULL ||
+        memtrace_open_reader(reader, file) != 0) {
+        printf("ERROR:  couldn't read a trace from %s.\n", trace_path);
+        return 1;
+    }
+
+    init_stackdist(&sd, block_size, log_2(max_sets), max_lines);
+
+    start = now_sec();
+    while (max_accesses == 0 || num_accesses < max_accesses) {
+        result = memtrace_read(reader, &access);
+        if (result <= 0)
+            break;
+
+        stackdist_access(&sd, access.address, access.size);
+        num_accesses++;
+    }
+    elapsed = now_sec() - start;
+
+    if (result < 0)
+        printf("Stopping at the malformed part of the trace.\n");
+
+    printf("Trace:  %llu accesses, %llu block accesses of %u bytes\n",
+           num_accesses, sd.num_accesses, block_size);
+    printf("Simulation time:  %.3f sec, %.2f million accesses/sec\n\n",
+           elapsed, (elapsed > 0) ? num_accesses / elapsed / 1e6 : 0.0);
+
+    if (sd.num_accesses == 0) {
+        printf("Trace is empty.\n");
+        return 0;
+    }
+
+    /* One row per number of sets S, one column per number of lines E.  The
+     * capacity of each cache is B * S * E bytes.
+     */
+    printf("LRU miss ratios (%%), by cache-sets (rows) and cache-lines per "
+           "set (columns):\n\n");
+    printf("%8s %10s", "sets", "set bytes");
+    for (e = 1; e <= max_lines; e++) {
+        if (report_lines(e, max_lines, all_lines))
+            printf(" %7u", e);
+    }
+    printf("\n");
+
+    for (s = 0; s <= sd.max_set_bits; s++) {
+        printf("%8u %10u", 1 << s, block_size << s);
+        for (e = 1; e <= max_lines; e++) {
+            if (report_lines(e, max_lines, all_lines)) {
+                printf(" %7.3f", 100.0 * stackdist_misses(&sd, s, e) /
+                       sd.num_accesses);
+            }
+        }
+        printf("\n");
+    }
+    printf("\nThe capacity of each cache is its \"set bytes\" times its "
+           "lines per set.\n");
+
+    free_stackdist(&sd);
+    if (file != stdin)
+        fclose(file);
+    free(reader);
+
+    return (result < 0) ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pagemap.h"
+
+
+/* Local functions used by the page map implementation. */
+
+uint32_t hash_frame(uint64_t frame);
+uint32_t find_slot(pagemap_t *p_map, uint64_t key);
+int grow_page_map(pagemap_t *p_map);
+
+
+int init_page_map(pagemap_t *p_map, uint32_t frame_bits, uint32_t mem_size) {
+    bzero(p_map, sizeof(pagemap_t));
+    p_map->frame_bits = frame_bits;
+    p_map->num_frames = (frame_bits < 32) ? mem_size >> frame_bits : 0;
+
+    return grow_page_map(p_map);
+}
+
+
+addr_t map_trace_address(pagemap_t *p_map, uint64_t address) {
+    uint64_t key = (address >> p_map->frame_bits) + 1;
+    addr_t offset = address & (((addr_t) 1 << p_map->frame_bits) - 1);
+    uint32_t slot = find_slot(p_map, key);
+
+    if (p_map->keys[slot] == 0) {
+        if (p_map->num_used == p_map->num_frames) {
+            printf("ERROR:  the trace touches more than %u frames of %u "
+                   "bytes, which is more\n        than the simulated memory "
+                   "holds.  Give a larger memory size with -m.\n",
+                   p_map->num_frames, 1U << p_map->frame_bits);
+            exit(1);
+        }
+
+        if (2 * (p_map->num_used + 1) > p_map->table_capacity) {
+            if (grow_page_map(p_map) != 0) {
+                printf("ERROR:  out of memory for the page map.\n");
+                exit(1);
+            }
+            slot = find_slot(p_map, key);
+        }
+
+        p_map->keys[slot] = key;
+        p_map->frames[slot] = p_map->num_used++;
+    }
+
+    return ((addr_t) p_map->frames[slot] << p_map->frame_bits) | offset;
+}
+
+
+void free_page_map(pagemap_t *p_map) {
+    free(p_map->keys);
+    free(p_map->frames);
+}
+
+
+/*---------------------------------------------------------------------------
+ * PAGE MAP HELPER FUNCTIONS
+ */
+
+
+uint32_t hash_frame(uint64_t frame) {
+    frame ^= frame >> 33;
+    frame *= 0xff51afd7ed558ccdULL;
+    frame ^= frame >> 33;
+    return (uint32_t) frame;
+}
+
+
+/* Returns the slot holding the key, or the empty slot where it would go. */
+uint32_t find_slot(pagemap_t *p_map, uint64_t key) {
+    uint32_t i = hash_frame(key) & (p_map->table_capacity - 1);
+
+    while (p_map->keys[i] != 0 && p_map->keys[i] != key)
+        i = (i + 1) & (p_map->table_capacity - 1);
+    return i;
+}
+
+
+/* Doubles the hash table, keeping the load factor at or below one half.
+ * Returns 0 on success, or -1 if out of memory.
+ */
+int grow_page_map(pagemap_t *p_map) {
+    uint64_t *old_keys = p_map->keys;
+    uint32_t *old_frames = p_map->frames;
+    uint32_t old_capacity = p_map->table_capacity, i, slot;
+
+    p_map->table_capacity = old_capacity ? 2 * old_capacity : 1024;
+    p_map->keys = calloc(p_map->table_capacity, sizeof(uint64_t));
+    p_map->frames = malloc(p_map->table_capacity * sizeof(uint32_t));
+    if (p_map->keys == NULL || p_map->frames == NULL) {
+        free(p_map->keys);
+        free(p_map->frames);
+        p_map->keys = old_keys;
+        p_map->frames = old_frames;
+        p_map->table_capacity = old_capacity;
+        return -1;
+    }
+
+    for (i = 0; i < old_capacity; i++) {
+        if (old_keys[i] != 0) {
+            slot = find_slot(p_map, old_keys[i]);
+            p_map->keys[slot] = old_keys[i];
+            p_map->frames[slot] = old_frames[i];
+        }
+    }
+    free(old_keys);
+    free(old_frames);
+    return 0;
+}
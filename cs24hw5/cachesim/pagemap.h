@@ -0,0 +1,50 @@
+#ifndef PAGEMAP_H
+#define PAGEMAP_H
+
+
+#include "membase.h"
+
+
+/* This struct maps the addresses of a trace, which may be 64 bits, into the
+ * simulated memory.  Both are divided into frames of 2^frame_bits bytes,
+ * and each trace frame is given the next free frame of the simulated memory
+ * the first time it is touched.  The offset within the frame is kept, so
+ * with frames at least as large as the span of each cache's sets, every
+ * access keeps its set and block offset, and distinct trace addresses stay
+ * distinct, as they would in a simulation of the whole address space.
+ */
+typedef struct pagemap_t {
+    uint32_t frame_bits;
+
+    /* The number of frames in the simulated memory, and of those given to
+     * trace frames so far.
+     */
+    uint32_t num_frames;
+    uint32_t num_used;
+
+    /* Open-addressing hash table from trace frames to simulated frames.  A
+     * slot holds its trace frame plus 1, or 0 if it is empty.
+     */
+    uint64_t *keys;
+    uint32_t *frames;
+    uint32_t table_capacity;
+} pagemap_t;
+
+
+/* Initializes a page map into a simulated memory of mem_size bytes, with
+ * frames of 2^frame_bits bytes.  Returns 0 on success, or -1 if out of
+ * memory.
+ */
+int init_page_map(pagemap_t *p_map, uint32_t frame_bits, uint32_t mem_size);
+
+/* Returns the simulated address of a trace address, giving its frame a
+ * frame of the simulated memory if it doesn't have one yet.  If the memory
+ * has no free frames left, prints an error and exits, rather than letting
+ * trace frames share a frame.
+ */
+addr_t map_trace_address(pagemap_t *p_map, uint64_t address);
+
+void free_page_map(pagemap_t *p_map);
+
+
+#endif /* PAGEMAP_H */
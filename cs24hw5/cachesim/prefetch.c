@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "prefetch.h"
+
+
+/* Implementations of the prefetcher models.  The simulated accesses don't
+ * carry the address of the instruction making them, so the stride
+ * prefetcher tracks strides per memory region rather than per load
+ * instruction.
+ */
+
+
+/* The number of regions tracked by the stride prefetcher. */
+#define STRIDE_TABLE_SIZE 64
+
+/* A stride is trusted once it has been seen this many times in a row. */
+#define STRIDE_CONFIDENCE 2
+
+/* The number of streams tracked by the stream prefetcher. */
+#define NUM_STREAMS 16
+
+/* A miss within this many blocks past the end of a stream extends it. */
+#define STREAM_WINDOW 4
+
+/* A stream is trusted once it has been extended this many times. */
+#define STREAM_CONFIDENCE 2
+
+
+/* Prefetches the block "distance" blocks away from the one holding
+ * "address", unless that is in another page.
+ */
+static void prefetch_nearby(cache_t *p_cache, addr_t address,
+                            int64_t distance, cacheline_t *p_keep) {
+    uint32_t page_size = PREFETCH_PAGE_SIZE;
+    int64_t target;
+
+    if (page_size < p_cache->block_size)
+        page_size = p_cache->block_size;
+
+    target = (int64_t) (address & ~(p_cache->block_size - 1)) +
+             distance * p_cache->block_size;
+    if (target < 0 || target / page_size != address / page_size)
+        return;
+
+    issue_prefetch(p_cache, (addr_t) target, p_keep);
+}
+
+
+/*---------------------------------------------------------------------------
+ * Next-line (tagged) prefetching:  a miss, or the first hit on a prefetched
+ * line, prefetches the next "degree" blocks.
+ */
+
+
+static void nextline_access(cache_t *p_cache, addr_t address,
+                            access_outcome outcome, cacheline_t *p_line) {
+    uint32_t i;
+
+    if (outcome == ACCESS_HIT)
+        return;
+
+    for (i = 1; i <= p_cache->prefetch_degree; i++)
+        prefetch_nearby(p_cache, address, i, p_line);
+}
+
+
+static const prefetcher_t nextline_prefetcher = {
+    "nextline", NULL, nextline_access
+};
+
+
+/*---------------------------------------------------------------------------
+ * Stride prefetching:  each region (page) remembers the last block accessed
+ * in it, and the distance between the last two blocks.  Once the same
+ * stride has been seen STRIDE_CONFIDENCE times in a row, each access
+ * prefetches the next "degree" blocks along the stride.
+ */
+
+
+typedef struct stride_entry {
+    addr_t region;
+    int valid;
+    addr_t last_block;
+    int64_t stride;
+    int confidence;
+} stride_entry;
+
+
+static void stride_init(cache_t *p_cache) {
+    p_cache->prefetch_state = calloc(STRIDE_TABLE_SIZE, sizeof(stride_entry));
+}
+
+
+static void stride_access(cache_t *p_cache, addr_t address,
+                          access_outcome outcome, cacheline_t *p_line) {
+    stride_entry *table = p_cache->prefetch_state, *p_entry;
+    addr_t region = address / PREFETCH_PAGE_SIZE;
+    addr_t block = address >> p_cache->block_offset_bits;
+    int64_t stride;
+    uint32_t i;
+
+    p_entry = table + (region * 2654435761U >> 26) % STRIDE_TABLE_SIZE;
+    if (!p_entry->valid || p_entry->region != region) {
+        p_entry->valid = 1;
+        p_entry->region = region;
+        p_entry->last_block = block;
+        p_entry->stride = 0;
+        p_entry->confidence = 0;
+        return;
+    }
+
+    /* Repeated accesses to one block say nothing about the stride. */
+    if (block == p_entry->last_block)
+        return;
+
+    stride = (int64_t) block - (int64_t) p_entry->last_block;
+    if (stride == p_entry->stride) {
+        if (p_entry->confidence < STRIDE_CONFIDENCE)
+            p_entry->confidence++;
+    }
+    else {
+        p_entry->stride = stride;
+        p_entry->confidence = 1;
+    }
+    p_entry->last_block = block;
+
+    if (p_entry->confidence >= STRIDE_CONFIDENCE) {
+        for (i = 1; i <= p_cache->prefetch_degree; i++)
+            prefetch_nearby(p_cache, address, i * stride, p_line);
+    }
+}
+
+
+static const prefetcher_t stride_prefetcher = {
+    "stride", stride_init, stride_access
+};
+
+
+/*---------------------------------------------------------------------------
+ * Stream prefetching:  misses (and first hits on prefetched lines) a few
+ * blocks past the end of a tracked stream extend it, in either direction.
+ * Once a stream has been extended STREAM_CONFIDENCE times, each extension
+ * prefetches "degree" blocks ahead of it.  A miss that extends no stream
+ * starts a new one, replacing the least recently extended stream.
+ */
+
+
+typedef struct stream_entry {
+    int valid;
+    addr_t last_block;
+
+    /* +1 for an ascending stream, -1 for descending, 0 if not known yet. */
+    int direction;
+
+    int confidence;
+    uint64_t last_time;
+} stream_entry;
+
+
+static void stream_init(cache_t *p_cache) {
+    p_cache->prefetch_state = calloc(NUM_STREAMS, sizeof(stream_entry));
+}
+
+
+static void stream_access(cache_t *p_cache, addr_t address,
+                          access_outcome outcome, cacheline_t *p_line) {
+    stream_entry *streams = p_cache->prefetch_state, *p_stream = NULL;
+    int64_t block = address >> p_cache->block_offset_bits, distance;
+    int i;
+    uint32_t k;
+
+    if (outcome == ACCESS_HIT)
+        return;
+
+    for (i = 0; i < NUM_STREAMS; i++) {
+        if (!streams[i].valid)
+            continue;
+
+        distance = block - (int64_t) streams[i].last_block;
+        if (streams[i].direction < 0)
+            distance = -distance;
+        else if (streams[i].direction == 0 && distance < 0)
+            distance = -distance;
+
+        if (distance > 0 && distance <= STREAM_WINDOW) {
+            p_stream = streams + i;
+            break;
+        }
+    }
+
+    if (p_stream == NULL) {
+        /* Start a new stream in place of the least recently used one. */
+        p_stream = streams;
+        for (i = 0; i < NUM_STREAMS; i++) {
+            if (!streams[i].valid) {
+                p_stream = streams + i;
+                break;
+            }
+            if (streams[i].last_time < p_stream->last_time)
+                p_stream = streams + i;
+        }
+
+        p_stream->valid = 1;
+        p_stream->last_block = block;
+        p_stream->direction = 0;
+        p_stream->confidence = 0;
+        p_stream->last_time = clock_tick();
+        return;
+    }
+
+    if (p_stream->direction == 0)
+        p_stream->direction = (block > p_stream->last_block) ? 1 : -1;
+    if (p_stream->confidence < STREAM_CONFIDENCE)
+        p_stream->confidence++;
+    p_stream->last_block = block;
+    p_stream->last_time = clock_tick();
+
+    if (p_stream->confidence >= STREAM_CONFIDENCE) {
+        for (k = 1; k <= p_cache->prefetch_degree; k++) {
+            prefetch_nearby(p_cache, address,
+                            (int64_t) k * p_stream->direction, p_line);
+        }
+    }
+}
+
+
+static const prefetcher_t stream_prefetcher = {
+    "stream", stream_init, stream_access
+};
+
+
+/*---------------------------------------------------------------------------
+ * PREFETCHER LOOKUP
+ */
+
+
+const prefetcher_t *prefetchers[] = {
+    &nextline_prefetcher, &stride_prefetcher, &stream_prefetcher, NULL
+};
+
+
+/* Returns the prefetcher with the given name, or NULL if there isn't one. */
+const prefetcher_t * find_prefetcher(const char *name) {
+    int i;
+
+    for (i = 0; prefetchers[i] != NULL; i++) {
+        if (strcmp(prefetchers[i]->name, name) == 0)
+            return prefetchers[i];
+    }
+    return NULL;
+}
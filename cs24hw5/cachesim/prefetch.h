@@ -0,0 +1,54 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+
+#include "cache.h"
+
+
+/* The size of the region prefetches are confined to, like hardware
+ * prefetchers that don't cross page boundaries.  Prefetches never leave the
+ * page of the access that triggered them.
+ */
+#define PREFETCH_PAGE_SIZE 4096
+
+/* The number of blocks prefetched ahead when no degree is given. */
+#define DEFAULT_PREFETCH_DEGREE 2
+
+
+/* What happened when a demand access looked up its line. */
+typedef enum access_outcome {
+    ACCESS_HIT,             /* a hit on a line loaded on demand */
+    ACCESS_PREFETCHED_HIT,  /* the first hit on a line loaded by a prefetch */
+    ACCESS_MISS             /* a miss */
+} access_outcome;
+
+
+/* This struct describes a hardware prefetcher model.  A cache with a
+ * prefetcher tells it about every demand access, and the prefetcher calls
+ * issue_prefetch() for blocks it predicts will be used soon.  Prefetchers
+ * keep their state in the cache's prefetch_state.
+ */
+typedef struct prefetcher_t {
+    /* The name of the prefetcher, as given in cache specifications. */
+    const char *name;
+
+    /* Allocates the prefetcher's state in the cache.  May be NULL. */
+    void (*init)(cache_t *p_cache);
+
+    /* Called after each demand access.  p_line is the line accessed, which
+     * prefetches must not evict.
+     */
+    void (*on_access)(cache_t *p_cache, addr_t address,
+                      access_outcome outcome, cacheline_t *p_line);
+} prefetcher_t;
+
+
+/* The prefetchers that can be selected by name. */
+extern const prefetcher_t *prefetchers[];
+
+
+/* Returns the prefetcher with the given name, or NULL if there isn't one. */
+const prefetcher_t * find_prefetcher(const char *name);
+
+
+#endif /* PREFETCH_H */
@@ -0,0 +1,657 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+#include "replace.h"
+
+
+/* The number of entries the set of seen blocks starts with.  It doubles
+ * whenever it becomes half full.
+ */
+#define INITIAL_SEEN_SIZE 1024
+
+
+/* A registered region of the simulated memory. */
+typedef struct profile_region_t {
+    addr_t start;
+    addr_t size;
+} profile_region_t;
+
+
+/* The registered regions, and their names. */
+static profile_region_t regions[MAX_PROFILE_REGIONS];
+static const char *region_names[MAX_PROFILE_REGIONS];
+static uint32_t num_regions = 0;
+
+/* The names of the marked sites, and the index of the current one, which
+ * is MAX_ACCESS_SITES when accesses are unmarked.
+ */
+static const char *sites[MAX_ACCESS_SITES];
+static uint32_t num_sites = 0;
+static uint32_t current_site = MAX_ACCESS_SITES;
+
+int profiling_active = 0;
+
+
+/* The names of the miss classes, as printed. */
+static const char *miss_class_names[NUM_MISS_CLASSES] = {
+    "compulsory", "capacity", "conflict"
+};
+
+
+/* Local functions used by the profiling implementation. */
+
+uint32_t hash_block(addr_t block);
+int shadow_access(cache_profile_t *p_profile, addr_t block);
+void shadow_unlink(cache_profile_t *p_profile, int32_t i);
+void shadow_push_mru(cache_profile_t *p_profile, int32_t i);
+int seen_insert(cache_profile_t *p_profile, addr_t block);
+uint32_t find_region(addr_t address);
+void count_access(profile_counts_t *p_counts, int hit, int cls);
+void add_counts(profile_counts_t *p_counts, const profile_counts_t *p_other);
+
+void print_counts(const char *name, const profile_counts_t *p_counts,
+                  int classify);
+void write_csv_row(FILE *file, int level, const char *kind,
+                   const char *name, const profile_counts_t *p_counts,
+                   int classify);
+void write_csv_string(FILE *file, const char *s);
+void write_json_string(FILE *file, const char *s);
+void write_json_list(FILE *file, const char **names,
+                     const profile_counts_t *counts, uint32_t num_named,
+                     uint32_t other_index, const char *other_name,
+                     int classify);
+void write_json_counts(FILE *file, const char *name,
+                       const profile_counts_t *p_counts, int classify);
+
+
+/*---------------------------------------------------------------------------
+ * REGIONS AND SITES
+ */
+
+
+int add_profile_region(const char *name, addr_t start, addr_t size) {
+    if (num_regions == MAX_PROFILE_REGIONS)
+        return -1;
+
+    region_names[num_regions] = name;
+    regions[num_regions].start = start;
+    regions[num_regions].size = size;
+    num_regions++;
+    profiling_active = 1;
+    return 0;
+}
+
+
+void set_access_site(const char *name) {
+    uint32_t i;
+
+    current_site = MAX_ACCESS_SITES;
+    if (name == NULL)
+        return;
+    profiling_active = 1;
+
+    /* Sites are usually marked with string literals, so look for the same
+     * pointer first, which is quick.
+     */
+    for (i = 0; i < num_sites; i++) {
+        if (sites[i] == name) {
+            current_site = i;
+            return;
+        }
+    }
+    for (i = 0; i < num_sites; i++) {
+        if (strcmp(sites[i], name) == 0) {
+            current_site = i;
+            return;
+        }
+    }
+
+    if (num_sites < MAX_ACCESS_SITES) {
+        sites[num_sites] = name;
+        current_site = num_sites++;
+    }
+}
+
+
+/* Returns the index of the first region containing the address, or
+ * MAX_PROFILE_REGIONS if none does.
+ */
+uint32_t find_region(addr_t address) {
+    uint32_t i;
+
+    for (i = 0; i < num_regions; i++) {
+        if (address - regions[i].start < regions[i].size)
+            return i;
+    }
+    return MAX_PROFILE_REGIONS;
+}
+
+
+/*---------------------------------------------------------------------------
+ * PER-CACHE PROFILING
+ */
+
+
+/* Allocates the profiling state of a new cache, which doesn't classify
+ * misses.
+ */
+cache_profile_t * alloc_cache_profile() {
+    cache_profile_t *p_profile = calloc(1, sizeof(cache_profile_t));
+
+    p_profile->mru = -1;
+    p_profile->lru = -1;
+    return p_profile;
+}
+
+
+/* Turns classification of the cache's misses on or off.  The shadow cache
+ * holds as many blocks as the cache, and starts out empty, as does the set
+ * of seen blocks.
+ */
+void set_miss_classification(cache_t *p_cache, int classify) {
+    cache_profile_t *p_profile = p_cache->profile;
+    uint32_t num_buckets = 1;
+
+    free(p_profile->lines);
+    free(p_profile->buckets);
+    free(p_profile->seen);
+    p_profile->lines = NULL;
+    p_profile->buckets = NULL;
+    p_profile->seen = NULL;
+    p_profile->num_used = 0;
+    p_profile->seen_count = 0;
+    p_profile->mru = -1;
+    p_profile->lru = -1;
+
+    p_profile->classify = classify;
+    if (!classify)
+        return;
+
+    p_profile->num_lines =
+        p_cache->num_sets * p_cache->cache_sets[0].num_lines;
+    p_profile->lines = malloc(p_profile->num_lines * sizeof(shadow_line_t));
+
+    while (num_buckets < p_profile->num_lines)
+        num_buckets *= 2;
+    p_profile->buckets = malloc(num_buckets * sizeof(int32_t));
+    memset(p_profile->buckets, 0xFF, num_buckets * sizeof(int32_t));
+    p_profile->bucket_mask = num_buckets - 1;
+
+    p_profile->seen_size = INITIAL_SEEN_SIZE;
+    p_profile->seen = calloc(p_profile->seen_size, sizeof(addr_t));
+}
+
+
+/* Called for every lookup a cache performs on demand, after the lookup,
+ * with "hit" nonzero if it hit.  Classifies misses and updates the counts.
+ */
+void profile_access(cache_t *p_cache, addr_t address, int hit) {
+    cache_profile_t *p_profile = p_cache->profile;
+    addr_t block = address >> p_cache->block_offset_bits;
+    int first, shadow_hit, cls = -1;
+
+    if (p_profile->classify) {
+        first = seen_insert(p_profile, block);
+        shadow_hit = shadow_access(p_profile, block);
+
+        if (!hit) {
+            if (first)
+                cls = MISS_COMPULSORY;
+            else if (!shadow_hit)
+                cls = MISS_CAPACITY;
+            else
+                cls = MISS_CONFLICT;
+            p_profile->classes[cls]++;
+        }
+    }
+
+    if (!profiling_active)
+        return;
+
+    count_access(p_profile->regions + find_region(address), hit, cls);
+    count_access(p_profile->sites + current_site, hit, cls);
+}
+
+
+void count_access(profile_counts_t *p_counts, int hit, int cls) {
+    p_counts->accesses++;
+    if (!hit)
+        p_counts->misses++;
+    if (cls >= 0)
+        p_counts->classes[cls]++;
+}
+
+
+/* Adds another cache's counts to this cache's.  The shadow caches are left
+ * alone.
+ */
+void add_profile_counts(cache_profile_t *p_profile,
+                        const cache_profile_t *p_other) {
+    uint32_t i;
+
+    for (i = 0; i < NUM_MISS_CLASSES; i++)
+        p_profile->classes[i] += p_other->classes[i];
+    for (i = 0; i <= MAX_PROFILE_REGIONS; i++)
+        add_counts(p_profile->regions + i, p_other->regions + i);
+    for (i = 0; i <= MAX_ACCESS_SITES; i++)
+        add_counts(p_profile->sites + i, p_other->sites + i);
+}
+
+
+void add_counts(profile_counts_t *p_counts, const profile_counts_t *p_other) {
+    int i;
+
+    p_counts->accesses += p_other->accesses;
+    p_counts->misses += p_other->misses;
+    for (i = 0; i < NUM_MISS_CLASSES; i++)
+        p_counts->classes[i] += p_other->classes[i];
+}
+
+
+/* Resets the counts, but not the contents of the shadow cache or the set of
+ * seen blocks, just as resetting a cache's statistics doesn't empty it.
+ */
+void reset_profile_counts(cache_profile_t *p_profile) {
+    memset(p_profile->classes, 0, sizeof(p_profile->classes));
+    memset(p_profile->regions, 0, sizeof(p_profile->regions));
+    memset(p_profile->sites, 0, sizeof(p_profile->sites));
+}
+
+
+void free_cache_profile(cache_profile_t *p_profile) {
+    free(p_profile->lines);
+    free(p_profile->buckets);
+    free(p_profile->seen);
+    free(p_profile);
+}
+
+
+/*---------------------------------------------------------------------------
+ * THE SHADOW CACHE AND SEEN BLOCKS
+ */
+
+
+uint32_t hash_block(addr_t block) {
+    uint32_t h = block * 2654435761U;
+
+    return h ^ (h >> 16);
+}
+
+
+/* Accesses a block in the shadow fully-associative LRU cache, loading it if
+ * it isn't there.  Returns nonzero if it was there.
+ */
+int shadow_access(cache_profile_t *p_profile, addr_t block) {
+    int32_t *p_link, i;
+    uint32_t bucket = hash_block(block) & p_profile->bucket_mask;
+
+    for (i = p_profile->buckets[bucket]; i >= 0;
+         i = p_profile->lines[i].chain) {
+        if (p_profile->lines[i].block == block) {
+            if (i != p_profile->mru) {
+                shadow_unlink(p_profile, i);
+                shadow_push_mru(p_profile, i);
+            }
+            return 1;
+        }
+    }
+
+    if (p_profile->num_used < p_profile->num_lines) {
+        i = p_profile->num_used++;
+    }
+    else {
+        /* Evict the least recently used block, unchaining it first. */
+        i = p_profile->lru;
+        p_link = p_profile->buckets +
+            (hash_block(p_profile->lines[i].block) & p_profile->bucket_mask);
+        while (*p_link != i)
+            p_link = &p_profile->lines[*p_link].chain;
+        *p_link = p_profile->lines[i].chain;
+        shadow_unlink(p_profile, i);
+    }
+
+    p_profile->lines[i].block = block;
+    p_profile->lines[i].chain = p_profile->buckets[bucket];
+    p_profile->buckets[bucket] = i;
+    shadow_push_mru(p_profile, i);
+    return 0;
+}
+
+
+void shadow_unlink(cache_profile_t *p_profile, int32_t i) {
+    shadow_line_t *p_line = p_profile->lines + i;
+
+    if (p_line->prev >= 0)
+        p_profile->lines[p_line->prev].next = p_line->next;
+    else
+        p_profile->mru = p_line->next;
+
+    if (p_line->next >= 0)
+        p_profile->lines[p_line->next].prev = p_line->prev;
+    else
+        p_profile->lru = p_line->prev;
+}
+
+
+void shadow_push_mru(cache_profile_t *p_profile, int32_t i) {
+    shadow_line_t *p_line = p_profile->lines + i;
+
+    p_line->prev = -1;
+    p_line->next = p_profile->mru;
+    if (p_profile->mru >= 0)
+        p_profile->lines[p_profile->mru].prev = i;
+    else
+        p_profile->lru = i;
+    p_profile->mru = i;
+}
+
+
+/* Adds a block to the set of seen blocks, returning nonzero if it wasn't
+ * there already.
+ */
+int seen_insert(cache_profile_t *p_profile, addr_t block) {
+    addr_t *old_seen;
+    uint32_t old_size, mask, i, j;
+
+    mask = p_profile->seen_size - 1;
+    for (i = hash_block(block) & mask; p_profile->seen[i] != 0;
+         i = (i + 1) & mask) {
+        if (p_profile->seen[i] == block + 1)
+            return 0;
+    }
+    p_profile->seen[i] = block + 1;
+    p_profile->seen_count++;
+
+    if (p_profile->seen_count * 2 > p_profile->seen_size) {
+        /* Double the size of the table, and rehash the blocks into it. */
+        old_seen = p_profile->seen;
+        old_size = p_profile->seen_size;
+
+        p_profile->seen_size *= 2;
+        p_profile->seen = calloc(p_profile->seen_size, sizeof(addr_t));
+        mask = p_profile->seen_size - 1;
+
+        for (j = 0; j < old_size; j++) {
+            if (old_seen[j] == 0)
+                continue;
+            for (i = hash_block(old_seen[j] - 1) & mask;
+                 p_profile->seen[i] != 0; i = (i + 1) & mask);
+            p_profile->seen[i] = old_seen[j];
+        }
+        free(old_seen);
+    }
+
+    return 1;
+}
+
+
+/*---------------------------------------------------------------------------
+ * REPORTING
+ */
+
+
+/* Prints a cache's miss classes, and its counts for each region and site
+ * that it saw accesses to, after the rest of its statistics.
+ */
+void print_profile_stats(cache_t *p_cache) {
+    cache_profile_t *p_profile = p_cache->profile;
+    uint32_t i;
+
+    if (p_profile->classify) {
+        printf("   misses:  compulsory=%lld capacity=%lld conflict=%lld\n",
+               p_profile->classes[MISS_COMPULSORY],
+               p_profile->classes[MISS_CAPACITY],
+               p_profile->classes[MISS_CONFLICT]);
+    }
+
+    for (i = 0; i < num_regions; i++) {
+        print_counts(region_names[i], p_profile->regions + i,
+                     p_profile->classify);
+    }
+    if (num_regions > 0) {
+        print_counts("(other)", p_profile->regions + MAX_PROFILE_REGIONS,
+                     p_profile->classify);
+    }
+
+    for (i = 0; i < num_sites; i++)
+        print_counts(sites[i], p_profile->sites + i, p_profile->classify);
+    if (num_sites > 0) {
+        print_counts("(unmarked)", p_profile->sites + MAX_ACCESS_SITES,
+                     p_profile->classify);
+    }
+}
+
+
+void print_counts(const char *name, const profile_counts_t *p_counts,
+                  int classify) {
+    if (p_counts->accesses == 0)
+        return;
+
+    printf("   %-20s accesses=%lld misses=%lld miss-rate=%.2f%%\n", name,
+           p_counts->accesses, p_counts->misses,
+           100.0 * p_counts->misses / p_counts->accesses);
+    if (classify) {
+        printf("   %-20s compulsory=%lld capacity=%lld conflict=%lld\n", "",
+               p_counts->classes[MISS_COMPULSORY],
+               p_counts->classes[MISS_CAPACITY],
+               p_counts->classes[MISS_CONFLICT]);
+    }
+}
+
+
+/* CSV output has one row per cache, region, site and memory, in the order
+ * of the levels, with a header row first.  Levels are numbered from 1, the
+ * level the program accesses.  Miss classes are empty for caches that don't
+ * classify misses, and hits and misses are empty for the memory.
+ */
+void write_stats_csv(FILE *file, membase_t *p_mem, int num_caches) {
+    cache_t *p_cache;
+    profile_counts_t counts;
+    char name[64];
+    int level;
+    uint32_t i;
+
+    fprintf(file, "level,kind,name,reads,writes,accesses,hits,misses,"
+            "compulsory,capacity,conflict\n");
+
+    for (level = 1; level <= num_caches; level++) {
+        p_cache = (cache_t *) p_mem;
+
+        sprintf(name, "%u:%u:%d", p_cache->block_size, p_cache->num_sets,
+                p_cache->cache_sets[0].num_lines);
+        memset(&counts, 0, sizeof(counts));
+        counts.accesses = p_cache->num_hits + p_cache->num_misses;
+        counts.misses = p_cache->num_misses;
+        memcpy(counts.classes, p_cache->profile->classes,
+               sizeof(counts.classes));
+
+        fprintf(file, "%d,cache,", level);
+        write_csv_string(file, name);
+        fprintf(file, ",%lld,%lld", p_cache->num_reads, p_cache->num_writes);
+        write_csv_row(file, level, NULL, NULL, &counts,
+                      p_cache->profile->classify);
+
+        for (i = 0; i < num_regions; i++) {
+            write_csv_row(file, level, "region", region_names[i],
+                          p_cache->profile->regions + i,
+                          p_cache->profile->classify);
+        }
+        if (num_regions > 0) {
+            write_csv_row(file, level, "region", "(other)",
+                          p_cache->profile->regions + MAX_PROFILE_REGIONS,
+                          p_cache->profile->classify);
+        }
+        for (i = 0; i < num_sites; i++) {
+            write_csv_row(file, level, "site", sites[i],
+                          p_cache->profile->sites + i,
+                          p_cache->profile->classify);
+        }
+        if (num_sites > 0) {
+            write_csv_row(file, level, "site", "(unmarked)",
+                          p_cache->profile->sites + MAX_ACCESS_SITES,
+                          p_cache->profile->classify);
+        }
+
+        p_mem = p_cache->next_memory;
+    }
+
+    fprintf(file, "%d,memory,memory,%lld,%lld,%lld,,,,,\n", level,
+            p_mem->num_reads, p_mem->num_writes,
+            p_mem->num_reads + p_mem->num_writes);
+}
+
+
+/* Writes the counts of a CSV row, after its first columns.  If kind is
+ * NULL, the first columns (through writes) have already been written.
+ */
+void write_csv_row(FILE *file, int level, const char *kind,
+                   const char *name, const profile_counts_t *p_counts,
+                   int classify) {
+    if (kind != NULL) {
+        fprintf(file, "%d,%s,", level, kind);
+        write_csv_string(file, name);
+        fprintf(file, ",,");
+    }
+
+    fprintf(file, ",%lld,%lld,%lld", p_counts->accesses,
+            p_counts->accesses - p_counts->misses, p_counts->misses);
+    if (classify) {
+        fprintf(file, ",%lld,%lld,%lld\n", p_counts->classes[MISS_COMPULSORY],
+                p_counts->classes[MISS_CAPACITY],
+                p_counts->classes[MISS_CONFLICT]);
+    }
+    else {
+        fprintf(file, ",,,\n");
+    }
+}
+
+
+/* Writes a quoted CSV field. */
+void write_csv_string(FILE *file, const char *s) {
+    fputc('"', file);
+    for (; *s != '\0'; s++) {
+        if (*s == '"')
+            fputc('"', file);
+        fputc(*s, file);
+    }
+    fputc('"', file);
+}
+
+
+/* JSON output is an object with a "levels" array, holding an object for
+ * each level from the one the program accesses down to the memory.
+ */
+void write_stats_json(FILE *file, membase_t *p_mem, int num_caches) {
+    cache_t *p_cache;
+    cache_profile_t *p_profile;
+    profile_counts_t counts;
+    int level;
+
+    fprintf(file, "{\n  \"levels\": [\n");
+
+    for (level = 1; level <= num_caches; level++) {
+        p_cache = (cache_t *) p_mem;
+        p_profile = p_cache->profile;
+
+        fprintf(file, "    {\n      \"level\": %d,\n      \"kind\": \"cache\",\n",
+                level);
+        fprintf(file, "      \"block_size\": %u,\n      \"sets\": %u,\n"
+                "      \"lines_per_set\": %d,\n      \"policy\": ",
+                p_cache->block_size, p_cache->num_sets,
+                p_cache->cache_sets[0].num_lines);
+        write_json_string(file, p_cache->policy->name);
+        fprintf(file, ",\n      \"reads\": %lld,\n      \"writes\": %lld,\n"
+                "      \"next_read_bytes\": %lld,\n"
+                "      \"next_write_bytes\": %lld,\n",
+                p_cache->num_reads, p_cache->num_writes,
+                p_cache->next_read_bytes, p_cache->next_write_bytes);
+
+        memset(&counts, 0, sizeof(counts));
+        counts.accesses = p_cache->num_hits + p_cache->num_misses;
+        counts.misses = p_cache->num_misses;
+        memcpy(counts.classes, p_profile->classes, sizeof(counts.classes));
+        fprintf(file, "      \"totals\": ");
+        write_json_counts(file, NULL, &counts, p_profile->classify);
+
+        fprintf(file, ",\n      \"regions\": ");
+        write_json_list(file, region_names, p_profile->regions, num_regions,
+                        MAX_PROFILE_REGIONS, "(other)", p_profile->classify);
+        fprintf(file, ",\n      \"sites\": ");
+        write_json_list(file, sites, p_profile->sites, num_sites,
+                        MAX_ACCESS_SITES, "(unmarked)", p_profile->classify);
+        fprintf(file, "\n    },\n");
+
+        p_mem = p_cache->next_memory;
+    }
+
+    fprintf(file, "    {\n      \"level\": %d,\n      \"kind\": \"memory\",\n"
+            "      \"reads\": %lld,\n      \"writes\": %lld\n    }\n  ]\n}\n",
+            level, p_mem->num_reads, p_mem->num_writes);
+}
+
+
+/* Writes a JSON array of the counts of the regions or sites that were
+ * accessed.  "counts" holds the counts of the num_named regions or sites
+ * listed in "names", and the counts for everything else at other_index.
+ */
+void write_json_list(FILE *file, const char **names,
+                     const profile_counts_t *counts, uint32_t num_named, uint32_t other_index,
+                     const char *other_name, int classify) {
+    uint32_t i, index;
+    int first = 1;
+
+    fputc('[', file);
+    for (i = 0; i < num_named + (num_named > 0); i++) {
+        index = (i < num_named) ? i : other_index;
+        if (counts[index].accesses == 0)
+            continue;
+
+        fputs(first ? "\n        " : ",\n        ", file);
+        write_json_counts(file, (i < num_named) ? names[i] :
+                          other_name, counts + index, classify);
+        first = 0;
+    }
+    fputs(first ? "]" : "\n      ]", file);
+}
+
+
+/* Writes a JSON object holding counts, with a "name" member if name isn't
+ * NULL.  The miss classes are only included if the cache classifies misses.
+ */
+void write_json_counts(FILE *file, const char *name,
+                       const profile_counts_t *p_counts, int classify) {
+    int i;
+
+    fprintf(file, "{");
+    if (name != NULL) {
+        fprintf(file, "\"name\": ");
+        write_json_string(file, name);
+        fprintf(file, ", ");
+    }
+    fprintf(file, "\"accesses\": %lld, \"hits\": %lld, \"misses\": %lld",
+            p_counts->accesses, p_counts->accesses - p_counts->misses,
+            p_counts->misses);
+    if (classify) {
+        for (i = 0; i < NUM_MISS_CLASSES; i++) {
+            fprintf(file, ", \"%s\": %lld", miss_class_names[i],
+                    p_counts->classes[i]);
+        }
+    }
+    fprintf(file, "}");
+}
+
+
+void write_json_string(FILE *file, const char *s) {
+    fputc('"', file);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(file, "\\%c", *s);
+        else if ((unsigned char) *s < 0x20)
+            fprintf(file, "\\u%04x", *s);
+        else
+            fputc(*s, file);
+    }
+    fputc('"', file);
+}
@@ -0,0 +1,130 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+
+#include <stdio.h>
+
+#include "cache.h"
+
+
+/* Miss classification and attribution.  A cache can classify each miss as
+ * compulsory (the block was never accessed before), capacity (a fully
+ * associative LRU cache of the same size would have missed too) or conflict
+ * (only the cache's limited associativity made it miss), by running a
+ * shadow fully-associative cache beside it.  Every cache also counts its
+ * accesses and misses per address region and per access site, once the
+ * program being simulated has registered regions or marked sites.
+ */
+
+
+/* The most regions and sites that can be registered. */
+#define MAX_PROFILE_REGIONS 16
+#define MAX_ACCESS_SITES 64
+
+
+/* The kinds of miss, as classified by a cache's shadow cache. */
+typedef enum miss_class {
+    MISS_COMPULSORY,
+    MISS_CAPACITY,
+    MISS_CONFLICT,
+    NUM_MISS_CLASSES
+} miss_class;
+
+
+/* The counts kept for a cache as a whole, and for each region and site. */
+typedef struct profile_counts_t {
+    /* The number of lookups, and the number that missed. */
+    uint64_t accesses;
+    uint64_t misses;
+
+    /* The misses of each class, if the cache classifies them. */
+    uint64_t classes[NUM_MISS_CLASSES];
+} profile_counts_t;
+
+
+/* A line of the shadow fully-associative cache.  Lines are kept in LRU
+ * order in a doubly-linked list, and found through a hash table of chains.
+ * Links are indexes into the array of lines, or -1.
+ */
+typedef struct shadow_line_t {
+    addr_t block;
+    int32_t prev;
+    int32_t next;
+    int32_t chain;
+} shadow_line_t;
+
+
+/* The profiling state of a cache. */
+typedef struct cache_profile_t {
+    /* Nonzero if misses are classified. */
+    int classify;
+
+    /* The shadow cache:  num_lines lines, of which num_used are in use,
+     * from most recently used (mru) to least (lru).
+     */
+    shadow_line_t *lines;
+    uint32_t num_lines;
+    uint32_t num_used;
+    int32_t mru;
+    int32_t lru;
+    int32_t *buckets;
+    uint32_t bucket_mask;
+
+    /* The blocks ever accessed, as an open-addressed hash set of block
+     * numbers plus 1, which grows as needed.
+     */
+    addr_t *seen;
+    uint32_t seen_size;
+    uint32_t seen_count;
+
+    /* Misses of each class across the whole cache. */
+    uint64_t classes[NUM_MISS_CLASSES];
+
+    /* The counts for each region, with one more for accesses outside all
+     * of them, and for each site, with one more for unmarked accesses.
+     */
+    profile_counts_t regions[MAX_PROFILE_REGIONS + 1];
+    profile_counts_t sites[MAX_ACCESS_SITES + 1];
+} cache_profile_t;
+
+
+/* Nonzero once any region has been registered or site marked, so caches
+ * know to count accesses by region and site.
+ */
+extern int profiling_active;
+
+
+/* Names a range of the simulated memory, e.g. an array, so that caches
+ * count the accesses and misses within it.  Returns 0 on success, or -1 if
+ * there are too many regions.
+ */
+int add_profile_region(const char *name, addr_t start, addr_t size);
+
+/* Attributes the accesses that follow, at every level of the memory, to
+ * the named site, e.g. one statement of the program being simulated.  A
+ * NULL name ends the attribution.  Sites past MAX_ACCESS_SITES count as
+ * unmarked.
+ */
+void set_access_site(const char *name);
+
+
+/* These functions are used by the cache implementation. */
+cache_profile_t * alloc_cache_profile();
+void set_miss_classification(cache_t *p_cache, int classify);
+void profile_access(cache_t *p_cache, addr_t address, int hit);
+void add_profile_counts(cache_profile_t *p_profile,
+                        const cache_profile_t *p_other);
+void reset_profile_counts(cache_profile_t *p_profile);
+void free_cache_profile(cache_profile_t *p_profile);
+
+void print_profile_stats(cache_t *p_cache);
+
+
+/* Writes the statistics of a memory hierarchy with num_caches caches in
+ * front of the memory, as CSV or JSON.
+ */
+void write_stats_csv(FILE *file, membase_t *p_mem, int num_caches);
+void write_stats_json(FILE *file, membase_t *p_mem, int num_caches);
+
+
+#endif /* PROFILE_H */
@@ -1,11 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <time.h>
-#include <assert.h>
 
 #include "memory.h"
 #include "cache.h"
 #include "cmdline.h"
+#include "profile.h"
+#include "sort.h"
 
 
 #define NUM_ELEMS 1000000
@@ -17,63 +19,8 @@
 #define SEED 54321098
 
 
-/* This helper handles the task of swapping two integers in the simulated
- * memory.
- */
-void swap_values(membase_t *p_mem, int i, int j) {
-    int i_val = read_int(p_mem, i);
-    int j_val = read_int(p_mem, j);
-
-    write_int(p_mem, i, j_val);
-    write_int(p_mem, j, i_val);
-}
-
-
-/* This function partitions a range of values between the start and end
- * indexes, inclusive, and then returns the index of the pivot value.
- */
-int partition(membase_t *p_mem, int start, int end) {
-    int pivot_idx, pivot, swap_idx, i;
-
-    assert(end > start);
-
-    pivot_idx = (start + end) / 2;
-    pivot = read_int(p_mem, pivot_idx);
-    swap_values(p_mem, pivot_idx, end);
-
-    swap_idx = start;
-    for (i = start; i < end; i++) {
-        if (read_int(p_mem, i) < pivot) {
-            swap_values(p_mem, i, swap_idx);
-            swap_idx++;
-        }
-    }
-
-    swap_values(p_mem, swap_idx, end);
-
-    return swap_idx;
-}
-
-
-/* This method implements the quicksort algorithm for a particular range
- * of values in the array.  The quicksort is implemented as a recursive
- * operation, and the array is sorted in-place.  The start and end indexes
- * are inclusive.
- */
-void quicksort(membase_t *p_mem, int start, int end) {
-    int pivot_idx;
-
-    if (end <= start)
-        return;
-
-    pivot_idx = partition(p_mem, start, end);
-    quicksort(p_mem, start, pivot_idx - 1);
-    quicksort(p_mem, pivot_idx + 1, end);
-}
-
-
 /* This function is used by the C standard-library function qsort(), so that
- * we can check the output of our quicksort algorithm.
+ * we can check the output of our sorting algorithm.
  */
 int compare_int_ptrs(const void *v1, const void *v2) {
     int i1 = *(int *) v1;
@@ -83,19 +30,90 @@ int compare_int_ptrs(const void *v1, const void *v2) {
 }
 
 
+void qsorttest_usage(const char *progname) {
+    int i;
+
+    printf("usage: %s [-a algorithm] [-n elements] [-s stats-file]\n"
+           "\t[-M latency[:bandwidth]] [-T tlb-spec ...] [-P page-size] "
+           "[cache-spec ...]\n\n", progname);
+    printf("\t-a algorithm    the sorting algorithm (default %s):\n",
+           sort_algorithms[0].name);
+    for (i = 0; sort_algorithms[i].name != NULL; i++) {
+        printf("\t\t%-12s%s\n", sort_algorithms[i].name,
+               sort_algorithms[i].description);
+    }
+    printf("\t-n elements     the number of ints to sort (default %d)\n",
+           NUM_ELEMS);
+    printf("\tCache specifications are described below.\n\n");
+    usage(progname);
+}
+
+
 int main(int argc, const char **argv) {
+    const sort_algorithm_t *algorithm = sort_algorithms;
+    int num_elems = NUM_ELEMS;
     int *inputs;
-    int i, error;
+    int i, opt, error;
     membase_t *p_mem;
 
-    /* Set up the simulated memory. */
-    p_mem = make_cached_memory(argc, argv, NUM_ELEMS * sizeof(int));
+    while ((opt = getopt(argc, (char * const *) argv, "a:n:s:M:T:P:")) != -1) {
+        switch (opt) {
+        case 'a':
+            algorithm = find_sort_algorithm(optarg);
+            if (algorithm == NULL) {
+                printf("ERROR:  unknown algorithm \"%s\".\n", optarg);
+                qsorttest_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        case 'n':
+            num_elems = atoi(optarg);
+            break;
+
+        case 's':
+            set_stats_file(optarg);
+            break;
+
+        case 'M':
+            if (parse_memory_timing(optarg) != 0) {
+                qsorttest_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        case 'T':
+        case 'P':
+            if ((opt == 'T') ? parse_tlb_spec(optarg) != 0 :
+                               parse_page_size(optarg) != 0) {
+                qsorttest_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        default:
+            qsorttest_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (num_elems <= 0) {
+        printf("ERROR:  the number of elements must be positive.\n");
+        qsorttest_usage(argv[0]);
+        return 1;
+    }
+
+    /* Set up the simulated memory.  The remaining arguments are the cache
+     * specifications.
+     */
+    argv[optind - 1] = argv[0];
+    p_mem = make_cached_memory(argc - optind + 1, argv + optind - 1,
+                               algorithm->mem_size(num_elems));
 
     /* Generate random floats to sort. */
 
-    printf("Generating %d random ints to sort.\n", NUM_ELEMS);
+    printf("Generating %d random ints to sort.\n", num_elems);
 
-    inputs = malloc(NUM_ELEMS * sizeof(float));
+    inputs = malloc(num_elems * sizeof(int));
 
     srand(SEED);
 
@@ -103,25 +121,33 @@ int main(int argc, const char **argv) {
      * separate loop, so that the inputs we use don't change if the random
      * replacement policy is currently in effect.
      */
-    for (i = 0; i < NUM_ELEMS; i++)
+    for (i = 0; i < num_elems; i++)
         inputs[i] = rand();
     
-    for (i = 0; i < NUM_ELEMS; i++)
+    add_profile_region("array", 0, num_elems * sizeof(int));
+    if (algorithm->mem_size(num_elems) > num_elems * sizeof(int)) {
+        add_profile_region("scratch", num_elems * sizeof(int),
+            algorithm->mem_size(num_elems) - num_elems * sizeof(int));
+    }
+    set_access_site("fill");
+    for (i = 0; i < num_elems; i++)
         write_int(p_mem, i, inputs[i]);
 
-    /* Quicksort the array of integers. */
+    /* Sort the array of integers. */
 
-    printf("Quicksorting the array of integers.\n");
-    quicksort(p_mem, 0, NUM_ELEMS - 1);
+    printf("Sorting the array of integers with the %s algorithm.\n",
+           algorithm->name);
+    algorithm->sort(p_mem, num_elems);
 
     /* Sort the inputs so that we can check the heap's results. */
 
     printf("Checking the results against the sorted inputs.\n");
 
-    qsort(inputs, NUM_ELEMS, sizeof(float), compare_int_ptrs);
+    qsort(inputs, num_elems, sizeof(int), compare_int_ptrs);
 
+    set_access_site("check");
     error = 0;
-    for (i = 0; i < NUM_ELEMS; i++) {
+    for (i = 0; i < num_elems; i++) {
         int val = read_int(p_mem, i);
         if (val != inputs[i]) {
             printf("ERROR:  sorted arrays don't match at index %d!  "
@@ -135,11 +161,14 @@ int main(int argc, const char **argv) {
         abort();
     }
 
-    /* Print out the results of the quicksort. */
+    /* Print out the results of the sort. */
 
     printf("\nMemory-Access Statistics:\n\n");
     p_mem->print_stats(p_mem);
     printf("\n");
+    print_timing_summary(p_mem);
+    printf("\n");
+    write_stats_file(p_mem);
 
     return 0;
 }
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "replace.h"
+
+
+/* Implementations of the cache replacement policies.  Every policy is only
+ * asked for a victim when all lines of the set are valid; the cache itself
+ * fills invalid lines first.
+ */
+
+
+/* The largest re-reference prediction value for SRRIP and BRRIP, which use
+ * 2 bits per line.
+ */
+#define RRPV_MAX 3
+
+/* BRRIP inserts blocks with a long rather than a distant re-reference
+ * prediction once in this many insertions.
+ */
+#define BRRIP_LONG_INTERVAL 32
+
+
+/* Returns the index of a line within its set. */
+static int line_index(cacheset_t *p_set, cacheline_t *p_line) {
+    return p_line - p_set->cache_lines;
+}
+
+
+/*---------------------------------------------------------------------------
+ * LRU:  evict the line that was least recently accessed.
+ */
+
+
+static void lru_touch(cache_t *p_cache, cacheset_t *p_set,
+                      cacheline_t *p_line) {
+    p_set->ages[line_index(p_set, p_line)] = clock_tick();
+}
+
+
+/* Returns the line with the smallest age, i.e. the oldest one. */
+static cacheline_t * oldest_line(cache_t *p_cache, cacheset_t *p_set) {
+    uint64_t *ages = p_set->ages, oldest = ages[0];
+    int i, victim = 0;
+
+    for (i = 1; i < p_set->num_lines; i++) {
+        if (ages[i] < oldest) {
+            oldest = ages[i];
+            victim = i;
+        }
+    }
+    return p_set->cache_lines + victim;
+}
+
+
+static const replpolicy_t lru_policy = {
+    "lru", 0, 0, NULL, lru_touch, lru_touch, oldest_line
+};
+
+
+/*---------------------------------------------------------------------------
+ * FIFO:  evict the line that was loaded the longest ago.
+ */
+
+
+static void fifo_touch(cache_t *p_cache, cacheset_t *p_set,
+                       cacheline_t *p_line) {
+    /* Hits don't change the order of eviction. */
+}
+
+
+static const replpolicy_t fifo_policy = {
+    "fifo", 0, 0, NULL, fifo_touch, lru_touch, oldest_line
+};
+
+
+/*---------------------------------------------------------------------------
+ * Random:  evict any line.
+ */
+
+
+static cacheline_t * random_victim(cache_t *p_cache, cacheset_t *p_set) {
+    return p_set->cache_lines + rand() % p_set->num_lines;
+}
+
+
+static const replpolicy_t random_policy = {
+    "random", 0, 0, NULL, fifo_touch, fifo_touch, random_victim
+};
+
+
+/*---------------------------------------------------------------------------
+ * LFU:  evict the line accessed the fewest times since it was loaded, and
+ * the least recently used of those on a tie.  repl_state is the count.
+ */
+
+
+static void lfu_touch(cache_t *p_cache, cacheset_t *p_set,
+                      cacheline_t *p_line) {
+    p_line->repl_state++;
+    p_set->ages[line_index(p_set, p_line)] = clock_tick();
+}
+
+
+static void lfu_insert(cache_t *p_cache, cacheset_t *p_set,
+                       cacheline_t *p_line) {
+    p_line->repl_state = 1;
+    p_set->ages[line_index(p_set, p_line)] = clock_tick();
+}
+
+
+static cacheline_t * lfu_victim(cache_t *p_cache, cacheset_t *p_set) {
+    cacheline_t *victim = p_set->cache_lines, *p_line;
+    int i;
+
+    for (i = 1; i < p_set->num_lines; i++) {
+        p_line = p_set->cache_lines + i;
+        if (p_line->repl_state < victim->repl_state ||
+            (p_line->repl_state == victim->repl_state &&
+             p_set->ages[i] < p_set->ages[line_index(p_set, victim)]))
+            victim = p_line;
+    }
+    return victim;
+}
+
+
+static const replpolicy_t lfu_policy = {
+    "lfu", 0, 0, NULL, lfu_touch, lfu_insert, lfu_victim
+};
+
+
+/*---------------------------------------------------------------------------
+ * Tree pseudo-LRU:  the lines are the leaves of a binary tree, and each
+ * interior node has a bit saying which half of its subtree was used less
+ * recently.  The victim is found by following the bits from the root.  The
+ * tree is stored in heap order in the set's policy_state, one byte per node.
+ */
+
+
+static void plru_init_set(cache_t *p_cache, cacheset_t *p_set) {
+    p_set->policy_state = calloc(p_set->num_lines, 1);
+}
+
+
+static void plru_touch(cache_t *p_cache, cacheset_t *p_set,
+                       cacheline_t *p_line) {
+    unsigned char *bits = p_set->policy_state;
+    int index = line_index(p_set, p_line);
+    int node = 0, half = p_set->num_lines / 2, dir;
+
+    /* Walk down to the line, pointing each node away from it. */
+    while (half > 0) {
+        dir = (index & half) ? 1 : 0;
+        bits[node] = !dir;
+        node = 2 * node + 1 + dir;
+        half /= 2;
+    }
+}
+
+
+static cacheline_t * plru_victim(cache_t *p_cache, cacheset_t *p_set) {
+    unsigned char *bits = p_set->policy_state;
+    int node = 0, index = 0, half = p_set->num_lines / 2;
+
+    while (half > 0) {
+        index = 2 * index + bits[node];
+        node = 2 * node + 1 + bits[node];
+        half /= 2;
+    }
+    return p_set->cache_lines + index;
+}
+
+
+static const replpolicy_t plru_policy = {
+    "plru", 1, 0, plru_init_set, plru_touch, plru_touch, plru_victim
+};
+
+
+/*---------------------------------------------------------------------------
+ * SRRIP and BRRIP (Jaleel et al., "High Performance Cache Replacement Using
+ * Re-Reference Interval Prediction"):  each line has a 2-bit prediction of
+ * how soon it will be used again, in repl_state.  Hits predict a near
+ * re-reference, and the victim is a line predicting a distant one, aging
+ * all lines until there is one.  SRRIP inserts new blocks with a long
+ * prediction; BRRIP usually inserts them with a distant one, so blocks that
+ * are never reused don't push out the working set.
+ */
+
+
+static void rrip_touch(cache_t *p_cache, cacheset_t *p_set,
+                       cacheline_t *p_line) {
+    p_line->repl_state = 0;
+}
+
+
+static void srrip_insert(cache_t *p_cache, cacheset_t *p_set,
+                         cacheline_t *p_line) {
+    p_line->repl_state = RRPV_MAX - 1;
+}
+
+
+static void brrip_insert(cache_t *p_cache, cacheset_t *p_set,
+                         cacheline_t *p_line) {
+    if (rand() % BRRIP_LONG_INTERVAL == 0)
+        p_line->repl_state = RRPV_MAX - 1;
+    else
+        p_line->repl_state = RRPV_MAX;
+}
+
+
+static cacheline_t * rrip_victim(cache_t *p_cache, cacheset_t *p_set) {
+    int i;
+
+    for (;;) {
+        for (i = 0; i < p_set->num_lines; i++) {
+            if (p_set->cache_lines[i].repl_state >= RRPV_MAX)
+                return p_set->cache_lines + i;
+        }
+        for (i = 0; i < p_set->num_lines; i++)
+            p_set->cache_lines[i].repl_state++;
+    }
+}
+
+
+static const replpolicy_t srrip_policy = {
+    "srrip", 0, 0, NULL, rrip_touch, srrip_insert, rrip_victim
+};
+
+static const replpolicy_t brrip_policy = {
+    "brrip", 0, 0, NULL, rrip_touch, brrip_insert, rrip_victim
+};
+
+
+/*---------------------------------------------------------------------------
+ * Belady's optimal policy:  evict the line whose block will be used again
+ * the furthest in the future, as told by the registered next-use oracle.
+ * In a multi-level hierarchy every level sees the next uses in the program's
+ * own access stream, rather than in the stream that reaches that level.
+ */
+
+
+static next_use_fn oracle_next_use = NULL;
+static void *oracle_context = NULL;
+
+
+void set_next_use_oracle(next_use_fn next_use, void *context) {
+    oracle_next_use = next_use;
+    oracle_context = context;
+}
+
+
+static cacheline_t * opt_victim(cache_t *p_cache, cacheset_t *p_set) {
+    cacheline_t *victim = NULL, *p_line;
+    uint64_t furthest = 0, next_use;
+    int i;
+
+    assert(oracle_next_use != NULL);
+
+    for (i = 0; i < p_set->num_lines; i++) {
+        p_line = p_set->cache_lines + i;
+        next_use = oracle_next_use(oracle_context,
+            get_block_start_from_line_info(p_cache, p_line->tag,
+                                           p_set->set_no),
+            p_cache->block_size);
+
+        if (victim == NULL || next_use > furthest) {
+            victim = p_line;
+            furthest = next_use;
+        }
+    }
+    return victim;
+}
+
+
+static const replpolicy_t opt_policy = {
+    "opt", 0, 1, NULL, fifo_touch, fifo_touch, opt_victim
+};
+
+
+/*---------------------------------------------------------------------------
+ * POLICY LOOKUP
+ */
+
+
+const replpolicy_t *replacement_policies[] = {
+    &lru_policy, &fifo_policy, &random_policy, &lfu_policy, &plru_policy,
+    &srrip_policy, &brrip_policy, &opt_policy, NULL
+};
+
+
+/* Returns the policy with the given name, or NULL if there isn't one. */
+const replpolicy_t * find_replacement_policy(const char *name) {
+    int i;
+
+    for (i = 0; replacement_policies[i] != NULL; i++) {
+        if (strcmp(replacement_policies[i]->name, name) == 0)
+            return replacement_policies[i];
+    }
+    return NULL;
+}
+
+
+/* Returns nonzero if the next-use oracle needed by Belady's policy has been
+ * registered.
+ */
+int have_next_use_oracle() {
+    return oracle_next_use != NULL;
+}
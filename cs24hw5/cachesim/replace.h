@@ -0,0 +1,65 @@
+#ifndef REPLACE_H
+#define REPLACE_H
+
+
+#include "cache.h"
+
+
+/* This struct describes a cache replacement policy.  Each cache points to
+ * one of these, and calls its functions as lines are accessed and replaced.
+ * Policies keep their per-line state in the ages of cacheset_t and the
+ * repl_state member of cacheline_t, and any per-set state in the
+ * policy_state of cacheset_t.
+ */
+typedef struct replpolicy_t {
+    /* The name of the policy, as given in cache specifications. */
+    const char *name;
+
+    /* Nonzero if the policy only works with a power-of-2 number of lines
+     * per set.
+     */
+    int needs_power_of_2_lines;
+
+    /* Nonzero if the policy needs to know when blocks will next be used;
+     * see set_next_use_oracle().
+     */
+    int needs_oracle;
+
+    /* Sets up any per-set state.  May be NULL. */
+    void (*init_set)(cache_t *p_cache, cacheset_t *p_set);
+
+    /* Called when an access hits in a line. */
+    void (*touch)(cache_t *p_cache, cacheset_t *p_set, cacheline_t *p_line);
+
+    /* Called when a block has been loaded into a line. */
+    void (*insert)(cache_t *p_cache, cacheset_t *p_set, cacheline_t *p_line);
+
+    /* Chooses a line to evict from a set whose lines are all valid. */
+    cacheline_t * (*choose_victim)(cache_t *p_cache, cacheset_t *p_set);
+} replpolicy_t;
+
+
+/* The policies that can be selected by name.  The first is the default. */
+extern const replpolicy_t *replacement_policies[];
+
+
+/* Returns the policy with the given name, or NULL if there isn't one. */
+const replpolicy_t * find_replacement_policy(const char *name);
+
+
+/* Belady's optimal policy evicts the line whose block will be used again the
+ * furthest in the future, so it needs to see the upcoming accesses.  This
+ * function type returns the sequence number of the next access to any byte
+ * of the block starting at "address", or UINT64_MAX if there is none in
+ * sight.  A trace-driven program registers one with set_next_use_oracle()
+ * before building its caches.
+ */
+typedef uint64_t (*next_use_fn)(void *context, addr_t address, uint32_t size);
+
+void set_next_use_oracle(next_use_fn next_use, void *context);
+
+/* Returns nonzero if a next-use oracle has been registered. */
+int have_next_use_oracle();
+
+
+#endif /* REPLACE_H */
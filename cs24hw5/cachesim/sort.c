@@ -0,0 +1,168 @@
+#include <assert.h>
+#include <string.h>
+
+#include "sort.h"
+#include "profile.h"
+
+
+/* Local functions used by the sorting algorithms. */
+
+void swap_values(membase_t *p_mem, int i, int j);
+int partition(membase_t *p_mem, int start, int end);
+void quicksort(membase_t *p_mem, int start, int end);
+
+uint32_t quicksort_mem_size(int num_elems);
+void quicksort_array(membase_t *p_mem, int num_elems);
+uint32_t radix_sort_mem_size(int num_elems);
+void radix_sort(membase_t *p_mem, int num_elems);
+
+
+const sort_algorithm_t sort_algorithms[] = {
+    { "quick", "recursive in-place quicksort",
+      quicksort_mem_size, quicksort_array },
+    { "radix", "LSD radix sort through a scratch array, a byte per pass",
+      radix_sort_mem_size, radix_sort },
+    { NULL }
+};
+
+
+const sort_algorithm_t * find_sort_algorithm(const char *name) {
+    const sort_algorithm_t *algorithm;
+
+    for (algorithm = sort_algorithms; algorithm->name != NULL; algorithm++) {
+        if (strcmp(algorithm->name, name) == 0)
+            return algorithm;
+    }
+    return NULL;
+}
+
+
+/* This helper handles the task of swapping two integers in the simulated
+ * memory.
+ */
+void swap_values(membase_t *p_mem, int i, int j) {
+    int i_val, j_val;
+
+    set_access_site("swap_values");
+    i_val = read_int(p_mem, i);
+    j_val = read_int(p_mem, j);
+
+    write_int(p_mem, i, j_val);
+    write_int(p_mem, j, i_val);
+}
+
+
+/* This function partitions a range of values between the start and end
+ * indexes, inclusive, and then returns the index of the pivot value.
+ */
+int partition(membase_t *p_mem, int start, int end) {
+    int pivot_idx, pivot, swap_idx, i;
+
+    assert(end > start);
+
+    pivot_idx = (start + end) / 2;
+    set_access_site("partition");
+    pivot = read_int(p_mem, pivot_idx);
+    swap_values(p_mem, pivot_idx, end);
+
+    swap_idx = start;
+    for (i = start; i < end; i++) {
+        set_access_site("partition");
+        if (read_int(p_mem, i) < pivot) {
+            swap_values(p_mem, i, swap_idx);
+            swap_idx++;
+        }
+    }
+
+    swap_values(p_mem, swap_idx, end);
+
+    return swap_idx;
+}
+
+
+/* This method implements the quicksort algorithm for a particular range
+ * of values in the array.  The quicksort is implemented as a recursive
+ * operation, and the array is sorted in-place.  The start and end indexes
+ * are inclusive.
+ */
+void quicksort(membase_t *p_mem, int start, int end) {
+    int pivot_idx;
+
+    if (end <= start)
+        return;
+
+    pivot_idx = partition(p_mem, start, end);
+    quicksort(p_mem, start, pivot_idx - 1);
+    quicksort(p_mem, pivot_idx + 1, end);
+}
+
+
+uint32_t quicksort_mem_size(int num_elems) {
+    return num_elems * sizeof(int);
+}
+
+
+void quicksort_array(membase_t *p_mem, int num_elems) {
+    quicksort(p_mem, 0, num_elems - 1);
+}
+
+
+/* Radix sort needs a scratch array as big as the input, and a count for
+ * each digit.
+ */
+uint32_t radix_sort_mem_size(int num_elems) {
+    return (2 * num_elems + (1 << RADIX_BITS)) * sizeof(int);
+}
+
+
+/* LSD radix sort:  each pass counts the keys with each value of a digit,
+ * turns the counts into the index where each digit's keys start, and then
+ * scatters the keys to those places in the other array, in order.  The
+ * keys are read in two sequential streams, but the scatter writes to one
+ * place per digit value at a time, which is a different access pattern
+ * from quicksort's.  There are an even number of passes, so the sorted
+ * keys end up back in the input array.
+ */
+void radix_sort(membase_t *p_mem, int num_elems) {
+    int num_digits = 1 << RADIX_BITS;
+    int src = 0, dst = num_elems, counts = 2 * num_elems;
+    int shift, digit, i, index, total, count, tmp;
+    uint32_t key;
+
+    assert(32 % (2 * RADIX_BITS) == 0);
+
+    for (shift = 0; shift < 32; shift += RADIX_BITS) {
+        set_access_site("radix count");
+        for (digit = 0; digit < num_digits; digit++)
+            write_int(p_mem, counts + digit, 0);
+
+        for (i = 0; i < num_elems; i++) {
+            key = read_int(p_mem, src + i);
+            digit = (key >> shift) & (num_digits - 1);
+            write_int(p_mem, counts + digit,
+                      read_int(p_mem, counts + digit) + 1);
+        }
+
+        set_access_site("radix prefix");
+        total = 0;
+        for (digit = 0; digit < num_digits; digit++) {
+            count = read_int(p_mem, counts + digit);
+            write_int(p_mem, counts + digit, total);
+            total += count;
+        }
+
+        set_access_site("radix scatter");
+        for (i = 0; i < num_elems; i++) {
+            key = read_int(p_mem, src + i);
+            digit = (key >> shift) & (num_digits - 1);
+            index = read_int(p_mem, counts + digit);
+            write_int(p_mem, counts + digit, index + 1);
+            write_int(p_mem, dst + index, key);
+        }
+
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    set_access_site(NULL);
+}
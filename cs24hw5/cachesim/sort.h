@@ -0,0 +1,36 @@
+#ifndef __SORT_H__
+#define __SORT_H__
+
+
+#include "membase.h"
+
+
+/* This struct describes an algorithm that sorts an array of non-negative
+ * ints stored at the start of the memory.
+ */
+typedef struct sort_algorithm_t {
+    /* The name of the algorithm, as given with -a. */
+    const char *name;
+
+    const char *description;
+
+    /* Returns the bytes of memory the algorithm needs to sort num_elems
+     * ints, including any scratch space after the array.
+     */
+    uint32_t (*mem_size)(int num_elems);
+
+    void (*sort)(membase_t *p_mem, int num_elems);
+} sort_algorithm_t;
+
+
+/* The algorithms, ending with a NULL name.  The first is quicksort. */
+extern const sort_algorithm_t sort_algorithms[];
+
+const sort_algorithm_t * find_sort_algorithm(const char *name);
+
+
+/* LSD radix sort uses this many bits of the keys per pass. */
+#define RADIX_BITS 8
+
+
+#endif /* __SORT_H__ */
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "membase.h"
+#include "stackdist.h"
+
+
+/* Local functions used by the stack-distance engine. */
+
+void access_block(stackdist_t *p_sd, uint64_t block);
+
+
+/* Initializes the engine for caches with the specified block size, up to
+ * 2^max_set_bits sets and max_lines lines per set.  All stacks start out
+ * empty.
+ */
+void init_stackdist(stackdist_t *p_sd, uint32_t block_size,
+                    uint32_t max_set_bits, uint32_t max_lines) {
+    uint32_t s, num_sets;
+
+    assert(p_sd != NULL);
+    assert(is_power_of_2(block_size));
+    assert(max_lines > 0);
+
+    bzero(p_sd, sizeof(stackdist_t));
+
+    p_sd->block_size = block_size;
+    p_sd->block_offset_bits = log_2(block_size);
+    p_sd->max_set_bits = max_set_bits;
+    p_sd->max_lines = max_lines;
+
+    p_sd->stacks = malloc((max_set_bits + 1) * sizeof(uint64_t *));
+    p_sd->depths = malloc((max_set_bits + 1) * sizeof(uint32_t *));
+    p_sd->hits = malloc((max_set_bits + 1) * sizeof(uint64_t *));
+
+    for (s = 0; s <= max_set_bits; s++) {
+        num_sets = 1 << s;
+        p_sd->stacks[s] = malloc(num_sets * max_lines * sizeof(uint64_t));
+        p_sd->depths[s] = calloc(num_sets, sizeof(uint32_t));
+        p_sd->hits[s] = calloc(max_lines, sizeof(uint64_t));
+    }
+}
+
+
+/* Records an access to a range of bytes.  The range is split into the blocks
+ * it covers, and each one is looked up in every simulated configuration.
+ */
+void stackdist_access(stackdist_t *p_sd, uint64_t address, uint32_t size) {
+    uint64_t block, last_block;
+
+    assert(size > 0);
+
+    block = address >> p_sd->block_offset_bits;
+    last_block = (address + size - 1) >> p_sd->block_offset_bits;
+    do {
+        access_block(p_sd, block);
+    }
+    while (block++ != last_block);
+}
+
+
+/* Looks up a block in its set's LRU stack for every number of set-index
+ * bits, recording the depth it was found at, and moves it to the top of the
+ * stack.
+ */
+void access_block(stackdist_t *p_sd, uint64_t block) {
+    uint32_t s, depth, i;
+    uint64_t *stack;
+    uint32_t *p_depth;
+
+    p_sd->num_accesses++;
+
+    for (s = 0; s <= p_sd->max_set_bits; s++) {
+        uint64_t set_no = block & (((uint64_t) 1 << s) - 1);
+
+        stack = p_sd->stacks[s] + set_no * p_sd->max_lines;
+        p_depth = p_sd->depths[s] + set_no;
+
+        for (depth = 0; depth < *p_depth; depth++) {
+            if (stack[depth] == block)
+                break;
+        }
+
+        if (depth < *p_depth) {
+            /* Found in the stack:  a hit in every cache this deep. */
+            p_sd->hits[s][depth]++;
+        }
+        else if (*p_depth < p_sd->max_lines) {
+            /* Not found, and the stack has room to grow. */
+            (*p_depth)++;
+        }
+        else {
+            /* Not found; the bottom entry falls off the stack. */
+            depth = p_sd->max_lines - 1;
+        }
+
+        /* Move everything above the block down, and put it on top. */
+        for (i = depth; i > 0; i--)
+            stack[i] = stack[i - 1];
+        stack[0] = block;
+    }
+}
+
+
+/* Returns the number of misses in an LRU cache with 2^set_bits sets and
+ * "lines" lines per set, i.e. the accesses that weren't found within the
+ * top "lines" entries of their stack.
+ */
+uint64_t stackdist_misses(stackdist_t *p_sd, uint32_t set_bits,
+                          uint32_t lines) {
+    uint64_t misses = p_sd->num_accesses;
+    uint32_t depth;
+
+    assert(set_bits <= p_sd->max_set_bits);
+    assert(lines > 0 && lines <= p_sd->max_lines);
+
+    for (depth = 0; depth < lines; depth++)
+        misses -= p_sd->hits[set_bits][depth];
+
+    return misses;
+}
+
+
+/* This function releases all heap-allocated memory used by the engine. */
+void free_stackdist(stackdist_t *p_sd) {
+    uint32_t s;
+
+    for (s = 0; s <= p_sd->max_set_bits; s++) {
+        free(p_sd->stacks[s]);
+        free(p_sd->depths[s]);
+        free(p_sd->hits[s]);
+    }
+    free(p_sd->stacks);
+    free(p_sd->depths);
+    free(p_sd->hits);
+}
@@ -0,0 +1,66 @@
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+
+#include <stdint.h>
+
+
+/* This struct holds the state of a Mattson stack-distance engine, which
+ * simulates every LRU cache with a given block size, up to a maximum number
+ * of sets and lines per set, in a single pass over an access stream.
+ *
+ * For each number of set-index bits s, every set keeps its blocks in an LRU
+ * stack, most recently used first.  An access to a block at depth d of its
+ * set's stack hits in every cache with 2^s sets and more than d lines per
+ * set, and misses in the rest, so a histogram of the depths gives the misses
+ * of all associativities at once.  Stacks are only kept max_lines deep, since
+ * deeper accesses miss in every simulated cache anyway.
+ */
+typedef struct stackdist_t {
+    /* The block size shared by all the simulated caches; a power of 2. */
+    uint32_t block_size;
+    uint32_t block_offset_bits;
+
+    /* Caches with 2^0 up to 2^max_set_bits sets are simulated. */
+    uint32_t max_set_bits;
+
+    /* Caches with 1 up to max_lines lines per set are simulated. */
+    uint32_t max_lines;
+
+    /* stacks[s] holds the LRU stacks of the 2^s sets, max_lines entries per
+     * set, and depths[s] holds the number of valid entries of each stack.
+     */
+    uint64_t **stacks;
+    uint32_t **depths;
+
+    /* hits[s][d] is the number of accesses found at depth d of their stack
+     * with s set-index bits.
+     */
+    uint64_t **hits;
+
+    /* The number of block accesses simulated.  An access that spans several
+     * blocks counts once per block.
+     */
+    uint64_t num_accesses;
+} stackdist_t;
+
+
+/* Initializes the engine.  This requires a number of heap allocations, so
+ * the engine must be released with free_stackdist() when done.
+ */
+void init_stackdist(stackdist_t *p_sd, uint32_t block_size,
+                    uint32_t max_set_bits, uint32_t max_lines);
+
+/* Records an access to "size" bytes starting at "address". */
+void stackdist_access(stackdist_t *p_sd, uint64_t address, uint32_t size);
+
+/* Returns the number of misses in an LRU cache with 2^set_bits sets and
+ * "lines" lines per set.  Cold misses are included.
+ */
+uint64_t stackdist_misses(stackdist_t *p_sd, uint32_t set_bits,
+                          uint32_t lines);
+
+void free_stackdist(stackdist_t *p_sd);
+
+
+#endif /* STACKDIST_H */
@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cmdline.h"
+#include "apsp.h"
+#include "sort.h"
+#include "memory.h"
+#include "cache.h"
+
+
+/* Runs the shortest-path and sorting workloads against each of several
+ * cache configurations, and prints a table of the miss rates each workload
+ * gets with each configuration, e.g.:
+ *
+ *     ./sweep -w apsp 32:16:4 32:64:4,64:1024:8 64:64:8:plru,64:1024:16
+ *
+ * Each configuration is a comma-separated list of cache specifications,
+ * from the cache the program accesses down.
+ */
+
+
+/* The most configurations that can be compared. */
+#define MAX_CONFIGS 16
+
+/* The most caches in each configuration. */
+#define MAX_LEVELS 8
+
+/* The default problem sizes, smaller than apsptest's and qsorttest's so
+ * that a sweep doesn't take too long.
+ */
+#define DEFAULT_NODES 128
+#define DEFAULT_ELEMS 100000
+
+/* The percent of edges present in the graphs, as in apsptest. */
+#define CONNECTED_PCT 10
+
+/* Every workload and configuration sees the same random data. */
+#define SEED 54321098
+
+
+/* A workload:  one of the shortest-path or sorting algorithms. */
+typedef struct workload_t {
+    char name[32];
+    const apsp_algorithm_t *apsp;
+    const sort_algorithm_t *sort;
+} workload_t;
+
+
+/* A configuration:  model caches built from the specifications, which each
+ * run's caches are copied from.
+ */
+typedef struct config_t {
+    const char *spec;
+    uint32_t num_levels;
+    cache_t *levels[MAX_LEVELS];
+} config_t;
+
+
+/* The results of running a workload against a configuration. */
+typedef struct result_t {
+    double miss_rates[MAX_LEVELS];
+    double amat;
+} result_t;
+
+
+/* Local functions. */
+
+void sweep_usage(const char *progname);
+int add_workloads(workload_t *workloads, int num_workloads, const char *name);
+void build_config(config_t *p_config, const char *progname, int arg_no,
+                  membase_t *p_memory, uint32_t mem_size);
+void record_results(cache_t **caches, uint32_t num_levels,
+                    result_t *p_result);
+int run_apsp(const workload_t *p_work, membase_t *p_mem, int num_nodes,
+             int tile, cache_t **caches, uint32_t num_levels,
+             result_t *p_result);
+int run_sort(const workload_t *p_work, membase_t *p_mem, int num_elems,
+             cache_t **caches, uint32_t num_levels, result_t *p_result);
+int compare_int_ptrs(const void *v1, const void *v2);
+void print_row(const char *name, result_t *results, config_t *configs,
+               int num_configs, int amat);
+
+
+void sweep_usage(const char *progname) {
+    int i;
+
+    printf("usage: %s [-w workload,...] [-n nodes] [-e elements] [-b tile]\n"
+           "\t[-M latency[:bandwidth]] config ...\n\n", progname);
+    printf("\t-w workloads    the workloads to run, or apsp or sort for all "
+           "of either\n\t                kind (default all):\n");
+    for (i = 0; apsp_algorithms[i].name != NULL; i++) {
+        printf("\t\tapsp-%-12s%s\n", apsp_algorithms[i].name,
+               apsp_algorithms[i].description);
+    }
+    for (i = 0; sort_algorithms[i].name != NULL; i++) {
+        printf("\t\tsort-%-12s%s\n", sort_algorithms[i].name,
+               sort_algorithms[i].description);
+    }
+    printf("\t-n nodes        nodes in the graphs (default %d)\n",
+           DEFAULT_NODES);
+    printf("\t-e elements     ints to sort (default %d)\n", DEFAULT_ELEMS);
+    printf("\t-b tile         the tile or base-case size of the shortest-path "
+           "algorithms,\n\t                in nodes (default %d)\n",
+           DEFAULT_APSP_TILE);
+    printf("\t-M latency[:bandwidth]\n\t                the memory's latency "
+           "in cycles, and bytes per cycle\n");
+    printf("\n");
+    printf("\tEach config is a comma-separated list of cache specifications, "
+           "from the\n\tcache the program accesses down, e.g. "
+           "32:64:4,64:1024:8.  Up to %d configs\n\tmay be given.\n",
+           MAX_CONFIGS);
+    printf("\tCache specifications are described below.\n\n");
+    cache_spec_usage();
+}
+
+
+/* Adds the workloads selected by one name given with -w.  Returns the new
+ * number of workloads, or -1 if the name isn't recognized.
+ */
+int add_workloads(workload_t *workloads, int num_workloads,
+                  const char *name) {
+    int i, found = 0;
+
+    for (i = 0; apsp_algorithms[i].name != NULL; i++) {
+        sprintf(workloads[num_workloads].name, "apsp-%s",
+                apsp_algorithms[i].name);
+        if (strcmp(name, "apsp") == 0 ||
+            strcmp(name, workloads[num_workloads].name) == 0) {
+            workloads[num_workloads].apsp = apsp_algorithms + i;
+            workloads[num_workloads].sort = NULL;
+            num_workloads++;
+            found = 1;
+        }
+    }
+    for (i = 0; sort_algorithms[i].name != NULL; i++) {
+        sprintf(workloads[num_workloads].name, "sort-%s",
+                sort_algorithms[i].name);
+        if (strcmp(name, "sort") == 0 ||
+            strcmp(name, workloads[num_workloads].name) == 0) {
+            workloads[num_workloads].apsp = NULL;
+            workloads[num_workloads].sort = sort_algorithms + i;
+            num_workloads++;
+            found = 1;
+        }
+    }
+
+    return found ? num_workloads : -1;
+}
+
+
+/* Builds the model caches of a configuration, in front of p_memory,
+ * printing a description of each.  Exits if a specification is invalid.
+ */
+void build_config(config_t *p_config, const char *progname, int arg_no,
+                  membase_t *p_memory, uint32_t mem_size) {
+    char buffer[1024], *specs[MAX_LEVELS], *spec;
+    membase_t *p_next = p_memory;
+    int level;
+
+    strncpy(buffer, p_config->spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    p_config->num_levels = 0;
+    for (spec = strtok(buffer, ","); spec != NULL; spec = strtok(NULL, ",")) {
+        if (p_config->num_levels == MAX_LEVELS) {
+            printf("ERROR:  argument %d:  a configuration may have at most "
+                   "%d caches.\n", arg_no, MAX_LEVELS);
+            sweep_usage(progname);
+            exit(1);
+        }
+        specs[p_config->num_levels++] = spec;
+    }
+
+    for (level = p_config->num_levels - 1; level >= 0; level--) {
+        p_config->levels[level] = make_cache(progname, specs[level], arg_no,
+                                             p_next, mem_size);
+        p_next = (membase_t *) p_config->levels[level];
+    }
+
+    if (p_config->num_levels == 0 ||
+        p_config->levels[0]->inclusion != INCLUSION_NINE) {
+        printf("ERROR:  argument %d:  the first cache can't be inclusive or "
+               "exclusive.\n", arg_no);
+        sweep_usage(progname);
+        exit(1);
+    }
+    for (level = 1; level < p_config->num_levels; level++) {
+        if (add_upper_cache(p_config->levels[level],
+                            p_config->levels[level - 1]) != 0) {
+            printf("ERROR:  argument %d:  a cache in front of an inclusive "
+                   "or exclusive\n        cache must have the same block "
+                   "size.\n", arg_no);
+            sweep_usage(progname);
+            exit(1);
+        }
+    }
+}
+
+
+/* Records the miss rate of each cache, and the average access time of the
+ * first, as the results of a run.
+ */
+void record_results(cache_t **caches, uint32_t num_levels,
+                    result_t *p_result) {
+    uint64_t lookups;
+    uint32_t level;
+
+    for (level = 0; level < num_levels; level++) {
+        lookups = caches[level]->num_hits + caches[level]->num_misses;
+        p_result->miss_rates[level] = (lookups > 0) ?
+            100.0 * caches[level]->num_misses / lookups : 0.0;
+    }
+
+    lookups = caches[0]->num_hits + caches[0]->num_misses;
+    p_result->amat = (lookups > 0) ?
+        (double) caches[0]->total_latency / lookups : 0.0;
+}
+
+
+/* Runs the shortest-path algorithm of a workload, returning nonzero if it
+ * got the right distances.  The results are recorded before the distances
+ * are read back to check them.
+ */
+int run_apsp(const workload_t *p_work, membase_t *p_mem, int num_nodes,
+             int tile, cache_t **caches, uint32_t num_levels,
+             result_t *p_result) {
+    shortest_path_info info;
+    int *expected, i, ok = 1;
+
+    info.num_nodes = num_nodes;
+    info.p_mem = p_mem;
+    info.verbose = 0;
+
+    srand(SEED);
+    expected = malloc(num_nodes * num_nodes * sizeof(int));
+    generate_graph(&info, CONNECTED_PCT, expected);
+
+    p_mem->reset_stats(p_mem);
+    p_work->apsp->compute(&info, tile);
+    record_results(caches, num_levels, p_result);
+
+    host_shortest_paths(expected, num_nodes);
+    for (i = 0; i < num_nodes * num_nodes; i++) {
+        if (get_weight(&info, i / num_nodes, i % num_nodes) != expected[i])
+            ok = 0;
+    }
+
+    free(expected);
+    return ok;
+}
+
+
+/* This function is used by the C standard-library function qsort(), so that
+ * we can check the output of the sorting algorithms.
+ */
+int compare_int_ptrs(const void *v1, const void *v2) {
+    int i1 = *(int *) v1;
+    int i2 = *(int *) v2;
+
+    return i1 - i2;
+}
+
+
+/* Runs the sorting algorithm of a workload, returning nonzero if it sorted
+ * the array.
+ */
+int run_sort(const workload_t *p_work, membase_t *p_mem, int num_elems,
+             cache_t **caches, uint32_t num_levels, result_t *p_result) {
+    int *inputs, i, ok = 1;
+
+    srand(SEED);
+    inputs = malloc(num_elems * sizeof(int));
+    for (i = 0; i < num_elems; i++) {
+        inputs[i] = rand();
+        write_int(p_mem, i, inputs[i]);
+    }
+
+    p_mem->reset_stats(p_mem);
+    p_work->sort->sort(p_mem, num_elems);
+    record_results(caches, num_levels, p_result);
+
+    qsort(inputs, num_elems, sizeof(int), compare_int_ptrs);
+    for (i = 0; i < num_elems; i++) {
+        if (read_int(p_mem, i) != inputs[i])
+            ok = 0;
+    }
+
+    free(inputs);
+    return ok;
+}
+
+
+/* Prints a row of the table of results, one column per configuration. */
+void print_row(const char *name, result_t *results, config_t *configs,
+               int num_configs, int amat) {
+    char cell[256];
+    uint32_t level;
+    int i, length;
+
+    printf("%-18s", name);
+    for (i = 0; i < num_configs; i++) {
+        if (amat) {
+            sprintf(cell, "%.2f", results[i].amat);
+        }
+        else {
+            length = 0;
+            for (level = 0; level < configs[i].num_levels; level++) {
+                length += sprintf(cell + length, "%s%.2f",
+                                  (level > 0) ? " / " : "",
+                                  results[i].miss_rates[level]);
+            }
+        }
+        printf("  %-24s", cell);
+    }
+    printf("\n");
+}
+
+
+int main(int argc, const char **argv) {
+    workload_t workloads[16];
+    config_t configs[MAX_CONFIGS];
+    result_t *results;
+    int num_workloads = 0, num_configs, num_nodes = DEFAULT_NODES;
+    int num_elems = DEFAULT_ELEMS, tile = DEFAULT_APSP_TILE;
+    char buffer[256], *name;
+    uint32_t mem_size, size, level;
+    memory_t *p_model, *p_memory;
+    cache_t *caches[MAX_LEVELS];
+    membase_t *p_next;
+    int opt, i, w, ok;
+
+    while ((opt = getopt(argc, (char * const *) argv, "w:n:e:b:M:")) != -1) {
+        switch (opt) {
+        case 'w':
+            strncpy(buffer, optarg, sizeof(buffer) - 1);
+            buffer[sizeof(buffer) - 1] = '\0';
+            for (name = strtok(buffer, ","); name != NULL;
+                 name = strtok(NULL, ",")) {
+                num_workloads = add_workloads(workloads, num_workloads, name);
+                if (num_workloads < 0) {
+                    printf("ERROR:  unknown workload \"%s\".\n", name);
+                    sweep_usage(argv[0]);
+                    return 1;
+                }
+            }
+            break;
+
+        case 'n':
+            num_nodes = atoi(optarg);
+            break;
+
+        case 'e':
+            num_elems = atoi(optarg);
+            break;
+
+        case 'b':
+            tile = atoi(optarg);
+            break;
+
+        case 'M':
+            if (parse_memory_timing(optarg) != 0) {
+                sweep_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        default:
+            sweep_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (num_nodes <= 0 || num_elems <= 0 || tile <= 0) {
+        printf("ERROR:  the sizes must be positive.\n");
+        sweep_usage(argv[0]);
+        return 1;
+    }
+    num_configs = argc - optind;
+    if (num_configs == 0 || num_configs > MAX_CONFIGS) {
+        printf("ERROR:  give from 1 to %d configurations.\n", MAX_CONFIGS);
+        sweep_usage(argv[0]);
+        return 1;
+    }
+    if (num_workloads == 0) {
+        num_workloads = add_workloads(workloads, 0, "apsp");
+        num_workloads = add_workloads(workloads, num_workloads, "sort");
+    }
+
+    /* Every run gets a memory big enough for any of the workloads. */
+    mem_size = apsp_mem_size(num_nodes);
+    for (w = 0; w < num_workloads; w++) {
+        if (workloads[w].sort != NULL) {
+            size = workloads[w].sort->mem_size(num_elems);
+            if (size > mem_size)
+                mem_size = size;
+        }
+    }
+
+    printf("Constructing the configurations:\n");
+    p_model = make_memory(mem_size);
+    for (i = 0; i < num_configs; i++) {
+        printf("Configuration %d:  %s\n", i + 1, argv[optind + i]);
+        configs[i].spec = argv[optind + i];
+        build_config(configs + i, argv[0], optind + i, (membase_t *) p_model,
+                     mem_size);
+    }
+    printf("\n");
+
+    /* Run each workload against a fresh copy of each configuration. */
+
+    results = malloc(num_workloads * num_configs * sizeof(result_t));
+    for (w = 0; w < num_workloads; w++) {
+        printf("Running %s:", workloads[w].name);
+        fflush(stdout);
+        for (i = 0; i < num_configs; i++) {
+            p_memory = malloc(sizeof(memory_t));
+            init_memory(p_memory, mem_size);
+            set_memory_timing(p_memory, p_model->latency,
+                              p_model->bytes_per_cycle);
+            p_next = (membase_t *) p_memory;
+            for (level = configs[i].num_levels; level-- > 0; ) {
+                caches[level] = malloc(sizeof(cache_t));
+                init_cache_like(caches[level], configs[i].levels[level],
+                                p_next);
+                if (level + 1 < configs[i].num_levels)
+                    add_upper_cache((cache_t *) p_next, caches[level]);
+                p_next = (membase_t *) caches[level];
+            }
+
+            if (workloads[w].apsp != NULL) {
+                ok = run_apsp(workloads + w, p_next, num_nodes, tile, caches,
+                              configs[i].num_levels,
+                              results + w * num_configs + i);
+            }
+            else {
+                ok = run_sort(workloads + w, p_next, num_elems, caches,
+                              configs[i].num_levels,
+                              results + w * num_configs + i);
+            }
+            if (!ok) {
+                printf("\nERROR:  %s got the wrong results with "
+                       "configuration %d, aborting.\n", workloads[w].name,
+                       i + 1);
+                abort();
+            }
+            printf(" %d", i + 1);
+            fflush(stdout);
+
+            for (level = 0; level < configs[i].num_levels; level++) {
+                caches[level]->free((membase_t *) caches[level]);
+                free(caches[level]);
+            }
+            p_memory->free((membase_t *) p_memory);
+            free(p_memory);
+        }
+        printf("\n");
+    }
+
+    /* Print the tables of results. */
+
+    printf("\nMiss rates (%%), from the first cache down:\n\n");
+    printf("%-18s", "workload");
+    for (i = 0; i < num_configs; i++) {
+        sprintf(buffer, "config %d", i + 1);
+        printf("  %-24s", buffer);
+    }
+    printf("\n");
+    for (w = 0; w < num_workloads; w++) {
+        print_row(workloads[w].name, results + w * num_configs, configs,
+                  num_configs, 0);
+    }
+
+    printf("\nAverage memory access time (cycles):\n\n");
+    printf("%-18s", "workload");
+    for (i = 0; i < num_configs; i++) {
+        sprintf(buffer, "config %d", i + 1);
+        printf("  %-24s", buffer);
+    }
+    printf("\n");
+    for (w = 0; w < num_workloads; w++) {
+        print_row(workloads[w].name, results + w * num_configs, configs,
+                  num_configs, 1);
+    }
+    printf("\n");
+
+    return 0;
+}
@@ -5,24 +5,32 @@
 #include "membase.h"
 #include "memory.h"
 #include "cache.h"
+#include "prefetch.h"
 
 
 #define TESTMEM_SIZE 65536
 #define NUM_WRITES 50000
+#define MAX_BLOCK_WRITE 200
 
 
 #define DEBUG_TESTMEM 0
 
 
+int run_mixed_test(cache_t **p_levels, int num_levels, memory_t *p_memory,
+                   unsigned char *p_raw, unsigned char *p_contents);
+
+
 int main() {
-    cache_t cache;
+    cache_t cache, lower, bottom;
+    cache_t *p_levels[3];
     memory_t memory;
-    unsigned char *p_raw;
+    unsigned char *p_raw, *p_contents;
 
     int i, count;
 
     p_raw = malloc(TESTMEM_SIZE);
     bzero(p_raw, TESTMEM_SIZE);
+    p_contents = malloc(TESTMEM_SIZE);
 
     init_memory(&memory, TESTMEM_SIZE);
     init_cache(&cache, /* block_size */ 64, /* num_sets */ 16,
@@ -43,22 +51,226 @@ int main() {
     }
 
     flush_cache(&cache);
+    copy_from_memory(&memory, 0, p_contents, TESTMEM_SIZE);
 
     count = 0;
     for (i = 0; i < TESTMEM_SIZE; i++) {
-        if (p_raw[i] != memory.mem[i]) {
+        if (p_raw[i] != p_contents[i]) {
             count++;
             printf("Values at index %d don't match:  raw[i] = %u, mem[i] = %u\n",
-                i, p_raw[i], memory.mem[i]);
+                i, p_raw[i], p_contents[i]);
+        }
+    }
+
+    if (count == 0)
+        printf("Memories are identical.\n");
+
+    /* Now do the same with word and block writes, some of which straddle
+     * cache lines, and check that reads through the cache see them too.
+     * A prefetcher is turned on, so prefetches also evict dirty lines.
+     */
+    printf("Running word and block test.\n");
+    set_prefetcher(&cache, find_prefetcher("stream"), 4, TESTMEM_SIZE);
+
+    for (i = 0; i < NUM_WRITES; i++) {
+        unsigned char block[MAX_BLOCK_WRITE];
+        uint32_t size, j;
+        addr_t addr;
+
+        if (i % 2 == 0) {
+            uint32_t value = rand();
+
+            addr = rand() % (TESTMEM_SIZE - 3);
+            p_raw[addr] = value & 0xFF;
+            p_raw[addr + 1] = (value >> 8) & 0xFF;
+            p_raw[addr + 2] = (value >> 16) & 0xFF;
+            p_raw[addr + 3] = (value >> 24) & 0xFF;
+            write_word((membase_t *) &cache, addr, value);
+        }
+        else {
+            size = 1 + rand() % MAX_BLOCK_WRITE;
+            addr = rand() % (TESTMEM_SIZE - size + 1);
+            for (j = 0; j < size; j++)
+                p_raw[addr + j] = block[j] = rand() % 256;
+            write_block((membase_t *) &cache, addr, block, size);
         }
     }
 
+    count = 0;
+    for (i = 0; i < TESTMEM_SIZE - 3; i += 1 + rand() % 8) {
+        uint32_t expected = p_raw[i] | p_raw[i + 1] << 8 | p_raw[i + 2] << 16 |
+                            (uint32_t) p_raw[i + 3] << 24;
+        if (read_word((membase_t *) &cache, i) != expected)
+            count++;
+    }
+
+    flush_cache(&cache);
+    copy_from_memory(&memory, 0, p_contents, TESTMEM_SIZE);
+
+    for (i = 0; i < TESTMEM_SIZE; i++) {
+        if (p_raw[i] != p_contents[i])
+            count++;
+    }
+
+    if (count == 0)
+        printf("Memories are identical.\n");
+    else
+        printf("%d mismatches in word and block test.\n", count);
+
+    cache.free((membase_t *) &cache);
+    memory.free((membase_t *) &memory);
+
+    /* Finally, a write-through, no-write-allocate cache in front of an
+     * exclusive cache with a write-combining buffer, so that reads that miss
+     * in both must see the writes still held in the buffer.
+     */
+    printf("Running exclusive write-combining test.\n");
+    bzero(p_raw, TESTMEM_SIZE);
+    init_memory(&memory, TESTMEM_SIZE);
+    init_cache(&lower, 32, 64, 4, (membase_t *) &memory);
+    set_write_policy(&lower, 0, 1, 2);
+    set_inclusion_policy(&lower, INCLUSION_EXCLUSIVE);
+    init_cache(&cache, 32, 16, 2, (membase_t *) &lower);
+    set_write_policy(&cache, 1, 0, 0);
+    add_upper_cache(&lower, &cache);
+
+    p_levels[0] = &cache;
+    p_levels[1] = &lower;
+    count = run_mixed_test(p_levels, 2, &memory, p_raw, p_contents);
+
+    if (count == 0)
+        printf("Memories are identical.\n");
+    else
+        printf("%d mismatches in exclusive write-combining test.\n", count);
+
+    cache.free((membase_t *) &cache);
+    lower.free((membase_t *) &lower);
+    memory.free((membase_t *) &memory);
+
+    /* Two exclusive levels stacked under a write-back cache, so that dirty
+     * blocks move up through the middle level without being allocated
+     * there, and must stay dirty on the way.
+     */
+    printf("Running stacked exclusive test.\n");
+    bzero(p_raw, TESTMEM_SIZE);
+    init_memory(&memory, TESTMEM_SIZE);
+    init_cache(&bottom, 32, 64, 8, (membase_t *) &memory);
+    set_inclusion_policy(&bottom, INCLUSION_EXCLUSIVE);
+    init_cache(&lower, 32, 32, 4, (membase_t *) &bottom);
+    set_inclusion_policy(&lower, INCLUSION_EXCLUSIVE);
+    add_upper_cache(&bottom, &lower);
+    init_cache(&cache, 32, 8, 2, (membase_t *) &lower);
+    add_upper_cache(&lower, &cache);
+
+    p_levels[0] = &cache;
+    p_levels[1] = &lower;
+    p_levels[2] = &bottom;
+    count = run_mixed_test(p_levels, 3, &memory, p_raw, p_contents);
+
+    if (count == 0)
+        printf("Memories are identical.\n");
+    else
+        printf("%d mismatches in stacked exclusive test.\n", count);
+
+    cache.free((membase_t *) &cache);
+    lower.free((membase_t *) &lower);
+    bottom.free((membase_t *) &bottom);
+    memory.free((membase_t *) &memory);
+
+    /* A direct-mapped cache with a victim cache, so that dirty lines are
+     * replaced into the victim cache, and swapped back on a hit there.
+     */
+    printf("Running victim cache test.\n");
+    bzero(p_raw, TESTMEM_SIZE);
+    init_memory(&memory, TESTMEM_SIZE);
+    init_cache(&cache, 32, 64, 1, (membase_t *) &memory);
+    set_victim_cache(&cache, 8);
+
+    p_levels[0] = &cache;
+    count = run_mixed_test(p_levels, 1, &memory, p_raw, p_contents);
+
+    if (count == 0)
+        printf("Memories are identical.\n");
+    else
+        printf("%d mismatches in victim cache test.\n", count);
+
+    cache.free((membase_t *) &cache);
+    memory.free((membase_t *) &memory);
+
+    /* An inclusive cache smaller than the write-back cache in front of it,
+     * so that it often back-invalidates dirty lines above it, whose data
+     * must still reach the memory.
+     */
+    printf("Running inclusive back-invalidation test.\n");
+    bzero(p_raw, TESTMEM_SIZE);
+    init_memory(&memory, TESTMEM_SIZE);
+    init_cache(&lower, 32, 16, 2, (membase_t *) &memory);
+    set_inclusion_policy(&lower, INCLUSION_INCLUSIVE);
+    init_cache(&cache, 32, 16, 4, (membase_t *) &lower);
+    add_upper_cache(&lower, &cache);
+
+    p_levels[0] = &cache;
+    p_levels[1] = &lower;
+    count = run_mixed_test(p_levels, 2, &memory, p_raw, p_contents);
+
+    if (lower.num_back_invalidations == 0) {
+        printf("No back-invalidations in inclusive test.\n");
+        count++;
+    }
+
     if (count == 0)
         printf("Memories are identical.\n");
+    else
+        printf("%d mismatches in inclusive back-invalidation test.\n", count);
 
     cache.free((membase_t *) &cache);
+    lower.free((membase_t *) &lower);
     memory.free((membase_t *) &memory);
 
     return 0;
 }
 
+
+/* Runs random word writes and reads through a hierarchy of caches, the one
+ * accessed first in p_levels[0], keeping p_raw up to date with the writes.
+ * Then the caches are flushed from the top down, and the memory is compared
+ * with p_raw, using p_contents as scratch space.  Returns the number of
+ * reads that returned the wrong value plus the number of bytes of memory
+ * that don't match.
+ */
+int run_mixed_test(cache_t **p_levels, int num_levels, memory_t *p_memory,
+                   unsigned char *p_raw, unsigned char *p_contents) {
+    int i, count = 0;
+
+    for (i = 0; i < NUM_WRITES; i++) {
+        addr_t addr = rand() % (TESTMEM_SIZE - 3);
+        uint32_t value = rand();
+
+        if (i % 2 == 0) {
+            p_raw[addr] = value & 0xFF;
+            p_raw[addr + 1] = (value >> 8) & 0xFF;
+            p_raw[addr + 2] = (value >> 16) & 0xFF;
+            p_raw[addr + 3] = (value >> 24) & 0xFF;
+            write_word((membase_t *) p_levels[0], addr, value);
+        }
+        else {
+            uint32_t expected = p_raw[addr] | p_raw[addr + 1] << 8 |
+                                p_raw[addr + 2] << 16 |
+                                (uint32_t) p_raw[addr + 3] << 24;
+            if (read_word((membase_t *) p_levels[0], addr) != expected)
+                count++;
+        }
+    }
+
+    for (i = 0; i < num_levels; i++)
+        flush_cache(p_levels[i]);
+    copy_from_memory(p_memory, 0, p_contents, TESTMEM_SIZE);
+
+    for (i = 0; i < TESTMEM_SIZE; i++) {
+        if (p_raw[i] != p_contents[i])
+            count++;
+    }
+
+    return count;
+}
+
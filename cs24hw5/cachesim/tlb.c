@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "tlb.h"
+
+
+/* Set this to a nonzero value and rebuild to see debug output. */
+#define DEBUG_TLB 0
+
+
+/* Local functions used by the TLB implementation. */
+
+unsigned char tlb_read_byte(membase_t *mb, addr_t address);
+void tlb_write_byte(membase_t *mb, addr_t address, unsigned char value);
+uint32_t tlb_read_word(membase_t *mb, addr_t address);
+void tlb_write_word(membase_t *mb, addr_t address, uint32_t value);
+void tlb_read_block(membase_t *mb, addr_t address, unsigned char *dest,
+                    uint32_t size);
+void tlb_write_block(membase_t *mb, addr_t address, const unsigned char *src,
+                     uint32_t size);
+void tlb_print_stats(membase_t *mb);
+void tlb_reset_stats(membase_t *mb);
+void tlb_free(membase_t *mb);
+
+void translate(tlb_t *p_tlb, addr_t address);
+int lookup_tlb_level(tlblevel_t *p_level, addr_t page);
+void fill_tlb_level(tlblevel_t *p_level, addr_t page);
+void walk_page_table(tlb_t *p_tlb, addr_t address);
+
+
+/* Rounds a number of bytes up to whole 4KB pages. */
+static uint32_t round_to_page(uint32_t bytes) {
+    return (bytes + (1 << PAGE_BITS_4K) - 1) & ~((1 << PAGE_BITS_4K) - 1);
+}
+
+
+/* Returns the bytes of page directories and tables needed to map mem_size
+ * bytes with pages of 2^page_bits bytes, rounded up to whole pages.  There
+ * is a directory entry per 2MB of memory, and with 4KB pages a table entry
+ * per page.
+ */
+uint32_t page_table_size(uint32_t mem_size, uint32_t page_bits) {
+    uint32_t size;
+
+    size = round_to_page((((mem_size - 1) >> PAGE_BITS_2M) + 1) * PTE_SIZE);
+    if (page_bits == PAGE_BITS_4K) {
+        size += round_to_page((((mem_size - 1) >> PAGE_BITS_4K) + 1) *
+                              PTE_SIZE);
+    }
+    return size;
+}
+
+
+/* Initializes a TLB in front of next_mem, translating the first mem_size
+ * bytes of the address space, with its page directories and tables at
+ * table_base.
+ */
+void init_tlb(tlb_t *p_tlb, uint32_t page_bits, addr_t table_base,
+              uint32_t mem_size, membase_t *next_mem) {
+    assert(page_bits == PAGE_BITS_4K || page_bits == PAGE_BITS_2M);
+    assert(next_mem != NULL);
+
+    bzero(p_tlb, sizeof(tlb_t));
+
+    p_tlb->read_byte = tlb_read_byte;
+    p_tlb->write_byte = tlb_write_byte;
+    p_tlb->read_word = tlb_read_word;
+    p_tlb->write_word = tlb_write_word;
+    p_tlb->read_block = tlb_read_block;
+    p_tlb->write_block = tlb_write_block;
+    p_tlb->print_stats = tlb_print_stats;
+    p_tlb->reset_stats = tlb_reset_stats;
+    p_tlb->free = tlb_free;
+
+    p_tlb->next_memory = next_mem;
+    p_tlb->page_bits = page_bits;
+
+    /* The page tables follow the page directories. */
+    p_tlb->table_base = table_base;
+    p_tlb->pt_base = table_base +
+        round_to_page((((mem_size - 1) >> PAGE_BITS_2M) + 1) * PTE_SIZE);
+}
+
+
+/* Adds a level of TLB behind the existing ones, with "entries" entries in
+ * sets of "ways".  Returns 0 on success, or -1 if there are already
+ * MAX_TLB_LEVELS levels, or entries / ways isn't a power of 2.
+ */
+int add_tlb_level(tlb_t *p_tlb, uint32_t entries, uint32_t ways,
+                  uint32_t hit_latency) {
+    tlblevel_t *p_level;
+
+    if (p_tlb->num_levels == MAX_TLB_LEVELS || ways == 0 ||
+        entries % ways != 0 || entries == 0 || !is_power_of_2(entries / ways))
+        return -1;
+
+    p_level = p_tlb->levels + p_tlb->num_levels++;
+    p_level->num_sets = entries / ways;
+    p_level->ways = ways;
+    p_level->hit_latency = hit_latency;
+    p_level->entries = calloc(entries, sizeof(tlbentry_t));
+    p_level->num_hits = 0;
+    p_level->num_misses = 0;
+    return 0;
+}
+
+
+/* This function translates the virtual address of an access, advancing
+ * the TLB's time by what the translation takes.  Each level of TLB is
+ * looked up in turn, and a hit fills the levels before it; if they all
+ * miss, the page table is walked and every level is filled.
+ */
+void translate(tlb_t *p_tlb, addr_t address) {
+    addr_t page = address >> p_tlb->page_bits;
+    uint64_t start = p_tlb->time;
+    uint32_t level, i;
+
+    for (level = 0; level < p_tlb->num_levels; level++) {
+        p_tlb->time += p_tlb->levels[level].hit_latency;
+        if (lookup_tlb_level(p_tlb->levels + level, page))
+            break;
+    }
+
+    if (level == p_tlb->num_levels)
+        walk_page_table(p_tlb, address);
+
+    for (i = 0; i < level; i++)
+        fill_tlb_level(p_tlb->levels + i, page);
+
+    p_tlb->walk_cycles += p_tlb->time - start;
+}
+
+
+/* Looks up a page in one level of TLB, returning nonzero on a hit. */
+int lookup_tlb_level(tlblevel_t *p_level, addr_t page) {
+    tlbentry_t *p_set = p_level->entries +
+        (page & (p_level->num_sets - 1)) * p_level->ways;
+    uint32_t i;
+
+    for (i = 0; i < p_level->ways; i++) {
+        if (p_set[i].valid && p_set[i].page == page) {
+            p_set[i].last_time = clock_tick();
+            p_level->num_hits++;
+            return 1;
+        }
+    }
+
+    p_level->num_misses++;
+    return 0;
+}
+
+
+/* Puts a page's translation into one level of TLB, replacing the least
+ * recently used entry of its set.
+ */
+void fill_tlb_level(tlblevel_t *p_level, addr_t page) {
+    tlbentry_t *p_set = p_level->entries +
+        (page & (p_level->num_sets - 1)) * p_level->ways;
+    tlbentry_t *victim = p_set;
+    uint32_t i;
+
+    for (i = 0; i < p_level->ways; i++) {
+        if (!p_set[i].valid) {
+            victim = p_set + i;
+            break;
+        }
+        if (p_set[i].last_time < victim->last_time)
+            victim = p_set + i;
+    }
+
+    victim->valid = 1;
+    victim->page = page;
+    victim->last_time = clock_tick();
+}
+
+
+/* Walks the page table for an address, reading the page-directory entry
+ * and, for 4KB pages, the page-table entry through the next level of the
+ * memory.  Each read depends on the one before, so they are done in turn.
+ */
+void walk_page_table(tlb_t *p_tlb, addr_t address) {
+    membase_t *next_mem = p_tlb->next_memory;
+    unsigned char entry[PTE_SIZE];
+    addr_t pte_addrs[2];
+    uint32_t num_reads = 0, i;
+
+    pte_addrs[num_reads++] = p_tlb->table_base +
+                             (address >> PAGE_BITS_2M) * PTE_SIZE;
+    if (p_tlb->page_bits == PAGE_BITS_4K) {
+        pte_addrs[num_reads++] = p_tlb->pt_base +
+                                 (address >> PAGE_BITS_4K) * PTE_SIZE;
+    }
+
+#if DEBUG_TLB
+    printf("TLB miss on address %u; walking the page table\n", address);
+#endif
+
+    for (i = 0; i < num_reads; i++) {
+        next_mem->time = p_tlb->time;
+        read_block(next_mem, pte_addrs[i], entry, PTE_SIZE);
+        p_tlb->time = next_mem->time;
+    }
+
+    p_tlb->num_walks++;
+    p_tlb->num_walk_reads += num_reads;
+}
+
+
+/* The functions below translate the address of each access, and then pass
+ * the access on to the next level of the memory at the same address.
+ * Accesses that cross pages are split, so that each page is translated.
+ * Writes are passed on without posting them, so that the access time counts
+ * until they complete, as a cache's does; the functions in membase.c post
+ * the write to the TLB itself, which takes it once it is translated and the
+ * next level has taken it.
+ */
+
+
+unsigned char tlb_read_byte(membase_t *mb, addr_t address) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    membase_t *next_mem = p_tlb->next_memory;
+    uint64_t start = p_tlb->time;
+    unsigned char value;
+
+    p_tlb->num_reads++;
+    translate(p_tlb, address);
+
+    next_mem->time = p_tlb->time;
+    value = read_byte(next_mem, address);
+    p_tlb->time = next_mem->time;
+    p_tlb->total_latency += p_tlb->time - start;
+    return value;
+}
+
+
+void tlb_write_byte(membase_t *mb, addr_t address, unsigned char value) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    membase_t *next_mem = p_tlb->next_memory;
+    uint64_t start = p_tlb->time;
+
+    p_tlb->num_writes++;
+    translate(p_tlb, address);
+
+    next_mem->time = p_tlb->time;
+    next_mem->accept_time = p_tlb->time;
+    next_mem->write_byte(next_mem, address, value);
+    p_tlb->time = next_mem->time;
+    if (next_mem->accept_time > p_tlb->accept_time)
+        p_tlb->accept_time = next_mem->accept_time;
+    p_tlb->total_latency += p_tlb->time - start;
+}
+
+
+uint32_t tlb_read_word(membase_t *mb, addr_t address) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    membase_t *next_mem = p_tlb->next_memory;
+    uint64_t start = p_tlb->time;
+    unsigned char bytes[4];
+    uint32_t value;
+
+    if ((address >> p_tlb->page_bits) != ((address + 3) >> p_tlb->page_bits)) {
+        tlb_read_block(mb, address, bytes, 4);
+        return get_le_word(bytes);
+    }
+
+    p_tlb->num_reads++;
+    translate(p_tlb, address);
+
+    next_mem->time = p_tlb->time;
+    value = read_word(next_mem, address);
+    p_tlb->time = next_mem->time;
+    p_tlb->total_latency += p_tlb->time - start;
+    return value;
+}
+
+
+void tlb_write_word(membase_t *mb, addr_t address, uint32_t value) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    membase_t *next_mem = p_tlb->next_memory;
+    uint64_t start = p_tlb->time;
+    unsigned char bytes[4];
+
+    if ((address >> p_tlb->page_bits) != ((address + 3) >> p_tlb->page_bits)) {
+        put_le_word(bytes, value);
+        tlb_write_block(mb, address, bytes, 4);
+        return;
+    }
+
+    p_tlb->num_writes++;
+    translate(p_tlb, address);
+
+    next_mem->time = p_tlb->time;
+    next_mem->accept_time = p_tlb->time;
+    next_mem->write_word(next_mem, address, value);
+    p_tlb->time = next_mem->time;
+    if (next_mem->accept_time > p_tlb->accept_time)
+        p_tlb->accept_time = next_mem->accept_time;
+    p_tlb->total_latency += p_tlb->time - start;
+}
+
+
+void tlb_read_block(membase_t *mb, addr_t address, unsigned char *dest,
+                    uint32_t size) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    membase_t *next_mem = p_tlb->next_memory;
+    addr_t page_size = (addr_t) 1 << p_tlb->page_bits;
+    uint32_t chunk;
+    uint64_t start;
+
+    while (size > 0) {
+        chunk = page_size - (address & (page_size - 1));
+        if (chunk > size)
+            chunk = size;
+
+        start = p_tlb->time;
+        p_tlb->num_reads++;
+        translate(p_tlb, address);
+
+        next_mem->time = p_tlb->time;
+        read_block(next_mem, address, dest, chunk);
+        p_tlb->time = next_mem->time;
+        p_tlb->total_latency += p_tlb->time - start;
+
+        address += chunk;
+        dest += chunk;
+        size -= chunk;
+    }
+}
+
+
+void tlb_write_block(membase_t *mb, addr_t address, const unsigned char *src,
+                     uint32_t size) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    membase_t *next_mem = p_tlb->next_memory;
+    addr_t page_size = (addr_t) 1 << p_tlb->page_bits;
+    uint32_t chunk;
+    uint64_t start;
+
+    while (size > 0) {
+        chunk = page_size - (address & (page_size - 1));
+        if (chunk > size)
+            chunk = size;
+
+        start = p_tlb->time;
+        p_tlb->num_writes++;
+        translate(p_tlb, address);
+
+        next_mem->time = p_tlb->time;
+        next_mem->accept_time = p_tlb->time;
+        next_mem->write_block(next_mem, address, src, chunk);
+        p_tlb->time = next_mem->time;
+        if (next_mem->accept_time > p_tlb->accept_time)
+            p_tlb->accept_time = next_mem->accept_time;
+        p_tlb->total_latency += p_tlb->time - start;
+
+        address += chunk;
+        src += chunk;
+        size -= chunk;
+    }
+}
+
+
+/* This function prints the statistics for the TLB itself, and then calls
+ * the next level of the memory to print its statistics.
+ */
+void tlb_print_stats(membase_t *mb) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    uint64_t accesses = p_tlb->num_reads + p_tlb->num_writes;
+    tlblevel_t *p_level;
+    uint64_t lookups;
+    uint32_t level;
+
+    printf(" * TLB reads=%lld writes=%lld, %s pages\n", p_tlb->num_reads,
+           p_tlb->num_writes,
+           (p_tlb->page_bits == PAGE_BITS_4K) ? "4KB" : "2MB");
+
+    for (level = 0; level < p_tlb->num_levels; level++) {
+        p_level = p_tlb->levels + level;
+        lookups = p_level->num_hits + p_level->num_misses;
+        printf("   L%u TLB, %u entries, %u-way, hit-latency=%u cycles:  "
+               "hits=%lld misses=%lld miss-rate=%.2f%%\n", level + 1,
+               p_level->num_sets * p_level->ways, p_level->ways,
+               p_level->hit_latency, p_level->num_hits, p_level->num_misses,
+               (lookups > 0) ? 100.0 * p_level->num_misses / lookups : 0.0);
+    }
+
+    printf("   page-walks=%lld (%.2f%% of accesses), page-table-reads=%lld\n",
+           p_tlb->num_walks,
+           (accesses > 0) ? 100.0 * p_tlb->num_walks / accesses : 0.0,
+           p_tlb->num_walk_reads);
+    printf("   average-translation-time=%.2f cycles, "
+           "average-access-time=%.2f cycles\n",
+           (accesses > 0) ? (double) p_tlb->walk_cycles / accesses : 0.0,
+           (accesses > 0) ? (double) p_tlb->total_latency / accesses : 0.0);
+
+    p_tlb->next_memory->print_stats(p_tlb->next_memory);
+}
+
+
+/* This function resets the statistics of the TLB and of the levels of the
+ * memory below it.
+ */
+void tlb_reset_stats(membase_t *mb) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    uint32_t level;
+
+    p_tlb->num_reads = 0;
+    p_tlb->num_writes = 0;
+    for (level = 0; level < p_tlb->num_levels; level++) {
+        p_tlb->levels[level].num_hits = 0;
+        p_tlb->levels[level].num_misses = 0;
+    }
+    p_tlb->num_walks = 0;
+    p_tlb->num_walk_reads = 0;
+    p_tlb->walk_cycles = 0;
+    p_tlb->total_latency = 0;
+
+    p_tlb->next_memory->reset_stats(p_tlb->next_memory);
+}
+
+
+/* This function releases the levels of the TLB. */
+void tlb_free(membase_t *mb) {
+    tlb_t *p_tlb = (tlb_t *) mb;
+    uint32_t level;
+
+    for (level = 0; level < p_tlb->num_levels; level++)
+        free(p_tlb->levels[level].entries);
+}
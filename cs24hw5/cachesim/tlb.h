@@ -0,0 +1,166 @@
+#ifndef TLB_H
+#define TLB_H
+
+
+#include "membase.h"
+
+
+/* A translation lookaside buffer in front of the first cache.  The
+ * simulated programs use their addresses as virtual addresses, which are
+ * mapped to the same physical addresses, so the TLB only adds the cost of
+ * translation:  it caches page-table entries in one or more levels of
+ * set-associative TLB, and on a miss in all of them it walks the page
+ * table, reading its entries through the caches below like any other data.
+ *
+ * The page table is laid out as IA32's with PAE:  the four page-directory-
+ * pointer entries are held in registers, so a walk reads an 8-byte entry of
+ * a page directory and, for 4KB pages, then one of a page table.  With 2MB
+ * pages, the page directory maps the pages itself.  The page directories
+ * and tables of the whole address space are kept one after the other at
+ * table_base, past the memory the program uses.
+ */
+
+
+/* The most levels of TLB in front of the page-table walker. */
+#define MAX_TLB_LEVELS 4
+
+/* The page sizes supported, as log_2 of the size. */
+#define PAGE_BITS_4K 12
+#define PAGE_BITS_2M 21
+
+/* Page-directory and page-table entries are 8 bytes, as with PAE. */
+#define PTE_SIZE 8
+
+/* The cycles a hit in each level of TLB adds to an access, unless "lat=N"
+ * is given.  The first level is looked up alongside the first cache.
+ */
+#define DEFAULT_L1_TLB_LATENCY 0
+#define DEFAULT_TLB_LATENCY 7
+
+
+/* An entry of a TLB, holding the translation of one virtual page. */
+typedef struct tlbentry_t {
+    char valid;
+
+    /* The virtual page number. */
+    addr_t page;
+
+    /* When the entry was last used, for LRU replacement. */
+    uint64_t last_time;
+} tlbentry_t;
+
+
+/* One level of TLB:  num_sets sets of "ways" entries each. */
+typedef struct tlblevel_t {
+    uint32_t num_sets;
+    uint32_t ways;
+    uint32_t hit_latency;
+
+    /* The entries of all the sets, set after set. */
+    tlbentry_t *entries;
+
+    uint64_t num_hits;
+    uint64_t num_misses;
+} tlblevel_t;
+
+
+/* This struct holds the state of a TLB.  It starts with the same members
+ * as membase_t, so that it can be used wherever a membase_t can.
+ */
+typedef struct tlb_t {
+    /* The number of reads that occurred at this level of the memory. */
+    uint64_t num_reads;
+
+    /* The number of writes that occurred at this level of the memory. */
+    uint64_t num_writes;
+
+    /* The simulated time, in cycles.  An access to this level starts at
+     * this time, and the level advances it to the time the access completes
+     * (see the timing model in membase.c).
+     */
+    uint64_t time;
+
+    /* When this level took the last posted write, which may be after the
+     * write was issued if the level had to wait for room to track it.
+     */
+    uint64_t accept_time;
+
+    /* The function to read a byte from the memory. */
+    unsigned char (*read_byte)(membase_t *mb, addr_t address);
+
+    /* The function to write a byte to the memory. */
+    void (*write_byte)(membase_t *mb, addr_t address, unsigned char value);
+
+    /* The function to read a 4-byte word from the memory. */
+    uint32_t (*read_word)(membase_t *mb, addr_t address);
+
+    /* The function to write a 4-byte word to the memory. */
+    void (*write_word)(membase_t *mb, addr_t address, uint32_t value);
+
+    /* The function to read a range of bytes from the memory. */
+    void (*read_block)(membase_t *mb, addr_t address, unsigned char *dest,
+                       uint32_t size);
+
+    /* The function to write a range of bytes to the memory. */
+    void (*write_block)(membase_t *mb, addr_t address,
+                        const unsigned char *src, uint32_t size);
+
+    /* The function to print the memory's access statistics. */
+    void (*print_stats)(struct membase_t *mb);
+
+    /* The function to reset the memory's access statistics. */
+    void (*reset_stats)(struct membase_t *mb);
+
+    /* The function to release any internally allocated data used by
+     * the memory.
+     */
+    void (*free)(membase_t *mb);
+
+    /* The first cache, or the memory, which the TLB passes accesses and
+     * page-table reads on to.
+     */
+    membase_t *next_memory;
+
+    /* log_2 of the page size. */
+    uint32_t page_bits;
+
+    /* The levels of TLB, from the one looked up first. */
+    uint32_t num_levels;
+    tlblevel_t levels[MAX_TLB_LEVELS];
+
+    /* Where the page directories start, and the page tables after them. */
+    addr_t table_base;
+    addr_t pt_base;
+
+    /* The number of page walks, and the page-table entries they read. */
+    uint64_t num_walks;
+    uint64_t num_walk_reads;
+
+    /* The cycles spent on translation, and on whole accesses. */
+    uint64_t walk_cycles;
+    uint64_t total_latency;
+} tlb_t;
+
+
+/* Returns the bytes of page directories and tables needed to map mem_size
+ * bytes with pages of 2^page_bits bytes, rounded up to whole pages.
+ */
+uint32_t page_table_size(uint32_t mem_size, uint32_t page_bits);
+
+/* Initializes a TLB in front of next_mem, translating the first mem_size
+ * bytes of the address space, with its page directories and tables at
+ * table_base.  The TLB has no levels until add_tlb_level() is called, and
+ * walks the page table on every access.
+ */
+void init_tlb(tlb_t *p_tlb, uint32_t page_bits, addr_t table_base,
+              uint32_t mem_size, membase_t *next_mem);
+
+/* Adds a level of TLB behind the existing ones, with "entries" entries in
+ * sets of "ways".  Returns 0 on success, or -1 if there are already
+ * MAX_TLB_LEVELS levels, or entries / ways isn't a power of 2.
+ */
+int add_tlb_level(tlb_t *p_tlb, uint32_t entries, uint32_t ways,
+                  uint32_t hit_latency);
+
+
+#endif /* TLB_H */
@@ -0,0 +1,715 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cmdline.h"
+#include "memtrace.h"
+#include "lookahead.h"
+#include "pagemap.h"
+#include "replace.h"
+#include "memory.h"
+#include "cache.h"
+#include "profile.h"
+
+
+/* Runs a binary memory-access trace (see memtrace.h) through a simulated
+ * memory hierarchy, instead of accesses made by a test program itself.  The
+ * trace is streamed, so it can be arbitrarily long, and can be piped in from
+ * another program, e.g.:
+ *
+ *     valgrind --tool=lackey --trace-mem=yes prog 2>&1 | ./mktrace - - | \
+ *         ./tracesim 64:64:8 64:1024:8
+ *
+ * With -j, the cache sets are divided into shards that are simulated on
+ * worker threads, each with its own copy of the hierarchy.  Every block
+ * maps to the same shard at every level, so the shards never interact, and
+ * each sees its accesses in trace order; their statistics add up to those
+ * of a serial simulation.
+ */
+
+
+/* The default size of the simulated memory.  It must be a power of 2.  The
+ * memory is only allocated as it is written, so it costs little to make it
+ * as large as possible, which lets the trace touch the most frames.
+ */
+#define DEFAULT_MEM_SIZE (1U << 31)
+
+/* Trace addresses are mapped into the simulated memory in frames of at least
+ * 2^MIN_FRAME_BITS bytes.
+ */
+#define MIN_FRAME_BITS 12
+
+/* The default number of accesses read ahead for Belady's policy. */
+#define DEFAULT_WINDOW (1024 * 1024)
+
+/* Accesses up to this size are simulated as one block operation. */
+#define MAX_BLOCK_ACCESS 256
+
+/* The most worker threads that can be used with -j. */
+#define MAX_THREADS 64
+
+/* Accesses are handed to a shard's thread in batches of this many, and up
+ * to this many batches can be waiting for it.
+ */
+#define SHARD_BATCH_SIZE 4096
+#define SHARD_QUEUE_DEPTH 8
+
+
+/* The state of one shard of a parallel simulation. */
+typedef struct shard_t {
+    /* The shard's copy of the memory hierarchy. */
+    membase_t *p_mem;
+
+    /* The mask keeping addresses within the simulated memory. */
+    addr_t mask;
+
+    pthread_t thread;
+
+    /* The queue of batches of accesses for the thread.  Batches from tail
+     * up to head are waiting to be simulated; batch head is being filled,
+     * and holds "filled" accesses so far.  Batch i is at slot
+     * i % SHARD_QUEUE_DEPTH.  done is set once no more will be queued.
+     */
+    memaccess_t *batches;
+    uint32_t counts[SHARD_QUEUE_DEPTH];
+    uint64_t head;
+    uint64_t tail;
+    uint32_t filled;
+    int done;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} shard_t;
+
+
+/* A parallel simulation.  Addresses are divided into regions of
+ * 2^shard_bits bytes, at least a block of every cache, and the low bits of
+ * the region number pick the shard.  These bits are within the set index
+ * of every cache, so all the blocks in a set go to the same shard.
+ */
+typedef struct shardset_t {
+    uint32_t num_shards;
+    uint32_t shard_bits;
+    addr_t key_mask;
+    uint32_t num_levels;
+    shard_t *shards;
+} shardset_t;
+
+
+void tracesim_usage(const char *progname) {
+    printf("usage: %s [-t trace-file] [-m mem-size] [-n max-accesses] "
+           "[-l window]\n\t[-j threads] [-s stats-file] "
+           "[-M latency[:bandwidth]] [-T tlb-spec ...]\n\t[-P page-size] "
+           "[cache-spec ...]\n\n", progname);
+    printf("\t-t trace-file   binary trace to simulate, or - for standard "
+           "input (default -)\n");
+    printf("\t-m mem-size     size of the simulated memory; must be a power "
+           "of 2\n\t                (default %u)\n", DEFAULT_MEM_SIZE);
+    printf("\t-n max-accesses stop after this many accesses\n");
+    printf("\t-l window       accesses to look ahead for the opt replacement "
+           "policy\n\t                (default %d)\n", DEFAULT_WINDOW);
+    printf("\t-j threads      simulate shards of the cache sets on this many "
+           "threads, up to %d\n", MAX_THREADS);
+    printf("\t-s stats-file   also write the statistics to this file, as "
+           "JSON or CSV\n");
+    printf("\t-M latency[:bandwidth]\n\t                the memory's latency "
+           "in cycles, and bytes per cycle\n");
+    printf("\n");
+    printf("\tTrace addresses are mapped into the simulated memory a frame at "
+           "a time, as\n\teach frame is first touched.  Frames are at least "
+           "%dKB, and as large as\n\tthe span of every cache's sets, so the "
+           "cache set and block offset of each\n\taccess are preserved, and "
+           "distinct addresses stay distinct.  The memory\n\tmust hold every "
+           "frame the trace touches.\n", (1 << MIN_FRAME_BITS) / 1024);
+    printf("\tThe caches only keep tags, and the memory is only allocated as "
+           "it is written,\n\tso large caches and memories take little of "
+           "the host's memory.\n");
+    printf("\tWith -j, the caches can't have prefetchers, write-combining "
+           "buffers, victim\n\tcaches, the opt policy or 3C classification, "
+           "which all look\n\tbeyond one set.  The random and brrip "
+           "policies still work, but draw from\n\tone random sequence in "
+           "whatever order the threads run.  Each shard also\n\tkeeps its "
+           "own clock, so the cycles add up the shards' and don't count\n\t"
+           "contention between them.\n");
+    printf("\tCache specifications are described below.\n\n");
+    usage(progname);
+}
+
+
+/* Performs one trace access against the simulated memory, as a single word
+ * or block operation where possible.  Written data is always zero, since
+ * traces don't record values.
+ */
+void simulate_access(membase_t *p_mem, memaccess_t *access, addr_t mask) {
+    static __thread unsigned char scratch[MAX_BLOCK_ACCESS];
+    addr_t address = (addr_t) access->address & mask;
+    uint32_t size = access->size, i;
+
+    if (size == 4 && address < mask - 2) {
+        if (access->is_write)
+            write_word(p_mem, address, 0);
+        else
+            read_word(p_mem, address);
+    }
+    else if (size <= MAX_BLOCK_ACCESS && size - 1 <= mask - address) {
+        if (access->is_write)
+            write_block(p_mem, address, scratch, size);
+        else
+            read_block(p_mem, address, scratch, size);
+    }
+    else {
+        /* Huge, or wraps around the end of the simulated memory. */
+        for (i = 0; i < size; i++) {
+            if (access->is_write)
+                write_byte(p_mem, (address + i) & mask, 0);
+            else
+                read_byte(p_mem, (address + i) & mask);
+        }
+    }
+}
+
+
+/* This function is run by the thread of each shard.  It simulates batches
+ * of accesses as they are queued, until there are no more.
+ */
+void * run_shard(void *arg) {
+    shard_t *p_shard = (shard_t *) arg;
+    memaccess_t *batch;
+    uint32_t slot, i;
+
+    while (1) {
+        pthread_mutex_lock(&p_shard->lock);
+        while (p_shard->tail == p_shard->head && !p_shard->done)
+            pthread_cond_wait(&p_shard->cond, &p_shard->lock);
+        if (p_shard->tail == p_shard->head) {
+            pthread_mutex_unlock(&p_shard->lock);
+            return NULL;
+        }
+        slot = p_shard->tail % SHARD_QUEUE_DEPTH;
+        pthread_mutex_unlock(&p_shard->lock);
+
+        batch = p_shard->batches + slot * SHARD_BATCH_SIZE;
+        for (i = 0; i < p_shard->counts[slot]; i++)
+            simulate_access(p_shard->p_mem, batch + i, p_shard->mask);
+
+        pthread_mutex_lock(&p_shard->lock);
+        p_shard->tail++;
+        pthread_cond_signal(&p_shard->cond);
+        pthread_mutex_unlock(&p_shard->lock);
+    }
+}
+
+
+/* Hands the batch being filled to the shard's thread, then waits until
+ * there is a free slot for the next one.
+ */
+void submit_batch(shard_t *p_shard) {
+    pthread_mutex_lock(&p_shard->lock);
+    p_shard->counts[p_shard->head % SHARD_QUEUE_DEPTH] = p_shard->filled;
+    p_shard->head++;
+    p_shard->filled = 0;
+    pthread_cond_signal(&p_shard->cond);
+
+    while (p_shard->head - p_shard->tail == SHARD_QUEUE_DEPTH)
+        pthread_cond_wait(&p_shard->cond, &p_shard->lock);
+    pthread_mutex_unlock(&p_shard->lock);
+}
+
+
+/* Adds an access to the batch being filled for a shard. */
+void queue_access(shard_t *p_shard, addr_t address, uint32_t size,
+                  int is_write) {
+    memaccess_t *p_access = p_shard->batches +
+        (p_shard->head % SHARD_QUEUE_DEPTH) * SHARD_BATCH_SIZE +
+        p_shard->filled;
+
+    p_access->address = address;
+    p_access->size = size;
+    p_access->is_write = is_write;
+
+    p_shard->filled++;
+    if (p_shard->filled == SHARD_BATCH_SIZE)
+        submit_batch(p_shard);
+}
+
+
+/* Sends a trace access to the shards.  An access spanning several regions
+ * is split at the region boundaries, which are also block boundaries in
+ * every cache, so each cache sees the same accesses to its lines as it
+ * would in a serial simulation; accesses that simulate_access() performs a
+ * byte at a time are sent a byte at a time for the same reason.
+ */
+void shard_access(shardset_t *p_set, memaccess_t *access, addr_t mask) {
+    addr_t address = (addr_t) access->address & mask;
+    addr_t region_size = (addr_t) 1 << p_set->shard_bits;
+    uint32_t size = access->size, chunk, i;
+    shard_t *p_shard;
+
+    if (size <= MAX_BLOCK_ACCESS && size - 1 <= mask - address) {
+        while (size > 0) {
+            chunk = region_size - (address & (region_size - 1));
+            if (chunk > size)
+                chunk = size;
+
+            p_shard = p_set->shards + ((address >> p_set->shard_bits) &
+                                       p_set->key_mask) % p_set->num_shards;
+            queue_access(p_shard, address, chunk, access->is_write);
+
+            address += chunk;
+            size -= chunk;
+        }
+    }
+    else {
+        for (i = 0; i < size; i++) {
+            addr_t byte_address = (address + i) & mask;
+
+            p_shard = p_set->shards + ((byte_address >> p_set->shard_bits) &
+                                       p_set->key_mask) % p_set->num_shards;
+            queue_access(p_shard, byte_address, 1, access->is_write);
+        }
+    }
+}
+
+
+/* Maps a trace access into the simulated memory and performs it, on the
+ * shards if p_shards isn't NULL.  The access is mapped a frame at a time,
+ * since neighboring trace frames needn't be neighbors in the simulated
+ * memory.
+ */
+void map_access(pagemap_t *p_map, memaccess_t *access, membase_t *p_mem,
+                shardset_t *p_shards, addr_t mask) {
+    uint64_t address = access->address, end = address + access->size;
+    uint64_t frame_mask = ((uint64_t) 1 << p_map->frame_bits) - 1;
+    uint64_t chunk_end;
+    memaccess_t piece;
+
+    piece.is_write = access->is_write;
+    while (address < end) {
+        chunk_end = (address | frame_mask) + 1;
+        if (chunk_end > end || chunk_end == 0)
+            chunk_end = end;
+
+        piece.address = map_trace_address(p_map, address);
+        piece.size = (uint32_t) (chunk_end - address);
+        if (p_shards != NULL)
+            shard_access(p_shards, &piece, mask);
+        else
+            simulate_access(p_mem, &piece, mask);
+
+        address = chunk_end;
+    }
+}
+
+
+/* Returns log_2 of the frames the trace is mapped in:  the largest span of
+ * the sets of the caches given by the specifications, but at least
+ * 2^MIN_FRAME_BITS bytes.  Invalid specifications are left to
+ * make_cached_memory() to report.
+ */
+uint32_t choose_frame_bits(int num_specs, const char **specs) {
+    uint32_t frame_bits = MIN_FRAME_BITS, block_size, num_sets, bits;
+    int i;
+
+    for (i = 0; i < num_specs; i++) {
+        if (sscanf(specs[i], "%u:%u", &block_size, &num_sets) == 2 &&
+            is_power_of_2(block_size) && is_power_of_2(num_sets)) {
+            bits = log_2(block_size) + log_2(num_sets);
+            if (bits > frame_bits)
+                frame_bits = bits;
+        }
+    }
+    return frame_bits;
+}
+
+
+/* Sets up a parallel simulation with up to num_threads shards.  p_mem is
+ * the hierarchy for the first shard, with num_levels caches in front of the
+ * memory; the other shards get copies of it.  Returns 0 on success, or -1
+ * if the hierarchy can't be divided into shards.
+ */
+int start_shards(shardset_t *p_set, membase_t *p_mem, uint32_t num_levels,
+                 uint32_t num_threads, uint32_t mem_size, addr_t mask) {
+    cache_t **levels;
+    cache_t *p_cache;
+    memory_t *p_memory, *p_model;
+    membase_t *p_next;
+    uint32_t level, top_bits, min_top_bits = 31, i;
+    int key_bits;
+
+    levels = malloc(num_levels * sizeof(cache_t *));
+    p_set->shard_bits = 0;
+    p_next = p_mem;
+    for (level = 0; level < num_levels; level++) {
+        p_cache = (cache_t *) p_next;
+        levels[level] = p_cache;
+        p_next = p_cache->next_memory;
+
+        if (p_cache->prefetcher != NULL || p_cache->wc_entries > 0 ||
+            p_cache->vc_entries > 0 || p_cache->profile->classify) {
+            printf("ERROR:  caches with prefetchers, write-combining buffers, "
+                   "victim caches or\n        3C classification can't be "
+                   "simulated in parallel.\n");
+            free(levels);
+            return -1;
+        }
+
+        if (p_cache->block_offset_bits > p_set->shard_bits)
+            p_set->shard_bits = p_cache->block_offset_bits;
+        top_bits = p_cache->block_offset_bits + p_cache->sets_addr_bits;
+        if (top_bits < min_top_bits)
+            min_top_bits = top_bits;
+    }
+    p_model = (memory_t *) p_next;
+
+    /* Regions are the largest block size, and only the set-index bits
+     * shared by every cache can pick the shard.
+     */
+    key_bits = (int) min_top_bits - (int) p_set->shard_bits;
+    if (key_bits < 0)
+        key_bits = 0;
+    if (key_bits > log_2(MAX_THREADS))
+        key_bits = log_2(MAX_THREADS);
+    p_set->key_mask = ((addr_t) 1 << key_bits) - 1;
+
+    p_set->num_shards = num_threads;
+    if (p_set->num_shards > p_set->key_mask + 1) {
+        p_set->num_shards = p_set->key_mask + 1;
+        printf("The caches only divide into %u shard%s.\n",
+               p_set->num_shards, (p_set->num_shards == 1) ? "" : "s");
+    }
+    p_set->num_levels = num_levels;
+    p_set->shards = calloc(p_set->num_shards, sizeof(shard_t));
+
+    for (i = 0; i < p_set->num_shards; i++) {
+        shard_t *p_shard = p_set->shards + i;
+
+        if (i == 0) {
+            p_shard->p_mem = p_mem;
+        }
+        else {
+            p_memory = malloc(sizeof(memory_t));
+            init_memory(p_memory, mem_size);
+            set_memory_timing(p_memory, p_model->latency,
+                              p_model->bytes_per_cycle);
+            p_next = (membase_t *) p_memory;
+            for (level = num_levels; level-- > 0; ) {
+                p_cache = malloc(sizeof(cache_t));
+                init_cache_like(p_cache, levels[level], p_next);
+                if (level + 1 < num_levels)
+                    add_upper_cache((cache_t *) p_next, p_cache);
+                p_next = (membase_t *) p_cache;
+            }
+            p_shard->p_mem = p_next;
+        }
+
+        p_shard->mask = mask;
+        p_shard->batches = malloc(SHARD_QUEUE_DEPTH * SHARD_BATCH_SIZE *
+                                  sizeof(memaccess_t));
+        pthread_mutex_init(&p_shard->lock, NULL);
+        pthread_cond_init(&p_shard->cond, NULL);
+        pthread_create(&p_shard->thread, NULL, run_shard, p_shard);
+    }
+
+    printf("Simulating %u shard%s in parallel.\n", p_set->num_shards,
+           (p_set->num_shards == 1) ? "" : "s");
+
+    free(levels);
+    return 0;
+}
+
+
+/* Waits for the shards to simulate everything queued for them, then adds
+ * the statistics and clocks of every shard's hierarchy into the first
+ * shard's, and frees the others.
+ */
+void finish_shards(shardset_t *p_set) {
+    membase_t *p_total, *p_mem, *p_next;
+    uint32_t i, level;
+
+    for (i = 0; i < p_set->num_shards; i++) {
+        shard_t *p_shard = p_set->shards + i;
+
+        if (p_shard->filled > 0)
+            submit_batch(p_shard);
+
+        pthread_mutex_lock(&p_shard->lock);
+        p_shard->done = 1;
+        pthread_cond_signal(&p_shard->cond);
+        pthread_mutex_unlock(&p_shard->lock);
+    }
+
+    for (i = 0; i < p_set->num_shards; i++) {
+        shard_t *p_shard = p_set->shards + i;
+
+        pthread_join(p_shard->thread, NULL);
+        pthread_mutex_destroy(&p_shard->lock);
+        pthread_cond_destroy(&p_shard->cond);
+        free(p_shard->batches);
+        if (i == 0)
+            continue;
+
+        p_total = p_set->shards[0].p_mem;
+        p_mem = p_shard->p_mem;
+        p_total->time += p_mem->time;
+        for (level = 0; level < p_set->num_levels; level++) {
+            add_cache_stats((cache_t *) p_total, (cache_t *) p_mem);
+            p_total = ((cache_t *) p_total)->next_memory;
+            p_next = ((cache_t *) p_mem)->next_memory;
+            p_mem->free(p_mem);
+            free(p_mem);
+            p_mem = p_next;
+        }
+        p_total->num_reads += p_mem->num_reads;
+        p_total->num_writes += p_mem->num_writes;
+        ((memory_t *) p_total)->total_latency +=
+            ((memory_t *) p_mem)->total_latency;
+        p_mem->free(p_mem);
+        free(p_mem);
+    }
+
+    free(p_set->shards);
+}
+
+
+double now_sec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main(int argc, const char **argv) {
+    const char *trace_path = "-";
+    uint32_t mem_size = DEFAULT_MEM_SIZE;
+    uint64_t max_accesses = 0, num_accesses = 0, num_reads = 0, num_writes = 0;
+    uint64_t num_bytes = 0;
+    uint32_t num_threads = 1;
+    shardset_t shards;
+    FILE *file;
+    memtrace_reader_t *reader;
+    lookahead_t lookahead;
+    pagemap_t map;
+    uint32_t window = DEFAULT_WINDOW, granule_size = 0;
+    memaccess_t access;
+    membase_t *p_mem;
+    addr_t mask;
+    double start, elapsed;
+    int opt, result, i;
+
+    while ((opt = getopt(argc, (char * const *) argv, "t:m:n:l:j:s:M:T:P:")) != -1) {
+        switch (opt) {
+        case 't':
+            trace_path = optarg;
+            break;
+
+        case 'm':
+            mem_size = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'n':
+            max_accesses = strtoull(optarg, NULL, 0);
+            break;
+
+        case 'l':
+            window = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'j':
+            num_threads = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            set_stats_file(optarg);
+            break;
+
+        case 'M':
+            if (parse_memory_timing(optarg) != 0) {
+                tracesim_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        case 'T':
+        case 'P':
+            if ((opt == 'T') ? parse_tlb_spec(optarg) != 0 :
+                               parse_page_size(optarg) != 0) {
+                tracesim_usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        default:
+            tracesim_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (window == 0) {
+        tracesim_usage(argv[0]);
+        return 1;
+    }
+    if (num_threads == 0 || num_threads > MAX_THREADS) {
+        printf("ERROR:  the number of threads must be from 1 to %d.\n",
+               MAX_THREADS);
+        tracesim_usage(argv[0]);
+        return 1;
+    }
+    if (num_threads > 1 && optind == argc) {
+        printf("ERROR:  there are no caches to simulate in parallel.\n");
+        tracesim_usage(argv[0]);
+        return 1;
+    }
+    if (mem_size == 0 || !is_power_of_2(mem_size) || mem_size > (1U << 31)) {
+        printf("ERROR:  memory size must be a power of 2, up to 2^31.\n");
+        tracesim_usage(argv[0]);
+        return 1;
+    }
+
+    if (strcmp(trace_path, "-") == 0)
+        file = stdin;
+    else
+        file = fopen(trace_path, "rb");
+
+    reader = malloc(sizeof(memtrace_reader_t));
+    if (file == NULL || reader == NULL ||
+        memtrace_open_reader(reader, file) != 0) {
+        printf("ERROR:  couldn't read a trace from %s.\n", trace_path);
+        return 1;
+    }
+
+    mask = mem_size - 1;
+
+    if (init_page_map(&map, choose_frame_bits(argc - optind, argv + optind),
+                      mem_size) != 0) {
+        printf("ERROR:  out of memory for the page map.\n");
+        return 1;
+    }
+    if (map.num_frames == 0) {
+        printf("ERROR:  the memory must be at least as large as the span of "
+               "each cache's\n        sets, %u bytes.\n",
+               1U << map.frame_bits);
+        tracesim_usage(argv[0]);
+        return 1;
+    }
+
+    /* If any cache uses Belady's policy, read ahead in the trace to see the
+     * next uses of blocks.  Granules are the smallest block size of any
+     * cache, so every block covers whole granules.
+     */
+    for (i = optind; i < argc; i++) {
+        if (strstr(argv[i], ":opt") != NULL) {
+            granule_size = (uint32_t) -1;
+            break;
+        }
+    }
+    if (granule_size != 0 && num_threads > 1) {
+        printf("ERROR:  the opt policy can't be simulated in parallel.\n");
+        tracesim_usage(argv[0]);
+        return 1;
+    }
+    if (granule_size != 0) {
+        for (i = optind; i < argc; i++) {
+            uint32_t block_size = strtoul(argv[i], NULL, 10);
+            if (block_size > 0 && is_power_of_2(block_size) &&
+                block_size < granule_size)
+                granule_size = block_size;
+        }
+        if (!is_power_of_2(granule_size) ||
+            init_lookahead(&lookahead, reader, &map, granule_size,
+                           window) != 0) {
+            printf("ERROR:  couldn't read ahead in the trace.\n");
+            return 1;
+        }
+        set_next_use_oracle(lookahead_next_use, &lookahead);
+    }
+
+    /* The remaining arguments are the cache specifications.  Traces don't
+     * record values, so the caches needn't keep any data, and since only
+     * zeros are written, the memory is never allocated.
+     */
+    set_tag_only_caches();
+    argv[optind - 1] = argv[0];
+    p_mem = make_cached_memory(argc - optind + 1, argv + optind - 1,
+                               mem_size);
+
+    /* Page walks aren't in the trace, so the opt policy can't see them
+     * coming, and the shards only copy the caches.
+     */
+    if (get_tlb() != NULL && (granule_size != 0 || num_threads > 1)) {
+        printf("ERROR:  a TLB can't be simulated with the opt policy, or in "
+               "parallel.\n");
+        tracesim_usage(argv[0]);
+        return 1;
+    }
+
+    /* Frames must also cover whole pages of the TLB.  No accesses have been
+     * mapped yet, since there is no lookahead with a TLB.
+     */
+    if (get_tlb() != NULL && get_tlb()->page_bits > map.frame_bits) {
+        free_page_map(&map);
+        if (init_page_map(&map, get_tlb()->page_bits, mem_size) != 0 ||
+            map.num_frames == 0) {
+            printf("ERROR:  the memory must hold at least one page of the "
+                   "TLB.\n");
+            return 1;
+        }
+    }
+
+    if (num_threads > 1 &&
+        start_shards(&shards, p_mem, argc - optind, num_threads, mem_size,
+                     mask) != 0) {
+        tracesim_usage(argv[0]);
+        return 1;
+    }
+
+    printf("Simulating the trace.\n");
+
+    start = now_sec();
+    while (max_accesses == 0 || num_accesses < max_accesses) {
+        if (granule_size != 0)
+            result = lookahead_next(&lookahead, &access);
+        else
+            result = memtrace_read(reader, &access);
+        if (result <= 0)
+            break;
+
+        map_access(&map, &access, p_mem, (num_threads > 1) ? &shards : NULL,
+                   mask);
+        if (access.is_write)
+            num_writes++;
+        else
+            num_reads++;
+        num_bytes += access.size;
+        num_accesses++;
+    }
+    if (num_threads > 1)
+        finish_shards(&shards);
+    elapsed = now_sec() - start;
+
+    if (result < 0)
+        printf("Stopping at the malformed part of the trace.\n");
+
+    printf("\nTrace:  %llu accesses (%llu reads, %llu writes), %llu bytes\n",
+           num_accesses, num_reads, num_writes, num_bytes);
+    printf("Simulation time:  %.3f sec, %.2f million accesses/sec\n", elapsed,
+           (elapsed > 0) ? num_accesses / elapsed / 1e6 : 0.0);
+
+    printf("\nMemory-Access Statistics:\n\n");
+    p_mem->print_stats(p_mem);
+    printf("\n");
+    print_timing_summary(p_mem);
+    printf("\n");
+    write_stats_file(p_mem);
+
+    if (granule_size != 0)
+        free_lookahead(&lookahead);
+    free_page_map(&map);
+    if (file != stdin)
+        fclose(file);
+    free(reader);
+
+    return (result < 0) ? 1 : 0;
+}